@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <math.h>
 #include <canutil/read.h>
 #include <pb_encode.h>
 #include "can/canread.h"
@@ -16,11 +17,24 @@ using openxc::pipeline::publish;
 namespace pipeline = openxc::pipeline;
 namespace time = openxc::util::time;
 
+uint64_t openxc::can::read::loadPayload(const CanMessage* message) {
+    uint64_t payload = 0;
+    for(int i = 0; i < CAN_MESSAGE_SIZE; i++) {
+        payload = (payload << 8) | message->data[i];
+    }
+    return payload;
+}
+
+float openxc::can::read::parseSignalBitfield(const CanSignal* signal,
+        uint64_t payload) {
+    // Same arithmetic as bitfield_parse_float, so the results are identical
+    return extractBitfield(payload, signal->bitPosition, signal->bitSize) *
+            signal->factor + signal->offset;
+}
+
 float openxc::can::read::parseSignalBitfield(const CanSignal* signal,
         const CanMessage* message) {
-    return bitfield_parse_float(message->data, CAN_MESSAGE_SIZE,
-            signal->bitPosition, signal->bitSize, signal->factor,
-            signal->offset);
+    return parseSignalBitfield(signal, loadPayload(message));
 }
 
 openxc_DynamicField openxc::can::read::noopDecoder(const CanSignal* signal,
@@ -164,8 +178,13 @@ void openxc::can::read::passthroughMessage(CanBus* bus, CanMessage* message,
 void openxc::can::read::translateSignal(const CanSignal* signal, CanMessage* message,
         const CanSignal* signals, SignalManager* signalManagers, int signalCount,
         openxc::pipeline::Pipeline* pipeline) {
-    SignalManager* signalManager = lookupSignalManagerDetails(signal->genericName, signalManagers, signalCount);
-    if(signal == NULL || message == NULL || signalManager == NULL) {
+    if(signal == NULL || message == NULL) {
+        return;
+    }
+
+    SignalManager* signalManager = lookupSignalManager(signal, signals,
+            signalManagers, signalCount);
+    if(signalManager == NULL) {
         return;
     }
 
@@ -186,17 +205,120 @@ void openxc::can::read::translateSignal(const CanSignal* signal, CanMessage* mes
 
 
 
+/* Private: Return true if any of a message's signals must see it decoded even
+ * though it hasn't changed - because it opted out, hasn't been received yet,
+ * would publish the same value again now or has a value held back by its send
+ * filter.
+ */
+static bool signalsNeedDecoding(const CanMessageDefinition* definition,
+        const CanSignal* signals, SignalManager* signalManagers,
+        int signalCount) {
+    for(int i = 0; i < definition->signalSpan; i++) {
+        const CanSignal* signal = &definition->firstSignal[i];
+        if(signal->message != definition) {
+            continue;
+        }
+
+        if(signal->decodeUnchanged) {
+            return true;
+        }
+
+        SignalManager* signalManager = openxc::can::lookupSignalManager(signal,
+                signals, signalManagers, signalCount);
+        if(signalManager != NULL && (!signalManager->received ||
+                    signalManager->sendPending || (signal->sendSame &&
+                        time::elapsed(&signalManager->frequencyClock, false)))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool openxc::can::read::shouldDecodeMessage(CanMessageDefinition* definition,
+        const CanMessage* message, const CanSignal* signals,
+        SignalManager* signalManagers, int signalCount) {
+    if(definition == NULL) {
+        return true;
+    }
+
+    bool decode = !definition->decoded || definition->decodeUnchanged ||
+            definition->firstSignal == NULL ||
+            definition->bus->passthroughCanMessages ||
+            message->length != definition->lastDecodedLength ||
+            memcmp(message->data, definition->lastDecodedValue,
+                    CAN_MESSAGE_SIZE) ||
+            signalsNeedDecoding(definition, signals, signalManagers,
+                    signalCount);
+
+    if(decode) {
+        definition->decoded = true;
+        memcpy(definition->lastDecodedValue, message->data, CAN_MESSAGE_SIZE);
+        definition->lastDecodedLength = message->length;
+        ++definition->decodedCount;
+    } else {
+        ++definition->skippedCount;
+    }
+    return decode;
+}
+
+/* Private: Return true if a value is outside all of a filter's deadbands of
+ * the last value published.
+ */
+static bool outsideDeadbands(const SignalSendFilter* filter,
+        SignalManager* signalManager, float value) {
+    float change = fabs(value - signalManager->lastSentValue);
+    if(filter->deadband > 0 && change <= filter->deadband) {
+        return false;
+    }
+
+    return filter->deadbandPercent == 0 || change >
+            fabs(signalManager->lastSentValue) * filter->deadbandPercent / 100;
+}
+
+/* Private: Return true if enough time has passed since the last value was
+ * published to publish another.
+ */
+static bool sendIntervalElapsed(const SignalSendFilter* filter,
+        SignalManager* signalManager) {
+    return filter->minSendInterval == 0 ||
+            time::systemTimeMs() - signalManager->lastSentTime >=
+                filter->minSendInterval;
+}
+
 bool openxc::can::read::shouldSend(const CanSignal* signal, SignalManager* signalManager, float value) {
+    // A value held back by the send filter counts as a change until it's
+    // published, even though it's the last value received.
+    bool changed = value != signalManager->lastValue ||
+            (signalManager->sendPending &&
+                value != signalManager->lastSentValue);
     bool send = true;
     if(time::conditionalTick((time::FrequencyClock*) &signalManager->frequencyClock) ||
-            (value != signalManager->lastValue && signal->forceSendChanged)) {
-        if(signalManager->received && !signal->sendSame
-                && value == signalManager->lastValue) {
+            (changed && signal->forceSendChanged)) {
+        if(signalManager->received && !signal->sendSame && !changed) {
             send = false;
         }
     } else {
         send = false;
     }
+
+    if(send && signalManager->sent) {
+        const SignalSendFilter* filter = signalManager->sendFilterOverridden ?
+                &signalManager->sendFilter : &signal->sendFilter;
+        bool elapsed = sendIntervalElapsed(filter, signalManager);
+        send = outsideDeadbands(filter, signalManager, value);
+        signalManager->sendPending = send && !elapsed &&
+                value != signalManager->lastSentValue;
+        send = send && elapsed;
+    }
+
+    if(send) {
+        signalManager->sent = true;
+        signalManager->lastSentValue = value;
+        signalManager->lastSentTime = time::systemTimeMs();
+        ++signalManager->publishedCount;
+    } else {
+        ++signalManager->suppressedCount;
+    }
     return send;
 }
 
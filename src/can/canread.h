@@ -30,6 +30,31 @@ void translateSignal(const CanSignal* signal,
         CanMessage* message, const CanSignal* signals, SignalManager* signalManagers, int signalCount,
         openxc::pipeline::Pipeline* pipeline);
 
+/* Public: Decide if a received CAN message needs to be decoded, or if it's the
+ * same as the last one and decoding it couldn't publish anything new.
+ *
+ * A message is skipped only if its data is identical to the last one decoded
+ * and none of its signals would publish the same value again right now - they
+ * have all been received before, and any that has sendSame set isn't due to
+ * send by its frequency yet. Messages without any signals, on a bus passing
+ * through raw CAN messages, or with decodeUnchanged set on the definition or
+ * any of its signals are always decoded.
+ *
+ * The definition's decodedCount or skippedCount is incremented, and if the
+ * message is to be decoded it's remembered for next time.
+ *
+ * definition - The definition of the message, or NULL if it has none.
+ * message - The received CAN message.
+ * signals - an array of all active signals.
+ * signalManagers - The managers for the signals array.
+ * signalCount - The length of the signals array.
+ *
+ * Returns true if the message should be passed to decodeCanMessage.
+ */
+bool shouldDecodeMessage(CanMessageDefinition* definition,
+        const CanMessage* message, const CanSignal* signals,
+        SignalManager* signalManagers, int signalCount);
+
 /* Public: Publish a CAN message to the pipeline without any parsing or
  * processing - just encapsulate it in a VehicleMessage.
  *
@@ -202,6 +227,55 @@ openxc_DynamicField noopDecoder(const CanSignal* signal, const CanSignal* signal
  */
 float parseSignalBitfield(const CanSignal* signal, const CanMessage* message);
 
+/* Public: The same as parseSignalBitfield(CanSignal*, CanMessage*), but from
+ * data already loaded with loadPayload. Parsing each signal of a message this
+ * way reads the data once instead of bit by bit for every signal.
+ */
+float parseSignalBitfield(const CanSignal* signal, uint64_t payload);
+
+/* Public: Load the data of a CAN message into a single 64-bit word for
+ * extractBitfield.
+ *
+ * The first byte of the data is the most significant byte of the word, so bit
+ * position 0 (the most significant bit of the first byte) is the word's most
+ * significant bit, the same numbering CanSignal uses. All CAN_MESSAGE_SIZE
+ * bytes are loaded regardless of the message's length.
+ */
+uint64_t loadPayload(const CanMessage* message);
+
+/* Public: Return a bitfield from data loaded with loadPayload, right aligned.
+ *
+ * This gives the same result as bitfield-c's get_bitfield on the message's
+ * data, including 0 for a bitfield that doesn't fit in the data.
+ *
+ * bitPosition - The starting bit of the bitfield, where 0 is the most
+ *      significant bit of the first byte of the message.
+ * bitSize - The width of the bitfield, from 1 to 64.
+ */
+inline uint64_t extractBitfield(uint64_t payload, uint8_t bitPosition,
+        uint8_t bitSize) {
+    if(bitSize == 0 || bitPosition + bitSize > CAN_MESSAGE_SIZE * 8) {
+        return 0;
+    }
+    return (payload << bitPosition) >> (CAN_MESSAGE_SIZE * 8 - bitSize);
+}
+
+/* Public: The same as extractBitfield, for a bitfield layout that's known at
+ * compile time, e.g. in a custom handler:
+ *
+ *      uint64_t raw = extractBitfield<12, 4>(loadPayload(message));
+ *
+ * The shift and mask are constants, so this compiles down to a couple of
+ * instructions, and a layout that doesn't fit in a CAN message won't compile.
+ */
+template<uint8_t BitPosition, uint8_t BitSize>
+inline uint64_t extractBitfield(uint64_t payload) {
+    static_assert(BitSize > 0 && BitPosition + BitSize <= CAN_MESSAGE_SIZE * 8,
+            "bitfield must fit in a CAN message");
+    return (payload >> (CAN_MESSAGE_SIZE * 8 - BitPosition - BitSize)) &
+            (~0ULL >> (CAN_MESSAGE_SIZE * 8 - BitSize));
+}
+
 /* Public: Parse a signal from a CAN message and apply any required
  * transforations to get a human readable value.
  *
@@ -240,7 +314,14 @@ openxc_DynamicField decodeSignal(const CanSignal* signal, const CanSignal* signa
  *
  * A signal may decide not to publish if it has a limited frequency and the
  * timer hasn't expired yet, or if it's configured to only send if the value
- * changes and the it has not.
+ * changes and the it has not. Once a value has been published, the next is
+ * also held back if it's within the signal's send filter deadbands of it or
+ * too soon after it. A changed value held back only because it came too soon
+ * is still published once enough time has passed, even if it doesn't change
+ * again.
+ *
+ * The value is recorded in the signal manager as published if this returns
+ * true, so the caller must publish it.
  *
  * Returns true of the value should be published.
  */
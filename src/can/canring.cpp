@@ -0,0 +1,65 @@
+#include "can/canring.h"
+
+/* The producer and consumer each only write their own index, but the message
+ * copy has to be complete before the index that hands it over is published.
+ * The barrier keeps both the compiler and the CPU from reordering them - on
+ * the single core PIC32 and LPC17xx it's little more than a compiler barrier,
+ * and it also makes the ring safe for the host tests' producer thread.
+ */
+#define CAN_RING_BARRIER() __sync_synchronize()
+
+uint16_t openxc::can::ring::initialize(CanRing* ring, uint16_t size) {
+    if(size == 0 || size > CAN_RECEIVE_RING_MAX_SIZE ||
+            (size & (size - 1)) != 0) {
+        size = CAN_RECEIVE_RING_MAX_SIZE;
+    }
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->highWatermark = 0;
+    ring->overflows = 0;
+    return size;
+}
+
+bool openxc::can::ring::push(CanRing* ring, const CanMessage* message) {
+    uint16_t tail = ring->tail;
+    uint16_t waiting = tail - ring->head;
+    if(waiting >= ring->size) {
+        ++ring->overflows;
+        return false;
+    }
+
+    ring->messages[tail & (ring->size - 1)] = *message;
+    CAN_RING_BARRIER();
+    ring->tail = tail + 1;
+
+    if(waiting + 1 > ring->highWatermark) {
+        ring->highWatermark = waiting + 1;
+    }
+    return true;
+}
+
+bool openxc::can::ring::pop(CanRing* ring, CanMessage* message) {
+    uint16_t head = ring->head;
+    if(head == ring->tail) {
+        return false;
+    }
+
+    CAN_RING_BARRIER();
+    *message = ring->messages[head & (ring->size - 1)];
+    CAN_RING_BARRIER();
+    ring->head = head + 1;
+    return true;
+}
+
+uint16_t openxc::can::ring::length(const CanRing* ring) {
+    return (uint16_t)(ring->tail - ring->head);
+}
+
+bool openxc::can::ring::empty(const CanRing* ring) {
+    return ring->head == ring->tail;
+}
+
+bool openxc::can::ring::full(const CanRing* ring) {
+    return length(ring) >= ring->size;
+}
@@ -0,0 +1,53 @@
+#ifndef __CANRING_H__
+#define __CANRING_H__
+
+#include <stdint.h>
+#include "can/canutil.h"
+
+namespace openxc {
+namespace can {
+namespace ring {
+
+/* Public: Empty the ring and reset its counters.
+ *
+ * size - The number of messages the ring should hold. If this isn't a power of
+ *      2 from 1 to CAN_RECEIVE_RING_MAX_SIZE, the ring gets
+ *      CAN_RECEIVE_RING_MAX_SIZE.
+ *
+ * Returns the size used.
+ */
+uint16_t initialize(CanRing* ring, uint16_t size);
+
+/* Public: Copy a message onto the tail of the ring. Only the producer (the CAN
+ * interrupt handler) may call this.
+ *
+ * Returns true if the message was added, or false if the ring was full and the
+ * message was dropped and counted in the ring's overflows.
+ */
+bool push(CanRing* ring, const CanMessage* message);
+
+/* Public: Copy the message at the head of the ring out and remove it. Only the
+ * consumer (the main loop) may call this.
+ *
+ * Returns true if a message was waiting.
+ */
+bool pop(CanRing* ring, CanMessage* message);
+
+/* Public: Return the number of messages waiting in the ring. Either side may
+ * call this, but the other may change it at any time.
+ */
+uint16_t length(const CanRing* ring);
+
+/* Public: Return true if no messages are waiting in the ring.
+ */
+bool empty(const CanRing* ring);
+
+/* Public: Return true if the ring has no room for another message.
+ */
+bool full(const CanRing* ring);
+
+} // namespace ring
+} // namespace can
+} // namespace openxc
+
+#endif // __CANRING_H__
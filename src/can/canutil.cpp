@@ -1,4 +1,5 @@
 #include "can/canutil.h"
+#include "can/canring.h"
 #include "can/canwrite.h"
 #include "util/log.h"
 #include "config.h"
@@ -9,15 +10,47 @@
 namespace time = openxc::util::time;
 namespace statistics = openxc::util::statistics;
 namespace config = openxc::config;
+namespace ring = openxc::can::ring;
 
 using openxc::util::log::debug;
 using openxc::util::statistics::DeltaStatistic;
 
 const int openxc::can::CAN_ACTIVE_TIMEOUT_S = 30;
 
+/* Private: Rebuild the bus's inactive AcceptanceFilterIndex from its list of
+ * acceptance filters, then swap it in for the active one.
+ *
+ * The interrupt handler only ever reads the active index, and switching which
+ * one is active is a single byte write, so it sees either the complete old set
+ * of filters or the complete new one.
+ */
+static void rebuildAcceptanceFilterIndex(CanBus* bus) {
+    uint8_t inactive = !bus->activeAcceptanceFilterIndex;
+    AcceptanceFilterIndex* index = &bus->acceptanceFilterIndexes[inactive];
+    memset(index->standardIds, 0, sizeof(index->standardIds));
+    index->extendedIdCount = 0;
+
+    AcceptanceFilterListEntry* entry;
+    LIST_FOREACH(entry, &bus->acceptanceFilters, entries) {
+        if(entry->filter < STANDARD_CAN_ID_COUNT) {
+            index->standardIds[entry->filter / 32] |=
+                    (uint32_t)1 << (entry->filter % 32);
+        } else if(index->extendedIdCount < MAX_ACCEPTANCE_FILTERS) {
+            // insertion sort, there are never more than a couple dozen
+            int i = index->extendedIdCount++;
+            for(; i > 0 && index->extendedIds[i - 1] > entry->filter; i--) {
+                index->extendedIds[i] = index->extendedIds[i - 1];
+            }
+            index->extendedIds[i] = entry->filter;
+        }
+    }
+
+    bus->activeAcceptanceFilterIndex = inactive;
+}
+
 void openxc::can::initializeCommon(CanBus* bus) {
     debug("Initializing CAN node %d...", bus->address);
-    QUEUE_INIT(CanMessage, &bus->receiveQueue);
+    ring::initialize(&bus->receiveQueue, bus->receiveQueueSize);
     QUEUE_INIT(CanMessage, &bus->sendQueue);
 
     LIST_INIT(&bus->acceptanceFilters);
@@ -26,11 +59,14 @@ void openxc::can::initializeCommon(CanBus* bus) {
         LIST_INSERT_HEAD(&bus->freeAcceptanceFilters,
                 &bus->acceptanceFilterEntries[i], entries);
     }
+    rebuildAcceptanceFilterIndex(bus);
 
     bus->writeHandler = openxc::can::write::sendMessage;
     bus->lastMessageReceived = 0;
     LIST_INIT(&bus->dynamicMessages);
     LIST_INIT(&bus->freeMessageDefinitions);
+    memset(&bus->messageDefinitionIndex, 0,
+            sizeof(bus->messageDefinitionIndex));
     for(size_t i = 0; i < MAX_DYNAMIC_MESSAGE_COUNT; i++) {
         //(bus->definitionEntries[i].definition) = (CanMessageDefinition*) malloc(sizeof(CanMessageDefinition));
         LIST_INSERT_HEAD(&bus->freeMessageDefinitions,
@@ -124,6 +160,16 @@ const CanSignal* openxc::can::lookupSignal(const char* name, const CanSignal* si
     return lookupSignal(name, signals, signalCount, false);
 }
 
+const CanSignal* openxc::can::lookupSignal(SignalBinding* binding,
+        const CanSignal* signals, int signalCount) {
+    if(binding->signals != signals) {
+        binding->signal = lookupSignal(binding->genericName, signals,
+                signalCount);
+        binding->signals = signals;
+    }
+    return binding->signal;
+}
+
 SignalManager* openxc::can::lookupSignalManagerDetails(const char* signalName, SignalManager* signalManagers, int signalCount) {
     for (int i = 0; i < signalCount; i++) {
         if (strcmp(signalManagers[i].signal->genericName, signalName) == 0) {
@@ -134,6 +180,65 @@ SignalManager* openxc::can::lookupSignalManagerDetails(const char* signalName, S
     return NULL;
 }
 
+void openxc::can::bindSignalManagers(const CanSignal* signals,
+        SignalManager* signalManagers, int signalCount) {
+    for(int i = 0; i < signalCount; i++) {
+        signalManagers[i].binding = lookupSignalManagerDetails(
+                signals[i].genericName, signalManagers, signalCount);
+    }
+}
+
+void openxc::can::bindMessageSignals(const CanSignal* signals,
+        int signalCount) {
+    for(int i = 0; i < signalCount; i++) {
+        CanMessageDefinition* message =
+                (CanMessageDefinition*) signals[i].message;
+        if(message != NULL) {
+            message->firstSignal = NULL;
+            message->signalSpan = 0;
+        }
+    }
+
+    for(int i = 0; i < signalCount; i++) {
+        CanMessageDefinition* message =
+                (CanMessageDefinition*) signals[i].message;
+        if(message == NULL) {
+            continue;
+        }
+
+        if(message->firstSignal == NULL) {
+            message->firstSignal = &signals[i];
+        }
+        message->signalSpan = &signals[i] - message->firstSignal + 1;
+    }
+}
+
+SignalManager* openxc::can::lookupSignalManager(const CanSignal* signal,
+        const CanSignal* signals, SignalManager* signalManagers,
+        int signalCount) {
+    if(signal < signals || signal >= signals + signalCount) {
+        return lookupSignalManagerDetails(signal->genericName, signalManagers,
+                signalCount);
+    }
+
+    SignalManager* signalManager = &signalManagers[signal - signals];
+    if(signalManager->binding == NULL) {
+        signalManager->binding = lookupSignalManagerDetails(
+                signal->genericName, signalManagers, signalCount);
+    }
+    return signalManager->binding;
+}
+
+SignalManager* openxc::can::lookupSignalManager(SignalManagerBinding* binding,
+        SignalManager* signalManagers, int signalCount) {
+    if(binding->signalManagers != signalManagers) {
+        binding->signalManager = lookupSignalManagerDetails(
+                binding->genericName, signalManagers, signalCount);
+        binding->signalManagers = signalManagers;
+    }
+    return binding->signalManager;
+}
+
 static bool commandComparator(void* name, int index, void* commands) {
     return !strcmp((const char*)name,
             ((CanCommand*)commands)[index].genericName);
@@ -165,26 +270,144 @@ static CanMessageDefinition* lookupMessage(CanBus* bus, uint32_t id,
         const CanMessageDefinition* messages, int messageCount) {
     CanMessageDefinition* message = NULL;
     for(int i = 0; i < messageCount; i++) {
-        if(messages[i].bus == bus && messages[i].id == id) {
+        if(messages[i].bus == bus && messages[i].id == id &&
+                messages[i].format == format) {
             message = (CanMessageDefinition*) &messages[i];
         }
     }
     return message;
 }
 
+static CanMessageDefinition* lookupDynamicMessage(CanBus* bus, uint32_t id,
+        CanMessageFormat format) {
+    CanMessageDefinitionListEntry* entry;
+    LIST_FOREACH(entry, &bus->dynamicMessages, entries) {
+        if(entry->definition.id == id && entry->definition.format == format) {
+            return &entry->definition;
+        }
+    }
+    return NULL;
+}
+
+static int indexSlot(uint32_t id, CanMessageFormat format) {
+    // Knuth's multiplicative hash, so nearby IDs land in different slots
+    return ((id ^ ((uint32_t)format << 31)) * 2654435761u >> 16) &
+            (MESSAGE_DEFINITION_INDEX_SIZE - 1);
+}
+
+/* Private: Find the slot in the index holding the definition with this ID and
+ * format, or the empty slot where it would go.
+ */
+static CanMessageDefinition** findIndexSlot(CanMessageDefinitionIndex* index,
+        uint32_t id, CanMessageFormat format) {
+    int slot = indexSlot(id, format);
+    while(index->slots[slot] != NULL && (index->slots[slot]->id != id ||
+                index->slots[slot]->format != format)) {
+        slot = (slot + 1) & (MESSAGE_DEFINITION_INDEX_SIZE - 1);
+    }
+    return &index->slots[slot];
+}
+
+/* Private: Add a definition to the index.
+ *
+ * replace - If a definition with the same ID and format is already in the
+ *      index, replace it with this one.
+ */
+static void addToIndex(CanMessageDefinitionIndex* index,
+        CanMessageDefinition* message, bool replace) {
+    CanMessageDefinition** slot = findIndexSlot(index, message->id,
+            message->format);
+    if(*slot != NULL) {
+        if(replace) {
+            *slot = message;
+        }
+    } else if(index->count >= MESSAGE_DEFINITION_INDEX_SIZE * 3 / 4) {
+        index->overflowed = true;
+    } else {
+        *slot = message;
+        ++index->count;
+    }
+}
+
+/* Private: Remove a definition from the index, if it's the one indexed for its
+ * ID and format.
+ *
+ * The following entries in the probe sequence are shifted back to fill the
+ * gap, so lookups never need to skip over deleted slots.
+ */
+static void removeFromIndex(CanMessageDefinitionIndex* index,
+        CanMessageDefinition* message) {
+    int slot = findIndexSlot(index, message->id, message->format) -
+            index->slots;
+    if(index->slots[slot] != message) {
+        return;
+    }
+
+    index->slots[slot] = NULL;
+    --index->count;
+    int next = (slot + 1) & (MESSAGE_DEFINITION_INDEX_SIZE - 1);
+    while(index->slots[next] != NULL) {
+        CanMessageDefinition* displaced = index->slots[next];
+        int home = indexSlot(displaced->id, displaced->format);
+        // move it back if the gap is between its home slot and where it is
+        bool movable = slot <= next ?
+                (home <= slot || home > next) :
+                (home <= slot && home > next);
+        if(movable) {
+            index->slots[slot] = displaced;
+            index->slots[next] = NULL;
+            slot = next;
+        }
+        next = (next + 1) & (MESSAGE_DEFINITION_INDEX_SIZE - 1);
+    }
+}
+
+static void rebuildMessageDefinitionIndex(CanBus* bus,
+        const CanMessageDefinition* predefinedMessages,
+        int predefinedMessageCount) {
+    CanMessageDefinitionIndex* index = &bus->messageDefinitionIndex;
+    memset(index->slots, 0, sizeof(index->slots));
+    index->count = 0;
+    index->overflowed = false;
+    index->predefinedMessages = predefinedMessages;
+    index->predefinedMessageCount = predefinedMessageCount;
+
+    // The last predefined definition for a message wins, and any predefined
+    // definition wins over a dynamic one, the same as a linear search.
+    for(int i = 0; i < predefinedMessageCount; i++) {
+        if(predefinedMessages[i].bus == bus) {
+            addToIndex(index, (CanMessageDefinition*) &predefinedMessages[i],
+                    true);
+        }
+    }
+
+    CanMessageDefinitionListEntry* entry;
+    LIST_FOREACH(entry, &bus->dynamicMessages, entries) {
+        addToIndex(index, &entry->definition, false);
+    }
+}
+
 CanMessageDefinition* openxc::can::lookupMessageDefinition(CanBus* bus,
         uint32_t id, CanMessageFormat format,
         const CanMessageDefinition* predefinedMessages,
         int predefinedMessageCount) {
-    CanMessageDefinition* message = lookupMessage(bus, id, format,
-            predefinedMessages, predefinedMessageCount);
-    if(message == NULL) {
-        CanMessageDefinitionListEntry* entry;
-        LIST_FOREACH(entry, &bus->dynamicMessages, entries) {
-            if(entry->definition.id == id) {
-                message = &entry->definition;
-                break;
-            }
+    if(predefinedMessages == NULL || predefinedMessageCount <= 0) {
+        return lookupDynamicMessage(bus, id, format);
+    }
+
+    CanMessageDefinitionIndex* index = &bus->messageDefinitionIndex;
+    if(index->predefinedMessages != predefinedMessages ||
+            index->predefinedMessageCount != predefinedMessageCount) {
+        rebuildMessageDefinitionIndex(bus, predefinedMessages,
+                predefinedMessageCount);
+    }
+
+    CanMessageDefinition* message = *findIndexSlot(index, id, format);
+    if(message == NULL && index->overflowed) {
+        message = lookupMessage(bus, id, format, predefinedMessages,
+                predefinedMessageCount);
+        if(message == NULL) {
+            message = lookupDynamicMessage(bus, id, format);
         }
     }
     return message;
@@ -204,8 +427,7 @@ CanBus* openxc::can::lookupBus(uint8_t address, CanBus* buses, const int busCoun
 bool openxc::can::registerMessageDefinition(CanBus* bus, uint32_t id,
         CanMessageFormat format,
         const CanMessageDefinition* predefinedMessages, int predefinedMessageCount) {
-    CanMessageDefinition* message = lookupMessageDefinition(
-            bus, id, format, NULL, 0);
+    CanMessageDefinition* message = lookupDynamicMessage(bus, id, format);
     if(message == NULL && LIST_FIRST(&bus->freeMessageDefinitions) != NULL) {
         CanMessageDefinitionListEntry* entry = LIST_FIRST(
                 &bus->freeMessageDefinitions);
@@ -213,11 +435,13 @@ bool openxc::can::registerMessageDefinition(CanBus* bus, uint32_t id,
 
         entry->definition.bus = bus;
         entry->definition.id = id;
+        entry->definition.format = format;
         entry->definition.frequencyClock = {bus->maxMessageFrequency};
         entry->definition.forceSendChanged = true;
 
         LIST_INSERT_HEAD(&bus->dynamicMessages, entry, entries);
         message = &entry->definition;
+        addToIndex(&bus->messageDefinitionIndex, message, false);
     }
     return message != NULL;
 }
@@ -226,15 +450,23 @@ bool openxc::can::unregisterMessageDefinition(CanBus* bus, uint32_t id,
         CanMessageFormat format) {
     CanMessageDefinitionListEntry* entry, *match = NULL;
     LIST_FOREACH(entry, &bus->dynamicMessages, entries) {
-        if(entry->definition.id == id) {
+        if(entry->definition.id == id && entry->definition.format == format) {
             match = entry;
             break;
         }
     }
 
     if(match != NULL) {
-        LIST_REMOVE(entry, entries);
-        LIST_INSERT_HEAD(&bus->freeMessageDefinitions, entry, entries);
+        LIST_REMOVE(match, entries);
+        LIST_INSERT_HEAD(&bus->freeMessageDefinitions, match, entries);
+        removeFromIndex(&bus->messageDefinitionIndex, &match->definition);
+        // A predefined definition can't have been shadowing it, but another
+        // dynamic one that didn't fit in the index may be waiting for its slot
+        if(bus->messageDefinitionIndex.overflowed) {
+            rebuildMessageDefinitionIndex(bus,
+                    bus->messageDefinitionIndex.predefinedMessages,
+                    bus->messageDefinitionIndex.predefinedMessageCount);
+        }
         return true;
     }
     return false;
@@ -250,6 +482,20 @@ bool openxc::can::signalsWritable(CanBus* bus, const CanSignal* signals,
     return false;
 }
 
+/* Private: Log how many times each message on the bus was decoded, and how many
+ * times it was skipped because it hadn't changed.
+ */
+static void logMessageDecodeStatistics(CanBus* bus) {
+    for(int i = 0; i < MESSAGE_DEFINITION_INDEX_SIZE; i++) {
+        CanMessageDefinition* message = bus->messageDefinitionIndex.slots[i];
+        if(message != NULL && message->skippedCount > 0) {
+            debug("CAN%d msg 0x%x decoded: %d, skipped unchanged: %d",
+                    bus->address, message->id, message->decodedCount,
+                    message->skippedCount);
+        }
+    }
+}
+
 void openxc::can::logBusStatistics(CanBus* buses, const int busCount) {
     if(!config::getConfiguration()->calculateMetrics) {
         return;
@@ -280,24 +526,28 @@ void openxc::can::logBusStatistics(CanBus* buses, const int busCount) {
 
             statistics::update(&bus->receivedDataStats,
                     bus->messagesReceived * CAN_MESSAGE_TOTAL_BIT_SIZE / 8192);
+            unsigned int dropped = bus->receiveQueue.overflows;
             statistics::update(&bus->totalMessageStats,
-                    bus->messagesReceived + bus->messagesDropped);
+                    bus->messagesReceived + dropped);
             statistics::update(&bus->receivedMessageStats,
                     bus->messagesReceived);
-            statistics::update(&bus->droppedMessageStats, bus->messagesDropped);
+            statistics::update(&bus->droppedMessageStats, dropped);
 
             statistics::update(&bus->sendQueueStats,
                     QUEUE_LENGTH(CanMessage, &bus->sendQueue));
             statistics::update(&bus->receiveQueueStats,
-                    QUEUE_LENGTH(CanMessage, &bus->receiveQueue));
+                    ring::length(&bus->receiveQueue));
 
             if(bus->totalMessageStats.total > 0) {
                 debug("CAN%d Rx queue length: %d, avg: %f percent",
                         bus->address,
-                        QUEUE_LENGTH(CanMessage, &bus->receiveQueue),
+                        ring::length(&bus->receiveQueue),
                         statistics::exponentialMovingAverage(
                             &bus->receiveQueueStats) /
-                                QUEUE_MAX_LENGTH(CanMessage) * 100);
+                                bus->receiveQueue.size * 100);
+                debug("CAN%d Rx queue high watermark: %d of %d, overflows: %d",
+                        bus->address, bus->receiveQueue.highWatermark,
+                        bus->receiveQueue.size, bus->receiveQueue.overflows);
                 debug("CAN%d Tx queue length: %d, avg: %f percent",
                         bus->address,
                         QUEUE_LENGTH(CanMessage, &bus->sendQueue),
@@ -317,11 +567,16 @@ void openxc::can::logBusStatistics(CanBus* buses, const int busCount) {
                         statistics::exponentialMovingAverage(
                             &bus->receivedDataStats) /
                             BUS_STATS_LOG_FREQUENCY_S);
+                debug("CAN%d Rx budget exhausted %d times", bus->address,
+                        bus->receiveBudgetExhausted);
+                debug("CAN%d Rx batch limit reached %d times", bus->address,
+                        bus->receiveBatchLimited);
+                logMessageDecodeStatistics(bus);
             }
 
             totalMessages += bus->totalMessageStats.total;
             messagesReceived += bus->messagesReceived;
-            messagesDropped += bus->messagesDropped;
+            messagesDropped += dropped;
             dataReceived += bus->receivedDataStats.total;
         }
         statistics::update(&totalMessageStats, totalMessages);
@@ -348,8 +603,7 @@ void openxc::can::logBusStatistics(CanBus* buses, const int busCount) {
         lastTimeLogged = time::systemTimeMs();
 
         for(int i = 0; i < busCount; i++) {
-            if(QUEUE_LENGTH(CanMessage, &buses[i].receiveQueue) ==
-                    QUEUE_MAX_LENGTH(CanMessage)) {
+            if(ring::full(&buses[i].receiveQueue)) {
                 debug("Dropped CAN messages while running stats on bus %d", i);
             }
         }
@@ -425,6 +679,7 @@ bool openxc::can::addAcceptanceFilter(CanBus* bus, uint32_t id,
         LIST_REMOVE(availableFilter, entries);
         LIST_INSERT_HEAD(&bus->freeAcceptanceFilters, availableFilter, entries);
     }
+    rebuildAcceptanceFilterIndex(bus);
     return status;
 }
 
@@ -445,6 +700,7 @@ void openxc::can::removeAcceptanceFilter(CanBus* bus, uint32_t id,
             debug("No active users - disabling filter");
             LIST_REMOVE(entry, entries);
             LIST_INSERT_HEAD(&bus->freeAcceptanceFilters, entry, entries);
+            rebuildAcceptanceFilterIndex(bus);
             updateAcceptanceFilterTable(buses, busCount);
         }
     }
@@ -459,15 +715,27 @@ bool openxc::can::setAcceptanceFilterStatus(CanBus* bus, bool enabled,
 }
 
 bool openxc::can::shouldAcceptMessage(CanBus* bus, uint32_t messageId) {
-    bool acceptMessage = bus->bypassFilters;
-    if(!acceptMessage) {
-        AcceptanceFilterListEntry* entry;
-        LIST_FOREACH(entry, &bus->acceptanceFilters, entries) {
-            if(entry->filter == messageId) {
-                acceptMessage = true;
-                break;
-            }
+    if(bus->bypassFilters) {
+        return true;
+    }
+
+    const AcceptanceFilterIndex* index =
+            &bus->acceptanceFilterIndexes[bus->activeAcceptanceFilterIndex];
+    if(messageId < STANDARD_CAN_ID_COUNT) {
+        return (index->standardIds[messageId / 32] >> (messageId % 32)) & 1;
+    }
+
+    int low = 0;
+    int high = index->extendedIdCount - 1;
+    while(low <= high) {
+        int middle = (low + high) / 2;
+        if(index->extendedIds[middle] == messageId) {
+            return true;
+        } else if(index->extendedIds[middle] < messageId) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
         }
     }
-    return acceptMessage;
+    return false;
 }
@@ -17,8 +17,27 @@
 // TODO this takes up a ton of memory
 #define MAX_DYNAMIC_MESSAGE_COUNT 12
 
+// The number of slots in each bus's hash index of message definitions - must
+// be a power of 2. The index is kept at most 3/4 full, so this supports up to
+// 96 predefined and dynamic messages per bus before lookups fall back to a
+// linear search.
+#ifndef MESSAGE_DEFINITION_INDEX_SIZE
+#define MESSAGE_DEFINITION_INDEX_SIZE 128
+#endif
+
 #define CAN_MESSAGE_SIZE 8
 
+// The most messages each bus's receive ring can hold - must be a power of 2.
+// Every bus's ring has storage for this many messages (24 bytes each on the
+// 32-bit targets), so it sets the receive buffer RAM used per bus. Buses can be
+// given a smaller ring with receiveQueueSize, but that doesn't save any RAM.
+#ifndef CAN_RECEIVE_RING_MAX_SIZE
+#define CAN_RECEIVE_RING_MAX_SIZE 8
+#endif
+
+// The number of possible 11-bit standard CAN message IDs.
+#define STANDARD_CAN_ID_COUNT 2048
+
 /* Public: The type signature for a CAN signal decoder.
  *
  * A SignalDecoder transforms a raw floating point CAN signal into a number,
@@ -76,6 +95,25 @@ struct CanSignalState {
 };
 typedef struct CanSignalState CanSignalState;
 
+/* Public: Limits on how often a signal's value is published, on top of its
+ * frequency, so a noisy signal isn't sent every time it changes by a hair.
+ *
+ * A value is suppressed if it's within any of the deadbands of the last value
+ * published, even if the signal has sendSame set.
+ *
+ * deadband - Only publish a value that differs from the last one published by
+ *      more than this. 0 turns it off.
+ * deadbandPercent - The same as deadband, as a percentage of the magnitude of
+ *      the last value published. 0 turns it off.
+ * minSendInterval - The least time in milliseconds between publishing values,
+ *      even if forceSendChanged is set. 0 for no limit.
+ */
+typedef struct {
+    float deadband;
+    float deadbandPercent;
+    unsigned int minSendInterval;
+} SignalSendFilter;
+
 /* Public: A CAN signal to decode from the bus and output over USB.
  *
  * message     - The message this signal is a part of.
@@ -106,6 +144,13 @@ typedef struct CanSignalState CanSignalState;
  * encoder     - An optional function to encode a signal value to be written to
  *                CAN into a byte array. If NULL, the default numerical encoder
  *                is used.
+ * sendFilter  - Deadbands and a minimum interval to limit publishing the
+ *                signal's value. All 0 by default, to publish it as often as
+ *                the options above allow.
+ * decodeUnchanged - If true, the signal's message is decoded even if its data
+ *                hasn't changed since the last one, for a decoder that keeps
+ *                its own state (e.g. counting or integrating values). Defaults
+ *                to false.
  * received    - True if this signal has ever been received.
  * lastValue   - The last received value of the signal. If 'received' is false,
  *      this value is undefined.
@@ -127,17 +172,82 @@ struct CanSignal {
     bool writable;
     SignalDecoder decoder;
     SignalEncoder encoder;
+    SignalSendFilter sendFilter;
+    bool decodeUnchanged;
 };
 typedef struct CanSignal CanSignal;
 
+/* Public: The state kept for a CAN signal as it's received.
+ *
+ * signal - The signal this manager was generated for.
+ * frequencyClock - A clock to control the output frequency of the signal.
+ * received - True if the signal has been received at least once.
+ * lastValue - The last received value of the signal.
+ * sendFilter - The send filter set at runtime with a command. It's only used
+ *      if sendFilterOverridden is true, otherwise the signal's own is.
+ * sendFilterOverridden - True if sendFilter replaces the signal's.
+ * sent - True if a value has been published.
+ * lastSentValue - The last value published.
+ * lastSentTime - The time in ms the last value was published.
+ * sendPending - True if a changed value was held back only by the send
+ *      filter's minSendInterval, so it's still published once the interval is
+ *      over even if it doesn't change again.
+ * publishedCount - The number of values shouldSend allowed to be published.
+ * suppressedCount - The number of values shouldSend held back, for any
+ *      reason.
+ *
+ * Private:
+ * binding - The manager that holds the state for the signal at the same index
+ *      in the signals array, resolved by bindSignalManagers(). Signals that
+ *      share a generic name all share the first one's manager.
+ */
 struct SignalManager {
     const CanSignal* signal;
     openxc::util::time::FrequencyClock frequencyClock;
     bool received;
     float lastValue;
+    SignalSendFilter sendFilter;
+    bool sendFilterOverridden;
+    bool sent;
+    float lastSentValue;
+    unsigned long lastSentTime;
+    bool sendPending;
+    unsigned int publishedCount;
+    unsigned int suppressedCount;
+    struct SignalManager* binding;
 };
 typedef struct SignalManager SignalManager;
 
+/* Public: A signal referenced by generic name that is only looked up the first
+ * time it's needed, instead of with a strcmp on every CAN message. The lookup
+ * is repeated if the active list of signals changes.
+ *
+ * This is intended to be declared static in a handler that needs to find
+ * another signal, e.g.:
+ *
+ *      static SignalBinding signBinding = {"steering_wheel_angle_sign"};
+ *
+ * genericName - The generic name of the signal to find.
+ *
+ * Private:
+ * signals - The array the signal was looked up in.
+ * signal - The signal found in that array, or NULL if it wasn't there.
+ */
+typedef struct {
+    const char* genericName;
+    const CanSignal* signals;
+    const CanSignal* signal;
+} SignalBinding;
+
+/* Public: The same as a SignalBinding, but for the SignalManager of the named
+ * signal.
+ */
+typedef struct {
+    const char* genericName;
+    SignalManager* signalManagers;
+    SignalManager* signalManager;
+} SignalManagerBinding;
+
 /* Public: The definition of a CAN message. This includes a lot of metadata, so
  * to save memory this struct should not be used for storing incoming and
  * outgoing CAN messages.
@@ -153,6 +263,21 @@ typedef struct SignalManager SignalManager;
  * lastValue - The last received value of the message. Defaults to undefined.
  *      This is required for the forceSendChanged functionality, as the stack
  *      needs to compare an incoming CAN message with the previous frame.
+ * decodeUnchanged - If true, the message is decoded even if it's the same as
+ *      the last one decoded, e.g. if a handler for it counts frames. Defaults
+ *      to false. Signals can also opt out on their own.
+ * decodedCount - The number of times this message was decoded.
+ * skippedCount - The number of times this message was skipped without decoding
+ *      because it hadn't changed.
+ *
+ * Private:
+ * decoded - True if the message has been decoded at least once.
+ * lastDecodedValue - The data of the message last decoded.
+ * lastDecodedLength - The length of the message last decoded.
+ * firstSignal - The first of this message's signals in the active signals
+ *      array, or NULL if it has none. Set by bindMessageSignals().
+ * signalSpan - The number of signals from firstSignal through the message's
+ *      last one. Signals of other messages in between are ignored.
  */
 struct CanMessageDefinition {
     struct CanBus* bus;
@@ -161,6 +286,14 @@ struct CanMessageDefinition {
     openxc::util::time::FrequencyClock frequencyClock;
     bool forceSendChanged;
     uint8_t lastValue[CAN_MESSAGE_SIZE];
+    bool decodeUnchanged;
+    unsigned int decodedCount;
+    unsigned int skippedCount;
+    bool decoded;
+    uint8_t lastDecodedValue[CAN_MESSAGE_SIZE];
+    uint8_t lastDecodedLength;
+    const struct CanSignal* firstSignal;
+    uint16_t signalSpan;
 };
 typedef struct CanMessageDefinition CanMessageDefinition;
 
@@ -171,17 +304,44 @@ typedef struct CanMessageDefinition CanMessageDefinition;
  * format - the format of the message's ID.
  * data  - The message's data field.
  * length - the length of the data array (max 8).
+ * receivedAtUs - The system time the message was received by the CAN
+ *      controller, in microseconds, or 0 if it didn't come from a bus.
  */
 struct CanMessage {
     uint32_t id;
     CanMessageFormat format;
     uint8_t data[CAN_MESSAGE_SIZE];
     uint8_t length;
+    unsigned long receivedAtUs;
 };
 typedef struct CanMessage CanMessage;
 
 QUEUE_DECLARE(CanMessage, 8);
 
+/* Public: A ring of CAN messages with a single producer, the CAN interrupt
+ * handler, and a single consumer, the main loop. Only the producer writes the
+ * tail and the counters and only the consumer writes the head, so neither side
+ * needs a critical section.
+ *
+ * The head and tail run freely and are masked with size - 1 to find a slot, so
+ * the number of messages waiting is always tail - head.
+ *
+ * messages - Storage for the messages. Only the first size are used.
+ * size - The number of messages the ring can hold, a power of 2.
+ * head - The number of messages ever popped.
+ * tail - The number of messages ever pushed.
+ * highWatermark - The most messages that have ever been waiting at once.
+ * overflows - The number of messages dropped because the ring was full.
+ */
+typedef struct {
+    CanMessage messages[CAN_RECEIVE_RING_MAX_SIZE];
+    uint16_t size;
+    volatile uint16_t head;
+    volatile uint16_t tail;
+    volatile uint16_t highWatermark;
+    volatile unsigned int overflows;
+} CanRing;
+
 /* Private: An entry in the list of acceptance filters for each CanBus.
  *
  * This struct is meant to be used with a LIST type from <sys/queue.h>.
@@ -202,6 +362,45 @@ struct AcceptanceFilterListEntry {
  */
 LIST_HEAD(AcceptanceFilterList, AcceptanceFilterListEntry);
 
+/* Private: A copy of a bus's acceptance filters arranged for constant time
+ * lookup from the CAN interrupt handler, rebuilt each time the filter list
+ * changes.
+ *
+ * Filters are indexed by ID value alone, the same as the filter list is
+ * searched - any filter below STANDARD_CAN_ID_COUNT is a bit in the bitmap,
+ * and the rest are kept in a sorted array for a binary search.
+ *
+ * standardIds - A bitmap of the accepted IDs below STANDARD_CAN_ID_COUNT.
+ * extendedIds - The accepted IDs of STANDARD_CAN_ID_COUNT and above, in
+ *      ascending order.
+ * extendedIdCount - The number of IDs in extendedIds.
+ */
+typedef struct {
+    uint32_t standardIds[STANDARD_CAN_ID_COUNT / 32];
+    uint32_t extendedIds[MAX_ACCEPTANCE_FILTERS];
+    uint8_t extendedIdCount;
+} AcceptanceFilterIndex;
+
+/* Private: An open addressed hash table of the predefined and dynamic message
+ * definitions for one bus, keyed by ID and format.
+ *
+ * slots - The definitions in the table, NULL for an empty slot. Collisions are
+ *      resolved by linear probing.
+ * count - The number of definitions in the table.
+ * predefinedMessages - The array of predefined messages that was indexed. The
+ *      index is rebuilt if a lookup is made with a different array.
+ * predefinedMessageCount - The length of the predefinedMessages array.
+ * overflowed - True if some definitions didn't fit in the index, so a lookup
+ *      that misses must fall back to a linear search.
+ */
+typedef struct {
+    struct CanMessageDefinition* slots[MESSAGE_DEFINITION_INDEX_SIZE];
+    uint16_t count;
+    const struct CanMessageDefinition* predefinedMessages;
+    int predefinedMessageCount;
+    bool overflowed;
+} CanMessageDefinitionIndex;
+
 struct CanMessageDefinitionListEntry {
     CanMessageDefinition definition;
     LIST_ENTRY(CanMessageDefinitionListEntry) entries;
@@ -234,28 +433,45 @@ LIST_HEAD(CanMessageDefinitionList, CanMessageDefinitionListEntry);
  *      are no acceptance filters configured.
  * loopback - True if the controller should be configured in loopback mode, so
  *         all sent messages are received immediately on that same controller.
+ * receiveQueueSize - The number of received messages that can wait to be
+ *      translated, a power of 2 up to CAN_RECEIVE_RING_MAX_SIZE. If this is 0
+ *      (or invalid), the bus gets the largest ring. The storage for the
+ *      largest ring is always reserved, so this only limits how many messages
+ *      wait, not the RAM used.
  *
  * acceptanceFilters - a list of active acceptance filters for this bus.
  * freeAcceptanceFilters - a list of available slots for acceptance filters.
  * acceptanceFilterEntries - static memory allocated for entires in the
  *      acceptanceFilters and freeAcceptanceFilters list.
+ * acceptanceFilterIndexes - two copies of the acceptanceFilters arranged for
+ *      shouldAcceptMessage. One is used by the CAN interrupt handler while the
+ *      other is rebuilt, so the interrupt never sees a partial update.
+ * activeAcceptanceFilterIndex - which of the acceptanceFilterIndexes is
+ *      currently in use.
  * dynamicMessages - a list of CAN message IDs ever received on this bus. This
  *      is used for message frequency control and metrics.
  * freeMessageDefinitions - a list of available slots for dynamic message
  *      definitions.
  * definitionEntries - static memory allocated for entires in the
  *      dynamicMessages and freeMessageDefinitions list.
+ * messageDefinitionIndex - a hash index of the predefined and dynamic message
+ *      definitions on this bus, for lookupMessageDefinition.
  * writeHandler - a function that actually writes out a CanMessage object to the
  *      CAN interface (implementation is platform specific);
  * lastMessageReceived - the time (in ms) when the last CAN message was
  *      received. If no message has been received, it should be 0.
  * messagesReceived - A count of the number of CAN messages received.
- * messagesDropped - A count of the number of CAN messages we knowingly dropped
- * - i.e. we received an interrupt with a new CAN message but the incoming CAN
- *   message queue was full.
+ * receiveBudgetExhausted - A count of the number of times the main loop's CAN
+ *      receive budget ran out while messages were still waiting in this bus's
+ *      receiveQueue.
+ * receiveBatchLimited - A count of the number of times the main loop stopped
+ *      draining this bus at canReceiveBatchSize messages, with time budget
+ *      left, while messages were still waiting in its receiveQueue.
  * sendQueue - a queue of CanMessage instances that need to be written to CAN.
- * receiveQueue - a queue of messages received from CAN that have yet to be
- *      translated.
+ * receiveQueue - a ring of messages received from CAN that have yet to be
+ *      translated. The ring's overflows are the messages we knowingly dropped -
+ *      i.e. we received an interrupt with a new CAN message but the ring was
+ *      full.
  */
 struct CanBus {
     unsigned int speed;
@@ -265,18 +481,23 @@ struct CanBus {
     bool passthroughCanMessages;
     bool bypassFilters;
     bool loopback;
+    unsigned short receiveQueueSize;
 
     // Private
     AcceptanceFilterList acceptanceFilters;
     AcceptanceFilterList freeAcceptanceFilters;
     AcceptanceFilterListEntry acceptanceFilterEntries[MAX_ACCEPTANCE_FILTERS];
+    AcceptanceFilterIndex acceptanceFilterIndexes[2];
+    volatile uint8_t activeAcceptanceFilterIndex;
     CanMessageDefinitionList dynamicMessages;
     CanMessageDefinitionList freeMessageDefinitions;
     CanMessageDefinitionListEntry definitionEntries[MAX_DYNAMIC_MESSAGE_COUNT];
+    CanMessageDefinitionIndex messageDefinitionIndex;
     bool (*writeHandler)(CanBus*, CanMessage*);
     unsigned long lastMessageReceived;
     unsigned int messagesReceived;
-    unsigned int messagesDropped;
+    unsigned int receiveBudgetExhausted;
+    unsigned int receiveBatchLimited;
 
     // TODO These are unnecessary if you aren't calculating metrics, and they do
     // take up a bit of memory.
@@ -288,7 +509,7 @@ struct CanBus {
     openxc::util::statistics::Statistic receiveQueueStats;
 
     QUEUE_TYPE(CanMessage) sendQueue;
-    QUEUE_TYPE(CanMessage) receiveQueue;
+    CanRing receiveQueue;
 };
 typedef struct CanBus CanBus;
 
@@ -420,8 +641,80 @@ const CanSignal* lookupSignal(const char* name, const CanSignal* signals, int si
 const CanSignal* lookupSignal(const char* name, const CanSignal* signals, int signalCount,
         bool writable);
 
+/* Public: Look up a signal by generic name, remembering the result in the
+ * binding so it's only searched for once per list of signals.
+ *
+ * binding - The binding with the generic name of the signal to find.
+ * signals - The list of all signals.
+ * signalCount - The length of the signals array.
+ *
+ * Returns a pointer to the CanSignal if found, otherwise NULL.
+ */
+const CanSignal* lookupSignal(SignalBinding* binding, const CanSignal* signals,
+        int signalCount);
+
+/* Public: Look up the SignalManager of a signal based on its generic name.
+ *
+ * This is a linear search with a strcmp for each signal - on the hot path, use
+ * lookupSignalManager with a signal or a SignalManagerBinding instead.
+ *
+ * signalName - The generic, OpenXC name of the signal.
+ * signalManagers - The list of all signal managers.
+ * signalCount - The length of the signalManagers array.
+ *
+ * Returns a pointer to the first SignalManager for a signal with that name if
+ * found, otherwise NULL.
+ */
 SignalManager* lookupSignalManagerDetails(const char* signalName, SignalManager* signalManagers, int signalCount);
 
+/* Public: Resolve the SignalManager for every signal up front, so they can be
+ * found with lookupSignalManager without searching while decoding.
+ *
+ * signals - The list of all signals.
+ * signalManagers - The list of all signal managers, in the same order.
+ * signalCount - The length of the signals and signalManagers arrays.
+ */
+void bindSignalManagers(const CanSignal* signals,
+        SignalManager* signalManagers, int signalCount);
+
+/* Public: Point each message definition at its signals, so
+ * read::shouldDecodeMessage can check them without searching.
+ *
+ * signals - The list of all signals. Each definition they reference is
+ *      updated.
+ * signalCount - The length of the signals array.
+ */
+void bindMessageSignals(const CanSignal* signals, int signalCount);
+
+/* Public: Return the SignalManager for a signal from the signals array.
+ *
+ * If the managers were already bound with bindSignalManagers, this doesn't
+ * search at all. Otherwise the manager is looked up by name and remembered for
+ * next time.
+ *
+ * signal - A signal from the signals array.
+ * signals - The list of all signals.
+ * signalManagers - The list of all signal managers, in the same order.
+ * signalCount - The length of the signals and signalManagers arrays.
+ *
+ * Returns a pointer to the SignalManager if found, otherwise NULL.
+ */
+SignalManager* lookupSignalManager(const CanSignal* signal,
+        const CanSignal* signals, SignalManager* signalManagers,
+        int signalCount);
+
+/* Public: Look up a SignalManager by generic name, remembering the result in
+ * the binding so it's only searched for once per list of managers.
+ *
+ * binding - The binding with the generic name of the signal to find.
+ * signalManagers - The list of all signal managers.
+ * signalCount - The length of the signalManagers array.
+ *
+ * Returns a pointer to the SignalManager if found, otherwise NULL.
+ */
+SignalManager* lookupSignalManager(SignalManagerBinding* binding,
+        SignalManager* signalManagers, int signalCount);
+
 /* Public: Look up the CanCommand representation of a command based on its
  * generic name.
  *
@@ -460,6 +753,11 @@ const CanSignalState* lookupSignalState(int value, const CanSignal* signal);
 /* Public: Search all predefined and dynamically configured CAN messages for one
  * matching the given ID.
  *
+ * The definitions are kept in a hash index on the bus, so this doesn't search
+ * the arrays. The index is rebuilt if the predefinedMessages array is different
+ * from the last call. If there is a predefined and dynamic definition for the
+ * same message, the predefined one is returned.
+ *
  * bus - The CanBus to search for the message.
  * id - The ID of the CAN message.
  * format - The format of the ID of the message.
@@ -630,6 +928,11 @@ void logBusStatistics(CanBus* buses, const int busCount);
  * bus has the AF off but we still want to filter on the other, we use this to
  * do software filtering based on the registered CAN messages.
  *
+ * This is called from the CAN interrupt handler for every message, so it
+ * doesn't walk the filter list - standard IDs are checked in a bitmap and
+ * extended IDs with a binary search, both kept up to date by
+ * addAcceptanceFilter and removeAcceptanceFilter.
+ *
  * bus - The bus the message was received on.
  * messageId - the ID of the message.
  *
@@ -0,0 +1,49 @@
+#include "diagnostic_flow_control_command.h"
+
+#include <string.h>
+#include "config.h"
+#include "diagnostics.h"
+#include "util/log.h"
+
+using openxc::util::log::debug;
+using openxc::config::getConfiguration;
+
+namespace diagnostics = openxc::diagnostics;
+
+const char openxc::commands::DIAGNOSTIC_BLOCK_SIZE_COMMAND_NAME[] =
+        "diagnostic_block_size";
+const char openxc::commands::DIAGNOSTIC_SEPARATION_TIME_COMMAND_NAME[] =
+        "diagnostic_separation_time";
+
+void openxc::commands::handleDiagnosticFlowControlCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount) {
+    if(value->type != openxc_DynamicField_Type_NUM ||
+            value->numeric_value < 0) {
+        debug("Diagnostic flow control command requires a positive number");
+        return;
+    }
+
+    const char* requestName = NULL;
+    if(event != NULL) {
+        if(event->type != openxc_DynamicField_Type_STRING) {
+            debug("Diagnostic flow control command request name must be a "
+                    "string");
+            return;
+        }
+        requestName = event->string_value;
+    }
+
+    int blockSize = -1;
+    float separationTimeMs = -1;
+    if(!strcmp(name, DIAGNOSTIC_BLOCK_SIZE_COMMAND_NAME)) {
+        blockSize = value->numeric_value;
+    } else {
+        separationTimeMs = value->numeric_value;
+    }
+
+    if(!diagnostics::setFlowControl(&getConfiguration()->diagnosticsManager,
+                requestName, blockSize, separationTimeMs)) {
+        debug("No diagnostic request matched the flow control command");
+    }
+}
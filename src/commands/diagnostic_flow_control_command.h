@@ -0,0 +1,37 @@
+#ifndef __DIAGNOSTIC_FLOW_CONTROL_COMMAND_H__
+#define __DIAGNOSTIC_FLOW_CONTROL_COMMAND_H__
+
+#include "openxc.pb.h"
+#include <can/canutil.h>
+
+namespace openxc {
+namespace commands {
+
+extern const char DIAGNOSTIC_BLOCK_SIZE_COMMAND_NAME[];
+extern const char DIAGNOSTIC_SEPARATION_TIME_COMMAND_NAME[];
+
+/* Public: Change one setting of the ISO-TP flow control that multi-frame
+ * diagnostic responses are answered with (see diagnostics::setFlowControl),
+ * sent as a simple message write:
+ *
+ *      {"name": "diagnostic_block_size", "value": 8, "event": "vin"}
+ *
+ * The command's name picks the setting - diagnostic_block_size or
+ * diagnostic_separation_time.
+ *
+ * value - The new block size, or the new separation time (STmin) in
+ *      milliseconds.
+ * event - An optional name of the active requests to change. If this is left
+ *      out, the default of every bus and all of the active requests are
+ *      changed.
+ *
+ * The arguments are those of a CommandHandler (see can/canutil.h).
+ */
+void handleDiagnosticFlowControlCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount);
+
+} // namespace commands
+} // namespace openxc
+
+#endif // __DIAGNOSTIC_FLOW_CONTROL_COMMAND_H__
@@ -0,0 +1,48 @@
+#include "diagnostic_rate_command.h"
+
+#include "config.h"
+#include "diagnostics.h"
+#include "util/log.h"
+
+using openxc::util::log::debug;
+using openxc::config::getConfiguration;
+
+namespace diagnostics = openxc::diagnostics;
+
+const char openxc::commands::DIAGNOSTIC_RATE_COMMAND_NAME[] =
+        "diagnostic_rate";
+
+void openxc::commands::handleDiagnosticRateCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount) {
+    diagnostics::DiagnosticsManager* manager =
+            &getConfiguration()->diagnosticsManager;
+    if(value->type == openxc_DynamicField_Type_BOOL && value->boolean_value) {
+        diagnostics::logRequestStatistics(manager);
+        return;
+    }
+
+    float minFrequency;
+    if(value->type == openxc_DynamicField_Type_BOOL) {
+        minFrequency = 0;
+    } else if(value->type == openxc_DynamicField_Type_NUM &&
+            value->numeric_value > 0) {
+        minFrequency = value->numeric_value;
+    } else {
+        debug("Diagnostic rate command requires a frequency, true or false");
+        return;
+    }
+
+    const char* requestName = NULL;
+    if(event != NULL) {
+        if(event->type != openxc_DynamicField_Type_STRING) {
+            debug("Diagnostic rate command request name must be a string");
+            return;
+        }
+        requestName = event->string_value;
+    }
+
+    if(!diagnostics::setAdaptiveRate(manager, requestName, minFrequency)) {
+        debug("No recurring diagnostic request matched the rate command");
+    }
+}
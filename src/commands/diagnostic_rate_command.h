@@ -0,0 +1,36 @@
+#ifndef __DIAGNOSTIC_RATE_COMMAND_H__
+#define __DIAGNOSTIC_RATE_COMMAND_H__
+
+#include "openxc.pb.h"
+#include <can/canutil.h>
+
+namespace openxc {
+namespace commands {
+
+extern const char DIAGNOSTIC_RATE_COMMAND_NAME[];
+
+/* Public: Switch the adaptive rate of recurring diagnostic requests on or off
+ * (see diagnostics::setAdaptiveRate), or log their statistics, sent as a simple
+ * message write:
+ *
+ *      {"name": "diagnostic_rate", "value": 0.5, "event": "engine_speed"}
+ *
+ * The most a request's adaptive rate recovers to is the frequency it was added
+ * with by the diagnostic request command.
+ *
+ * value - The least frequency in Hz the rate may back off to, which switches
+ *      adaptive mode on, false to switch it off, or true to only log the
+ *      effective rate and counters of every recurring request.
+ * event - An optional name of the recurring requests to change. If this is left
+ *      out, every recurring request is changed.
+ *
+ * The arguments are those of a CommandHandler (see can/canutil.h).
+ */
+void handleDiagnosticRateCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount);
+
+} // namespace commands
+} // namespace openxc
+
+#endif // __DIAGNOSTIC_RATE_COMMAND_H__
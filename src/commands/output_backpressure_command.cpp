@@ -0,0 +1,78 @@
+#include "output_backpressure_command.h"
+
+#include <string.h>
+#include "config.h"
+#include "util/log.h"
+
+using openxc::util::log::debug;
+using openxc::config::getConfiguration;
+using openxc::pipeline::BackpressurePolicy;
+using openxc::pipeline::BackpressureStall;
+using openxc::interface::InterfaceDescriptor;
+using openxc::interface::InterfaceType;
+using openxc::interface::descriptorToString;
+using openxc::interface::lookupInterfaceType;
+
+const char openxc::commands::OUTPUT_BACKPRESSURE_COMMAND_NAME[] =
+        "output_backpressure";
+
+// Indexed by BackpressurePolicy
+static const char* POLICY_NAMES[] = {
+    "drop_newest",
+    "drop_oldest",
+    "block",
+};
+
+/* Private: Return the index of the policy with the given name, or -1 if there
+ * isn't one.
+ */
+static int lookupPolicy(const char* name) {
+    for(size_t i = 0; i < sizeof(POLICY_NAMES) / sizeof(POLICY_NAMES[0]); i++) {
+        if(!strcmp(name, POLICY_NAMES[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void openxc::commands::handleOutputBackpressureCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount) {
+    openxc::config::Configuration* config = getConfiguration();
+    int first = 0;
+    int last = PIPELINE_ENDPOINT_COUNT - 1;
+    if(event != NULL) {
+        InterfaceType interface;
+        if(event->type != openxc_DynamicField_Type_STRING ||
+                !lookupInterfaceType(event->string_value, &interface)) {
+            debug("Output backpressure command has an unknown interface");
+            return;
+        }
+        first = last = interface;
+    }
+
+    int policy = -1;
+    if(value->type == openxc_DynamicField_Type_STRING) {
+        policy = lookupPolicy(value->string_value);
+    } else if(value->type == openxc_DynamicField_Type_NUM &&
+            value->numeric_value >= 0) {
+        policy = BackpressurePolicy::BLOCK;
+        config->backpressureBlockMs = value->numeric_value;
+    }
+
+    if(policy == -1) {
+        debug("Output backpressure command requires a policy or number value");
+        return;
+    }
+
+    for(int i = first; i <= last; i++) {
+        config->backpressurePolicies[i] = (BackpressurePolicy) policy;
+        const BackpressureStall* stall = &config->pipeline.stalls[i];
+        InterfaceDescriptor descriptor;
+        descriptor.type = (InterfaceType) i;
+        debug("%s backpressure %s (block %u ms), stalled %u times, "
+                "longest %lu us", descriptorToString(&descriptor),
+                POLICY_NAMES[policy],
+                config->backpressureBlockMs, stall->count, stall->longestUs);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef __OUTPUT_BACKPRESSURE_COMMAND_H__
+#define __OUTPUT_BACKPRESSURE_COMMAND_H__
+
+#include "openxc.pb.h"
+#include <can/canutil.h>
+
+namespace openxc {
+namespace commands {
+
+extern const char OUTPUT_BACKPRESSURE_COMMAND_NAME[];
+
+/* Public: Change what an interface does with messages when its send queue is
+ * full (see BackpressurePolicy in pipeline.h), sent as a simple message write:
+ *
+ *      {"name": "output_backpressure", "value": "drop_oldest", "event": "uart"}
+ *
+ * The policy in effect and how long each interface has stalled waiting for
+ * room are logged either way.
+ *
+ * value - The policy, one of "drop_newest", "drop_oldest" or "block", or a
+ *      number of milliseconds to block for at most.
+ * event - An optional interface name, one of "usb", "uart", "network",
+ *      "telit", "ble" or "fs". If this is left out, the policy is changed for
+ *      every interface.
+ *
+ * The arguments are those of a CommandHandler (see can/canutil.h).
+ */
+void handleOutputBackpressureCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount);
+
+} // namespace commands
+} // namespace openxc
+
+#endif // __OUTPUT_BACKPRESSURE_COMMAND_H__
@@ -0,0 +1,40 @@
+#include "output_batching_command.h"
+
+#include "config.h"
+#include "util/log.h"
+
+using openxc::util::log::debug;
+using openxc::config::getConfiguration;
+
+const char openxc::commands::OUTPUT_BATCHING_COMMAND_NAME[] =
+        "output_batching";
+
+void openxc::commands::handleOutputBatchingCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount) {
+    openxc::config::Configuration* config = getConfiguration();
+    if(value->type == openxc_DynamicField_Type_BOOL) {
+        config->outputBatching = value->boolean_value;
+    } else if(value->type == openxc_DynamicField_Type_NUM &&
+            value->numeric_value >= 0) {
+        config->outputBatching = value->numeric_value >= 1;
+        if(config->outputBatching) {
+            config->outputBatchBytes = MIN(value->numeric_value,
+                    OUTPUT_BATCH_MAX_BYTES);
+        }
+    } else {
+        debug("Output batching command requires a boolean or number value");
+        return;
+    }
+
+    if(event != NULL && event->type == openxc_DynamicField_Type_NUM &&
+            event->numeric_value >= 0) {
+        config->outputBatchAgeMs = event->numeric_value;
+    }
+
+    // Anything still waiting after batching is turned off is sent the next
+    // time the pipeline is processed.
+    debug("Output batching %s, %d bytes or %u ms",
+            config->outputBatching ? "on" : "off", config->outputBatchBytes,
+            config->outputBatchAgeMs);
+}
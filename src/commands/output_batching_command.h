@@ -0,0 +1,33 @@
+#ifndef __OUTPUT_BATCHING_COMMAND_H__
+#define __OUTPUT_BATCHING_COMMAND_H__
+
+#include "openxc.pb.h"
+#include <can/canutil.h>
+
+namespace openxc {
+namespace commands {
+
+extern const char OUTPUT_BATCHING_COMMAND_NAME[];
+
+/* Public: Turn output batching on or off, sent as a simple message write:
+ *
+ *      {"name": "output_batching", "value": true, "event": 50}
+ *
+ * The control commands are defined by the OpenXC message format, so this is
+ * handled as a built-in command in the VI rather than a new command type.
+ *
+ * value - true or false to turn batching on or off, or a number of bytes to
+ *      turn it on and fill each batch with that many bytes of messages. 0
+ *      turns it off.
+ * event - An optional number of milliseconds, the longest a message may wait
+ *      in a batch before it's sent.
+ *
+ * The arguments are those of a CommandHandler (see can/canutil.h).
+ */
+void handleOutputBatchingCommand(const char* name, openxc_DynamicField* value,
+        openxc_DynamicField* event, const CanSignal* signals, int signalCount);
+
+} // namespace commands
+} // namespace openxc
+
+#endif // __OUTPUT_BATCHING_COMMAND_H__
@@ -0,0 +1,53 @@
+#include "output_coalescing_command.h"
+
+#include "config.h"
+#include "util/log.h"
+
+using openxc::util::log::debug;
+using openxc::config::getConfiguration;
+using openxc::interface::InterfaceDescriptor;
+using openxc::interface::InterfaceType;
+using openxc::interface::descriptorToString;
+using openxc::interface::lookupInterfaceType;
+
+const char openxc::commands::OUTPUT_COALESCING_COMMAND_NAME[] =
+        "output_coalescing";
+
+void openxc::commands::handleOutputCoalescingCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount) {
+    openxc::config::Configuration* config = getConfiguration();
+    if(value->type != openxc_DynamicField_Type_BOOL) {
+        debug("Output coalescing command requires a boolean value");
+        return;
+    }
+
+    int first = 0;
+    int last = PIPELINE_ENDPOINT_COUNT - 1;
+    if(event != NULL) {
+        InterfaceType interface;
+        if(event->type != openxc_DynamicField_Type_STRING ||
+                !lookupInterfaceType(event->string_value, &interface) ||
+                interface == InterfaceType::USB) {
+            debug("Output coalescing command has an unknown interface");
+            return;
+        }
+        first = last = interface;
+    }
+
+    for(int i = first; i <= last; i++) {
+        if(i == InterfaceType::USB) {
+            continue;
+        }
+
+        // Anything still waiting in the table after coalescing is turned off
+        // is sent the next time the pipeline is processed
+        config->outputCoalescing[i] = value->boolean_value;
+        InterfaceDescriptor descriptor;
+        descriptor.type = (InterfaceType) i;
+        debug("%s output coalescing %s, %u stale values skipped",
+                descriptorToString(&descriptor),
+                config->outputCoalescing[i] ? "on" : "off",
+                config->pipeline.coalescing.replaced[i]);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef __OUTPUT_COALESCING_COMMAND_H__
+#define __OUTPUT_COALESCING_COMMAND_H__
+
+#include "openxc.pb.h"
+#include <can/canutil.h>
+
+namespace openxc {
+namespace commands {
+
+extern const char OUTPUT_COALESCING_COMMAND_NAME[];
+
+/* Public: Turn output coalescing on or off for an interface (see
+ * pipeline::publish), sent as a simple message write:
+ *
+ *      {"name": "output_coalescing", "value": true, "event": "ble"}
+ *
+ * USB always gets every message, so it can't be coalesced.
+ *
+ * value - true or false to turn coalescing on or off.
+ * event - An optional interface name, one of "uart", "network", "telit", "ble"
+ *      or "fs". If this is left out, every interface but USB is changed.
+ *
+ * The arguments are those of a CommandHandler (see can/canutil.h).
+ */
+void handleOutputCoalescingCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount);
+
+} // namespace commands
+} // namespace openxc
+
+#endif // __OUTPUT_COALESCING_COMMAND_H__
@@ -42,6 +42,9 @@ bool openxc::commands::handlePayloadFormatCommand(openxc_ControlCommand* command
                 case openxc_PayloadFormatCommand_PayloadFormat_PROTOBUF:
                     format = PayloadFormat::PROTOBUF;
                     break;
+                case openxc_PayloadFormatCommand_PayloadFormat_MESSAGEPACK:
+                    format = PayloadFormat::MESSAGEPACK;
+                    break;
             }
 
             status = true;
@@ -54,7 +57,9 @@ bool openxc::commands::handlePayloadFormatCommand(openxc_ControlCommand* command
         // Don't change format until we've sent the response
         getConfiguration()->payloadFormat = format;
         debug("Set message format to %s",
-                format == PayloadFormat::JSON ? "JSON" : "binary" );
+                format == PayloadFormat::JSON ? "JSON" :
+                    format == PayloadFormat::PROTOBUF ? "protobuf" :
+                    "MessagePack");
     }
 
     return status;
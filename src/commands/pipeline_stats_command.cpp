@@ -0,0 +1,48 @@
+#include "pipeline_stats_command.h"
+
+#include <string.h>
+#include "config.h"
+#include "util/log.h"
+
+using openxc::util::log::debug;
+using openxc::config::getConfiguration;
+using openxc::pipeline::Pipeline;
+using openxc::interface::InterfaceType;
+using openxc::interface::lookupInterfaceType;
+
+namespace pipeline = openxc::pipeline;
+
+const char openxc::commands::PIPELINE_STATS_COMMAND_NAME[] =
+        "pipeline_stats";
+
+void openxc::commands::handlePipelineStatsCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount) {
+    bool reset = value->type == openxc_DynamicField_Type_STRING &&
+            !strcmp(value->string_value, "reset");
+    if(!reset && value->type != openxc_DynamicField_Type_BOOL) {
+        debug("Pipeline stats command requires true or \"reset\"");
+        return;
+    }
+
+    int first = 0;
+    int last = PIPELINE_ENDPOINT_COUNT - 1;
+    if(event != NULL) {
+        InterfaceType interface;
+        if(event->type != openxc_DynamicField_Type_STRING ||
+                !lookupInterfaceType(event->string_value, &interface)) {
+            debug("Pipeline stats command has an unknown interface");
+            return;
+        }
+        first = last = interface;
+    }
+
+    Pipeline* pipeline = &getConfiguration()->pipeline;
+    for(int i = first; i <= last; i++) {
+        pipeline::logLatency(pipeline, (InterfaceType) i);
+    }
+
+    if(reset) {
+        pipeline::resetLatency(pipeline);
+    }
+}
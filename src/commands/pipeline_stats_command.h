@@ -0,0 +1,31 @@
+#ifndef __PIPELINE_STATS_COMMAND_H__
+#define __PIPELINE_STATS_COMMAND_H__
+
+#include "openxc.pb.h"
+#include <can/canutil.h>
+
+namespace openxc {
+namespace commands {
+
+extern const char PIPELINE_STATS_COMMAND_NAME[];
+
+/* Public: Log how long the messages sent on each interface took to go out
+ * (see pipeline::logLatency), sent as a simple message write:
+ *
+ *      {"name": "pipeline_stats", "value": true, "event": "usb"}
+ *
+ * value - true to log the latencies, or "reset" to log them and then start
+ *      recording them over.
+ * event - An optional interface name, one of "usb", "uart", "network",
+ *      "telit", "ble" or "fs". If this is left out, every interface is logged.
+ *
+ * The arguments are those of a CommandHandler (see can/canutil.h).
+ */
+void handlePipelineStatsCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount);
+
+} // namespace commands
+} // namespace openxc
+
+#endif // __PIPELINE_STATS_COMMAND_H__
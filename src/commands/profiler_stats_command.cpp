@@ -0,0 +1,32 @@
+#include "profiler_stats_command.h"
+
+#include <string.h>
+#include "util/log.h"
+#include "util/profiler.h"
+
+using openxc::util::log::debug;
+
+namespace profiler = openxc::util::profiler;
+
+const char openxc::commands::PROFILER_STATS_COMMAND_NAME[] =
+        "profiler_stats";
+
+void openxc::commands::handleProfilerStatsCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount) {
+    bool reset = value->type == openxc_DynamicField_Type_STRING &&
+            !strcmp(value->string_value, "reset");
+    if(!reset && value->type != openxc_DynamicField_Type_BOOL) {
+        debug("Profiler stats command requires true or \"reset\"");
+        return;
+    }
+
+#ifdef __PROFILING__
+    profiler::logCounters();
+    if(reset) {
+        profiler::reset();
+    }
+#else
+    debug("Profiling probes aren't compiled in - build with PROFILING=1");
+#endif
+}
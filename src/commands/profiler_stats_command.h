@@ -0,0 +1,32 @@
+#ifndef __PROFILER_STATS_COMMAND_H__
+#define __PROFILER_STATS_COMMAND_H__
+
+#include "openxc.pb.h"
+#include <can/canutil.h>
+
+namespace openxc {
+namespace commands {
+
+extern const char PROFILER_STATS_COMMAND_NAME[];
+
+/* Public: Log the cycles spent in each stage of the hot path (see
+ * util/profiler.h), sent as a simple message write:
+ *
+ *      {"name": "profiler_stats", "value": true}
+ *
+ * The probes are only compiled in when the firmware is built with
+ * PROFILING=1.
+ *
+ * value - true to log the counters, or "reset" to log them and then start
+ *      counting over.
+ *
+ * The arguments are those of a CommandHandler (see can/canutil.h).
+ */
+void handleProfilerStatsCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount);
+
+} // namespace commands
+} // namespace openxc
+
+#endif // __PROFILER_STATS_COMMAND_H__
@@ -0,0 +1,61 @@
+#include "signal_send_filter_command.h"
+
+#include <string.h>
+#include "signals.h"
+#include "util/log.h"
+
+using openxc::util::log::debug;
+using openxc::signals::getSignalManagers;
+using openxc::can::lookupSignal;
+using openxc::can::lookupSignalManager;
+
+const char openxc::commands::SIGNAL_DEADBAND_COMMAND_NAME[] =
+        "signal_deadband";
+const char openxc::commands::SIGNAL_DEADBAND_PERCENT_COMMAND_NAME[] =
+        "signal_deadband_percent";
+const char openxc::commands::SIGNAL_MIN_SEND_INTERVAL_COMMAND_NAME[] =
+        "signal_min_send_interval";
+
+void openxc::commands::handleSignalSendFilterCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount) {
+    if(value->type != openxc_DynamicField_Type_STRING) {
+        debug("Signal send filter command requires a signal name value");
+        return;
+    }
+
+    const CanSignal* signal = lookupSignal(value->string_value, signals,
+            signalCount);
+    SignalManager* signalManager = signal == NULL ? NULL :
+            lookupSignalManager(signal, signals, getSignalManagers(),
+                signalCount);
+    if(signalManager == NULL) {
+        debug("No signal named %s to filter", value->string_value);
+        return;
+    }
+
+    if(event != NULL && event->type == openxc_DynamicField_Type_NUM &&
+            event->numeric_value >= 0) {
+        if(!signalManager->sendFilterOverridden) {
+            signalManager->sendFilter = signal->sendFilter;
+            signalManager->sendFilterOverridden = true;
+        }
+
+        SignalSendFilter* filter = &signalManager->sendFilter;
+        if(!strcmp(name, SIGNAL_DEADBAND_COMMAND_NAME)) {
+            filter->deadband = event->numeric_value;
+        } else if(!strcmp(name, SIGNAL_DEADBAND_PERCENT_COMMAND_NAME)) {
+            filter->deadbandPercent = event->numeric_value;
+        } else if(!strcmp(name, SIGNAL_MIN_SEND_INTERVAL_COMMAND_NAME)) {
+            filter->minSendInterval = event->numeric_value;
+        }
+    }
+
+    const SignalSendFilter* filter = signalManager->sendFilterOverridden ?
+            &signalManager->sendFilter : &signal->sendFilter;
+    debug("%s deadband %f (%f percent), min interval %u ms: "
+            "%u published, %u suppressed", signal->genericName,
+            filter->deadband, filter->deadbandPercent,
+            filter->minSendInterval, signalManager->publishedCount,
+            signalManager->suppressedCount);
+}
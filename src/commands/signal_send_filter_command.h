@@ -0,0 +1,37 @@
+#ifndef __SIGNAL_SEND_FILTER_COMMAND_H__
+#define __SIGNAL_SEND_FILTER_COMMAND_H__
+
+#include "openxc.pb.h"
+#include <can/canutil.h>
+
+namespace openxc {
+namespace commands {
+
+extern const char SIGNAL_DEADBAND_COMMAND_NAME[];
+extern const char SIGNAL_DEADBAND_PERCENT_COMMAND_NAME[];
+extern const char SIGNAL_MIN_SEND_INTERVAL_COMMAND_NAME[];
+
+/* Public: Change one setting of a signal's send filter (see SignalSendFilter
+ * in can/canutil.h), sent as a simple message write:
+ *
+ *      {"name": "signal_deadband", "value": "engine_speed", "event": 10}
+ *
+ * The command's name picks the setting - signal_deadband,
+ * signal_deadband_percent or signal_min_send_interval. The change replaces the
+ * signal's built-in filter until the VI restarts. Either way, the filter in
+ * effect and how many values it has published and suppressed are logged.
+ *
+ * value - The generic name of the signal.
+ * event - The new deadband, deadband percentage or interval in milliseconds.
+ *      If this is left out, the filter isn't changed.
+ *
+ * The arguments are those of a CommandHandler (see can/canutil.h).
+ */
+void handleSignalSendFilterCommand(const char* name,
+        openxc_DynamicField* value, openxc_DynamicField* event,
+        const CanSignal* signals, int signalCount);
+
+} // namespace commands
+} // namespace openxc
+
+#endif // __SIGNAL_SEND_FILTER_COMMAND_H__
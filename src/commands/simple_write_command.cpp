@@ -1,4 +1,12 @@
 #include "simple_write_command.h"
+#include "diagnostic_flow_control_command.h"
+#include "diagnostic_rate_command.h"
+#include "output_batching_command.h"
+#include "output_backpressure_command.h"
+#include "output_coalescing_command.h"
+#include "pipeline_stats_command.h"
+#include "profiler_stats_command.h"
+#include "signal_send_filter_command.h"
 
 #include "config.h"
 #include "diagnostics.h"
@@ -32,15 +40,59 @@ namespace usb = openxc::interface::usb;
 namespace uart = openxc::interface::uart;
 namespace pipeline = openxc::pipeline;
 
+/* Private: Commands built into the VI that are sent as simple message writes,
+ * checked before the signals and commands of the active configuration.
+ */
+static CanCommand BUILTIN_COMMANDS[] = {
+    {genericName: openxc::commands::DIAGNOSTIC_BLOCK_SIZE_COMMAND_NAME,
+        handler: openxc::commands::handleDiagnosticFlowControlCommand},
+    {genericName: openxc::commands::DIAGNOSTIC_RATE_COMMAND_NAME,
+        handler: openxc::commands::handleDiagnosticRateCommand},
+    {genericName: openxc::commands::DIAGNOSTIC_SEPARATION_TIME_COMMAND_NAME,
+        handler: openxc::commands::handleDiagnosticFlowControlCommand},
+    {genericName: openxc::commands::OUTPUT_BATCHING_COMMAND_NAME,
+        handler: openxc::commands::handleOutputBatchingCommand},
+    {genericName: openxc::commands::OUTPUT_BACKPRESSURE_COMMAND_NAME,
+        handler: openxc::commands::handleOutputBackpressureCommand},
+    {genericName: openxc::commands::OUTPUT_COALESCING_COMMAND_NAME,
+        handler: openxc::commands::handleOutputCoalescingCommand},
+    {genericName: openxc::commands::PIPELINE_STATS_COMMAND_NAME,
+        handler: openxc::commands::handlePipelineStatsCommand},
+    {genericName: openxc::commands::PROFILER_STATS_COMMAND_NAME,
+        handler: openxc::commands::handleProfilerStatsCommand},
+    {genericName: openxc::commands::SIGNAL_DEADBAND_COMMAND_NAME,
+        handler: openxc::commands::handleSignalSendFilterCommand},
+    {genericName: openxc::commands::SIGNAL_DEADBAND_PERCENT_COMMAND_NAME,
+        handler: openxc::commands::handleSignalSendFilterCommand},
+    {genericName: openxc::commands::SIGNAL_MIN_SEND_INTERVAL_COMMAND_NAME,
+        handler: openxc::commands::handleSignalSendFilterCommand},
+};
+
 bool openxc::commands::handleSimple(openxc_VehicleMessage* message) {
     bool status = true;
     if(message->type == openxc_VehicleMessage_Type_SIMPLE) {
         openxc_SimpleMessage* simpleMessage =
                 &message->simple_message;
         if(strlen(simpleMessage->name) > 0) {
-            const CanSignal* signal = lookupSignal(simpleMessage->name,
-                    getSignals(), getSignalCount(), true);
-            if(signal != NULL) {
+            CanCommand* builtin = lookupCommand(simpleMessage->name,
+                    BUILTIN_COMMANDS,
+                    sizeof(BUILTIN_COMMANDS) / sizeof(BUILTIN_COMMANDS[0]));
+            const CanSignal* signal = NULL;
+            if(builtin == NULL) {
+                signal = lookupSignal(simpleMessage->name, getSignals(),
+                        getSignalCount(), true);
+            }
+
+            if(builtin != NULL) {
+                if(simpleMessage->value.type == openxc_DynamicField_Type_UNUSED) {
+                    debug("Command %s missing value", simpleMessage->name);
+                    status = false;
+                } else {
+                    builtin->handler(simpleMessage->name, &simpleMessage->value,
+                            (simpleMessage->event.type != openxc_DynamicField_Type_UNUSED) ? &simpleMessage->event : NULL,
+                            getSignals(), getSignalCount());
+                }
+            } else if(signal != NULL) {
                 if(simpleMessage->value.type == openxc_DynamicField_Type_UNUSED) {
                     debug("Write request for %s missing value", simpleMessage->name);
                     status = false;
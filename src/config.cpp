@@ -33,6 +33,7 @@ static void initialize(openxc::config::Configuration* config) {
         &config->network,
 #endif // __USE_NETWORK__
     };
+    openxc::pipeline::initialize(&config->pipeline);
     #ifdef TELIT_HE910_SUPPORT
     // run flashHash
     getFlashHash(config);
@@ -130,6 +131,14 @@ openxc::config::Configuration* openxc::config::getConfiguration() {
         emulatedData: DEFAULT_EMULATED_DATA_STATUS,
         loggingOutput: DEFAULT_LOGGING_OUTPUT,
         calculateMetrics: DEFAULT_METRICS_STATUS,
+        canReceiveBatchSize: DEFAULT_CAN_RECEIVE_BATCH_SIZE,
+        canReceiveBudgetUs: DEFAULT_CAN_RECEIVE_BUDGET_US,
+        outputBatching: false,
+        outputBatchBytes: DEFAULT_OUTPUT_BATCH_BYTES,
+        outputBatchAgeMs: DEFAULT_OUTPUT_BATCH_AGE_MS,
+        backpressurePolicies: {},
+        backpressureBlockMs: DEFAULT_BACKPRESSURE_BLOCK_MS,
+        outputCoalescing: {},
         desiredRunLevel: RunLevel::CAN_ONLY,
         initialized: false,
         runLevel: RunLevel::NOT_RUNNING,
@@ -95,6 +95,26 @@ typedef enum {
  * calculateMetrics - If true, metrics on CAN bus and I/O activity will be
  *      calculated and logged. This has serious performance implications at the
  *      moment.
+ * canReceiveBatchSize - The most CAN messages to pull from each bus's receive
+ *      queue in a single pass through the main loop. A batch size of 1
+ *      interleaves every CAN message with USB, UART and diagnostics processing.
+ * canReceiveBudgetUs - The most time in microseconds to spend pulling messages
+ *      from the CAN receive queues in a single pass through the main loop,
+ *      across all buses. If 0, only canReceiveBatchSize limits the work.
+ * outputBatching - If true, vehicle messages published to USB and the network
+ *      are collected and sent together in batch frames instead of one at a
+ *      time (see pipeline.h).
+ * outputBatchBytes - The number of bytes of messages that fill a batch, which
+ *      is then sent immediately.
+ * outputBatchAgeMs - The longest time in milliseconds a message may wait in a
+ *      batch before the batch is sent, even if it isn't full.
+ * backpressurePolicies - What to do with a message for an interface whose send
+ *      queue is full, indexed by InterfaceType (see pipeline.h).
+ * backpressureBlockMs - The longest time in milliseconds to wait for room on
+ *      an interface with the BLOCK backpressure policy.
+ * outputCoalescing - For each InterfaceType, true if the interface only gets
+ *      the newest value of each signal (see pipeline::publish). Always false
+ *      for USB.
  * desiredRunLevel - The desired run level. If this is different from the
  *      current run level, the main loop will make the changes necessary.
  *
@@ -121,6 +141,15 @@ typedef struct {
     bool emulatedData;
     LoggingOutputInterface loggingOutput;
     bool calculateMetrics;
+    uint8_t canReceiveBatchSize;
+    unsigned int canReceiveBudgetUs;
+    bool outputBatching;
+    uint16_t outputBatchBytes;
+    unsigned int outputBatchAgeMs;
+    openxc::pipeline::BackpressurePolicy backpressurePolicies[
+            PIPELINE_ENDPOINT_COUNT];
+    unsigned int backpressureBlockMs;
+    bool outputCoalescing[PIPELINE_ENDPOINT_COUNT];
     RunLevel desiredRunLevel;
     bool initialized;
     RunLevel runLevel;
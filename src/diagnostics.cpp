@@ -10,12 +10,25 @@
 #include "config.h"
 
 #define MAX_RECURRING_DIAGNOSTIC_FREQUENCY_HZ 10
+#define MS_PER_SECOND 1000
+#define ADAPTIVE_BACKOFF_FACTOR 2
+#define ADAPTIVE_RECOVERY_FACTOR 1.25
+#define RESPONSE_TIME_AVERAGE_WEIGHT 8
 #define DIAGNOSTIC_RESPONSE_ARBITRATION_ID_OFFSET 0x8
+#define ISO_TP_FIRST_FRAME 0x1
+#define ISO_TP_CONSECUTIVE_FRAME 0x2
+#define ISO_TP_FLOW_CONTROL_CLEAR_TO_SEND 0x30
+#define MAX_SEPARATION_TIME_MS 127
 
 using openxc::diagnostics::ActiveDiagnosticRequest;
 using openxc::diagnostics::DiagnosticsManager;
+using openxc::diagnostics::DiagnosticFlowControl;
+using openxc::diagnostics::DiagnosticRequestList;
+using openxc::diagnostics::DiagnosticRequestQueue;
+using openxc::diagnostics::DiagnosticRequestStats;
 using openxc::diagnostics::DiagnosticResponseDecoder;
 using openxc::diagnostics::DiagnosticResponseCallback;
+using openxc::diagnostics::MultiFrameSession;
 using openxc::diagnostics::passthroughDecoder;
 using openxc::util::log::debug;
 using openxc::can::lookupBus;
@@ -55,15 +68,27 @@ static bool timedOut(ActiveDiagnosticRequest* request) {
     return time::elapsed(&request->timeoutClock, false);
 }
 
+/* Private: Returns true if the request stays open until it times out, to
+ * collect the response of every module that answers it.
+ *
+ * This is true if the request was added to wait for multiple responses, or if
+ * it's several PIDs packed into one functional broadcast request - each module
+ * only answers with the PIDs it supports.
+ */
+static bool waitsForMultipleResponses(const ActiveDiagnosticRequest* request) {
+    return request->waitForMultipleResponses || (request->packed &&
+            request->arbitration_id == OBD2_FUNCTIONAL_BROADCAST_ID);
+}
+
 /* Private: Returns true if a sufficient response has been received for a
  * diagnostic request.
  *
- * This is true when at least one response has been received and the request is
- * configured to not wait for multiple responses. Functional broadcast requests
- * may often wish to wait the full 100ms for modules to respond.
+ * This is true when at least one response has been received and the request
+ * doesn't wait for multiple responses. Functional broadcast requests may often
+ * wish to wait the full 100ms for modules to respond.
  */
 static bool responseReceived(ActiveDiagnosticRequest* request) {
-    return !request->waitForMultipleResponses &&
+    return !waitsForMultipleResponses(request) &&
                 request->handle.completed;
 }
 
@@ -75,11 +100,156 @@ static bool requestCompleted(ActiveDiagnosticRequest* request) {
             timedOut(request) && diagnostic_request_sent(&request->handle));
 }
 
+/* Private: Return the bucket of the in-flight table that holds requests to the
+ * arbitration ID on the given bus.
+ */
+static DiagnosticRequestList* inFlightBucket(DiagnosticsManager* manager,
+        const CanBus* bus, uint32_t arbitrationId) {
+    return &manager->inFlightRequests[(arbitrationId + bus->address * 7) %
+            DIAGNOSTIC_IN_FLIGHT_BUCKET_COUNT];
+}
+
+static void markInFlight(DiagnosticsManager* manager,
+        ActiveDiagnosticRequest* entry) {
+    entry->inFlight = true;
+    LIST_INSERT_HEAD(inFlightBucket(manager, entry->bus, entry->arbitration_id),
+            entry, inFlightEntries);
+}
+
+static void clearInFlight(ActiveDiagnosticRequest* entry) {
+    if(entry->inFlight) {
+        entry->inFlight = false;
+        LIST_REMOVE(entry, inFlightEntries);
+    }
+}
+
+/* Private: Return the time in milliseconds when a recurring request is next due
+ * to be sent, or 0 if its clock hasn't started yet (i.e. it's due right away so
+ * the staggered start can be applied).
+ */
+static unsigned long nextDueMs(const ActiveDiagnosticRequest* entry) {
+    if(entry->frequencyClock.lastTick == 0) {
+        return 0;
+    }
+    return entry->frequencyClock.lastTick +
+            (unsigned long)(MS_PER_SECOND / entry->frequencyClock.frequency);
+}
+
+/* Private: Insert a recurring request into the queue in front of the first
+ * request that is due after it.
+ */
+static void scheduleRecurringRequest(DiagnosticsManager* manager,
+        ActiveDiagnosticRequest* entry) {
+    unsigned long due = nextDueMs(entry);
+    ActiveDiagnosticRequest* candidate;
+    TAILQ_FOREACH(candidate, &manager->recurringRequests, queueEntries) {
+        if(nextDueMs(candidate) > due) {
+            TAILQ_INSERT_BEFORE(candidate, entry, queueEntries);
+            return;
+        }
+    }
+    TAILQ_INSERT_TAIL(&manager->recurringRequests, entry, queueEntries);
+}
+
+/* Private: Returns true if the request is a recurring, plain OBD-II mode 1
+ * request for a single PID that can share a CAN frame with other PIDs.
+ */
+static bool packable(const ActiveDiagnosticRequest* entry) {
+    const DiagnosticRequest* request = &entry->handle.request;
+    return entry->recurring && !entry->packed &&
+            !entry->waitForMultipleResponses && request->mode == 0x1 &&
+            request->has_pid && request->payload_length == 0 &&
+            obd2::pidResponseLength(request->pid) > 0;
+}
+
+/* Private: Return the single PID request that the entry was created with. A
+ * packed request always has the entry's own PID first in its payload.
+ */
+static DiagnosticRequest unpackedRequest(const ActiveDiagnosticRequest* entry) {
+    DiagnosticRequest request = entry->handle.request;
+    if(entry->packed) {
+        request.has_pid = true;
+        request.pid = request.payload[0];
+        request.pid_length = 1;
+        request.payload_length = 0;
+    }
+    return request;
+}
+
+/* Private: Fold the other due OBD-II PID requests to the same bus and
+ * arbitration ID into the leader's request, so up to
+ * MAX_OBD2_PIDS_PER_REQUEST PIDs are sent in one CAN frame. The folded
+ * requests are ticked as if they were sent and moved to the rescheduled queue.
+ *
+ * A packed functional broadcast request stays open until it times out, and the
+ * response of each module that answers is split up by PID as it arrives.
+ */
+static void packObd2Requests(DiagnosticsManager* manager,
+        ActiveDiagnosticRequest* leader, unsigned long now,
+        DiagnosticRequestQueue* rescheduled) {
+    DiagnosticRequest packedRequest = leader->handle.request;
+    packedRequest.has_pid = false;
+    packedRequest.pid = 0;
+    packedRequest.pid_length = 0;
+    packedRequest.payload[0] = leader->handle.request.pid;
+    packedRequest.payload_length = 1;
+
+    ActiveDiagnosticRequest* candidate = TAILQ_NEXT(leader, queueEntries);
+    while(candidate != NULL && nextDueMs(candidate) <= now &&
+            packedRequest.payload_length < MAX_OBD2_PIDS_PER_REQUEST) {
+        ActiveDiagnosticRequest* next = TAILQ_NEXT(candidate, queueEntries);
+        if(candidate->bus == leader->bus &&
+                candidate->arbitration_id == leader->arbitration_id &&
+                !candidate->inFlight && candidate->packLeader == NULL &&
+                packable(candidate) && nextDueMs(candidate) != 0 &&
+                time::elapsed(&candidate->frequencyClock, false)) {
+            packedRequest.payload[packedRequest.payload_length++] =
+                    candidate->handle.request.pid;
+            candidate->packLeader = leader;
+            time::tick(&candidate->frequencyClock);
+            TAILQ_REMOVE(&manager->recurringRequests, candidate, queueEntries);
+            TAILQ_INSERT_TAIL(rescheduled, candidate, queueEntries);
+        }
+        candidate = next;
+    }
+
+    if(packedRequest.payload_length > 1) {
+        leader->handle = generate_diagnostic_request(
+                &manager->shims[leader->bus->address - 1], &packedRequest,
+                NULL);
+        leader->packed = true;
+    }
+}
+
+/* Private: Put a packed request back to its single PID and release the
+ * requests that were folded into it.
+ */
+static void unpackRequest(DiagnosticsManager* manager,
+        ActiveDiagnosticRequest* leader) {
+    if(!leader->packed) {
+        return;
+    }
+
+    DiagnosticRequest request = unpackedRequest(leader);
+    leader->handle = generate_diagnostic_request(
+            &manager->shims[leader->bus->address - 1], &request, NULL);
+    leader->packed = false;
+
+    for(int i = 0; i < MAX_SIMULTANEOUS_DIAG_REQUESTS; i++) {
+        if(manager->requestListEntries[i].packLeader == leader) {
+            manager->requestListEntries[i].packLeader = NULL;
+        }
+    }
+}
+
 /* Private: Move the entry to the free list and decrement the lock count for any
  * CAN filters it used.
  */
 static void cancelRequest(DiagnosticsManager* manager,
         ActiveDiagnosticRequest* entry) {
+    clearInFlight(entry);
+    unpackRequest(manager, entry);
+    entry->packLeader = NULL;
     LIST_INSERT_HEAD(&manager->freeRequestEntries, entry, listEntries);
     if(entry->arbitration_id == OBD2_FUNCTIONAL_BROADCAST_ID) {
         for(uint32_t filter = OBD2_FUNCTIONAL_RESPONSE_START;
@@ -98,27 +268,86 @@ static void cancelRequest(DiagnosticsManager* manager,
     }
 }
 
+/* Private: Count a completed request as answered or timed out and, if it's an
+ * adaptive recurring request, adjust its rate.
+ *
+ * Returns true if the rate of the request changed.
+ */
+static bool updateRequestRate(ActiveDiagnosticRequest* entry) {
+    DiagnosticRequestStats* stats = &entry->stats;
+    bool answered = entry->handle.completed;
+    if(answered) {
+        ++stats->responseCount;
+        if(!waitsForMultipleResponses(entry)) {
+            unsigned long responseTime = time::systemTimeMs() - entry->sentAtMs;
+            stats->lastResponseTimeMs = responseTime;
+            if(stats->framesReceived > 1) {
+                debug("Received %u frame response from 0x%x in %lu ms",
+                        stats->framesReceived, entry->arbitration_id,
+                        responseTime);
+            }
+            stats->averageResponseTimeMs = stats->responseCount == 1 ?
+                    responseTime :
+                    (stats->averageResponseTimeMs *
+                        (RESPONSE_TIME_AVERAGE_WEIGHT - 1) + responseTime) /
+                    RESPONSE_TIME_AVERAGE_WEIGHT;
+        }
+    } else {
+        ++stats->timeoutCount;
+    }
+
+    if(!entry->recurring || !entry->adaptive) {
+        return false;
+    }
+
+    float frequency = entry->frequencyClock.frequency;
+    if(!answered) {
+        frequency /= ADAPTIVE_BACKOFF_FACTOR;
+        if(frequency < entry->minFrequency) {
+            frequency = entry->minFrequency;
+        }
+    } else if(stats->averageResponseTimeMs * 2 <
+            MS_PER_SECOND / frequency) {
+        // Only speed up while the ECU answers well within the period
+        frequency *= ADAPTIVE_RECOVERY_FACTOR;
+        if(frequency > entry->configuredFrequency) {
+            frequency = entry->configuredFrequency;
+        }
+    }
+
+    bool changed = frequency != entry->frequencyClock.frequency;
+    entry->frequencyClock.frequency = frequency;
+    return changed;
+}
+
 static void cleanupRequest(DiagnosticsManager* manager,
         ActiveDiagnosticRequest* entry, bool force) {
     if(force || (entry->inFlight && requestCompleted(entry))) {
-        entry->inFlight = false;
+        clearInFlight(entry);
 
         char request_string[128] = {0};
         diagnostic_request_to_string(&entry->handle.request,
                 request_string, sizeof(request_string));
         if(entry->recurring) {
-            TAILQ_REMOVE(&manager->recurringRequests, entry, queueEntries);
             if(force) {
+                TAILQ_REMOVE(&manager->recurringRequests, entry, queueEntries);
                 cancelRequest(manager, entry);
             } else {
-                debug("Moving completed recurring request to the back "
-                        "of the queue: %s", request_string);
-                TAILQ_INSERT_TAIL(&manager->recurringRequests, entry,
-                        queueEntries);
+                // It was already moved to its next deadline when it was sent,
+                // unless the adaptive rate has just changed that deadline
+                debug("Completed recurring request: %s", request_string);
+                bool rateChanged = updateRequestRate(entry);
+                unpackRequest(manager, entry);
+                if(rateChanged) {
+                    TAILQ_REMOVE(&manager->recurringRequests, entry,
+                            queueEntries);
+                    scheduleRecurringRequest(manager, entry);
+                }
             }
         } else {
             debug("Cancelling completed, non-recurring request: %s",
                     request_string);
+            updateRequestRate(entry);
             LIST_REMOVE(entry, listEntries);
             cancelRequest(manager, entry);
 
@@ -132,12 +361,24 @@ static void cleanupRequest(DiagnosticsManager* manager,
 // clean up the request list, move as many to the free list as possible
 static void cleanupActiveRequests(DiagnosticsManager* manager, bool force) {
     ActiveDiagnosticRequest* entry, *tmp;
-    LIST_FOREACH_SAFE(entry, &manager->nonrecurringRequests, listEntries, tmp) {
-        cleanupRequest(manager, entry, force);
-    }
+    if(force) {
+        LIST_FOREACH_SAFE(entry, &manager->nonrecurringRequests, listEntries,
+                tmp) {
+            cleanupRequest(manager, entry, force);
+        }
 
-    TAILQ_FOREACH_SAFE(entry, &manager->recurringRequests, queueEntries, tmp) {
-        cleanupRequest(manager, entry, force);
+        TAILQ_FOREACH_SAFE(entry, &manager->recurringRequests, queueEntries,
+                tmp) {
+            cleanupRequest(manager, entry, force);
+        }
+    } else {
+        // Only requests in flight can complete, so skip everything else
+        for(int i = 0; i < DIAGNOSTIC_IN_FLIGHT_BUCKET_COUNT; i++) {
+            LIST_FOREACH_SAFE(entry, &manager->inFlightRequests[i],
+                    inFlightEntries, tmp) {
+                cleanupRequest(manager, entry, force);
+            }
+        }
     }
 }
 
@@ -156,17 +397,50 @@ static bool sendDiagnosticCanMessage(CanBus* bus,
     return true;
 }
 
+/* Private: Send a frame for uds-c. If it's the flow control frame answering
+ * the first frame of a multi-frame response, the block size and STmin are
+ * filled in from the request in flight to the arbitration ID, or from the
+ * default of the bus if there isn't one (e.g. the response to a functional
+ * broadcast request).
+ */
+static bool sendDiagnosticShimMessage(CanBus* bus,
+        const uint32_t arbitrationId, const uint8_t data[],
+        const uint8_t size) {
+    if(size < 3 || size > CAN_MESSAGE_SIZE ||
+            data[0] != ISO_TP_FLOW_CONTROL_CLEAR_TO_SEND) {
+        return sendDiagnosticCanMessage(bus, arbitrationId, data, size);
+    }
+
+    DiagnosticsManager* manager = &getConfiguration()->diagnosticsManager;
+    DiagnosticFlowControl* flowControl =
+            &manager->flowControl[bus->address - 1];
+    ActiveDiagnosticRequest* entry;
+    LIST_FOREACH(entry, inFlightBucket(manager, bus, arbitrationId),
+            inFlightEntries) {
+        if(entry->bus == bus && entry->arbitration_id == arbitrationId) {
+            flowControl = &entry->flowControl;
+            break;
+        }
+    }
+
+    uint8_t flowControlFrame[CAN_MESSAGE_SIZE];
+    memcpy(flowControlFrame, data, size);
+    flowControlFrame[1] = flowControl->blockSize;
+    flowControlFrame[2] = flowControl->separationTime;
+    return sendDiagnosticCanMessage(bus, arbitrationId, flowControlFrame, size);
+}
+
 static bool sendDiagnosticCanMessageBus1(
         const uint32_t arbitrationId, const uint8_t* data,
         const uint8_t size) {
-    return sendDiagnosticCanMessage(&getCanBuses()[0], arbitrationId, data,
+    return sendDiagnosticShimMessage(&getCanBuses()[0], arbitrationId, data,
             size);
 }
 
 static bool sendDiagnosticCanMessageBus2(
         const uint32_t arbitrationId, const uint8_t* data,
         const uint8_t size) {
-    return sendDiagnosticCanMessage(&getCanBuses()[1], arbitrationId, data,
+    return sendDiagnosticShimMessage(&getCanBuses()[1], arbitrationId, data,
             size);
 }
 
@@ -178,6 +452,12 @@ void openxc::diagnostics::reset(DiagnosticsManager* manager) {
     TAILQ_INIT(&manager->recurringRequests);
     LIST_INIT(&manager->nonrecurringRequests);
     LIST_INIT(&manager->freeRequestEntries);
+    for(int i = 0; i < DIAGNOSTIC_IN_FLIGHT_BUCKET_COUNT; i++) {
+        LIST_INIT(&manager->inFlightRequests[i]);
+    }
+    for(int i = 0; i < MAX_MULTI_FRAME_SESSIONS; i++) {
+        manager->multiFrameSessions[i].bus = NULL;
+    }
 
     for(int i = 0; i < MAX_SIMULTANEOUS_DIAG_REQUESTS; i++) {
         LIST_INSERT_HEAD(&manager->freeRequestEntries,
@@ -195,6 +475,11 @@ void openxc::diagnostics::initialize(DiagnosticsManager* manager, CanBus* buses,
                     sendDiagnosticCanMessageBus2, NULL);
         }
     }
+    for(int i = 0; i < MAX_SHIM_COUNT; i++) {
+        manager->flowControl[i].blockSize = DEFAULT_FLOW_CONTROL_BLOCK_SIZE;
+        manager->flowControl[i].separationTime =
+                DEFAULT_FLOW_CONTROL_SEPARATION_TIME;
+    }
 
     reset(manager);
     manager->initialized = true;
@@ -217,18 +502,12 @@ static inline bool conflicting(ActiveDiagnosticRequest* request,
 static inline bool clearToSend(DiagnosticsManager* manager,
         ActiveDiagnosticRequest* request) {
     ActiveDiagnosticRequest* entry;
-    LIST_FOREACH(entry, &manager->nonrecurringRequests, listEntries) {
-        if(conflicting(request, entry)) {
-            return false;
-        }
-    }
-
-    TAILQ_FOREACH(entry, &manager->recurringRequests, queueEntries) {
+    LIST_FOREACH(entry, inFlightBucket(manager, request->bus,
+                request->arbitration_id), inFlightEntries) {
         if(conflicting(request, entry)) {
             return false;
         }
     }
-
     return true;
 }
 
@@ -239,21 +518,28 @@ static inline bool shouldSend(ActiveDiagnosticRequest* request) {
                                                  true)));
 }
 
-static void sendRequest(DiagnosticsManager* manager, CanBus* bus,
+static inline bool readyToSend(DiagnosticsManager* manager, CanBus* bus,
         ActiveDiagnosticRequest* request) {
-    if(request->bus == bus && shouldSend(request) &&
-            clearToSend(manager, request)) {
-        time::tick(&request->frequencyClock);
-        start_diagnostic_request(&manager->shims[bus->address - 1],
-                &request->handle);
-        if(request->handle.completed && !request->handle.success) {
-            debug("Fatal error sending diagnostic request");
-        } else {
-            request->timeoutClock = {0};
-            request->timeoutClock.frequency = 10;
-            time::tick(&request->timeoutClock);
-            request->inFlight = true;
-        }
+    return request->bus == bus && shouldSend(request) &&
+            clearToSend(manager, request);
+}
+
+static void startRequest(DiagnosticsManager* manager,
+        ActiveDiagnosticRequest* request) {
+    time::tick(&request->frequencyClock);
+    start_diagnostic_request(&manager->shims[request->bus->address - 1],
+            &request->handle);
+    if(request->handle.completed && !request->handle.success) {
+        debug("Fatal error sending diagnostic request");
+        unpackRequest(manager, request);
+    } else {
+        request->timeoutClock = {0};
+        request->timeoutClock.frequency = 10;
+        time::tick(&request->timeoutClock);
+        request->sentAtMs = request->timeoutClock.lastTick;
+        request->stats.framesReceived = 0;
+        request->blockFramesReceived = 0;
+        markInFlight(manager, request);
     }
 }
 
@@ -263,57 +549,46 @@ void openxc::diagnostics::sendRequests(DiagnosticsManager* manager,
 
     ActiveDiagnosticRequest* entry;
     LIST_FOREACH(entry, &manager->nonrecurringRequests, listEntries) {
-        sendRequest(manager, bus, entry);
-    }
-
-    TAILQ_FOREACH(entry, &manager->recurringRequests, queueEntries) {
-        sendRequest(manager, bus, entry);
+        if(readyToSend(manager, bus, entry)) {
+            startRequest(manager, entry);
+        }
     }
-}
 
-static openxc_VehicleMessage wrapDiagnosticResponseWithSabot(CanBus* bus,
-        const ActiveDiagnosticRequest* request,
-        const DiagnosticResponse* response, openxc_DynamicField value) {
-    openxc_VehicleMessage message = openxc_VehicleMessage();		// Zero fill
-    message.type = openxc_VehicleMessage_Type_DIAGNOSTIC;
-    message.diagnostic_response = {0};
-    message.diagnostic_response.bus = bus->address;
+    // The recurring queue is sorted by deadline, so stop at the first request
+    // that isn't due. Any request whose deadline moved (because it was sent,
+    // packed into another request or its staggered start was picked) is set
+    // aside and put back in at its new position once the pass is done.
+    unsigned long now = time::systemTimeMs();
+    DiagnosticRequestQueue rescheduled;
+    TAILQ_INIT(&rescheduled);
+    entry = TAILQ_FIRST(&manager->recurringRequests);
+    while(entry != NULL && nextDueMs(entry) <= now) {
+        unsigned long due = nextDueMs(entry);
+        if(readyToSend(manager, bus, entry)) {
+            if(packable(entry)) {
+                packObd2Requests(manager, entry, now, &rescheduled);
+            }
+            startRequest(manager, entry);
+        }
 
-    if(request->arbitration_id != OBD2_FUNCTIONAL_BROADCAST_ID) {
-        message.diagnostic_response.message_id = response->arbitration_id
-            - DIAGNOSTIC_RESPONSE_ARBITRATION_ID_OFFSET;
-    } else {
-        // must preserve responding arb ID for responses to functional broadcast
-        // requests, as they are the actual module address and not just arb ID +
-        // 8.
-        message.diagnostic_response.message_id = response->arbitration_id;
+        ActiveDiagnosticRequest* next = TAILQ_NEXT(entry, queueEntries);
+        if(nextDueMs(entry) != due) {
+            TAILQ_REMOVE(&manager->recurringRequests, entry, queueEntries);
+            TAILQ_INSERT_TAIL(&rescheduled, entry, queueEntries);
+        }
+        entry = next;
     }
 
-    message.diagnostic_response.mode = response->mode;
-    message.diagnostic_response.pid = response->pid;
-    message.diagnostic_response.success = response->success;
-    message.diagnostic_response.negative_response_code =
-            response->negative_response_code;
-
-    if(response->payload_length > 0) {
-        if (request->decoder != NULL)  {
-            message.diagnostic_response.value = value;
-        } else {
-            memcpy(message.diagnostic_response.payload.bytes, response->payload,
-                    response->payload_length);
-            message.diagnostic_response.payload.size = response->payload_length;
-        }
+    while((entry = TAILQ_FIRST(&rescheduled)) != NULL) {
+        TAILQ_REMOVE(&rescheduled, entry, queueEntries);
+        scheduleRecurringRequest(manager, entry);
     }
-    return message;
 }
 
-void dumpPayload2(unsigned char *, size_t);
-
-static int prevFrames[] = {-1,-1,-1,-1,-1,-1,-1,-1}; // 7e8-7ef
-static openxc_VehicleMessage wrapDiagnosticStitchResponseWithSabot(CanBus* bus,
+static openxc_VehicleMessage wrapDiagnosticResponseWithSabot(CanBus* bus,
         const ActiveDiagnosticRequest* request,
         const DiagnosticResponse* response, openxc_DynamicField value) {
-    openxc_VehicleMessage message = openxc_VehicleMessage();        // Zero fill
+    openxc_VehicleMessage message = openxc_VehicleMessage();		// Zero fill
     message.type = openxc_VehicleMessage_Type_DIAGNOSTIC;
     message.diagnostic_response = {0};
     message.diagnostic_response.bus = bus->address;
@@ -334,15 +609,6 @@ static openxc_VehicleMessage wrapDiagnosticStitchResponseWithSabot(CanBus* bus,
     message.diagnostic_response.negative_response_code =
             response->negative_response_code;
 
-    int frame_offset = (response->arbitration_id - 0x07e8) & 0x7;   // Prevent overflow
-    message.diagnostic_response.frame = prevFrames[frame_offset] + 1;
-    if (response->completed) {
-        message.diagnostic_response.frame = -1;     // Marks the last frame in the response
-    } else {
-        message.diagnostic_response.success = true;
-    }
-    prevFrames[frame_offset] = message.diagnostic_response.frame;
-
     if(response->payload_length > 0) {
         if (request->decoder != NULL)  {
             message.diagnostic_response.value = value;
@@ -356,72 +622,7 @@ static openxc_VehicleMessage wrapDiagnosticStitchResponseWithSabot(CanBus* bus,
     return message;
 }
 
-#if (MULTIFRAME != 0)
-// The next 2 methods are the origial way that multi-frame
-// stitching was achieved.  It has been replaced with a new
-// openxc.proto file and uses a new message type.
-// These are here for reference until we know the new messages are working
-// 6/15/2020
-const int MAX_MULTI_FRAME_MESSAGE_SIZE = 300;
-
-static void sendPartialMessage(long timestamp,
-                                int frame,
-                                int message_id,
-                                int bus,
-                                int total_size,
-                                int mode,
-                                int pid,
-                                int value,
-                                int negative_response_code,
-                                const char *payload,
-                                int payload_size,
-                                Pipeline* pipeline) {
-
-    char messageBuffer[MAX_MULTI_FRAME_MESSAGE_SIZE];
-            
-    // Manually form the message that is going out.
-
-    int numWritten = snprintf(messageBuffer,
-            MAX_MULTI_FRAME_MESSAGE_SIZE,
-            "{\"timestamp\":%ld,\"frame\":%d,\"id\":%d,\"bus\":%d,\"total_size\":%d,\"mode\":%d,\"pid\":%d,\"value\":%d",
-            timestamp,
-            frame,
-            message_id+8,
-            bus,
-            total_size,
-            mode,
-            pid,
-            value);
-    
-    if (negative_response_code != 0) {  // Is there a failure code?
-        numWritten += snprintf(messageBuffer+numWritten,
-                            MAX_MULTI_FRAME_MESSAGE_SIZE-numWritten,
-                            ",\"success\":false,\"negative_response_code\":%d",
-                            negative_response_code);
-    } else {    // Success
-        numWritten += snprintf(messageBuffer+numWritten,
-                            MAX_MULTI_FRAME_MESSAGE_SIZE-numWritten,
-                            ",\"success\":true");
-    }
-
-    numWritten += snprintf(messageBuffer+numWritten,
-                            MAX_MULTI_FRAME_MESSAGE_SIZE-numWritten,
-                            ",\"payload\":\"0x");
-
-    for(int index=0; (index<payload_size) && (numWritten < MAX_MULTI_FRAME_MESSAGE_SIZE); index++) {
-        messageBuffer[numWritten++]=(((payload[index]>>4) & 0x0f) > 9) ? ((payload[index]>>4) & 0x0f) + 'a' - 10 : ((payload[index]>>4) & 0x0f) + '0';
-        messageBuffer[numWritten++]=((payload[index]&0xf) > 9) ? (payload[index]&0x0f) + 'a' - 10 : (payload[index]&0xf) + '0';
-    }
-    numWritten += snprintf(messageBuffer+numWritten,
-                            MAX_MULTI_FRAME_MESSAGE_SIZE-numWritten,
-                            "\"}");
-
-    int messageLen = strlen(messageBuffer) +1;
-    pipeline::sendMessage(pipeline,
-        (uint8_t*)messageBuffer, messageLen, MessageClass::SIMPLE);
-}
-
-#endif
+void dumpPayload2(unsigned char *, size_t);
 
 bool openxc::diagnostics::haveVINfromCan() {
     return vinComplete;
@@ -512,8 +713,7 @@ void openxc::diagnostics::sendGetVinError() {
 
 static void relayDiagnosticResponse(DiagnosticsManager* manager,
         ActiveDiagnosticRequest* request,
-        const DiagnosticResponse* response, Pipeline* pipeline,
-        bool stitchMessage) {
+        const DiagnosticResponse* response, Pipeline* pipeline) {
     float parsed_value = diagnostic_payload_to_integer(response);
 
     uint8_t buf_size = response->multi_frame ? response->payload_length + 1 : 20;
@@ -547,15 +747,6 @@ static void relayDiagnosticResponse(DiagnosticsManager* manager,
         } else {
             publishNumericalMessage(request->name, field.numeric_value, pipeline);
         }
-    } else if (stitchMessage) {
-        openxc_VehicleMessage message = wrapDiagnosticStitchResponseWithSabot(
-                request->bus, request, response, field);
-        pipeline::publish(&message, pipeline);
-
-        if (!(response->completed)) {
-            return; // Only return if this is not the last partial
-                    // Otherwise if this is last we want to invoke the callback
-        }
     } else {
         // If no name, send full details of response but still include 'value'
         // instead of 'payload' if they provided a decoder. The one case you
@@ -570,8 +761,167 @@ static void relayDiagnosticResponse(DiagnosticsManager* manager,
         request->callback(manager, request, response, parsed_value);
     }
 }
+
+/* Private: Find the session relaying the response arriving from the given
+ * arbitration ID on the bus, or start one. If every session is taken, the one
+ * that has been idle the longest is reclaimed.
+ */
+static MultiFrameSession* lookupMultiFrameSession(DiagnosticsManager* manager,
+        const ActiveDiagnosticRequest* request, uint32_t arbitrationId) {
+    MultiFrameSession* candidate = NULL;
+    for(int i = 0; i < MAX_MULTI_FRAME_SESSIONS; i++) {
+        MultiFrameSession* session = &manager->multiFrameSessions[i];
+        if(session->bus == request->bus &&
+                session->arbitrationId == arbitrationId) {
+            if(session->request == request &&
+                    session->requestSentAtMs == request->sentAtMs) {
+                return session;
+            }
+            // The rest of an older response that never finished
+            candidate = session;
+            break;
+        }
+
+        if(candidate == NULL || (candidate->bus != NULL &&
+                (session->bus == NULL ||
+                 session->lastSegmentMs < candidate->lastSegmentMs))) {
+            candidate = session;
+        }
+    }
+
+    if(candidate->bus != NULL && candidate->arbitrationId != arbitrationId) {
+        debug("Reclaiming multi-frame session for 0x%x, response is lost",
+                candidate->arbitrationId);
+    }
+    candidate->bus = request->bus;
+    candidate->arbitrationId = arbitrationId;
+    candidate->request = request;
+    candidate->requestSentAtMs = request->sentAtMs;
+    candidate->frame = 0;
+    return candidate;
+}
+
+/* Private: Relay one segment of a multi-frame response as soon as it arrives,
+ * numbered by its session (the last one is frame -1). The payload goes from
+ * the response straight into the outgoing message, so large responses don't
+ * need a buffer for the whole thing.
+ *
+ * A decoder or a name needs the complete payload to produce a value, so those
+ * requests are only relayed once the response is complete.
+ */
+static void relayMultiFrameSegment(DiagnosticsManager* manager,
+        ActiveDiagnosticRequest* request, const DiagnosticResponse* response,
+        Pipeline* pipeline) {
+    if(request->decoder != NULL ||
+            strnlen(request->name, sizeof(request->name)) > 0) {
+        if(response->completed) {
+            relayDiagnosticResponse(manager, request, response, pipeline);
+        }
+        return;
+    }
+
+    MultiFrameSession* session = lookupMultiFrameSession(manager, request,
+            response->arbitration_id);
+    session->lastSegmentMs = time::systemTimeMs();
+
+    openxc_VehicleMessage message = wrapDiagnosticResponseWithSabot(
+            request->bus, request, response, openxc_DynamicField());
+    if(response->completed) {
+        message.diagnostic_response.frame = -1;
+        session->bus = NULL;
+    } else {
+        message.diagnostic_response.frame = session->frame++;
+        message.diagnostic_response.success = true;
+    }
+    pipeline::publish(&message, pipeline);
+
+    if(response->completed && request->callback != NULL) {
+        request->callback(manager, request, response,
+                diagnostic_payload_to_integer(response));
+    }
+}
+
+/* Private: Split the response to a packed OBD-II request into one response per
+ * PID and relay each of them through the request that asked for that PID.
+ */
+static void relayPackedObd2Response(DiagnosticsManager* manager,
+        ActiveDiagnosticRequest* leader, const DiagnosticResponse* response,
+        Pipeline* pipeline) {
+    DiagnosticResponse pidResponse = *response;
+    pidResponse.multi_frame = false;
+
+    int index = 0;
+    while(index < response->payload_length) {
+        uint8_t pid = response->payload[index++];
+        uint8_t length = obd2::pidResponseLength(pid);
+        if(length == 0 || index + length > response->payload_length) {
+            debug("Unable to split packed OBD-II response at PID 0x%x", pid);
+            break;
+        }
+
+        ActiveDiagnosticRequest* member = NULL;
+        if(leader->handle.request.payload[0] == pid) {
+            member = leader;
+        } else {
+            for(int i = 0; i < MAX_SIMULTANEOUS_DIAG_REQUESTS; i++) {
+                ActiveDiagnosticRequest* candidate =
+                        &manager->requestListEntries[i];
+                if(candidate->packLeader == leader &&
+                        candidate->handle.request.pid == pid) {
+                    member = candidate;
+                    break;
+                }
+            }
+        }
+
+        if(member != NULL) {
+            pidResponse.pid = pid;
+            memcpy(pidResponse.payload, &response->payload[index], length);
+            pidResponse.payload_length = length;
+            relayDiagnosticResponse(manager, member, &pidResponse, pipeline);
+        }
+        index += length;
+    }
+}
+
 void sendCommandResponse(openxc_ControlCommand_Type commandType,
     bool status, char* responseMessage, size_t responseMessageLength);
+
+/* Private: isotp-c only answers the first frame of a multi-frame response with
+ * flow control. If the request has a block size, ask for the next block once
+ * the module has sent a whole one and the response isn't complete yet.
+ *
+ * The flow control goes to the ID the request was sent to, or for a functional
+ * broadcast request, to the physical request ID of the module that answered.
+ */
+static void continueMultiFrameResponse(ActiveDiagnosticRequest* entry,
+        const CanMessage* message, const DiagnosticResponse* response) {
+    if(entry->flowControl.blockSize == 0 || !response->multi_frame ||
+            response->completed) {
+        return;
+    }
+
+    uint8_t frameType = message->data[0] >> 4;
+    if(frameType == ISO_TP_FIRST_FRAME) {
+        entry->blockFramesReceived = 0;
+    } else if(frameType == ISO_TP_CONSECUTIVE_FRAME &&
+            ++entry->blockFramesReceived >= entry->flowControl.blockSize) {
+        entry->blockFramesReceived = 0;
+        uint8_t flowControlFrame[CAN_MESSAGE_SIZE] = {
+            ISO_TP_FLOW_CONTROL_CLEAR_TO_SEND,
+            entry->flowControl.blockSize,
+            entry->flowControl.separationTime
+        };
+        uint32_t arbitrationId = entry->handle.request.arbitration_id;
+        if(arbitrationId == OBD2_FUNCTIONAL_BROADCAST_ID) {
+            arbitrationId = message->id -
+                    DIAGNOSTIC_RESPONSE_ARBITRATION_ID_OFFSET;
+        }
+        sendDiagnosticCanMessage(entry->bus, arbitrationId, flowControlFrame,
+                sizeof(flowControlFrame));
+    }
+}
+
 static void receiveCanMessage(DiagnosticsManager* manager,
         CanBus* bus,
         ActiveDiagnosticRequest* entry,
@@ -583,6 +933,8 @@ static void receiveCanMessage(DiagnosticsManager* manager,
                 // coupled?
                 &manager->shims[bus->address - 1],
                 &entry->handle, message->id, message->data, message->length);
+        ++entry->stats.framesReceived;
+        continueMultiFrameResponse(entry, message, &response);
                 debug("Raw Message for get_vin");
                 debug((const char*)message->data);
                 // If this is a VIN command we don't want to send a diagnostic response.
@@ -590,23 +942,35 @@ static void receiveCanMessage(DiagnosticsManager* manager,
                     openxc::diagnostics::checkForVinCommand(message);
                     return;
                 }
-        if (response.multi_frame) {
+        if (entry->packed) {
+            // Only the complete response can be split up by PID
+            if (!response.completed) {
+                if (response.multi_frame) {
+                    time::tick(&entry->timeoutClock);
+                }
+            } else if (entry->handle.completed && entry->handle.success &&
+                    response.success) {
+                relayPackedObd2Response(manager, entry, &response, pipeline);
+            } else if (entry->handle.completed) {
+                relayDiagnosticResponse(manager, entry, &response, pipeline);
+            }
+        } else if (response.multi_frame) {
 #if (MULTIFRAME != 0)
-            relayDiagnosticResponse(manager, entry, &response, pipeline, true);   // Added 6/11/2020
+            relayMultiFrameSegment(manager, entry, &response, pipeline);
+#else
+            // This is the pre 2020 Way of sending a Diagnostic Response
+            // (all at once)
+            if (response.completed) {
+                relayDiagnosticResponse(manager, entry, &response, pipeline);
+            }
 #endif
             if (!response.completed) {
                 time::tick(&entry->timeoutClock);
-            } else {
-#if (MULTIFRAME == 0)
-                // This is the pre 2020 Way of sending a Diagnostic Response
-                // (all at once)
-                relayDiagnosticResponse(manager, entry, &response, pipeline, false);
-#endif
             }
         } else if (response.completed && entry->handle.completed) {
             if(entry->handle.success) {
                 // Handle Single frame messages here!
-                relayDiagnosticResponse(manager, entry, &response, pipeline, false);
+                relayDiagnosticResponse(manager, entry, &response, pipeline);
             } else {
                 debug("Fatal error sending or receiving diagnostic request");
             }
@@ -614,37 +978,58 @@ static void receiveCanMessage(DiagnosticsManager* manager,
     }
 }
 
+/* Private: Pass a received message to the request in flight to the given
+ * arbitration ID on the bus (if any), and clean it up if that completed it.
+ */
+static void dispatchToInFlightRequest(DiagnosticsManager* manager,
+        CanBus* bus, uint32_t requestArbitrationId, CanMessage* message,
+        Pipeline* pipeline) {
+    ActiveDiagnosticRequest* entry, *tmp;
+    LIST_FOREACH_SAFE(entry, inFlightBucket(manager, bus, requestArbitrationId),
+            inFlightEntries, tmp) {
+        if(entry->bus == bus &&
+                entry->arbitration_id == requestArbitrationId) {
+            receiveCanMessage(manager, bus, entry, message, pipeline);
+            cleanupRequest(manager, entry, false);
+        }
+    }
+}
+
 void openxc::diagnostics::receiveCanMessage(DiagnosticsManager* manager,
         CanBus* bus, CanMessage* message, Pipeline* pipeline) {
-    ActiveDiagnosticRequest* entry;
-
-    TAILQ_FOREACH(entry, &manager->recurringRequests, queueEntries) {
-        receiveCanMessage(manager, bus, entry, message, pipeline);
+    if(message->id < DIAGNOSTIC_RESPONSE_ARBITRATION_ID_OFFSET) {
+        return;
     }
 
-    LIST_FOREACH(entry, &manager->nonrecurringRequests, listEntries) {
-        receiveCanMessage(manager, bus, entry, message, pipeline);
+    // A response can only belong to a physical request to its ID - 8 or, if
+    // it's from one of the functional response addresses, a functional
+    // broadcast request. Everything else misses the in-flight table.
+    dispatchToInFlightRequest(manager, bus,
+            message->id - DIAGNOSTIC_RESPONSE_ARBITRATION_ID_OFFSET, message,
+            pipeline);
+    if(message->id >= OBD2_FUNCTIONAL_RESPONSE_START &&
+            message->id < OBD2_FUNCTIONAL_RESPONSE_START +
+                OBD2_FUNCTIONAL_RESPONSE_COUNT) {
+        dispatchToInFlightRequest(manager, bus, OBD2_FUNCTIONAL_BROADCAST_ID,
+                message, pipeline);
     }
-    cleanupActiveRequests(manager, false);
 }
 
-/* Note that this pops it off of whichver list it was on and returns it, so make
- * sure to add it to some other list or it'll be lost.
+/* Note that this leaves the request in the recurring queue, so remove it
+ * before moving it to any other list.
  */
 static ActiveDiagnosticRequest* lookupRecurringRequest(
         DiagnosticsManager* manager, const CanBus* bus,
         const DiagnosticRequest* request) {
-    ActiveDiagnosticRequest* existingEntry = NULL, *entry, *tmp;
-    TAILQ_FOREACH_SAFE(entry, &manager->recurringRequests, queueEntries, tmp) {
-        ActiveDiagnosticRequest* candidate = entry;
-        if(candidate->bus == bus && diagnostic_request_equals(
-                    &candidate->handle.request, request)) {
-            TAILQ_REMOVE(&manager->recurringRequests, entry, queueEntries);
-            existingEntry = entry;
-            break;
+    ActiveDiagnosticRequest* entry;
+    TAILQ_FOREACH(entry, &manager->recurringRequests, queueEntries) {
+        DiagnosticRequest candidate = unpackedRequest(entry);
+        if(entry->bus == bus && diagnostic_request_equals(&candidate,
+                    request)) {
+            return entry;
         }
     }
-    return existingEntry;
+    return NULL;
 }
 
 bool openxc::diagnostics::cancelRecurringRequest(
@@ -652,6 +1037,7 @@ bool openxc::diagnostics::cancelRecurringRequest(
     ActiveDiagnosticRequest* entry = lookupRecurringRequest(manager, bus,
             request);
     if(entry != NULL) {
+        TAILQ_REMOVE(&manager->recurringRequests, entry, queueEntries);
         cancelRequest(manager, entry);
     }
     return entry != NULL;
@@ -715,10 +1101,19 @@ static void updateDiagnosticRequestEntry(ActiveDiagnosticRequest* entry,
     entry->recurring = frequencyHz != 0;
     entry->frequencyClock = {0};
     entry->frequencyClock.frequency = entry->recurring ? frequencyHz : 0;
+    entry->adaptive = false;
+    entry->configuredFrequency = entry->frequencyClock.frequency;
+    entry->minFrequency = 0;
+    entry->sentAtMs = 0;
+    entry->flowControl = manager->flowControl[bus->address - 1];
+    entry->blockFramesReceived = 0;
+    entry->stats = {0};
     // time out after 100ms
     entry->timeoutClock = {0};
     entry->timeoutClock.frequency = 10;
     entry->inFlight = false;
+    entry->packed = false;
+    entry->packLeader = NULL;
 }
 
 bool openxc::diagnostics::addRequest(DiagnosticsManager* manager,
@@ -827,6 +1222,111 @@ bool openxc::diagnostics::addRequest(DiagnosticsManager* manager,
     return addRequest(manager, bus, request, NULL, false, NULL, NULL);
 }
 
+bool openxc::diagnostics::setAdaptiveRate(DiagnosticsManager* manager,
+        const char* name, float minFrequencyHz) {
+    bool matched = false;
+    ActiveDiagnosticRequest* entry, *tmp;
+    TAILQ_FOREACH_SAFE(entry, &manager->recurringRequests, queueEntries, tmp) {
+        if(name != NULL && strncmp(entry->name, name,
+                    MAX_GENERIC_NAME_LENGTH)) {
+            continue;
+        }
+
+        matched = true;
+        entry->adaptive = minFrequencyHz > 0;
+        entry->minFrequency = minFrequencyHz < entry->configuredFrequency ?
+                minFrequencyHz : entry->configuredFrequency;
+        if(!entry->adaptive &&
+                entry->frequencyClock.frequency != entry->configuredFrequency) {
+            entry->frequencyClock.frequency = entry->configuredFrequency;
+            TAILQ_REMOVE(&manager->recurringRequests, entry, queueEntries);
+            scheduleRecurringRequest(manager, entry);
+        }
+    }
+    return matched;
+}
+
+/* Private: Convert a separation time in milliseconds to the nearest STmin
+ * byte.
+ */
+static uint8_t encodeSeparationTime(float milliseconds) {
+    if(milliseconds >= MAX_SEPARATION_TIME_MS) {
+        return MAX_SEPARATION_TIME_MS;
+    } else if(milliseconds >= 1) {
+        return uint8_t(milliseconds + 0.5);
+    }
+
+    // 0xf1 - 0xf9 are 100 - 900 microseconds
+    int tenths = int(milliseconds * 10 + 0.5);
+    if(tenths >= 10) {
+        return 1;
+    }
+    return tenths > 0 ? 0xf0 + tenths : 0;
+}
+
+static void updateFlowControl(DiagnosticFlowControl* flowControl,
+        int blockSize, float separationTimeMs) {
+    if(blockSize >= 0) {
+        flowControl->blockSize = blockSize < UINT8_MAX ? blockSize : UINT8_MAX;
+    }
+    if(separationTimeMs >= 0) {
+        flowControl->separationTime = encodeSeparationTime(separationTimeMs);
+    }
+}
+
+static bool updateRequestFlowControl(ActiveDiagnosticRequest* entry,
+        const char* name, int blockSize, float separationTimeMs) {
+    if(name != NULL && strncmp(entry->name, name, MAX_GENERIC_NAME_LENGTH)) {
+        return false;
+    }
+    updateFlowControl(&entry->flowControl, blockSize, separationTimeMs);
+    return true;
+}
+
+bool openxc::diagnostics::setFlowControl(DiagnosticsManager* manager,
+        const char* name, int blockSize, float separationTimeMs) {
+    bool matched = false;
+    if(name == NULL) {
+        for(int i = 0; i < MAX_SHIM_COUNT; i++) {
+            updateFlowControl(&manager->flowControl[i], blockSize,
+                    separationTimeMs);
+        }
+        matched = true;
+    }
+
+    ActiveDiagnosticRequest* entry;
+    TAILQ_FOREACH(entry, &manager->recurringRequests, queueEntries) {
+        matched |= updateRequestFlowControl(entry, name, blockSize,
+                separationTimeMs);
+    }
+    LIST_FOREACH(entry, &manager->nonrecurringRequests, listEntries) {
+        matched |= updateRequestFlowControl(entry, name, blockSize,
+                separationTimeMs);
+    }
+    return matched;
+}
+
+void openxc::diagnostics::logRequestStatistics(DiagnosticsManager* manager) {
+    ActiveDiagnosticRequest* entry;
+    TAILQ_FOREACH(entry, &manager->recurringRequests, queueEntries) {
+        char request_string[128] = {0};
+        DiagnosticRequest request = unpackedRequest(entry);
+        diagnostic_request_to_string(&request, request_string,
+                sizeof(request_string));
+        debug("%s (%s): %f Hz (added at %f Hz%s), %u responses, "
+                "%u timeouts, %lu ms average response time, last response "
+                "%u frames in %lu ms",
+                strnlen(entry->name, MAX_GENERIC_NAME_LENGTH) > 0 ?
+                    entry->name : "unnamed",
+                request_string, entry->frequencyClock.frequency,
+                entry->configuredFrequency,
+                entry->adaptive ? ", adaptive" : "",
+                entry->stats.responseCount, entry->stats.timeoutCount,
+                entry->stats.averageResponseTimeMs,
+                entry->stats.framesReceived, entry->stats.lastResponseTimeMs);
+    }
+}
+
 /* Private: After checking for a proper CAN bus and the necessary write
  * permissions, process the requested command.
  */
@@ -992,6 +1492,24 @@ bool openxc::diagnostics::isSupportedPID(int requestMode, int requestPID)
     return false;
 }
 
+/* Private: Publish one segment of an emulated multi-frame response, numbered
+ * the same way relayMultiFrameSegment numbers the segments of a real one.
+ */
+static void publishEmulatedSegment(int messageId, int mode, int pid,
+        int frame, const char* payload, int payloadSize, Pipeline* pipeline) {
+    openxc_VehicleMessage message = openxc_VehicleMessage();        // Zero fill
+    message.type = openxc_VehicleMessage_Type_DIAGNOSTIC;
+    message.diagnostic_response = {0};
+    message.diagnostic_response.message_id = messageId;
+    message.diagnostic_response.mode = mode;
+    message.diagnostic_response.pid = pid;
+    message.diagnostic_response.success = true;
+    message.diagnostic_response.frame = frame;
+    memcpy(message.diagnostic_response.payload.bytes, payload, payloadSize);
+    message.diagnostic_response.payload.size = payloadSize;
+    pipeline::publish(&message, pipeline);
+}
+
 bool openxc::diagnostics::isStitchPID(int requestMode, int requestPID)
 {
 #if (MULTIFRAME==1)
@@ -1013,18 +1531,8 @@ bool openxc::diagnostics::generateAndSendEmulatedStitchMessages(int requestMode,
                                 (char)0x22, (char)0x2a, (char)0x04};
         emulPayload[4] = rand() % 256;
         emulPayload[5] = rand() % 256;
-        sendPartialMessage(0x00000000,      // long timestamp,
-                           -1,              // int frame,
-                           0x7d8,           // int message_id,
-                           0,               // int bus,
-                           0,               // int total_size,
-                           0x22,            // int mode,
-                           0xde00,          // int pid,
-                           0,               // int value,
-                           0,               // int negative_response_code,
-                           emulPayload,     // const char *payload,
-                           sizeof(emulPayload), // int payload_size,
-                           pipeline);
+        publishEmulatedSegment(0x7e0, 0x22, 0xde00, -1, emulPayload,
+                sizeof(emulPayload), pipeline);
     } else {
         char emulPayload1[] = {(char)0x62, (char)0xDE, (char)0x00, 
                                 (char)0x22, (char)0x2a, (char)0x04};
@@ -1036,31 +1544,10 @@ bool openxc::diagnostics::generateAndSendEmulatedStitchMessages(int requestMode,
             emulPayload2[cnt] = rand() % 256;
         }
 
-        sendPartialMessage(0x00000000,      // long timestamp,
-                           0,               // int frame,  (First Frame)
-                           0x7d8,           // int message_id,
-                           0,               // int bus,
-                           0,               // int total_size,
-                           0x22,            // int mode,
-                           0xde00,          // int pid,
-                           0,               // int value,
-                           0,               // int negative_response_code,
-                           emulPayload1,     // const char *payload,
-                           sizeof(emulPayload1), // int payload_size,
-                           pipeline);
-
-        sendPartialMessage(0x00000000,      // long timestamp,
-                           -1,               // int frame,  (Last Frame)
-                           0x7d8,           // int message_id,
-                           0,               // int bus,
-                           0,               // int total_size,
-                           0x22,            // int mode,
-                           0xde00,          // int pid,
-                           0,               // int value,
-                           0,               // int negative_response_code,
-                           emulPayload2,     // const char *payload,
-                           sizeof(emulPayload2), // int payload_size,
-                           pipeline);
+        publishEmulatedSegment(0x7e0, 0x22, 0xde00, 0, emulPayload1,
+                sizeof(emulPayload1), pipeline);
+        publishEmulatedSegment(0x7e0, 0x22, 0xde00, -1, emulPayload2,
+                sizeof(emulPayload2), pipeline);
     }
     return true;
 #endif
@@ -1120,6 +1607,7 @@ bool openxc::diagnostics::generateAndSendVINStitchMessages(int messageId, int re
     return false;
 #endif
 
+    int responseId = getEmulatedMessageID(messageId);
     int sampleSize = sizeof(VINArray) / sizeof(VINArray[0]);
     int selection = rand() % sampleSize;
     const int packetSize = 4;       // Send max "packetSize" ascii per message
@@ -1130,18 +1618,8 @@ bool openxc::diagnostics::generateAndSendVINStitchMessages(int messageId, int re
         int remaining = strlen(VINArray[selection]) - index;
         int payloadSize = (packetSize < remaining) ? packetSize : remaining;
         int frame = (count == numPackets - 1) ? -1 : count;
-        sendPartialMessage(0x00000000,      // long timestamp,
-                           frame,           // int frame,
-                           messageId + 8,   // int message_id,
-                           0,               // int bus,
-                           0,               // int total_size,
-                           requestMode,     // int mode,
-                           requestPID,      // int pid,
-                           0,               // int value,
-                           0,               // int negative_response_code,
-                           &VINArray[selection][index],     // const char *payload,
-                           payloadSize,     // int payload_size,
-                           pipeline);
+        publishEmulatedSegment(responseId, requestMode, requestPID, frame,
+                &VINArray[selection][index], payloadSize, pipeline);
         index += packetSize;
     }
 
@@ -26,6 +26,26 @@
  */
 #define MAX_SHIM_COUNT 2
 
+/* Private: The number of hash buckets in the table of in-flight requests. Only
+ * one request can be in flight per bus and arbitration ID, so this just needs
+ * to be large enough to keep the buckets short.
+ */
+#define DIAGNOSTIC_IN_FLIGHT_BUCKET_COUNT 16
+
+/* Private: The number of multi-frame responses that can be relayed at the same
+ * time. A session is only held while the segments of a response are arriving,
+ * so this only needs to cover the responses that overlap on all buses.
+ */
+#define MAX_MULTI_FRAME_SESSIONS 4
+
+/* Private: The ISO-TP flow control every CAN bus answers the first frame of a
+ * multi-frame response with, until it's changed with setFlowControl. No block
+ * size and no separation time let the module send all of the remaining frames
+ * back to back.
+ */
+#define DEFAULT_FLOW_CONTROL_BLOCK_SIZE 0
+#define DEFAULT_FLOW_CONTROL_SEPARATION_TIME 0
+
 namespace openxc {
 namespace diagnostics {
 
@@ -59,6 +79,63 @@ typedef void (*DiagnosticResponseCallback)(
         const DiagnosticResponse* response,
         float parsed_payload);
 
+/* Public: The ISO-TP flow control the VI answers the first frame of a
+ * multi-frame response with.
+ *
+ * blockSize - How many consecutive frames the module may send before it waits
+ *      for another flow control frame, or 0 to send all of them without
+ *      waiting.
+ * separationTime - The STmin byte, the least time the module must leave
+ *      between consecutive frames: 0-127 ms, or 0xf1-0xf9 for 100-900 us.
+ */
+typedef struct {
+    uint8_t blockSize;
+    uint8_t separationTime;
+} DiagnosticFlowControl;
+
+/* Public: Counters kept for each active diagnostic request.
+ *
+ * responseCount - The number of times the request was answered.
+ * timeoutCount - The number of times the request timed out without an answer.
+ * averageResponseTimeMs - A moving average of the time between sending the
+ *      request and receiving the complete response, in milliseconds. Requests
+ *      waiting for multiple responses always wait out the timeout, so this
+ *      isn't measured for them.
+ * framesReceived - The number of CAN frames received since the request was
+ *      last sent, to measure the transfer rate of multi-frame responses.
+ * lastResponseTimeMs - The time between sending the request and receiving the
+ *      complete response the last time it was answered, in milliseconds.
+ */
+typedef struct {
+    unsigned int responseCount;
+    unsigned int timeoutCount;
+    unsigned long averageResponseTimeMs;
+    unsigned int framesReceived;
+    unsigned long lastResponseTimeMs;
+} DiagnosticRequestStats;
+
+/* Private: The progress of relaying one multi-frame response, segment by
+ * segment, as it arrives.
+ *
+ * bus - The CAN bus the response is arriving on, or NULL if the session is
+ *      free.
+ * arbitrationId - The arbitration ID the response is arriving from.
+ * request - The request the response is for.
+ * requestSentAtMs - When that request was sent, to tell a new response from
+ *      the rest of one that never finished.
+ * frame - The index of the next segment to relay.
+ * lastSegmentMs - When the last segment was relayed, to pick the session to
+ *      reclaim when all of them are taken.
+ */
+typedef struct {
+    CanBus* bus;
+    uint32_t arbitrationId;
+    const struct ActiveDiagnosticRequest* request;
+    unsigned long requestSentAtMs;
+    int frame;
+    unsigned long lastSegmentMs;
+} MultiFrameSession;
+
 /* Private: An active diagnostic request, either recurring or one-time.
  *
  * bus - The CAN bus this request should be made on, or is currently in flight
@@ -92,10 +169,30 @@ typedef void (*DiagnosticResponseCallback)(
  *      not used.
  * timeoutClock - A FrequencyClock struct to monitor how long it's been since
  *      this request was sent.
+ * packed - True if the handle currently holds a mode 1 request for several
+ *      PIDs, this request's own PID first, built by the recurring scheduler. A
+ *      packed functional broadcast request waits for multiple responses.
+ * packLeader - If this request's PID was folded into another recurring
+ *      request that's in flight, that request. Otherwise NULL.
+ * adaptive - If true, the frequencyClock rate of this recurring request backs
+ *      off when it times out and recovers when it's answered (see
+ *      setAdaptiveRate).
+ * configuredFrequency - The rate the recurring request was added with, which is
+ *      also the most the adaptive rate will recover to.
+ * minFrequency - The least the adaptive rate will back off to.
+ * sentAtMs - The time the request was last sent.
+ * flowControl - The flow control to answer multi-frame responses to this
+ *      request with, the default of its bus unless changed with
+ *      setFlowControl.
+ * blockFramesReceived - The number of consecutive frames received since the
+ *      last flow control frame, to ask for the next block in time.
+ * stats - Response and timeout counters for the request.
  * queueEntries - Internal data structure reference for when this request is in
  *      the recurring requests queue.
  * listEntries - Internal data structure reference for when this request is in
  *      the non-recurring requests list or free list.
+ * inFlightEntries - Internal data structure reference for when this request is
+ *      in one of the in-flight table buckets.
  */
 struct ActiveDiagnosticRequest {
     CanBus* bus;
@@ -109,9 +206,19 @@ struct ActiveDiagnosticRequest {
     bool inFlight;
     openxc::util::time::FrequencyClock frequencyClock;
     openxc::util::time::FrequencyClock timeoutClock;
+    bool packed;
+    struct ActiveDiagnosticRequest* packLeader;
+    bool adaptive;
+    float configuredFrequency;
+    float minFrequency;
+    unsigned long sentAtMs;
+    DiagnosticFlowControl flowControl;
+    uint8_t blockFramesReceived;
+    DiagnosticRequestStats stats;
 
     TAILQ_ENTRY(ActiveDiagnosticRequest) queueEntries;
     LIST_ENTRY(ActiveDiagnosticRequest) listEntries;
+    LIST_ENTRY(ActiveDiagnosticRequest) inFlightEntries;
 };
 typedef struct ActiveDiagnosticRequest ActiveDiagnosticRequest;
 
@@ -128,12 +235,15 @@ TAILQ_HEAD(DiagnosticRequestQueue, ActiveDiagnosticRequest);
  * obd2Bus - A reference to the CAN bus that should be used for all standard
  *      OBD-II requests, if the bus is not explicitly spcified in the request.
  *      If NULL, all requests require an explicit bus.
+ * flowControl - The flow control each CAN bus answers multi-frame responses
+ *      with by default, in the same order as the shims.
  *
  * Private:
  *
- * recurringRequests - A queue of active, recurring diagnostic requests. When a
- *      response is received for a recurring request or it times out, it is
- *      popped from the queue and pushed onto the back.
+ * recurringRequests - A queue of active, recurring diagnostic requests, kept
+ *      sorted by the time each one is next due. When a request is sent it moves
+ *      back to the position of its next deadline, so the scheduler can stop at
+ *      the first request that isn't due yet.
  * nonrecurringRequests - A list of active one-time diagnostic requests. When a
  *      response is received for a non-recurring request or it times out, it is
  *      removed from this list and placed back in the free list.
@@ -141,15 +251,22 @@ TAILQ_HEAD(DiagnosticRequestQueue, ActiveDiagnosticRequest);
  *      requests. This free list is backed by statically allocated entries in
  *      the requestListEntries attribute.
  * requestListEntries - Static allocation for all active diagnostic requests.
+ * inFlightRequests - A hash table of the requests currently in flight, keyed by
+ *      bus and arbitration ID, to check if a request is clear to send without
+ *      scanning every active request.
+ * multiFrameSessions - The multi-frame responses currently being relayed.
  * initialized - True if the DiagnosticsManager has been initialized.
  */
 struct DiagnosticsManager {
     DiagnosticShims shims[MAX_SHIM_COUNT];
     CanBus* obd2Bus;
+    DiagnosticFlowControl flowControl[MAX_SHIM_COUNT];
     DiagnosticRequestQueue recurringRequests;
     DiagnosticRequestList nonrecurringRequests;
     DiagnosticRequestList freeRequestEntries;
     ActiveDiagnosticRequest requestListEntries[MAX_SIMULTANEOUS_DIAG_REQUESTS];
+    DiagnosticRequestList inFlightRequests[DIAGNOSTIC_IN_FLIGHT_BUCKET_COUNT];
+    MultiFrameSession multiFrameSessions[MAX_MULTI_FRAME_SESSIONS];
     bool initialized;
 };
 typedef struct DiagnosticsManager DiagnosticsManager;
@@ -310,7 +427,8 @@ bool cancelRecurringRequest(DiagnosticsManager* manager, CanBus* bus,
  *
  * This must be called for every new CAN message that is received. It will match
  * it to any existing requests, relay the response and perform any necessary
- * callbacks.
+ * callbacks. Messages are looked up by their arbitration ID in the table of
+ * requests in flight, so anything that isn't a response is dropped right away.
  *
  * manager - The manager that should receive the CAN message.
  * bus - The bus this message was received from.
@@ -331,6 +449,48 @@ void receiveCanMessage(DiagnosticsManager* manager, CanBus* bus,
  */
 void sendRequests(DiagnosticsManager* manager, CanBus* bus);
 
+/* Public: Switch the adaptive rate of recurring requests on or off.
+ *
+ * An adaptive request halves its rate every time it times out, down to
+ * minFrequencyHz, so a slow ECU doesn't tie up the bus and starve the other
+ * requests. Every time it's answered with time to spare before its next
+ * deadline, the rate steps back up toward the frequency it was added with.
+ *
+ * manager - The manager with the recurring requests.
+ * name - Only change recurring requests with this name. If NULL, change all of
+ *      them.
+ * minFrequencyHz - The least the rate may back off to. If this is 0, adaptive
+ *      mode is switched off and the requests go back to their added frequency.
+ *
+ * Returns true if any recurring request matched.
+ */
+bool setAdaptiveRate(DiagnosticsManager* manager, const char* name,
+        float minFrequencyHz);
+
+/* Public: Change the ISO-TP flow control that multi-frame responses are
+ * answered with. With a block size of 0 and no separation time a module sends
+ * large responses (e.g. DIDs or DTC lists) as fast as it can. A small block
+ * size or a longer separation time slow it down for a VI that can't keep up.
+ *
+ * manager - The manager with the active requests.
+ * name - Only change active requests with this name. If NULL, change the
+ *      default of every bus and all of the active requests.
+ * blockSize - The new block size, or -1 to leave it alone.
+ * separationTimeMs - The new least time between consecutive frames in
+ *      milliseconds, rounded to the nearest STmin value (up to 127 ms, or
+ *      steps of 0.1 ms below 1 ms), or -1 to leave it alone.
+ *
+ * Returns true if a default was changed or any active request matched.
+ */
+bool setFlowControl(DiagnosticsManager* manager, const char* name,
+        int blockSize, float separationTimeMs);
+
+/* Public: Log the effective rate, response and timeout counters, average
+ * response time and the frames and time of the last response for every
+ * recurring request.
+ */
+void logRequestStatistics(DiagnosticsManager* manager);
+
 bool isSupportedMessageID(int requestID);
 
 int getEmulatedMessageID(int requestID);
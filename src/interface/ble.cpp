@@ -5,13 +5,15 @@
 #include "util/log.h"
 #include "config.h"
 
+namespace slabpool = openxc::util::slabpool;
+
 using openxc::util::log::debug;
 
 void openxc::interface::ble::initializeCommon(BleDevice* device) {
     if(device != NULL) {
         debug("Initializing Bluetooth Low Energy common...");
         QUEUE_INIT(uint8_t,(QUEUE_TYPE(uint8_t)* ) &device->receiveQueue);//messages received over BLE characteristic write
-        QUEUE_INIT(uint8_t,(QUEUE_TYPE(uint8_t)* ) &device->sendQueue);
+        slabpool::clear(&device->sendQueue);
         device->descriptor.type = InterfaceType::BLE;
     }
 }
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include "interface/interface.h"
 #include "util/bytebuffer.h"
+#include "util/slabpool.h"
 
 
 namespace openxc {
@@ -14,7 +15,7 @@ namespace ble {
  * output.
  *
  * descriptor - A general descriptor for this interface.
- * sendQueue - A queue of bytes that need to be sent out over an IP network.
+ * sendQueue - A queue of payloads that need to be sent out over an IP network.
  * receiveQueue - A queue of bytes that have been received via an IP network but
  *      not yet processed.
  */
@@ -47,7 +48,7 @@ typedef enum {
 typedef struct {
     InterfaceDescriptor descriptor;
     BleSettings         blesettings;
-    QUEUE_TYPE(uint8_t) sendQueue;
+    SlabQueue sendQueue;
     QUEUE_TYPE(uint8_t) receiveQueue;
     bool configured;
     BleStatus status;
@@ -3,12 +3,14 @@
 #include "util/log.h"
 #include "config.h"
 
+namespace slabpool = openxc::util::slabpool;
+
 using openxc::util::log::debug;
 
 void openxc::interface::fs::initializeCommon(FsDevice* device) {
     if(device != NULL) {
         device->descriptor.type = InterfaceType::FS;
-        QUEUE_INIT(uint8_t,(QUEUE_TYPE(uint8_t)* ) &device->sendQueue);
+        slabpool::clear(&device->sendQueue);
     }
 }
 
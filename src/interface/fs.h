@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include "interface/interface.h"
 #include "util/bytebuffer.h" //to do remove this and add custom type to have 512 size
+#include "util/slabpool.h"
 #include "platform_profile.h"
 
 
@@ -23,7 +24,7 @@ namespace fs {
 typedef struct {
     InterfaceDescriptor descriptor;
     //since our write speeds are much higher to the SD card we are excluding the queue here
-    QUEUE_TYPE(uint8_t) sendQueue;
+    SlabQueue sendQueue;
     uint8_t buffer[FS_BUF_SZ];
     bool configured;
 } FsDevice;
@@ -1,5 +1,7 @@
 #include "interface.h"
 
+#include <string.h>
+
 #include "uart.h"
 #include "config.h"
 
@@ -18,6 +20,16 @@ static const char interfaceNames[][5] = {
 #endif
 };
 
+// Indexed by InterfaceType
+static const char* interfaceCommandNames[] = {
+    "usb",
+    "uart",
+    "network",
+    "telit",
+    "ble",
+    "fs",
+};
+
 const char* openxc::interface::descriptorToString(InterfaceDescriptor* descriptor) {
     if((int)descriptor->type < sizeof(interfaceNames) / sizeof(interfaceNames[0])) {
         return interfaceNames[descriptor->type];
@@ -25,6 +37,18 @@ const char* openxc::interface::descriptorToString(InterfaceDescriptor* descripto
     return "Unknown";
 }
 
+bool openxc::interface::lookupInterfaceType(const char* name,
+        InterfaceType* type) {
+    for(size_t i = 0; i < sizeof(interfaceCommandNames) /
+            sizeof(interfaceCommandNames[0]); i++) {
+        if(!strcmp(name, interfaceCommandNames[i])) {
+            *type = (InterfaceType) i;
+            return true;
+        }
+    }
+    return false;
+}
+
 bool openxc::interface::anyConnected() {
     return  openxc::interface::uart::connected   (&getConfiguration()->uart   ) ||
             openxc::interface::usb::connected    (&getConfiguration()->usb    ) ||
@@ -26,6 +26,13 @@ typedef struct {
 
 const char* descriptorToString(InterfaceDescriptor* descriptor);
 
+/* Public: Look up an interface by the name used for it in commands - "usb",
+ * "uart", "network", "telit", "ble" or "fs".
+ *
+ * Returns true and sets type if the name was recognized.
+ */
+bool lookupInterfaceType(const char* name, InterfaceType* type);
+
 /* Public: Return true if any of the output interfaces is connected.
  */
 bool anyConnected();
@@ -5,13 +5,15 @@
 #include "util/log.h"
 #include "config.h"
 
+namespace slabpool = openxc::util::slabpool;
+
 using openxc::util::log::debug;
 
 void openxc::interface::network::initializeCommon(NetworkDevice* device) {
     if(device != NULL) {
         debug("Initializing Network...");
         QUEUE_INIT(uint8_t, &device->receiveQueue);
-        QUEUE_INIT(uint8_t, &device->sendQueue);
+        slabpool::clear(&device->sendQueue);
         device->descriptor.type = InterfaceType::NETWORK;
     }
 }
@@ -8,6 +8,7 @@
 #endif // __USE_NETWORK__
 
 #include "util/bytebuffer.h"
+#include "util/slabpool.h"
 #include "commands/commands.h"
 #include "interface.h"
 
@@ -26,7 +27,7 @@ namespace network {
  * ipAddress - static IP address for the network device. If USE_DHCP is defined,
  *      this is ignored.
  *
- * sendQueue - A queue of bytes that need to be sent out over an IP network.
+ * sendQueue - A queue of payloads that need to be sent out over an IP network.
  * receiveQueue - A queue of bytes that have been received via an IP network but
  *      not yet processed.
  * server - An instance of Server which will allow connections from network
@@ -39,7 +40,7 @@ typedef struct {
     bool configured;
 
     // device to host
-    QUEUE_TYPE(uint8_t) sendQueue;
+    SlabQueue sendQueue;
     // host to device
     QUEUE_TYPE(uint8_t) receiveQueue;
 #if defined(__PIC32__) && defined(__USE_NETWORK__)
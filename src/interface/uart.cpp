@@ -7,13 +7,15 @@
 
 const int openxc::interface::uart::MAX_MESSAGE_SIZE = 128;
 
+namespace slabpool = openxc::util::slabpool;
+
 using openxc::util::log::debug;
 
 void openxc::interface::uart::initializeCommon(UartDevice* device) {
     if(device != NULL) {
         debug("Initializing UART.....");
         QUEUE_INIT(uint8_t, &device->receiveQueue);
-        QUEUE_INIT(uint8_t, &device->sendQueue);
+        slabpool::clear(&device->sendQueue);
 
         device->descriptor.type = InterfaceType::UART;
     }
@@ -4,12 +4,15 @@
 #include "commands/commands.h"
 #include "config.h"
 
+namespace slabpool = openxc::util::slabpool;
+
 using openxc::util::log::debug;
 
 void openxc::interface::usb::initializeCommon(UsbDevice* usbDevice) {
     debug("Initializing USB.....");
     for(int i = 0; i < ENDPOINT_COUNT; i++) {
         QUEUE_INIT(uint8_t, &usbDevice->endpoints[i].queue);
+        slabpool::clear(&usbDevice->endpoints[i].sendQueue);
     }
     usbDevice->configured = false;
     usbDevice->descriptor.type = InterfaceType::USB;
@@ -11,6 +11,7 @@
 #include "interface.h"
 #include "usb_config.h"
 #include "util/bytebuffer.h"
+#include "util/slabpool.h"
 
 #define USB_BUFFER_SIZE 64
 #define USB_SEND_BUFFER_SIZE 512
@@ -30,14 +31,15 @@ typedef enum {
  * address - the physical endpoint number.
  * size - the packet size for the endpoint, e.g. 512.
  * direction - the direction of the endpoint, IN or OUT.
- * queue - A queue of bytes from or for IN or OUT requests, depending on the
- *      direction.
+ * queue - A queue of bytes received from the host on an OUT endpoint.
+ * sendQueue - A queue of payloads to send to the host on an IN endpoint.
  */
 typedef struct {
     uint8_t address;
     uint8_t size;
     UsbEndpointDirection direction;
     QUEUE_TYPE(uint8_t) queue;
+    SlabQueue sendQueue;
     // This buffer MUST be non-local, so it doesn't get invalidated when it
     // falls off the stack
     uint8_t sendBuffer[USB_SEND_BUFFER_SIZE];
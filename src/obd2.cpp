@@ -58,6 +58,19 @@ const Obd2Pid OBD2_PIDS[] = {
     { pid: 0x63, name: "engine_torque", frequency: 1 },
 };
 
+/* Private: The number of data bytes in the mode 1 response for each standard
+ * PID, indexed by PID (0 for reserved PIDs).
+ */
+const uint8_t OBD2_PID_RESPONSE_LENGTHS[] = {
+    4, 4, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 1, // 0x00
+    2, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, // 0x10
+    4, 2, 2, 2, 4, 4, 4, 4, 4, 4, 4, 4, 1, 1, 1, 1, // 0x20
+    1, 2, 2, 1, 4, 4, 4, 4, 4, 4, 4, 4, 2, 2, 2, 2, // 0x30
+    4, 4, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 4, // 0x40
+    4, 1, 1, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, 2, 1, // 0x50
+    4, 1, 1, 2, 5,                                  // 0x60
+};
+
 static void checkIgnitionStatus(DiagnosticsManager* manager,
         const ActiveDiagnosticRequest* request,
         const DiagnosticResponse* response,
@@ -190,6 +203,13 @@ bool openxc::diagnostics::obd2::isObd2Request(DiagnosticRequest* request) {
     return request->mode == 0x1 && request->pid < 0xff;
 }
 
+uint8_t openxc::diagnostics::obd2::pidResponseLength(uint16_t pid) {
+    if(pid >= sizeof(OBD2_PID_RESPONSE_LENGTHS)) {
+        return 0;
+    }
+    return OBD2_PID_RESPONSE_LENGTHS[pid];
+}
+
 void openxc::diagnostics::obd2::handleObd2Pid(
         const DiagnosticResponse* response, float parsedPayload, char* str_buf, int buf_size) {
     snprintf(str_buf, buf_size, "%f", diagnostic_decode_obd2_pid(response));
@@ -6,6 +6,10 @@
 #include "util/timer.h"
 #include "diagnostics.h"
 
+/* Public: The most PIDs that can be asked for in a single mode 1 request.
+ */
+#define MAX_OBD2_PIDS_PER_REQUEST 6
+
 namespace openxc {
 namespace diagnostics {
 namespace obd2 {
@@ -40,6 +44,15 @@ void initialize(DiagnosticsManager* manager);
  */
 bool isObd2Request(DiagnosticRequest* request);
 
+/* Public: Return the number of data bytes in a mode 1 response for the PID.
+ *
+ * Responses to a request for multiple PIDs are just the PID and its data bytes
+ * one after another, so this is required to split them up again.
+ *
+ * Returns the length in bytes, or 0 if the PID isn't a standard one.
+ */
+uint8_t pidResponseLength(uint16_t pid);
+
 /* Public: Decode the payload of an OBD-II PID.
  *
  * This function matches the type signature for a DiagnosticResponseDecoder, so
@@ -1,16 +1,19 @@
 #include "payload.h"
 
-#include <cJSON.h>
 #include <stdlib.h>
 #include <sys/param.h>
 #include <stdio.h>
 
 #include "json.h"
+#include "payload/jsonreader.h"
+#include "payload/jsonwriter.h"
 #include "util/strutil.h"
 #include "util/log.h"
 #include "config.h"
 
 namespace payload = openxc::payload;
+namespace jsonreader = openxc::payload::jsonreader;
+namespace jsonwriter = openxc::payload::jsonwriter;
 
 using openxc::util::log::debug;
 
@@ -29,6 +32,7 @@ const char openxc::payload::json::GET_VIN_COMMAND_NAME[] = "get_vin";
 
 const char openxc::payload::json::PAYLOAD_FORMAT_JSON_NAME[] = "json";
 const char openxc::payload::json::PAYLOAD_FORMAT_PROTOBUF_NAME[] = "protobuf";
+const char openxc::payload::json::PAYLOAD_FORMAT_MESSAGEPACK_NAME[] = "messagepack";
 
 const char openxc::payload::json::COMMAND_RESPONSE_FIELD_NAME[] = "command_response";
 const char openxc::payload::json::COMMAND_RESPONSE_MESSAGE_FIELD_NAME[] = "message";
@@ -55,143 +59,132 @@ const char openxc::payload::json::DIAGNOSTIC_FRAME_FIELD_NAME[] = "frame";
 const char openxc::payload::json::DIAGNOSTIC_TOTAL_SIZE_FIELD_NAME[] = "total_size";
 
 
-static bool serializeDiagnostic(openxc_VehicleMessage* message, cJSON* root) {
-    cJSON_AddNumberToObject(root, payload::json::BUS_FIELD_NAME,
+// The longest hex strings the cJSON serializer had room for, including the "0x"
+// prefix - longer payloads are cut short at the same place so the output
+// doesn't change.
+#define CAN_DATA_MAX_ENCODED_LENGTH 66
+#define DIAGNOSTIC_PAYLOAD_MAX_ENCODED_LENGTH (MAX_DIAGNOSTIC_PAYLOAD_SIZE - 1)
+// Longer than the name of any command, so a name that's cut short to fit
+// can't match one
+#define MAX_COMMAND_NAME_LENGTH 32
+
+static void serializeDiagnostic(openxc_VehicleMessage* message,
+        JsonWriter* writer) {
+    jsonwriter::addNumber(writer, payload::json::BUS_FIELD_NAME,
             message->diagnostic_response.bus);
-    cJSON_AddNumberToObject(root, payload::json::ID_FIELD_NAME,
+    jsonwriter::addNumber(writer, payload::json::ID_FIELD_NAME,
             message->diagnostic_response.message_id);
-    cJSON_AddNumberToObject(root, payload::json::DIAGNOSTIC_MODE_FIELD_NAME,
+    jsonwriter::addNumber(writer, payload::json::DIAGNOSTIC_MODE_FIELD_NAME,
             message->diagnostic_response.mode);
-    cJSON_AddBoolToObject(root, payload::json::DIAGNOSTIC_SUCCESS_FIELD_NAME,
+    jsonwriter::addBool(writer, payload::json::DIAGNOSTIC_SUCCESS_FIELD_NAME,
             message->diagnostic_response.success);
-    cJSON_AddNumberToObject(root, payload::json::DIAGNOSTIC_PID_FIELD_NAME,
+    jsonwriter::addNumber(writer, payload::json::DIAGNOSTIC_PID_FIELD_NAME,
                 message->diagnostic_response.pid);
 
     if (message->diagnostic_response.total_size > 0) {
         // These next 2 fields are only in a stitched message frame
-        cJSON_AddNumberToObject(root, payload::json::DIAGNOSTIC_FRAME_FIELD_NAME,
+        jsonwriter::addNumber(writer, payload::json::DIAGNOSTIC_FRAME_FIELD_NAME,
                     message->diagnostic_response.frame);
-        cJSON_AddNumberToObject(root, payload::json::DIAGNOSTIC_TOTAL_SIZE_FIELD_NAME,
-                    message->diagnostic_response.total_size);
+        jsonwriter::addNumber(writer,
+                payload::json::DIAGNOSTIC_TOTAL_SIZE_FIELD_NAME,
+                message->diagnostic_response.total_size);
     }
 
     if(message->diagnostic_response.negative_response_code != 0) {
-        cJSON_AddNumberToObject(root, payload::json::DIAGNOSTIC_NRC_FIELD_NAME,
+        jsonwriter::addNumber(writer, payload::json::DIAGNOSTIC_NRC_FIELD_NAME,
                 message->diagnostic_response.negative_response_code);
     }
 
     if(message->diagnostic_response.value.type != openxc_DynamicField_Type_UNUSED) {
         if (message->diagnostic_response.value.type == openxc_DynamicField_Type_NUM) {
-            cJSON_AddNumberToObject(root, payload::json::DIAGNOSTIC_VALUE_FIELD_NAME,
+            jsonwriter::addNumber(writer,
+                    payload::json::DIAGNOSTIC_VALUE_FIELD_NAME,
                     message->diagnostic_response.value.numeric_value);
         } else {
-            cJSON_AddStringToObject(root, payload::json::DIAGNOSTIC_VALUE_FIELD_NAME,
+            jsonwriter::addString(writer,
+                    payload::json::DIAGNOSTIC_VALUE_FIELD_NAME,
                     message->diagnostic_response.value.string_value);
         }
     } else if(message->diagnostic_response.payload.size > 0) {
-        char encodedData[MAX_DIAGNOSTIC_PAYLOAD_SIZE];
-        const char* maxAddress = encodedData + sizeof(encodedData);
-        char* encodedDataIndex = encodedData;
-        encodedDataIndex += sprintf(encodedDataIndex, "0x");
-        for(uint8_t i = 0; i < message->diagnostic_response.payload.size &&
-                encodedDataIndex < maxAddress; i++) {
-            encodedDataIndex += snprintf(encodedDataIndex,
-                    maxAddress - encodedDataIndex,
-                    "%02x",
-                    message->diagnostic_response.payload.bytes[i]);
-        }
-        cJSON_AddStringToObject(root, payload::json::DIAGNOSTIC_PAYLOAD_FIELD_NAME,
-                encodedData);
+        jsonwriter::addHexString(writer,
+                payload::json::DIAGNOSTIC_PAYLOAD_FIELD_NAME,
+                message->diagnostic_response.payload.bytes,
+                message->diagnostic_response.payload.size,
+                DIAGNOSTIC_PAYLOAD_MAX_ENCODED_LENGTH);
     }
-    return true;
 }
 
-static bool serializeCommandResponse(openxc_VehicleMessage* message,
-        cJSON* root) {
+const char* openxc::payload::json::commandName(
+        openxc_ControlCommand_Type type) {
     const char* typeString = NULL;
-    if(message->command_response.type == openxc_ControlCommand_Type_VERSION) {
+    if(type == openxc_ControlCommand_Type_VERSION) {
         typeString = payload::json::VERSION_COMMAND_NAME;
-    } else if(message->command_response.type == openxc_ControlCommand_Type_DEVICE_ID) {
+    } else if(type == openxc_ControlCommand_Type_DEVICE_ID) {
         typeString = payload::json::DEVICE_ID_COMMAND_NAME;
-    } else if(message->command_response.type == openxc_ControlCommand_Type_GET_VIN) {
+    } else if(type == openxc_ControlCommand_Type_GET_VIN) {
         typeString = payload::json::GET_VIN_COMMAND_NAME;
-    } else if(message->command_response.type == openxc_ControlCommand_Type_PLATFORM) {
+    } else if(type == openxc_ControlCommand_Type_PLATFORM) {
         typeString = payload::json::DEVICE_PLATFORM_COMMAND_NAME;
-    } else if(message->command_response.type == openxc_ControlCommand_Type_DIAGNOSTIC) {
+    } else if(type == openxc_ControlCommand_Type_DIAGNOSTIC) {
         typeString = payload::json::DIAGNOSTIC_COMMAND_NAME;
-    } else if(message->command_response.type == openxc_ControlCommand_Type_PASSTHROUGH) {
+    } else if(type == openxc_ControlCommand_Type_PASSTHROUGH) {
         typeString = payload::json::PASSTHROUGH_COMMAND_NAME;
-    } else if(message->command_response.type == openxc_ControlCommand_Type_ACCEPTANCE_FILTER_BYPASS) {
+    } else if(type == openxc_ControlCommand_Type_ACCEPTANCE_FILTER_BYPASS) {
         typeString = payload::json::ACCEPTANCE_FILTER_BYPASS_COMMAND_NAME;
-    } else if(message->command_response.type == openxc_ControlCommand_Type_PAYLOAD_FORMAT) {
+    } else if(type == openxc_ControlCommand_Type_PAYLOAD_FORMAT) {
         typeString = payload::json::PAYLOAD_FORMAT_COMMAND_NAME;
-    } else if(message->command_response.type == openxc_ControlCommand_Type_PREDEFINED_OBD2_REQUESTS) {
+    } else if(type == openxc_ControlCommand_Type_PREDEFINED_OBD2_REQUESTS) {
         typeString = payload::json::PREDEFINED_OBD2_REQUESTS_COMMAND_NAME;
-    } else if(message->command_response.type == openxc_ControlCommand_Type_MODEM_CONFIGURATION) {
+    } else if(type == openxc_ControlCommand_Type_MODEM_CONFIGURATION) {
         typeString = payload::json::MODEM_CONFIGURATION_COMMAND_NAME;
-    } else if(message->command_response.type == openxc_ControlCommand_Type_RTC_CONFIGURATION) {
+    } else if(type == openxc_ControlCommand_Type_RTC_CONFIGURATION) {
         typeString = payload::json::RTC_CONFIGURATION_COMMAND_NAME;
-    } else if(message->command_response.type == openxc_ControlCommand_Type_SD_MOUNT_STATUS) {
+    } else if(type == openxc_ControlCommand_Type_SD_MOUNT_STATUS) {
         typeString = payload::json::SD_MOUNT_STATUS_COMMAND_NAME;
-    } else {
-        return false;
-    }
-
-    cJSON_AddStringToObject(root, payload::json::COMMAND_RESPONSE_FIELD_NAME,
-            typeString);
-    if(message->command_response.type != openxc_ControlCommand_Type_UNUSED) {
-        cJSON_AddStringToObject(root,
-                payload::json::COMMAND_RESPONSE_MESSAGE_FIELD_NAME,
-                message->command_response.message);
     }
+    return typeString;
+}
 
-    if(message->command_response.type != openxc_ControlCommand_Type_UNUSED) {
-        cJSON_AddBoolToObject(root,
-                payload::json::COMMAND_RESPONSE_STATUS_FIELD_NAME,
-                message->command_response.status);
-    }
-    return true;
+static void serializeCommandResponse(openxc_VehicleMessage* message,
+        JsonWriter* writer) {
+    jsonwriter::addString(writer, payload::json::COMMAND_RESPONSE_FIELD_NAME,
+            payload::json::commandName(message->command_response.type));
+    jsonwriter::addString(writer,
+            payload::json::COMMAND_RESPONSE_MESSAGE_FIELD_NAME,
+            message->command_response.message);
+    jsonwriter::addBool(writer,
+            payload::json::COMMAND_RESPONSE_STATUS_FIELD_NAME,
+            message->command_response.status);
 }
 
-static bool serializeCan(openxc_VehicleMessage* message, cJSON* root) {
-    cJSON_AddNumberToObject(root, payload::json::BUS_FIELD_NAME,
+static void serializeCan(openxc_VehicleMessage* message, JsonWriter* writer) {
+    jsonwriter::addNumber(writer, payload::json::BUS_FIELD_NAME,
             message->can_message.bus);
-    cJSON_AddNumberToObject(root, payload::json::ID_FIELD_NAME,
+    jsonwriter::addNumber(writer, payload::json::ID_FIELD_NAME,
             message->can_message.id);
-
-    char encodedData[67];
-    const char* maxAddress = encodedData + sizeof(encodedData);
-    char* encodedDataIndex = encodedData;
-    encodedDataIndex += sprintf(encodedDataIndex, "0x");
-    for(uint8_t i = 0; i < message->can_message.data.size &&
-            encodedDataIndex < maxAddress; i++) {
-        encodedDataIndex += snprintf(encodedDataIndex,
-                maxAddress - encodedDataIndex,
-                "%02x", message->can_message.data.bytes[i]);
-    }
-    cJSON_AddStringToObject(root, payload::json::DATA_FIELD_NAME,
-            encodedData);
+    jsonwriter::addHexString(writer, payload::json::DATA_FIELD_NAME,
+            message->can_message.data.bytes, message->can_message.data.size,
+            CAN_DATA_MAX_ENCODED_LENGTH);
 
     if(message->can_message.frame_format != openxc_CanMessage_FrameFormat_UNUSED) {
-        cJSON_AddStringToObject(root, payload::json::FRAME_FORMAT_FIELD_NAME,
+        jsonwriter::addString(writer, payload::json::FRAME_FORMAT_FIELD_NAME,
                 message->can_message.frame_format == openxc_CanMessage_FrameFormat_STANDARD ?
                     payload::json::FRAME_FORMAT_STANDARD_NAME :
                         payload::json::FRAME_FORMAT_EXTENDED_NAME);
     }
-    return true;
 }
 
-static cJSON* serializeDynamicField(openxc_DynamicField* field) {
-    cJSON* value = NULL;
+static void serializeDynamicField(JsonWriter* writer, const char* name,
+        openxc_DynamicField* field) {
     if(field->type == openxc_DynamicField_Type_NUM) {
-        value = cJSON_CreateNumber(field->numeric_value);
+        jsonwriter::addNumber(writer, name, field->numeric_value);
     } else if(field->type == openxc_DynamicField_Type_BOOL) {
-        value = cJSON_CreateBool(field->boolean_value);
+        jsonwriter::addBool(writer, name, field->boolean_value);
     } else if(field->type == openxc_DynamicField_Type_STRING) {
-        value = cJSON_CreateString(field->string_value);
+        jsonwriter::addString(writer, name, field->string_value);
     }
-    return value;
 }
+
 void dumpNum(int value);
 void dumpDouble(double value) {
     char buff[20];
@@ -199,26 +192,14 @@ void dumpDouble(double value) {
     debug(buff);
 }
 
-static bool serializeSimple(openxc_VehicleMessage* message, cJSON* root) {
-    const char* name = message->simple_message.name;
-    cJSON_AddStringToObject(root, payload::json::NAME_FIELD_NAME, name);
-
-    cJSON* value = NULL;
-    if(message->simple_message.value.type != openxc_DynamicField_Type_UNUSED) {
-        value = serializeDynamicField(&message->simple_message.value);
-        if(value != NULL) {
-            cJSON_AddItemToObject(root, payload::json::VALUE_FIELD_NAME, value);
-        }
-    }
-
-    cJSON* event = NULL;
-    if(message->simple_message.event.type != openxc_DynamicField_Type_UNUSED) {
-        event = serializeDynamicField(&message->simple_message.event);
-        if(event != NULL) {
-            cJSON_AddItemToObject(root, payload::json::EVENT_FIELD_NAME, event);
-        }
-    }
-    return true;
+static void serializeSimple(openxc_VehicleMessage* message,
+        JsonWriter* writer) {
+    jsonwriter::addString(writer, payload::json::NAME_FIELD_NAME,
+            message->simple_message.name);
+    serializeDynamicField(writer, payload::json::VALUE_FIELD_NAME,
+            &message->simple_message.value);
+    serializeDynamicField(writer, payload::json::EVENT_FIELD_NAME,
+            &message->simple_message.event);
 }
 
 /* Private: Parse a hex string as a byte array.
@@ -227,22 +208,27 @@ static bool serializeSimple(openxc_VehicleMessage* message, cJSON* root) {
  *      represented with 2 characters, e.g. `1` is `01` - the complete string
  *      must have an even number of characters. The string can optionally begin
  *      with a '0x' prefix.
+ * sourceLength - The length of the hex string, which doesn't need to be NUL
+ *      terminated.
  * destination - The array to store the resulting byte array.
  * destinationLength - The maximum length for the parsed byte array.
  *
  * Returns the size of the byte array stored in dest.
  */
-static size_t dehexlify(const char source[], uint8_t* destination,
-        size_t destinationLength) {
+static size_t dehexlify(const char source[], size_t sourceLength,
+        uint8_t* destination, size_t destinationLength) {
     size_t i = 0;
-    if(strstr(source, "0x") != NULL) {
-        i += 2;
+    for(size_t j = 0; j + 1 < sourceLength; j++) {
+        if(source[j] == '0' && source[j + 1] == 'x') {
+            i += 2;
+            break;
+        }
     }
 
     size_t byteIndex = 0;
-    for(; i < strlen(source) && byteIndex < destinationLength; i += 2) {
+    for(; i < sourceLength && byteIndex < destinationLength; i += 2) {
         char bytestring[3] = {0};
-        strncpy(bytestring, &(source[i]), 2);
+        strncpy(bytestring, &(source[i]), MIN(2, sourceLength - i));
 
         char* end = NULL;
         destination[byteIndex++] = strtoul(bytestring, &end, 16);
@@ -250,164 +236,193 @@ static size_t dehexlify(const char source[], uint8_t* destination,
     return byteIndex;
 }
 
-static void deserializePassthrough(cJSON* root, openxc_ControlCommand* command) {
+/* Private: Parse a hex string token as a byte array - see dehexlify.
+ *
+ * Returns the size of the byte array stored in destination, or 0 if the token
+ * isn't a string.
+ */
+static size_t dehexlifyToken(const JsonReader* reader, const JsonToken* token,
+        uint8_t* destination, size_t destinationLength) {
+    if(token->type != JSON_TOKEN_STRING) {
+        return 0;
+    }
+    return dehexlify(&reader->json[token->start], token->length, destination,
+            destinationLength);
+}
+
+static void deserializePassthrough(const JsonReader* reader,
+        const JsonToken* root, openxc_ControlCommand* command) {
     command->type = openxc_ControlCommand_Type_PASSTHROUGH;
 
-    cJSON* element = cJSON_GetObjectItem(root, "bus");
+    const JsonToken* element = jsonreader::find(reader, root, "bus");
     if(element != NULL) {
-        command->passthrough_mode_request.bus = element->valueint;
+        command->passthrough_mode_request.bus = jsonreader::integer(reader,
+                element);
     }
 
-    element = cJSON_GetObjectItem(root, "enabled");
+    element = jsonreader::find(reader, root, "enabled");
     if(element != NULL) {
-        command->passthrough_mode_request.enabled = bool(element->valueint);
+        command->passthrough_mode_request.enabled = bool(jsonreader::integer(
+                    reader, element));
     }
 }
 
-static void deserializePayloadFormat(cJSON* root,
-        openxc_ControlCommand* command) {
+static void deserializePayloadFormat(const JsonReader* reader,
+        const JsonToken* root, openxc_ControlCommand* command) {
     command->type = openxc_ControlCommand_Type_PAYLOAD_FORMAT;
 
-    cJSON* element = cJSON_GetObjectItem(root, "format");
+    const JsonToken* element = jsonreader::find(reader, root, "format");
     if(element != NULL) {
-        if(!strcmp(element->valuestring,
+        if(jsonreader::stringEquals(reader, element,
                     openxc::payload::json::PAYLOAD_FORMAT_JSON_NAME)) {
             command->payload_format_command.format =
                     openxc_PayloadFormatCommand_PayloadFormat_JSON;
-        } else if(!strcmp(element->valuestring,
+        } else if(jsonreader::stringEquals(reader, element,
                     openxc::payload::json::PAYLOAD_FORMAT_PROTOBUF_NAME)) {
             command->payload_format_command.format =
                     openxc_PayloadFormatCommand_PayloadFormat_PROTOBUF;
+        } else if(jsonreader::stringEquals(reader, element,
+                    openxc::payload::json::PAYLOAD_FORMAT_MESSAGEPACK_NAME)) {
+            command->payload_format_command.format =
+                    openxc_PayloadFormatCommand_PayloadFormat_MESSAGEPACK;
         }
     }
 }
 
-static void deserializePredefinedObd2RequestsCommand(cJSON* root,
-        openxc_ControlCommand* command) {
+static void deserializePredefinedObd2RequestsCommand(const JsonReader* reader,
+        const JsonToken* root, openxc_ControlCommand* command) {
     command->type = openxc_ControlCommand_Type_PREDEFINED_OBD2_REQUESTS;
 
-    cJSON* element = cJSON_GetObjectItem(root, "enabled");
+    const JsonToken* element = jsonreader::find(reader, root, "enabled");
     if(element != NULL) {
-        command->predefined_obd2_requests_command.enabled = bool(element->valueint);
+        command->predefined_obd2_requests_command.enabled = bool(
+                jsonreader::integer(reader, element));
     }
 }
 
-static void deserializeAfBypass(cJSON* root, openxc_ControlCommand* command) {
+static void deserializeAfBypass(const JsonReader* reader,
+        const JsonToken* root, openxc_ControlCommand* command) {
     command->type = openxc_ControlCommand_Type_ACCEPTANCE_FILTER_BYPASS;
 
-    cJSON* element = cJSON_GetObjectItem(root, "bus");
+    const JsonToken* element = jsonreader::find(reader, root, "bus");
     if(element != NULL) {
-        command->acceptance_filter_bypass_command.bus = element->valueint;
+        command->acceptance_filter_bypass_command.bus = jsonreader::integer(
+                reader, element);
     }
 
-    element = cJSON_GetObjectItem(root, "bypass");
+    element = jsonreader::find(reader, root, "bypass");
     if(element != NULL) {
         command->acceptance_filter_bypass_command.bypass =
-            bool(element->valueint);
+            bool(jsonreader::integer(reader, element));
     }
 }
 
-static void deserializeDiagnostic(cJSON* root, openxc_ControlCommand* command) {
+static void deserializeDiagnostic(const JsonReader* reader,
+        const JsonToken* root, openxc_ControlCommand* command) {
     command->type = openxc_ControlCommand_Type_DIAGNOSTIC;
 
-    cJSON* action = cJSON_GetObjectItem(root, "action");
-    if(action != NULL && action->type == cJSON_String) {
-        if(!strcmp(action->valuestring, "add")) {
-            command->diagnostic_request.action =
-                    openxc_DiagnosticControlCommand_Action_ADD;
-        } else if(!strcmp(action->valuestring, "cancel")) {
-            command->diagnostic_request.action =
-                    openxc_DiagnosticControlCommand_Action_CANCEL;
-        }
+    const JsonToken* action = jsonreader::find(reader, root, "action");
+    if(jsonreader::stringEquals(reader, action, "add")) {
+        command->diagnostic_request.action =
+                openxc_DiagnosticControlCommand_Action_ADD;
+    } else if(jsonreader::stringEquals(reader, action, "cancel")) {
+        command->diagnostic_request.action =
+                openxc_DiagnosticControlCommand_Action_CANCEL;
     }
 
-    cJSON* request = cJSON_GetObjectItem(root, "request");
+    const JsonToken* request = jsonreader::find(reader, root, "request");
     if(request != NULL) {
-        cJSON* element = cJSON_GetObjectItem(request, "bus");
+        const JsonToken* element = jsonreader::find(reader, request, "bus");
         if(element != NULL) {
-            command->diagnostic_request.request.bus = element->valueint;
+            command->diagnostic_request.request.bus = jsonreader::integer(
+                    reader, element);
         }
 
-        element = cJSON_GetObjectItem(request, "mode");
+        element = jsonreader::find(reader, request, "mode");
         if(element != NULL) {
             debug("mode");
-            dumpNum(element->valueint);
-            command->diagnostic_request.request.mode = element->valueint;
+            dumpNum(jsonreader::integer(reader, element));
+            command->diagnostic_request.request.mode = jsonreader::integer(
+                    reader, element);
         }
 
-        element = cJSON_GetObjectItem(request, "id");
+        element = jsonreader::find(reader, request, "id");
         if(element != NULL) {
-            command->diagnostic_request.request.message_id = element->valueint;
+            command->diagnostic_request.request.message_id =
+                    jsonreader::integer(reader, element);
         }
 
-        element = cJSON_GetObjectItem(request, "pid");
+        element = jsonreader::find(reader, request, "pid");
         if(element != NULL) {
-            command->diagnostic_request.request.pid = element->valueint;
+            command->diagnostic_request.request.pid = jsonreader::integer(
+                    reader, element);
         }
 
-        element = cJSON_GetObjectItem(request, "payload");
+        element = jsonreader::find(reader, request, "payload");
         if(element != NULL) {
-            command->diagnostic_request.request.payload.size = dehexlify(
-                    element->valuestring,
+            command->diagnostic_request.request.payload.size = dehexlifyToken(
+                    reader, element,
                     command->diagnostic_request.request.payload.bytes,
                     sizeof(((openxc_DiagnosticRequest*)0)->payload.bytes));
         }
 
-        element = cJSON_GetObjectItem(request, "multiple_responses");
+        element = jsonreader::find(reader, request, "multiple_responses");
         if(element != NULL) {
         debug("multiple_responses:");
-        dumpNum(element->valueint);
+        dumpNum(jsonreader::integer(reader, element));
             command->diagnostic_request.request.multiple_responses =
-                bool(element->valueint);
+                bool(jsonreader::integer(reader, element));
         }
 
-        element = cJSON_GetObjectItem(request, "frequency");
+        element = jsonreader::find(reader, request, "frequency");
         if(element != NULL) {
         debug("frequency:");
-        dumpDouble(element->valuedouble);
+        dumpDouble(jsonreader::number(reader, element));
             command->diagnostic_request.request.frequency =
-                element->valuedouble;
+                jsonreader::number(reader, element);
         }
 
-        element = cJSON_GetObjectItem(request, "decoded_type");
+        element = jsonreader::find(reader, request, "decoded_type");
         if(element != NULL) {
-            if(!strcmp(element->valuestring, "obd2")) {
+            if(jsonreader::stringEquals(reader, element, "obd2")) {
                 debug("decoded_type is obd2");
                 command->diagnostic_request.request.decoded_type =
                         openxc_DiagnosticRequest_DecodedType_OBD2;
-            } else if(!strcmp(element->valuestring, "none")) {
+            } else if(jsonreader::stringEquals(reader, element, "none")) {
                 debug("decoded_type is none");
                 command->diagnostic_request.request.decoded_type =
                         openxc_DiagnosticRequest_DecodedType_NONE;
             }
         }
 
-        element = cJSON_GetObjectItem(request, "name");
-        if(element != NULL && element->type == cJSON_String) {
+        element = jsonreader::find(reader, request, "name");
+        if(element != NULL && element->type == JSON_TOKEN_STRING) {
+            jsonreader::copyString(reader, element,
+                    command->diagnostic_request.request.name,
+                    sizeof(command->diagnostic_request.request.name));
             debug("name");
-            debug(element->valuestring);
-            strcpy(command->diagnostic_request.request.name,
-                    element->valuestring);
+            debug(command->diagnostic_request.request.name);
         }
     }
 }
 
-static bool deserializeDynamicField(cJSON* element,
-        openxc_DynamicField* field) {
+static bool deserializeDynamicField(const JsonReader* reader,
+        const JsonToken* element, openxc_DynamicField* field) {
     bool status = true;
     switch(element->type) {
-        case cJSON_String:
+        case JSON_TOKEN_STRING:
             field->type = openxc_DynamicField_Type_STRING;
-            strcpy(field->string_value, element->valuestring);
+            jsonreader::copyString(reader, element, field->string_value,
+                    sizeof(field->string_value));
             break;
-        case cJSON_False:
-        case cJSON_True:
+        case JSON_TOKEN_FALSE:
+        case JSON_TOKEN_TRUE:
             field->type = openxc_DynamicField_Type_BOOL;
-            field->boolean_value = bool(element->valueint);
+            field->boolean_value = element->type == JSON_TOKEN_TRUE;
             break;
-        case cJSON_Number:
+        case JSON_TOKEN_NUMBER:
             field->type = openxc_DynamicField_Type_NUM;
-            field->numeric_value = element->valuedouble;
+            field->numeric_value = jsonreader::number(reader, element);
             break;
         default:
             debug("Unsupported type in value field: %d", element->type);
@@ -417,55 +432,56 @@ static bool deserializeDynamicField(cJSON* element,
     return status;
 }
 
-static void deserializeSimple(cJSON* root, openxc_VehicleMessage* message) {
+static void deserializeSimple(const JsonReader* reader, const JsonToken* root,
+        openxc_VehicleMessage* message) {
     message->type = openxc_VehicleMessage_Type_SIMPLE;
     openxc_SimpleMessage* simpleMessage = &message->simple_message;
 
-    cJSON* element = cJSON_GetObjectItem(root, "name");
-    if(element != NULL && element->type == cJSON_String) {
-        strcpy(simpleMessage->name, element->valuestring);
+    const JsonToken* element = jsonreader::find(reader, root, "name");
+    if(element != NULL && element->type == JSON_TOKEN_STRING) {
+        jsonreader::copyString(reader, element, simpleMessage->name,
+                sizeof(simpleMessage->name));
     }
 
-    element = cJSON_GetObjectItem(root, "value");
+    element = jsonreader::find(reader, root, "value");
     if(element != NULL) {
-        if(deserializeDynamicField(element, &simpleMessage->value)) {
-        }
+        deserializeDynamicField(reader, element, &simpleMessage->value);
     }
 
-    element = cJSON_GetObjectItem(root, "event");
+    element = jsonreader::find(reader, root, "event");
     if(element != NULL) {
-        if(deserializeDynamicField(element, &simpleMessage->event)) {
-        }
+        deserializeDynamicField(reader, element, &simpleMessage->event);
     }
 }
 
-static void deserializeCan(cJSON* root, openxc_VehicleMessage* message) {
+static void deserializeCan(const JsonReader* reader, const JsonToken* root,
+        openxc_VehicleMessage* message) {
     message->type = openxc_VehicleMessage_Type_CAN;
     openxc_CanMessage* canMessage = &message->can_message;
 
-    cJSON* element = cJSON_GetObjectItem(root, "id");
+    const JsonToken* element = jsonreader::find(reader, root, "id");
     if(element != NULL) {
-        canMessage->id = element->valueint;
+        canMessage->id = jsonreader::integer(reader, element);
 
-        element = cJSON_GetObjectItem(root, "data");
+        element = jsonreader::find(reader, root, "data");
         if(element != NULL) {
-            canMessage->data.size = dehexlify(
-                    element->valuestring,
+            canMessage->data.size = dehexlifyToken(reader, element,
                     canMessage->data.bytes,
                     sizeof(((openxc_CanMessage*)0)->data.bytes));
         }
 
-        element = cJSON_GetObjectItem(root, "bus");
+        element = jsonreader::find(reader, root, "bus");
         if(element != NULL) {
-            canMessage->bus = element->valueint;
+            canMessage->bus = jsonreader::integer(reader, element);
         }
 
-        element = cJSON_GetObjectItem(root, payload::json::FRAME_FORMAT_FIELD_NAME);
+        element = jsonreader::find(reader, root,
+                payload::json::FRAME_FORMAT_FIELD_NAME);
         if(element != NULL) {
-            if(!strcmp(element->valuestring,
+            if(jsonreader::stringEquals(reader, element,
                         payload::json::FRAME_FORMAT_STANDARD_NAME)) {
                 canMessage->frame_format = openxc_CanMessage_FrameFormat_STANDARD;
-            } else if(!strcmp(element->valuestring,
+            } else if(jsonreader::stringEquals(reader, element,
                         payload::json::FRAME_FORMAT_EXTENDED_NAME)) {
                 canMessage->frame_format = openxc_CanMessage_FrameFormat_EXTENDED;
             }
@@ -473,33 +489,140 @@ static void deserializeCan(cJSON* root, openxc_VehicleMessage* message) {
     }
 }
 
-static void deserializeModemConfiguration(cJSON* root, openxc_ControlCommand* command) {
+static void deserializeModemConfiguration(const JsonReader* reader,
+        const JsonToken* root, openxc_ControlCommand* command) {
     // set up the struct for a modem configuration message
     command->type = openxc_ControlCommand_Type_MODEM_CONFIGURATION;
     openxc_ModemConfigurationCommand* modemConfigurationCommand = &command->modem_configuration_command;
-    // Keeping if statement commented out, was used for a depricated way to deserialize Modem Configuration.
-    // parse server command
-    // cJSON* server = cJSON_GetObjectItem(root, "server");
-    // if(server != NULL) {
-        cJSON* host = cJSON_GetObjectItem(root, "host");
-        if(host != NULL) {
-            strcpy(modemConfigurationCommand->serverConnectSettings.host, host->valuestring);
-        }
-        cJSON* port = cJSON_GetObjectItem(root, "port");
-        if(port != NULL) {
-            modemConfigurationCommand->serverConnectSettings.port = port->valueint;
-        }
-    // }
+    const JsonToken* host = jsonreader::find(reader, root, "host");
+    if(host != NULL) {
+        jsonreader::copyString(reader, host,
+                modemConfigurationCommand->serverConnectSettings.host,
+                sizeof(modemConfigurationCommand->serverConnectSettings.host));
+    }
+    const JsonToken* port = jsonreader::find(reader, root, "port");
+    if(port != NULL) {
+        modemConfigurationCommand->serverConnectSettings.port =
+                jsonreader::integer(reader, port);
+    }
 }
 
-static void deserializeRTCConfiguration(cJSON* root, openxc_ControlCommand* command) {
+static void deserializeRTCConfiguration(const JsonReader* reader,
+        const JsonToken* root, openxc_ControlCommand* command) {
 
     command->type = openxc_ControlCommand_Type_RTC_CONFIGURATION;
     openxc_RTCConfigurationCommand* rtcConfigurationCommand = &command->rtc_configuration_command;
-    
-    cJSON* time = cJSON_GetObjectItem(root, "unix_time");
+
+    const JsonToken* time = jsonreader::find(reader, root, "unix_time");
     if(time != NULL) {
-        rtcConfigurationCommand->unix_time = time->valueint;
+        rtcConfigurationCommand->unix_time = jsonreader::integer(reader, time);
+    }
+}
+
+/* Private: A command that can be received, and how to read its fields.
+ *
+ * name - The value of the "command" field for the command.
+ * type - The type of the command.
+ * deserialize - The function to read the rest of the command's fields, or
+ *      NULL if it doesn't have any.
+ * hash - The hash of the name, filled in the first time a command is
+ *      received.
+ */
+typedef struct {
+    const char* name;
+    openxc_ControlCommand_Type type;
+    void (*deserialize)(const JsonReader* reader, const JsonToken* root,
+            openxc_ControlCommand* command);
+    uint32_t hash;
+} CommandDeserializer;
+
+static CommandDeserializer COMMAND_DESERIALIZERS[] = {
+    {payload::json::VERSION_COMMAND_NAME,
+        openxc_ControlCommand_Type_VERSION, NULL, 0},
+    {payload::json::DEVICE_ID_COMMAND_NAME,
+        openxc_ControlCommand_Type_DEVICE_ID, NULL, 0},
+    {payload::json::GET_VIN_COMMAND_NAME,
+        openxc_ControlCommand_Type_GET_VIN, NULL, 0},
+    {payload::json::DEVICE_PLATFORM_COMMAND_NAME,
+        openxc_ControlCommand_Type_PLATFORM, NULL, 0},
+    {payload::json::DIAGNOSTIC_COMMAND_NAME,
+        openxc_ControlCommand_Type_DIAGNOSTIC, deserializeDiagnostic, 0},
+    {payload::json::PASSTHROUGH_COMMAND_NAME,
+        openxc_ControlCommand_Type_PASSTHROUGH, deserializePassthrough, 0},
+    {payload::json::PREDEFINED_OBD2_REQUESTS_COMMAND_NAME,
+        openxc_ControlCommand_Type_PREDEFINED_OBD2_REQUESTS,
+        deserializePredefinedObd2RequestsCommand, 0},
+    {payload::json::ACCEPTANCE_FILTER_BYPASS_COMMAND_NAME,
+        openxc_ControlCommand_Type_ACCEPTANCE_FILTER_BYPASS,
+        deserializeAfBypass, 0},
+    {payload::json::PAYLOAD_FORMAT_COMMAND_NAME,
+        openxc_ControlCommand_Type_PAYLOAD_FORMAT, deserializePayloadFormat,
+        0},
+    {payload::json::MODEM_CONFIGURATION_COMMAND_NAME,
+        openxc_ControlCommand_Type_MODEM_CONFIGURATION,
+        deserializeModemConfiguration, 0},
+    {payload::json::RTC_CONFIGURATION_COMMAND_NAME,
+        openxc_ControlCommand_Type_RTC_CONFIGURATION,
+        deserializeRTCConfiguration, 0},
+    {payload::json::SD_MOUNT_STATUS_COMMAND_NAME,
+        openxc_ControlCommand_Type_SD_MOUNT_STATUS, NULL, 0},
+};
+
+static const size_t COMMAND_DESERIALIZER_COUNT =
+        sizeof(COMMAND_DESERIALIZERS) / sizeof(COMMAND_DESERIALIZERS[0]);
+
+/* Private: Hash a command name with 32-bit FNV-1a.
+ */
+static uint32_t hashCommandName(const char* name) {
+    uint32_t hash = 2166136261u;
+    for(; *name != '\0'; name++) {
+        hash = (hash ^ (uint8_t)*name) * 16777619u;
+    }
+    return hash;
+}
+
+/* Private: Look up how to read a command from its name, comparing hashes so
+ * only the matching entry's name is compared in full.
+ *
+ * Returns the matching entry, or NULL if the command isn't recognized.
+ */
+static const CommandDeserializer* lookupCommandDeserializer(const char* name) {
+    static bool hashed = false;
+    if(!hashed) {
+        for(size_t i = 0; i < COMMAND_DESERIALIZER_COUNT; i++) {
+            COMMAND_DESERIALIZERS[i].hash = hashCommandName(
+                    COMMAND_DESERIALIZERS[i].name);
+        }
+        hashed = true;
+    }
+
+    uint32_t hash = hashCommandName(name);
+    for(size_t i = 0; i < COMMAND_DESERIALIZER_COUNT; i++) {
+        if(COMMAND_DESERIALIZERS[i].hash == hash &&
+                !strcmp(COMMAND_DESERIALIZERS[i].name, name)) {
+            return &COMMAND_DESERIALIZERS[i];
+        }
+    }
+    return NULL;
+}
+
+static void deserializeCommand(const JsonReader* reader, const JsonToken* root,
+        const JsonToken* commandNameToken, openxc_VehicleMessage* message) {
+    message->type = openxc_VehicleMessage_Type_CONTROL_COMMAND;
+    openxc_ControlCommand* command = &message->control_command;
+
+    char commandName[MAX_COMMAND_NAME_LENGTH] = {0};
+    jsonreader::copyString(reader, commandNameToken, commandName,
+            sizeof(commandName));
+
+    const CommandDeserializer* deserializer = lookupCommandDeserializer(
+            commandName);
+    if(deserializer == NULL) {
+        debug("Unrecognized command: %s", commandName);
+    } else if(deserializer->deserialize != NULL) {
+        deserializer->deserialize(reader, root, command);
+    } else {
+        command->type = deserializer->type;
     }
 }
 
@@ -509,91 +632,40 @@ size_t openxc::payload::json::deserialize(uint8_t payload[], size_t length,
     size_t messageLength = 0;
     if(delimiter != NULL) {
         messageLength = (size_t)(delimiter - (const char*)payload) + 1;
-        uint8_t messageBuffer[messageLength];
-        if(messageLength > 0) {
-            memcpy(messageBuffer, payload, messageLength);
-        }
         // There may be junk data at the start of the payload - seek ahead to the
         // start of the message.
-        char* jsonStart = strchr((char*)messageBuffer, '{');
+        const char* jsonStart = strchr((const char*)payload, '{');
         if(jsonStart == NULL) {
             debug("%s", "No JSON object start found");
             // Return message length so this bogus front matter is erased
             return messageLength;
         }
 
-        cJSON *root = cJSON_Parse(jsonStart);
-        if(root == NULL) {
+        // Tokenize the message where it is in the payload rather than copying
+        // it or building a tree on the heap
+        JsonReader reader;
+        if(!jsonreader::parse(&reader, jsonStart)) {
+            if(reader.full) {
+                debug("JSON message has more than %d values -- dropping it",
+                        JSON_MAX_TOKENS);
+                return messageLength;
+            }
             debug("No JSON found in %u byte payload", length);
             // TODO should this return messageLength to eat up corrupt data, or
             // does it need to be 0 so we preserve partial messages?
             return 0;
         }
 
-        cJSON* commandNameObject = cJSON_GetObjectItem(root, "command");
-        if(commandNameObject != NULL) {
-            message->type = openxc_VehicleMessage_Type_CONTROL_COMMAND;
-            openxc_ControlCommand* command = &message->control_command;
-
-            if(!strncmp(commandNameObject->valuestring, VERSION_COMMAND_NAME,
-                        strlen(VERSION_COMMAND_NAME))) {
-                command->type = openxc_ControlCommand_Type_VERSION;
-            } else if(!strncmp(commandNameObject->valuestring,
-                        DEVICE_ID_COMMAND_NAME, strlen(DEVICE_ID_COMMAND_NAME))) {
-                command->type = openxc_ControlCommand_Type_DEVICE_ID;
-            } else if(!strncmp(commandNameObject->valuestring,
-                        GET_VIN_COMMAND_NAME, strlen(GET_VIN_COMMAND_NAME))) {
-                command->type = openxc_ControlCommand_Type_GET_VIN;
-                        }
-             else if(!strncmp(commandNameObject->valuestring,
-                        DEVICE_PLATFORM_COMMAND_NAME, strlen(DEVICE_PLATFORM_COMMAND_NAME))) {
-                command->type = openxc_ControlCommand_Type_PLATFORM;
-            } else if(!strncmp(commandNameObject->valuestring,
-                        DIAGNOSTIC_COMMAND_NAME, strlen(DIAGNOSTIC_COMMAND_NAME))) {
-                deserializeDiagnostic(root, command);
-            } else if(!strncmp(commandNameObject->valuestring,
-                        PASSTHROUGH_COMMAND_NAME, strlen(PASSTHROUGH_COMMAND_NAME))) {
-                deserializePassthrough(root, command);
-            } else if(!strncmp(commandNameObject->valuestring,
-                        PREDEFINED_OBD2_REQUESTS_COMMAND_NAME,
-                            strlen(PREDEFINED_OBD2_REQUESTS_COMMAND_NAME))) {
-                deserializePredefinedObd2RequestsCommand(root, command);
-            } else if(!strncmp(commandNameObject->valuestring,
-                        ACCEPTANCE_FILTER_BYPASS_COMMAND_NAME,
-                        strlen(ACCEPTANCE_FILTER_BYPASS_COMMAND_NAME))) {
-                deserializeAfBypass(root, command);
-            } else if(!strncmp(commandNameObject->valuestring,
-                        PAYLOAD_FORMAT_COMMAND_NAME,
-                        strlen(PAYLOAD_FORMAT_COMMAND_NAME))) {
-                deserializePayloadFormat(root, command);
-            } 
-            else if(!strncmp(commandNameObject->valuestring,
-                        MODEM_CONFIGURATION_COMMAND_NAME,
-                        strlen(MODEM_CONFIGURATION_COMMAND_NAME))) {
-                deserializeModemConfiguration(root, command);
-            }
-            else if(!strncmp(commandNameObject->valuestring,
-                        RTC_CONFIGURATION_COMMAND_NAME,
-                        strlen(RTC_CONFIGURATION_COMMAND_NAME))) {
-                deserializeRTCConfiguration(root, command);
-            }
-            else if(!strncmp(commandNameObject->valuestring,
-                        SD_MOUNT_STATUS_COMMAND_NAME,
-                        strlen(SD_MOUNT_STATUS_COMMAND_NAME))) {
-                command->type = openxc_ControlCommand_Type_SD_MOUNT_STATUS;
-            }
-            else {
-                debug("Unrecognized command: %s", commandNameObject->valuestring);
-            }
+        const JsonToken* root = jsonreader::root(&reader);
+        const JsonToken* commandNameToken = jsonreader::find(&reader, root,
+                "command");
+        if(commandNameToken != NULL) {
+            deserializeCommand(&reader, root, commandNameToken, message);
+        } else if(jsonreader::find(&reader, root, "name") == NULL) {
+            deserializeCan(&reader, root, message);
         } else {
-            cJSON* nameObject = cJSON_GetObjectItem(root, "name");
-            if(nameObject == NULL) {
-                deserializeCan(root, message);
-            } else {
-                deserializeSimple(root, message);
-            }
+            deserializeSimple(&reader, root, message);
         }
-        cJSON_Delete(root);
     }
 
     return messageLength;
@@ -601,40 +673,60 @@ size_t openxc::payload::json::deserialize(uint8_t payload[], size_t length,
 
 int openxc::payload::json::serialize(openxc_VehicleMessage* message,
         uint8_t payload[], size_t length) {
-    cJSON* root = cJSON_CreateObject();
-    size_t finalLength = 0;
-    if(root != NULL) {
-        bool status = true;
-        if(message->timestamp != 0) {
-            cJSON_AddNumberToObject(root, "timestamp", message->timestamp);
-        }
-        if(message->type == openxc_VehicleMessage_Type_SIMPLE) {
-            status = serializeSimple(message, root);
-        } else if(message->type == openxc_VehicleMessage_Type_CAN) {
-            status = serializeCan(message, root);
-        } else if(message->type == openxc_VehicleMessage_Type_DIAGNOSTIC) {
-            status = serializeDiagnostic(message, root);
-        } else if(message->type == openxc_VehicleMessage_Type_COMMAND_RESPONSE) {
-            status = serializeCommandResponse(message, root);
-        } else {
-            debug("Unrecognized message type -- not sending");
-        }
+    if(message->type == openxc_VehicleMessage_Type_COMMAND_RESPONSE &&
+            commandName(message->command_response.type) == NULL) {
+        debug("Unrecognized command response type -- not sending");
+        return 0;
+    }
 
-        char* serialized = cJSON_PrintUnformatted(root);
-        if(status && serialized != NULL) {
-            // set the length to the strlen + 1, so we include the NULL
-            // character as a delimiter
-            finalLength = MIN(length, strlen(serialized) + 1);
-            memcpy(payload, serialized, finalLength);
-            free(serialized);
-        } else {
-            debug("Converting JSON to string failed -- possibly OOM");
-        }
+    JsonWriter writer;
+    jsonwriter::initialize(&writer, payload, length);
+    if(message->timestamp != 0) {
+        jsonwriter::addNumber(&writer, "timestamp", message->timestamp);
+    }
 
-        cJSON_Delete(root);
+    if(message->type == openxc_VehicleMessage_Type_SIMPLE) {
+        serializeSimple(message, &writer);
+    } else if(message->type == openxc_VehicleMessage_Type_CAN) {
+        serializeCan(message, &writer);
+    } else if(message->type == openxc_VehicleMessage_Type_DIAGNOSTIC) {
+        serializeDiagnostic(message, &writer);
+    } else if(message->type == openxc_VehicleMessage_Type_COMMAND_RESPONSE) {
+        serializeCommandResponse(message, &writer);
     } else {
-        debug("JSON object is NULL -- probably OOM");
+        debug("Unrecognized message type -- not sending");
     }
+    return jsonwriter::finish(&writer);
+}
+
+#define BATCH_VERSION_STRING(version) #version
+#define BATCH_HEADER(version) \
+        "{\"batch\":" BATCH_VERSION_STRING(version) ",\"messages\":["
 
-    return finalLength;
+static const char BATCH_HEADER_STRING[] = BATCH_HEADER(PAYLOAD_BATCH_VERSION);
+
+int openxc::payload::json::serializeBatch(const uint8_t messages[],
+        size_t messagesLength, int messageCount, uint8_t payload[],
+        size_t length) {
+    size_t headerLength = sizeof(BATCH_HEADER_STRING) - 1;
+    if(messageCount == 0 || messagesLength == 0 ||
+            headerLength + messagesLength + 2 > length) {
+        debug("JSON batch doesn't fit in payload");
+        return 0;
+    }
+    memcpy(payload, BATCH_HEADER_STRING, headerLength);
+
+    // Each message's NUL delimiter becomes the comma before the next message,
+    // and the last one closes the array.
+    uint8_t* array = &payload[headerLength];
+    memcpy(array, messages, messagesLength);
+    for(size_t i = 0; i < messagesLength - 1; i++) {
+        if(array[i] == '\0') {
+            array[i] = ',';
+        }
+    }
+    array[messagesLength - 1] = ']';
+    array[messagesLength] = '}';
+    array[messagesLength + 1] = '\0';
+    return headerLength + messagesLength + 2;
 }
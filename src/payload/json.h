@@ -21,6 +21,7 @@ extern const char PREDEFINED_OBD2_REQUESTS_COMMAND_NAME[];
 
 extern const char PAYLOAD_FORMAT_JSON_NAME[];
 extern const char PAYLOAD_FORMAT_PROTOBUF_NAME[];
+extern const char PAYLOAD_FORMAT_MESSAGEPACK_NAME[];
 
 extern const char COMMAND_RESPONSE_FIELD_NAME[];
 extern const char COMMAND_RESPONSE_MESSAGE_FIELD_NAME[];
@@ -50,6 +51,14 @@ extern const char MODEM_CONFIGURATION_COMMAND_NAME[];
 extern const char RTC_CONFIGURATION_COMMAND_NAME[];
 extern const char SD_MOUNT_STATUS_COMMAND_NAME[];
 
+/* Public: Look up the name used for a command in the "command" and
+ * "command_response" fields.
+ *
+ * Returns the name of the command, or NULL if it's not a command with a
+ * response.
+ */
+const char* commandName(openxc_ControlCommand_Type type);
+
 /* Public: Deserialize an OpenXC message from a payload containing JSON.
  *
  * payload - The bytestream payload to parse a message from.
@@ -72,6 +81,25 @@ size_t deserialize(uint8_t payload[], size_t length, openxc_VehicleMessage* mess
  */
 int serialize(openxc_VehicleMessage* message, uint8_t payload[], size_t length);
 
+/* Public: Wrap a batch of JSON messages in a single container object:
+ *
+ *      {"batch": 1, "messages": [{...}, {...}]}
+ *
+ * The "batch" field is the version of the container, PAYLOAD_BATCH_VERSION.
+ * Like every other JSON message, the frame is followed by a NUL delimiter.
+ *
+ * messages - The NUL delimited JSON messages, back to back, as written by
+ *      serialize().
+ * messagesLength - The total length of the messages.
+ * messageCount - The number of messages.
+ * payload - The buffer to store the frame - must be allocated by the caller.
+ * length -  The length of the payload buffer.
+ *
+ * Returns the number of bytes written to the payload, or 0 if it doesn't fit.
+ */
+int serializeBatch(const uint8_t messages[], size_t messagesLength,
+        int messageCount, uint8_t payload[], size_t length);
+
 } // namespace json
 } // namespace payload
 } // namespace openxc
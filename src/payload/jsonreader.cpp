@@ -0,0 +1,397 @@
+#include "payload/jsonreader.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+// The longest UTF-8 sequence a \u escape can decode to
+#define MAX_DECODED_CHARACTER_LENGTH 4
+// Token offsets are 16 bits
+#define MAX_JSON_LENGTH 0xffff
+
+static const uint8_t FIRST_BYTE_MARKS[] = {0x00, 0x00, 0xc0, 0xe0, 0xf0};
+
+static const char* skipWhitespace(const char* in) {
+    while(*in != '\0' && (unsigned char)*in <= 32) {
+        in++;
+    }
+    return in;
+}
+
+/* Private: Scan a number the same way cJSON's parse_number does, so values
+ * come out identical to the last bit.
+ *
+ * Returns a pointer to the first character after the number.
+ */
+static const char* scanNumber(const char* in, double* value) {
+    double n = 0, sign = 1, scale = 0;
+    int subscale = 0, signsubscale = 1;
+
+    if(*in == '-') {
+        sign = -1;
+        in++;
+    }
+    if(*in == '0') {
+        in++;
+    }
+    if(*in >= '1' && *in <= '9') {
+        do {
+            n = (n * 10.0) + (*in++ - '0');
+        } while(*in >= '0' && *in <= '9');
+    }
+    if(*in == '.' && in[1] >= '0' && in[1] <= '9') {
+        in++;
+        do {
+            n = (n * 10.0) + (*in++ - '0');
+            scale--;
+        } while(*in >= '0' && *in <= '9');
+    }
+    if(*in == 'e' || *in == 'E') {
+        in++;
+        if(*in == '+') {
+            in++;
+        } else if(*in == '-') {
+            signsubscale = -1;
+            in++;
+        }
+        while(*in >= '0' && *in <= '9') {
+            subscale = (subscale * 10) + (*in++ - '0');
+        }
+    }
+
+    if(value != NULL) {
+        *value = sign * n * pow(10.0, (scale + subscale * signsubscale));
+    }
+    return in;
+}
+
+static int addToken(JsonReader* reader, JsonTokenType type, const char* start,
+        size_t length) {
+    if(reader->count >= JSON_MAX_TOKENS) {
+        reader->full = true;
+        return -1;
+    }
+    JsonToken* token = &reader->tokens[reader->count];
+    token->type = type;
+    token->start = start - reader->json;
+    token->length = length;
+    token->end = ++reader->count;
+    return reader->count - 1;
+}
+
+static const char* parseValue(JsonReader* reader, const char* in, int depth);
+
+static const char* parseString(JsonReader* reader, const char* in) {
+    if(*in != '"') {
+        return NULL;
+    }
+
+    const char* start = ++in;
+    while(*in != '"' && *in != '\0') {
+        if(*in == '\\' && in[1] != '\0') {
+            in++;
+        }
+        in++;
+    }
+
+    if(*in != '"' ||
+            addToken(reader, JSON_TOKEN_STRING, start, in - start) < 0) {
+        return NULL;
+    }
+    return in + 1;
+}
+
+/* Private: Parse the members of an object or the elements of an array.
+ *
+ * in - The text just after the opening bracket.
+ * close - The closing bracket, '}' or ']'.
+ */
+static const char* parseContainer(JsonReader* reader, const char* in,
+        char close, int depth) {
+    in = skipWhitespace(in);
+    if(*in == close) {
+        return in + 1;
+    }
+
+    while(true) {
+        if(close == '}') {
+            in = parseString(reader, skipWhitespace(in));
+            if(in == NULL) {
+                return NULL;
+            }
+            in = skipWhitespace(in);
+            if(*in != ':') {
+                return NULL;
+            }
+            in++;
+        }
+
+        in = parseValue(reader, skipWhitespace(in), depth + 1);
+        if(in == NULL) {
+            return NULL;
+        }
+
+        in = skipWhitespace(in);
+        if(*in == close) {
+            return in + 1;
+        } else if(*in != ',') {
+            return NULL;
+        }
+        in++;
+    }
+}
+
+static const char* parseValue(JsonReader* reader, const char* in, int depth) {
+    if(depth > JSON_MAX_DEPTH) {
+        return NULL;
+    }
+
+    if(!strncmp(in, "null", 4)) {
+        return addToken(reader, JSON_TOKEN_NULL, in, 4) < 0 ? NULL : in + 4;
+    } else if(!strncmp(in, "false", 5)) {
+        return addToken(reader, JSON_TOKEN_FALSE, in, 5) < 0 ? NULL : in + 5;
+    } else if(!strncmp(in, "true", 4)) {
+        return addToken(reader, JSON_TOKEN_TRUE, in, 4) < 0 ? NULL : in + 4;
+    } else if(*in == '"') {
+        return parseString(reader, in);
+    } else if(*in == '-' || (*in >= '0' && *in <= '9')) {
+        const char* end = scanNumber(in, NULL);
+        return addToken(reader, JSON_TOKEN_NUMBER, in, end - in) < 0 ?
+                NULL : end;
+    } else if(*in == '[' || *in == '{') {
+        int index = addToken(reader,
+                *in == '[' ? JSON_TOKEN_ARRAY : JSON_TOKEN_OBJECT, in, 0);
+        if(index < 0) {
+            return NULL;
+        }
+
+        const char* end = parseContainer(reader, in + 1,
+                *in == '[' ? ']' : '}', depth);
+        if(end != NULL) {
+            reader->tokens[index].length = end - in;
+            reader->tokens[index].end = reader->count;
+        }
+        return end;
+    }
+    return NULL;
+}
+
+static unsigned parseHex4(const char* in, const char* end) {
+    unsigned value = 0;
+    for(int i = 0; i < 4; i++) {
+        if(in + i >= end || !isxdigit((unsigned char)in[i])) {
+            return 0;
+        }
+        value = (value << 4) | (isdigit((unsigned char)in[i]) ? in[i] - '0' :
+                tolower((unsigned char)in[i]) - 'a' + 10);
+    }
+    return value;
+}
+
+/* Private: Decode the \u escape at the start of in, including the second half
+ * of a surrogate pair, as UTF-8. Invalid escapes decode to nothing, as in
+ * cJSON.
+ *
+ * in - The text just after the "\u".
+ * next - An output parameter for the text after the escape.
+ *
+ * Returns the number of bytes stored in output.
+ */
+static size_t decodeUnicodeEscape(const char* in, const char* end,
+        const char** next, char* output) {
+    unsigned character = parseHex4(in, end);
+    *next = in + 4 <= end ? in + 4 : end;
+    if((character >= 0xdc00 && character <= 0xdfff) || character == 0) {
+        return 0;
+    }
+
+    if(character >= 0xd800 && character <= 0xdbff) {
+        in = *next;
+        if(end - in < 2 || in[0] != '\\' || in[1] != 'u') {
+            return 0;
+        }
+        unsigned low = parseHex4(in + 2, end);
+        *next = in + 6 <= end ? in + 6 : end;
+        if(low < 0xdc00 || low > 0xdfff) {
+            return 0;
+        }
+        character = 0x10000 + (((character & 0x3ff) << 10) | (low & 0x3ff));
+    }
+
+    size_t length = character < 0x80 ? 1 : character < 0x800 ? 2 :
+            character < 0x10000 ? 3 : 4;
+    for(size_t i = length - 1; i > 0; i--) {
+        output[i] = (character | 0x80) & 0xbf;
+        character >>= 6;
+    }
+    output[0] = character | FIRST_BYTE_MARKS[length];
+    return length;
+}
+
+/* Private: Decode the next character of a string, which may be an escape
+ * sequence.
+ *
+ * in - The position in the string, updated to the next character.
+ * end - The end of the string's raw text.
+ * output - The buffer for the decoded bytes, at least
+ *      MAX_DECODED_CHARACTER_LENGTH long.
+ *
+ * Returns the number of bytes stored in output.
+ */
+static size_t decodeCharacter(const char** in, const char* end, char* output) {
+    const char* position = *in;
+    if(*position != '\\') {
+        output[0] = *position;
+        *in = position + 1;
+        return 1;
+    }
+
+    position++;
+    if(position >= end) {
+        *in = end;
+        return 0;
+    }
+
+    size_t length = 1;
+    switch(*position) {
+        case 'b':
+            output[0] = '\b';
+            break;
+        case 'f':
+            output[0] = '\f';
+            break;
+        case 'n':
+            output[0] = '\n';
+            break;
+        case 'r':
+            output[0] = '\r';
+            break;
+        case 't':
+            output[0] = '\t';
+            break;
+        case 'u':
+            return decodeUnicodeEscape(position + 1, end, in, output);
+        default:
+            output[0] = *position;
+            break;
+    }
+    *in = position + 1;
+    return length;
+}
+
+static const char* tokenText(const JsonReader* reader, const JsonToken* token) {
+    return reader->json + token->start;
+}
+
+/* Private: Compare a string token with a NUL terminated string, decoding it as
+ * it goes.
+ */
+static bool matches(const JsonReader* reader, const JsonToken* token,
+        const char* value, bool ignoreCase) {
+    if(token == NULL || token->type != JSON_TOKEN_STRING) {
+        return false;
+    }
+
+    const char* in = tokenText(reader, token);
+    const char* end = in + token->length;
+    while(in < end) {
+        char decoded[MAX_DECODED_CHARACTER_LENGTH];
+        size_t length = decodeCharacter(&in, end, decoded);
+        for(size_t i = 0; i < length; i++, value++) {
+            if(*value == '\0') {
+                return false;
+            } else if(ignoreCase ?
+                    tolower((unsigned char)decoded[i]) !=
+                        tolower((unsigned char)*value) :
+                    decoded[i] != *value) {
+                return false;
+            }
+        }
+    }
+    return *value == '\0';
+}
+
+bool openxc::payload::jsonreader::parse(JsonReader* reader, const char* json) {
+    reader->json = json;
+    reader->count = 0;
+    reader->full = false;
+    if(strlen(json) > MAX_JSON_LENGTH) {
+        return false;
+    }
+    return parseValue(reader, skipWhitespace(json), 0) != NULL;
+}
+
+const JsonToken* openxc::payload::jsonreader::root(const JsonReader* reader) {
+    return reader->count > 0 ? &reader->tokens[0] : NULL;
+}
+
+const JsonToken* openxc::payload::jsonreader::find(const JsonReader* reader,
+        const JsonToken* object, const char* name) {
+    if(object == NULL || object->type != JSON_TOKEN_OBJECT) {
+        return NULL;
+    }
+
+    uint16_t index = object - reader->tokens + 1;
+    while(index < object->end) {
+        const JsonToken* value = &reader->tokens[index + 1];
+        if(matches(reader, &reader->tokens[index], name, true)) {
+            return value;
+        }
+        index = value->end;
+    }
+    return NULL;
+}
+
+double openxc::payload::jsonreader::number(const JsonReader* reader,
+        const JsonToken* token) {
+    double value = 0;
+    if(token != NULL && token->type == JSON_TOKEN_NUMBER) {
+        scanNumber(tokenText(reader, token), &value);
+    }
+    return value;
+}
+
+int openxc::payload::jsonreader::integer(const JsonReader* reader,
+        const JsonToken* token) {
+    if(token != NULL && token->type == JSON_TOKEN_TRUE) {
+        return 1;
+    }
+
+    double value = number(reader, token);
+    if(value != value) {
+        return 0;
+    } else if(value >= INT_MAX) {
+        return INT_MAX;
+    } else if(value <= INT_MIN) {
+        return INT_MIN;
+    }
+    return (int) value;
+}
+
+size_t openxc::payload::jsonreader::copyString(const JsonReader* reader,
+        const JsonToken* token, char* destination, size_t size) {
+    if(token == NULL || token->type != JSON_TOKEN_STRING || size == 0) {
+        return 0;
+    }
+
+    size_t length = 0;
+    const char* in = tokenText(reader, token);
+    const char* end = in + token->length;
+    while(in < end) {
+        char decoded[MAX_DECODED_CHARACTER_LENGTH];
+        size_t decodedLength = decodeCharacter(&in, end, decoded);
+        if(length + decodedLength >= size) {
+            break;
+        }
+        memcpy(&destination[length], decoded, decodedLength);
+        length += decodedLength;
+    }
+    destination[length] = '\0';
+    return length;
+}
+
+bool openxc::payload::jsonreader::stringEquals(const JsonReader* reader,
+        const JsonToken* token, const char* value) {
+    return matches(reader, token, value, false);
+}
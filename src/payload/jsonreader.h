@@ -0,0 +1,121 @@
+#ifndef __JSONREADER_H__
+#define __JSONREADER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Enough for the largest message in the OpenXC format, a diagnostic request
+// command with every field set, with room to spare for unknown fields.
+#define JSON_MAX_TOKENS 48
+// Messages are flat apart from the request in a diagnostic command.
+#define JSON_MAX_DEPTH 8
+
+typedef enum {
+    JSON_TOKEN_OBJECT,
+    JSON_TOKEN_ARRAY,
+    JSON_TOKEN_STRING,
+    JSON_TOKEN_NUMBER,
+    JSON_TOKEN_TRUE,
+    JSON_TOKEN_FALSE,
+    JSON_TOKEN_NULL,
+} JsonTokenType;
+
+/* Public: One value in a parsed JSON document. Tokens only point into the
+ * original text - nothing is copied or decoded until it's read.
+ *
+ * type - The type of the value.
+ * start - The offset of the value in the text. For strings this is the first
+ *      character after the opening quote.
+ * length - The length of the value in the text. For strings this is the raw,
+ *      still escaped length between the quotes.
+ * end - The index of the first token after this one that isn't part of it,
+ *      i.e. after all of an object or array's members.
+ */
+typedef struct {
+    JsonTokenType type;
+    uint16_t start;
+    uint16_t length;
+    uint16_t end;
+} JsonToken;
+
+/* Public: A JSON document tokenized in place.
+ *
+ * Object members are stored as a string token for the key immediately followed
+ * by the value's tokens.
+ *
+ * json - The NUL terminated text the tokens point into.
+ * tokens - The tokens for the document, the root value first.
+ * count - The number of tokens used.
+ * full - True if the last parse failed because the document had more than
+ *      JSON_MAX_TOKENS values.
+ */
+typedef struct {
+    const char* json;
+    JsonToken tokens[JSON_MAX_TOKENS];
+    uint16_t count;
+    bool full;
+} JsonReader;
+
+namespace openxc {
+namespace payload {
+namespace jsonreader {
+
+/* Public: Tokenize the first JSON value in a string, ignoring anything after
+ * it.
+ *
+ * This accepts the same input as cJSON_Parse - the value may be preceded by
+ * whitespace and followed by anything.
+ *
+ * json - The NUL terminated text to parse. It must outlive the reader and
+ *      isn't modified.
+ *
+ * Returns true if a complete value was parsed.
+ */
+bool parse(JsonReader* reader, const char* json);
+
+/* Public: Return the root value of the last document parsed.
+ */
+const JsonToken* root(const JsonReader* reader);
+
+/* Public: Find the value of an object's member, matching the name without
+ * regard to case like cJSON_GetObjectItem.
+ *
+ * Returns the value of the first member with the name, or NULL if there isn't
+ * one or the token isn't an object.
+ */
+const JsonToken* find(const JsonReader* reader, const JsonToken* object,
+        const char* name);
+
+/* Public: Return the value of a number token, calculated the same way as
+ * cJSON's valuedouble. Any other type of token is 0.
+ */
+double number(const JsonReader* reader, const JsonToken* token);
+
+/* Public: Return the value of a token as an int the same way as cJSON's
+ * valueint - numbers are truncated, true is 1 and anything else is 0.
+ */
+int integer(const JsonReader* reader, const JsonToken* token);
+
+/* Public: Decode a string token with its escapes into a buffer.
+ *
+ * destination - The buffer for the NUL terminated string. The string is cut
+ *      short if it doesn't fit.
+ * size - The size of the destination buffer.
+ *
+ * Returns the length of the decoded string, or 0 if the token isn't a string.
+ */
+size_t copyString(const JsonReader* reader, const JsonToken* token,
+        char* destination, size_t size);
+
+/* Public: Compare a string token with a NUL terminated string.
+ *
+ * Returns true if the token is a string that decodes to exactly the value.
+ */
+bool stringEquals(const JsonReader* reader, const JsonToken* token,
+        const char* value);
+
+} // namespace jsonreader
+} // namespace payload
+} // namespace openxc
+
+#endif // __JSONREADER_H__
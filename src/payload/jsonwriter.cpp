@@ -0,0 +1,397 @@
+#include "payload/jsonwriter.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+// Enough 32-bit words to hold the mantissa of the smallest subnormal double
+// scaled up by 10^331, the most formatNumber ever needs.
+#define BIGNUM_WORDS 40
+#define BILLION 1000000000
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+static const uint32_t POWERS_OF_10[] = {1, 10, 100, 1000, 10000, 100000,
+        1000000, 10000000, 100000000};
+
+/* Private: An unsigned integer large enough to scale any double to an integer
+ * without losing precision, least significant word first.
+ */
+typedef struct {
+    uint32_t words[BIGNUM_WORDS];
+    int size;
+} BigNum;
+
+static void bignumSet(BigNum* number, uint64_t value) {
+    number->words[0] = (uint32_t) value;
+    number->words[1] = (uint32_t) (value >> 32);
+    number->size = number->words[1] != 0 ? 2 : 1;
+}
+
+static void bignumMultiply(BigNum* number, uint32_t factor) {
+    uint64_t carry = 0;
+    for(int i = 0; i < number->size; i++) {
+        carry += (uint64_t) number->words[i] * factor;
+        number->words[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    if(carry != 0 && number->size < BIGNUM_WORDS) {
+        number->words[number->size++] = (uint32_t) carry;
+    }
+}
+
+static void bignumShiftLeft(BigNum* number, int bits) {
+    int wordShift = bits / 32;
+    if(wordShift > 0) {
+        memmove(&number->words[wordShift], &number->words[0],
+                number->size * sizeof(uint32_t));
+        memset(&number->words[0], 0, wordShift * sizeof(uint32_t));
+        number->size += wordShift;
+    }
+    if(bits % 32 != 0) {
+        bignumMultiply(number, (uint32_t)1 << (bits % 32));
+    }
+}
+
+/* Private: Divide the number in place, returning the remainder.
+ */
+static uint32_t bignumDivide(BigNum* number, uint32_t divisor) {
+    uint64_t remainder = 0;
+    for(int i = number->size - 1; i >= 0; i--) {
+        remainder = (remainder << 32) | number->words[i];
+        number->words[i] = (uint32_t) (remainder / divisor);
+        remainder %= divisor;
+    }
+    while(number->size > 1 && number->words[number->size - 1] == 0) {
+        number->size--;
+    }
+    return (uint32_t) remainder;
+}
+
+static bool bignumBit(BigNum* number, int bit) {
+    return bit / 32 < number->size &&
+            (number->words[bit / 32] >> (bit % 32)) & 1;
+}
+
+static bool bignumAnyBitsBelow(BigNum* number, int bit) {
+    for(int i = 0; i < bit / 32 && i < number->size; i++) {
+        if(number->words[i] != 0) {
+            return true;
+        }
+    }
+    return bit / 32 < number->size && bit % 32 != 0 &&
+            (number->words[bit / 32] & (((uint32_t)1 << (bit % 32)) - 1));
+}
+
+static void bignumShiftRight(BigNum* number, int bits) {
+    int wordShift = bits / 32;
+    int bitShift = bits % 32;
+    int size = number->size - wordShift;
+    for(int i = 0; i < size; i++) {
+        uint64_t word = number->words[i + wordShift];
+        if(i + wordShift + 1 < number->size) {
+            word |= (uint64_t) number->words[i + wordShift + 1] << 32;
+        }
+        number->words[i] = (uint32_t) (word >> bitShift);
+    }
+    number->size = size > 1 ? size : 1;
+    if(size < 1) {
+        number->words[0] = 0;
+    }
+}
+
+/* Private: Track how a value that's been divided down to an integer compares
+ * to the halfway point between it and the next integer, so it can be rounded
+ * half to even like printf does.
+ *
+ * Every divisor used is even, so the most significant remainder decides it
+ * unless it's exactly half its divisor, when any lower remainder breaks the
+ * tie.
+ */
+typedef struct {
+    int comparison;
+    bool inexact;
+} Rounding;
+
+static void recordRemainder(Rounding* rounding, bool aboveHalf, bool exactlyHalf,
+        bool nonzero) {
+    if(exactlyHalf) {
+        rounding->comparison = rounding->inexact ? 1 : 0;
+    } else {
+        rounding->comparison = aboveHalf ? 1 : -1;
+    }
+    rounding->inexact = rounding->inexact || nonzero;
+}
+
+/* Private: Return value * 10^exponent rounded half to even, exactly.
+ *
+ * value - A positive, finite number.
+ * exponent - The power of 10 to scale by. The result must fit in 64 bits.
+ */
+static uint64_t roundScaled(double value, int exponent) {
+    int binaryExponent;
+    uint64_t mantissa = (uint64_t) ldexp(frexp(value, &binaryExponent), 53);
+    binaryExponent -= 53;
+
+    BigNum number;
+    bignumSet(&number, mantissa);
+    if(binaryExponent > 0) {
+        bignumShiftLeft(&number, binaryExponent);
+    }
+    for(int i = exponent; i > 0; i -= 9) {
+        bignumMultiply(&number, i >= 9 ? BILLION : POWERS_OF_10[i]);
+    }
+
+    Rounding rounding = {-1, false};
+    if(binaryExponent < 0) {
+        int bits = -binaryExponent;
+        bool half = bignumBit(&number, bits - 1);
+        bool below = bignumAnyBitsBelow(&number, bits - 1);
+        recordRemainder(&rounding, half && below, half && !below,
+                half || below);
+        bignumShiftRight(&number, bits);
+    }
+    for(int i = -exponent; i > 0; i -= 9) {
+        uint32_t divisor = i >= 9 ? BILLION : POWERS_OF_10[i];
+        uint32_t remainder = bignumDivide(&number, divisor);
+        recordRemainder(&rounding, remainder > divisor / 2,
+                remainder == divisor / 2, remainder != 0);
+    }
+
+    uint64_t result = number.words[0];
+    if(number.size > 1) {
+        result |= (uint64_t) number.words[1] << 32;
+    }
+    if(rounding.comparison > 0 || (rounding.comparison == 0 && result & 1)) {
+        result++;
+    }
+    return result;
+}
+
+static size_t formatDigits(uint64_t value, int minimumDigits, char* buffer) {
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while(value != 0 || count < minimumDigits);
+
+    for(int i = 0; i < count; i++) {
+        buffer[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+/* Private: Format a value with %.0f.
+ */
+static size_t formatIntegral(double value, char* buffer) {
+    if(value != floor(value)) {
+        return formatDigits(roundScaled(value, 0), 1, buffer);
+    } else if(value < 18446744073709551616.0) {
+        return formatDigits((uint64_t) value, 1, buffer);
+    }
+
+    int binaryExponent;
+    uint64_t mantissa = (uint64_t) ldexp(frexp(value, &binaryExponent), 53);
+    BigNum number;
+    bignumSet(&number, mantissa);
+    bignumShiftLeft(&number, binaryExponent - 53);
+
+    uint32_t chunks[8];
+    int chunkCount = 0;
+    while(number.size > 1 || number.words[0] >= BILLION) {
+        chunks[chunkCount++] = bignumDivide(&number, BILLION);
+    }
+
+    size_t length = formatDigits(number.words[0], 1, buffer);
+    while(chunkCount > 0) {
+        length += formatDigits(chunks[--chunkCount], 9, &buffer[length]);
+    }
+    return length;
+}
+
+static size_t formatExponential(double value, char* buffer) {
+    int exponent = (int) floor(log10(value));
+    uint64_t digits = roundScaled(value, 6 - exponent);
+    // log10 can be off by one right at a power of 10, and rounding can carry
+    // into another digit
+    while(digits >= 10000000) {
+        digits = roundScaled(value, 6 - ++exponent);
+    }
+    while(digits < 1000000) {
+        digits = roundScaled(value, 6 - --exponent);
+    }
+
+    size_t length = formatDigits(digits / 1000000, 1, buffer);
+    buffer[length++] = '.';
+    length += formatDigits(digits % 1000000, 6, &buffer[length]);
+    buffer[length++] = 'e';
+    buffer[length++] = exponent < 0 ? '-' : '+';
+    length += formatDigits(exponent < 0 ? -exponent : exponent, 2,
+            &buffer[length]);
+    return length;
+}
+
+static size_t formatFixed(double value, char* buffer) {
+    uint64_t digits = roundScaled(value, 6);
+    size_t length = formatDigits(digits / 1000000, 1, buffer);
+    buffer[length++] = '.';
+    length += formatDigits(digits % 1000000, 6, &buffer[length]);
+    return length;
+}
+
+size_t openxc::payload::jsonwriter::formatNumber(double value, char* buffer) {
+    size_t length = 0;
+    if(value >= INT_MIN && value <= INT_MAX &&
+            fabs((double)(int) value - value) <= DBL_EPSILON) {
+        int integer = (int) value;
+        if(integer < 0) {
+            buffer[length++] = '-';
+        }
+        length += formatDigits(integer < 0 ? -(int64_t) integer : integer, 1,
+                &buffer[length]);
+    } else {
+        if(signbit(value)) {
+            buffer[length++] = '-';
+        }
+
+        double magnitude = fabs(value);
+        if(isnan(value)) {
+            memcpy(&buffer[length], "nan", 3);
+            length += 3;
+        } else if(isinf(value)) {
+            memcpy(&buffer[length], "inf", 3);
+            length += 3;
+        } else if(fabs(floor(value) - value) <= DBL_EPSILON &&
+                magnitude < 1.0e60) {
+            length += formatIntegral(magnitude, &buffer[length]);
+        } else if(magnitude < 1.0e-6 || magnitude > 1.0e9) {
+            length += formatExponential(magnitude, &buffer[length]);
+        } else {
+            length += formatFixed(magnitude, &buffer[length]);
+        }
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+static void put(JsonWriter* writer, char character) {
+    if(writer->position < writer->length) {
+        writer->buffer[writer->position] = character;
+    }
+    writer->position++;
+}
+
+static void putRaw(JsonWriter* writer, const char* value, size_t length) {
+    for(size_t i = 0; i < length; i++) {
+        put(writer, value[i]);
+    }
+}
+
+/* Private: Write a quoted string, escaped the same way cJSON does.
+ */
+static void putString(JsonWriter* writer, const char* value) {
+    put(writer, '"');
+    for(const char* character = value; *character != '\0'; character++) {
+        unsigned char token = *character;
+        if(token > 31 && token != '"' && token != '\\') {
+            put(writer, token);
+            continue;
+        }
+
+        put(writer, '\\');
+        switch(token) {
+            case '\\':
+            case '"':
+                put(writer, token);
+                break;
+            case '\b':
+                put(writer, 'b');
+                break;
+            case '\f':
+                put(writer, 'f');
+                break;
+            case '\n':
+                put(writer, 'n');
+                break;
+            case '\r':
+                put(writer, 'r');
+                break;
+            case '\t':
+                put(writer, 't');
+                break;
+            default:
+                putRaw(writer, "u00", 3);
+                put(writer, HEX_DIGITS[token >> 4]);
+                put(writer, HEX_DIGITS[token & 0xf]);
+                break;
+        }
+    }
+    put(writer, '"');
+}
+
+static void putName(JsonWriter* writer, const char* name) {
+    if(!writer->empty) {
+        put(writer, ',');
+    }
+    writer->empty = false;
+    putString(writer, name);
+    put(writer, ':');
+}
+
+void openxc::payload::jsonwriter::initialize(JsonWriter* writer,
+        uint8_t buffer[], size_t length) {
+    writer->buffer = buffer;
+    writer->length = length;
+    writer->position = 0;
+    writer->empty = true;
+    put(writer, '{');
+}
+
+void openxc::payload::jsonwriter::addNumber(JsonWriter* writer,
+        const char* name, double value) {
+    char formatted[JSON_NUMBER_MAX_LENGTH + 1];
+    size_t length = formatNumber(value, formatted);
+    putName(writer, name);
+    putRaw(writer, formatted, length);
+}
+
+void openxc::payload::jsonwriter::addBool(JsonWriter* writer, const char* name,
+        bool value) {
+    putName(writer, name);
+    if(value) {
+        putRaw(writer, "true", 4);
+    } else {
+        putRaw(writer, "false", 5);
+    }
+}
+
+void openxc::payload::jsonwriter::addString(JsonWriter* writer,
+        const char* name, const char* value) {
+    putName(writer, name);
+    putString(writer, value);
+}
+
+void openxc::payload::jsonwriter::addHexString(JsonWriter* writer,
+        const char* name, const uint8_t* bytes, size_t size,
+        size_t maxLength) {
+    putName(writer, name);
+    put(writer, '"');
+    putRaw(writer, "0x", 2);
+    size_t length = 2;
+    for(size_t i = 0; i < size && length < maxLength; i++) {
+        put(writer, HEX_DIGITS[bytes[i] >> 4]);
+        if(++length < maxLength) {
+            put(writer, HEX_DIGITS[bytes[i] & 0xf]);
+            ++length;
+        }
+    }
+    put(writer, '"');
+}
+
+size_t openxc::payload::jsonwriter::finish(JsonWriter* writer) {
+    put(writer, '}');
+    put(writer, '\0');
+    return writer->position < writer->length ?
+            writer->position : writer->length;
+}
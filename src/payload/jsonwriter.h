@@ -0,0 +1,88 @@
+#ifndef __JSONWRITER_H__
+#define __JSONWRITER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The longest string formatNumber will write, not counting the NUL - the
+// longest is a %.0f formatted integer just under 1e60.
+#define JSON_NUMBER_MAX_LENGTH 64
+
+/* Public: The state of a JSON object being written directly into a caller's
+ * buffer.
+ *
+ * The output is exactly what cJSON_PrintUnformatted would produce for the
+ * same object, so a message serializes to the same bytes whichever one is
+ * used.
+ *
+ * buffer - The buffer to write into.
+ * length - The size of the buffer.
+ * position - The number of bytes in the output so far. This keeps counting if
+ *      the buffer fills up, but nothing more is written to it.
+ * empty - True if no fields have been added to the open object yet.
+ */
+typedef struct {
+    uint8_t* buffer;
+    size_t length;
+    size_t position;
+    bool empty;
+} JsonWriter;
+
+namespace openxc {
+namespace payload {
+namespace jsonwriter {
+
+/* Public: Start writing a new JSON object at the beginning of the buffer.
+ */
+void initialize(JsonWriter* writer, uint8_t buffer[], size_t length);
+
+/* Public: Add a number field to the object.
+ *
+ * The number is formatted the same way cJSON formats it - see formatNumber.
+ */
+void addNumber(JsonWriter* writer, const char* name, double value);
+
+/* Public: Add a true or false field to the object.
+ */
+void addBool(JsonWriter* writer, const char* name, bool value);
+
+/* Public: Add a string field to the object, escaping any characters JSON
+ * requires.
+ */
+void addString(JsonWriter* writer, const char* name, const char* value);
+
+/* Public: Add a string field with the bytes encoded as a "0x" prefixed hex
+ * string.
+ *
+ * maxLength - The most characters to write for the value, including the "0x"
+ *      prefix. The hex string is cut short if it would be any longer.
+ */
+void addHexString(JsonWriter* writer, const char* name, const uint8_t* bytes,
+        size_t size, size_t maxLength);
+
+/* Public: Close the object and NUL terminate it.
+ *
+ * Returns the number of bytes in the output including the NUL, or the length
+ * of the buffer if the output didn't fit (in which case it's been truncated
+ * without a NUL, as cJSON output copied into the same buffer would be).
+ */
+size_t finish(JsonWriter* writer);
+
+/* Public: Format a number the way cJSON does - as an integer if it's within
+ * the range of an int, then with %.0f, %e or %f depending on its size. The
+ * digits are calculated exactly, so the result matches printf to the byte
+ * without pulling printf in.
+ *
+ * value - The number to format.
+ * buffer - The buffer to store the NUL terminated result, at least
+ *      JSON_NUMBER_MAX_LENGTH + 1 bytes long.
+ *
+ * Returns the length of the formatted number, not counting the NUL.
+ */
+size_t formatNumber(double value, char* buffer);
+
+} // namespace jsonwriter
+} // namespace payload
+} // namespace openxc
+
+#endif // __JSONWRITER_H__
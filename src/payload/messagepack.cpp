@@ -0,0 +1,868 @@
+#include "payload/messagepack.h"
+
+#include <cmp.h>
+#include <math.h>
+#include <string.h>
+
+#include "payload/json.h"
+#include "payload/payload.h"
+#include "util/log.h"
+
+namespace json = openxc::payload::json;
+
+using openxc::util::log::debug;
+
+// Long enough for every key in the OpenXC message format.
+#define MAX_KEY_LENGTH 32
+// Messages are flat apart from the request in a diagnostic command - anything
+// nested deeper than this is skipped as malformed rather than recursing
+// without bound.
+#define MAX_NESTING_DEPTH 4
+
+static const openxc_ControlCommand_Type COMMAND_TYPES[] = {
+    openxc_ControlCommand_Type_VERSION,
+    openxc_ControlCommand_Type_DEVICE_ID,
+    openxc_ControlCommand_Type_GET_VIN,
+    openxc_ControlCommand_Type_PLATFORM,
+    openxc_ControlCommand_Type_DIAGNOSTIC,
+    openxc_ControlCommand_Type_PASSTHROUGH,
+    openxc_ControlCommand_Type_ACCEPTANCE_FILTER_BYPASS,
+    openxc_ControlCommand_Type_PAYLOAD_FORMAT,
+    openxc_ControlCommand_Type_PREDEFINED_OBD2_REQUESTS,
+    openxc_ControlCommand_Type_MODEM_CONFIGURATION,
+    openxc_ControlCommand_Type_RTC_CONFIGURATION,
+    openxc_ControlCommand_Type_SD_MOUNT_STATUS,
+};
+
+/* Private: The payload a cmp context is reading from or writing to.
+ *
+ * truncated - True if a read went past the end of the payload, i.e. the
+ *      message hasn't been completely received yet.
+ */
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t position;
+    bool truncated;
+} MessagePackBuffer;
+
+static bool readBuffer(cmp_ctx_t* context, void* data, size_t limit) {
+    MessagePackBuffer* buffer = (MessagePackBuffer*) context->buf;
+    if(limit > buffer->length - buffer->position) {
+        buffer->truncated = true;
+        return false;
+    }
+    memcpy(data, &buffer->data[buffer->position], limit);
+    buffer->position += limit;
+    return true;
+}
+
+static size_t writeBuffer(cmp_ctx_t* context, const void* data, size_t count) {
+    MessagePackBuffer* buffer = (MessagePackBuffer*) context->buf;
+    if(count > buffer->length - buffer->position) {
+        return 0;
+    }
+    memcpy(&buffer->data[buffer->position], data, count);
+    buffer->position += count;
+    return count;
+}
+
+static void initializeContext(cmp_ctx_t* context, MessagePackBuffer* buffer,
+        uint8_t payload[], size_t length) {
+    buffer->data = payload;
+    buffer->length = length;
+    buffer->position = 0;
+    buffer->truncated = false;
+
+    // cmp_init gained a skip callback in later releases of cmp, so set up the
+    // context directly - nothing here uses cmp's own skip functions.
+    memset(context, 0, sizeof(*context));
+    context->buf = buffer;
+    context->read = readBuffer;
+    context->write = writeBuffer;
+}
+
+static bool writeString(cmp_ctx_t* context, const char* value) {
+    return cmp_write_str(context, value, strlen(value));
+}
+
+/* Private: Write a number with the smallest MessagePack type that holds it
+ * exactly - most signal values are integers or came from a float.
+ */
+static bool writeNumber(cmp_ctx_t* context, double value) {
+    if(value >= -9.2e18 && value <= 1.8e19 && value == floor(value)) {
+        if(value < 0) {
+            return cmp_write_integer(context, (int64_t) value);
+        }
+        return cmp_write_uinteger(context, (uint64_t) value);
+    } else if((double)(float) value == value) {
+        return cmp_write_float(context, (float) value);
+    }
+    return cmp_write_double(context, value);
+}
+
+static bool writeNumberField(cmp_ctx_t* context, const char* name,
+        double value) {
+    return writeString(context, name) && writeNumber(context, value);
+}
+
+static bool writeBoolField(cmp_ctx_t* context, const char* name, bool value) {
+    return writeString(context, name) && cmp_write_bool(context, value);
+}
+
+static bool writeStringField(cmp_ctx_t* context, const char* name,
+        const char* value) {
+    return writeString(context, name) && writeString(context, value);
+}
+
+static bool writeBytesField(cmp_ctx_t* context, const char* name,
+        const uint8_t* bytes, size_t size) {
+    return writeString(context, name) && cmp_write_bin(context, bytes, size);
+}
+
+static bool hasValue(openxc_DynamicField* field) {
+    return field->type == openxc_DynamicField_Type_NUM ||
+            field->type == openxc_DynamicField_Type_BOOL ||
+            field->type == openxc_DynamicField_Type_STRING;
+}
+
+static bool writeDynamicField(cmp_ctx_t* context, const char* name,
+        openxc_DynamicField* field) {
+    if(field->type == openxc_DynamicField_Type_NUM) {
+        return writeNumberField(context, name, field->numeric_value);
+    } else if(field->type == openxc_DynamicField_Type_BOOL) {
+        return writeBoolField(context, name, field->boolean_value);
+    } else if(field->type == openxc_DynamicField_Type_STRING) {
+        return writeStringField(context, name, field->string_value);
+    }
+    return true;
+}
+
+static uint32_t simpleFieldCount(openxc_VehicleMessage* message) {
+    return 1 + hasValue(&message->simple_message.value) +
+            hasValue(&message->simple_message.event);
+}
+
+static bool serializeSimple(cmp_ctx_t* context,
+        openxc_VehicleMessage* message) {
+    return writeStringField(context, json::NAME_FIELD_NAME,
+                message->simple_message.name) &&
+            writeDynamicField(context, json::VALUE_FIELD_NAME,
+                &message->simple_message.value) &&
+            writeDynamicField(context, json::EVENT_FIELD_NAME,
+                &message->simple_message.event);
+}
+
+static uint32_t canFieldCount(openxc_VehicleMessage* message) {
+    return 3 + (message->can_message.frame_format !=
+            openxc_CanMessage_FrameFormat_UNUSED);
+}
+
+static bool serializeCan(cmp_ctx_t* context, openxc_VehicleMessage* message) {
+    bool status = writeNumberField(context, json::BUS_FIELD_NAME,
+                message->can_message.bus) &&
+            writeNumberField(context, json::ID_FIELD_NAME,
+                message->can_message.id) &&
+            writeBytesField(context, json::DATA_FIELD_NAME,
+                message->can_message.data.bytes,
+                message->can_message.data.size);
+
+    if(status && message->can_message.frame_format !=
+            openxc_CanMessage_FrameFormat_UNUSED) {
+        status = writeStringField(context, json::FRAME_FORMAT_FIELD_NAME,
+                message->can_message.frame_format ==
+                        openxc_CanMessage_FrameFormat_STANDARD ?
+                    json::FRAME_FORMAT_STANDARD_NAME :
+                    json::FRAME_FORMAT_EXTENDED_NAME);
+    }
+    return status;
+}
+
+static uint32_t diagnosticFieldCount(openxc_VehicleMessage* message) {
+    openxc_DiagnosticResponse* response = &message->diagnostic_response;
+    return 5 + (response->total_size > 0 ? 2 : 0) +
+            (response->negative_response_code != 0) +
+            (response->value.type != openxc_DynamicField_Type_UNUSED ||
+                response->payload.size > 0);
+}
+
+static bool serializeDiagnostic(cmp_ctx_t* context,
+        openxc_VehicleMessage* message) {
+    openxc_DiagnosticResponse* response = &message->diagnostic_response;
+    bool status = writeNumberField(context, json::BUS_FIELD_NAME,
+                response->bus) &&
+            writeNumberField(context, json::ID_FIELD_NAME,
+                response->message_id) &&
+            writeNumberField(context, json::DIAGNOSTIC_MODE_FIELD_NAME,
+                response->mode) &&
+            writeBoolField(context, json::DIAGNOSTIC_SUCCESS_FIELD_NAME,
+                response->success) &&
+            writeNumberField(context, json::DIAGNOSTIC_PID_FIELD_NAME,
+                response->pid);
+
+    if(status && response->total_size > 0) {
+        status = writeNumberField(context, json::DIAGNOSTIC_FRAME_FIELD_NAME,
+                    response->frame) &&
+                writeNumberField(context,
+                    json::DIAGNOSTIC_TOTAL_SIZE_FIELD_NAME,
+                    response->total_size);
+    }
+
+    if(status && response->negative_response_code != 0) {
+        status = writeNumberField(context, json::DIAGNOSTIC_NRC_FIELD_NAME,
+                response->negative_response_code);
+    }
+
+    if(status && response->value.type != openxc_DynamicField_Type_UNUSED) {
+        if(response->value.type == openxc_DynamicField_Type_NUM) {
+            status = writeNumberField(context,
+                    json::DIAGNOSTIC_VALUE_FIELD_NAME,
+                    response->value.numeric_value);
+        } else {
+            status = writeStringField(context,
+                    json::DIAGNOSTIC_VALUE_FIELD_NAME,
+                    response->value.string_value);
+        }
+    } else if(status && response->payload.size > 0) {
+        status = writeBytesField(context, json::DIAGNOSTIC_PAYLOAD_FIELD_NAME,
+                response->payload.bytes, response->payload.size);
+    }
+    return status;
+}
+
+static bool serializeCommandResponse(cmp_ctx_t* context,
+        openxc_VehicleMessage* message) {
+    return writeStringField(context, json::COMMAND_RESPONSE_FIELD_NAME,
+                json::commandName(message->command_response.type)) &&
+            writeStringField(context,
+                json::COMMAND_RESPONSE_MESSAGE_FIELD_NAME,
+                message->command_response.message) &&
+            writeBoolField(context,
+                json::COMMAND_RESPONSE_STATUS_FIELD_NAME,
+                message->command_response.status);
+}
+
+int openxc::payload::messagepack::serialize(openxc_VehicleMessage* message,
+        uint8_t payload[], size_t length) {
+    if(message->type == openxc_VehicleMessage_Type_COMMAND_RESPONSE &&
+            json::commandName(message->command_response.type) == NULL) {
+        debug("Unrecognized command response type -- not sending");
+        return 0;
+    }
+
+    cmp_ctx_t context;
+    MessagePackBuffer buffer;
+    initializeContext(&context, &buffer, payload, length);
+
+    uint32_t fieldCount = message->timestamp != 0 ? 1 : 0;
+    if(message->type == openxc_VehicleMessage_Type_SIMPLE) {
+        fieldCount += simpleFieldCount(message);
+    } else if(message->type == openxc_VehicleMessage_Type_CAN) {
+        fieldCount += canFieldCount(message);
+    } else if(message->type == openxc_VehicleMessage_Type_DIAGNOSTIC) {
+        fieldCount += diagnosticFieldCount(message);
+    } else if(message->type == openxc_VehicleMessage_Type_COMMAND_RESPONSE) {
+        fieldCount += 3;
+    } else {
+        debug("Unrecognized message type -- not sending");
+    }
+
+    bool status = cmp_write_map(&context, fieldCount);
+    if(status && message->timestamp != 0) {
+        status = writeString(&context, "timestamp") &&
+                cmp_write_uinteger(&context, message->timestamp);
+    }
+
+    if(status) {
+        if(message->type == openxc_VehicleMessage_Type_SIMPLE) {
+            status = serializeSimple(&context, message);
+        } else if(message->type == openxc_VehicleMessage_Type_CAN) {
+            status = serializeCan(&context, message);
+        } else if(message->type == openxc_VehicleMessage_Type_DIAGNOSTIC) {
+            status = serializeDiagnostic(&context, message);
+        } else if(message->type == openxc_VehicleMessage_Type_COMMAND_RESPONSE) {
+            status = serializeCommandResponse(&context, message);
+        }
+    }
+
+    if(!status) {
+        debug("Error encoding MessagePack: %s", cmp_strerror(&context));
+        return 0;
+    }
+    return buffer.position;
+}
+
+int openxc::payload::messagepack::serializeBatch(const uint8_t messages[],
+        size_t messagesLength, int messageCount, uint8_t payload[],
+        size_t length) {
+    cmp_ctx_t context;
+    MessagePackBuffer buffer;
+    initializeContext(&context, &buffer, payload, length);
+
+    // The messages are already complete MessagePack objects, so they're
+    // copied in as the elements of the array.
+    if(messageCount == 0 || !cmp_write_map(&context, 2) ||
+            !writeString(&context, "batch") ||
+            !cmp_write_uinteger(&context, PAYLOAD_BATCH_VERSION) ||
+            !writeString(&context, "messages") ||
+            !cmp_write_array(&context, messageCount) ||
+            writeBuffer(&context, messages, messagesLength) != messagesLength) {
+        debug("Error encoding MessagePack batch");
+        return 0;
+    }
+    return buffer.position;
+}
+
+static bool skipBytes(cmp_ctx_t* context, size_t count) {
+    MessagePackBuffer* buffer = (MessagePackBuffer*) context->buf;
+    if(count > buffer->length - buffer->position) {
+        buffer->truncated = true;
+        return false;
+    }
+    buffer->position += count;
+    return true;
+}
+
+static bool skipObject(cmp_ctx_t* context, int depth);
+
+/* Private: Skip whatever follows an object's header - the bytes of a string,
+ * bin or ext object, or the elements of an array or map.
+ */
+static bool skipObjectBody(cmp_ctx_t* context, cmp_object_t* object,
+        int depth) {
+    uint32_t elements = 0;
+    switch(object->type) {
+        case CMP_TYPE_FIXSTR:
+        case CMP_TYPE_STR8:
+        case CMP_TYPE_STR16:
+        case CMP_TYPE_STR32:
+            return skipBytes(context, object->as.str_size);
+        case CMP_TYPE_BIN8:
+        case CMP_TYPE_BIN16:
+        case CMP_TYPE_BIN32:
+            return skipBytes(context, object->as.bin_size);
+        case CMP_TYPE_FIXEXT1:
+        case CMP_TYPE_FIXEXT2:
+        case CMP_TYPE_FIXEXT4:
+        case CMP_TYPE_FIXEXT8:
+        case CMP_TYPE_FIXEXT16:
+        case CMP_TYPE_EXT8:
+        case CMP_TYPE_EXT16:
+        case CMP_TYPE_EXT32:
+            return skipBytes(context, object->as.ext.size);
+        case CMP_TYPE_FIXARRAY:
+        case CMP_TYPE_ARRAY16:
+        case CMP_TYPE_ARRAY32:
+            elements = object->as.array_size;
+            break;
+        case CMP_TYPE_FIXMAP:
+        case CMP_TYPE_MAP16:
+        case CMP_TYPE_MAP32:
+            elements = object->as.map_size * 2;
+            break;
+        default:
+            return true;
+    }
+
+    if(depth >= MAX_NESTING_DEPTH) {
+        debug("MessagePack object is nested too deeply");
+        return false;
+    }
+
+    for(uint32_t i = 0; i < elements; i++) {
+        if(!skipObject(context, depth + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool skipObject(cmp_ctx_t* context, int depth) {
+    cmp_object_t object;
+    return cmp_read_object(context, &object) &&
+            skipObjectBody(context, &object, depth);
+}
+
+static bool isMap(cmp_object_t* object) {
+    return object->type == CMP_TYPE_FIXMAP || object->type == CMP_TYPE_MAP16 ||
+            object->type == CMP_TYPE_MAP32;
+}
+
+static bool isString(cmp_object_t* object) {
+    return object->type == CMP_TYPE_FIXSTR || object->type == CMP_TYPE_STR8 ||
+            object->type == CMP_TYPE_STR16 || object->type == CMP_TYPE_STR32;
+}
+
+/* Private: Read the body of a string object into a NUL terminated buffer,
+ * dropping anything that doesn't fit.
+ */
+static bool readStringBody(cmp_ctx_t* context, cmp_object_t* object,
+        char* destination, size_t size) {
+    size_t length = object->as.str_size;
+    size_t copied = length < size - 1 ? length : size - 1;
+    if(!context->read(context, destination, copied)) {
+        return false;
+    }
+    destination[copied] = '\0';
+    return skipBytes(context, length - copied);
+}
+
+/* Private: Read a string, or skip the object if it's anything else.
+ *
+ * Returns true if a string was read.
+ */
+static bool readString(cmp_ctx_t* context, char* destination, size_t size) {
+    cmp_object_t object;
+    if(!cmp_read_object(context, &object)) {
+        return false;
+    }
+    if(isString(&object)) {
+        return readStringBody(context, &object, destination, size);
+    }
+    skipObjectBody(context, &object, 0);
+    return false;
+}
+
+static bool objectNumber(cmp_object_t* object, double* value) {
+    switch(object->type) {
+        case CMP_TYPE_POSITIVE_FIXNUM:
+        case CMP_TYPE_UINT8:
+            *value = object->as.u8;
+            break;
+        case CMP_TYPE_UINT16:
+            *value = object->as.u16;
+            break;
+        case CMP_TYPE_UINT32:
+            *value = object->as.u32;
+            break;
+        case CMP_TYPE_UINT64:
+            *value = object->as.u64;
+            break;
+        case CMP_TYPE_NEGATIVE_FIXNUM:
+        case CMP_TYPE_SINT8:
+            *value = object->as.s8;
+            break;
+        case CMP_TYPE_SINT16:
+            *value = object->as.s16;
+            break;
+        case CMP_TYPE_SINT32:
+            *value = object->as.s32;
+            break;
+        case CMP_TYPE_SINT64:
+            *value = object->as.s64;
+            break;
+        case CMP_TYPE_FLOAT:
+            *value = object->as.flt;
+            break;
+        case CMP_TYPE_DOUBLE:
+            *value = object->as.dbl;
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+/* Private: Read a number of any MessagePack type, or skip the object if it's
+ * anything else.
+ *
+ * Returns true if a number was read.
+ */
+static bool readNumber(cmp_ctx_t* context, double* value) {
+    cmp_object_t object;
+    if(!cmp_read_object(context, &object)) {
+        return false;
+    }
+    if(objectNumber(&object, value)) {
+        return true;
+    }
+    skipObjectBody(context, &object, 0);
+    return false;
+}
+
+/* Private: Read a boolean, accepting a number for it as JSON does.
+ */
+static bool readBool(cmp_ctx_t* context, bool* value) {
+    cmp_object_t object;
+    double number;
+    if(!cmp_read_object(context, &object)) {
+        return false;
+    }
+    if(object.type == CMP_TYPE_BOOLEAN) {
+        *value = object.as.boolean;
+        return true;
+    } else if(objectNumber(&object, &number)) {
+        *value = number != 0;
+        return true;
+    }
+    skipObjectBody(context, &object, 0);
+    return false;
+}
+
+static int hexValue(char character) {
+    if(character >= '0' && character <= '9') {
+        return character - '0';
+    } else if(character >= 'a' && character <= 'f') {
+        return character - 'a' + 10;
+    } else if(character >= 'A' && character <= 'F') {
+        return character - 'A' + 10;
+    }
+    return 0;
+}
+
+/* Private: Read a byte array from either a bin object or a "0x" prefixed hex
+ * string, or skip the object if it's anything else.
+ *
+ * Returns the number of bytes stored in destination.
+ */
+static size_t readBytes(cmp_ctx_t* context, uint8_t* destination,
+        size_t size) {
+    cmp_object_t object;
+    if(!cmp_read_object(context, &object)) {
+        return 0;
+    }
+
+    if(object.type == CMP_TYPE_BIN8 || object.type == CMP_TYPE_BIN16 ||
+            object.type == CMP_TYPE_BIN32) {
+        size_t copied = object.as.bin_size < size ? object.as.bin_size : size;
+        if(!context->read(context, destination, copied) ||
+                !skipBytes(context, object.as.bin_size - copied)) {
+            return 0;
+        }
+        return copied;
+    } else if(isString(&object)) {
+        // Decode the hex string a pair of digits at a time rather than
+        // buffering all of it
+        uint32_t remaining = object.as.str_size;
+        size_t count = 0;
+        bool first = true;
+        char digits[2];
+        while(remaining >= 2) {
+            if(!context->read(context, digits, sizeof(digits))) {
+                return 0;
+            }
+            remaining -= 2;
+
+            if(first && digits[0] == '0' && digits[1] == 'x') {
+                first = false;
+                continue;
+            }
+            first = false;
+            if(count < size) {
+                destination[count++] = hexValue(digits[0]) << 4 |
+                        hexValue(digits[1]);
+            }
+        }
+        return skipBytes(context, remaining) ? count : 0;
+    }
+
+    skipObjectBody(context, &object, 0);
+    return 0;
+}
+
+static void readDynamicField(cmp_ctx_t* context, openxc_DynamicField* field) {
+    cmp_object_t object;
+    if(!cmp_read_object(context, &object)) {
+        return;
+    }
+
+    if(isString(&object)) {
+        field->type = openxc_DynamicField_Type_STRING;
+        readStringBody(context, &object, field->string_value,
+                sizeof(field->string_value));
+    } else if(object.type == CMP_TYPE_BOOLEAN) {
+        field->type = openxc_DynamicField_Type_BOOL;
+        field->boolean_value = object.as.boolean;
+    } else if(objectNumber(&object, &field->numeric_value)) {
+        field->type = openxc_DynamicField_Type_NUM;
+    } else {
+        debug("Unsupported type in value field: %d", object.type);
+        skipObjectBody(context, &object, 0);
+    }
+}
+
+static void readDiagnosticRequest(cmp_ctx_t* context,
+        openxc_DiagnosticRequest* request) {
+    cmp_object_t object;
+    if(!cmp_read_object(context, &object)) {
+        return;
+    }
+    if(!isMap(&object)) {
+        skipObjectBody(context, &object, 0);
+        return;
+    }
+
+    for(uint32_t i = 0; i < object.as.map_size; i++) {
+        char key[MAX_KEY_LENGTH];
+        double number;
+        char decodedType[8];
+        if(!readString(context, key, sizeof(key))) {
+            skipObject(context, 0);
+        } else if(!strcmp(key, json::BUS_FIELD_NAME)) {
+            if(readNumber(context, &number)) {
+                request->bus = number;
+            }
+        } else if(!strcmp(key, json::DIAGNOSTIC_MODE_FIELD_NAME)) {
+            if(readNumber(context, &number)) {
+                request->mode = number;
+            }
+        } else if(!strcmp(key, json::ID_FIELD_NAME)) {
+            if(readNumber(context, &number)) {
+                request->message_id = number;
+            }
+        } else if(!strcmp(key, json::DIAGNOSTIC_PID_FIELD_NAME)) {
+            if(readNumber(context, &number)) {
+                request->pid = number;
+            }
+        } else if(!strcmp(key, json::DIAGNOSTIC_PAYLOAD_FIELD_NAME)) {
+            request->payload.size = readBytes(context, request->payload.bytes,
+                    sizeof(request->payload.bytes));
+        } else if(!strcmp(key, "multiple_responses")) {
+            readBool(context, &request->multiple_responses);
+        } else if(!strcmp(key, "frequency")) {
+            readNumber(context, &request->frequency);
+        } else if(!strcmp(key, "decoded_type")) {
+            if(readString(context, decodedType, sizeof(decodedType))) {
+                if(!strcmp(decodedType, "obd2")) {
+                    request->decoded_type =
+                            openxc_DiagnosticRequest_DecodedType_OBD2;
+                } else if(!strcmp(decodedType, "none")) {
+                    request->decoded_type =
+                            openxc_DiagnosticRequest_DecodedType_NONE;
+                }
+            }
+        } else if(!strcmp(key, json::NAME_FIELD_NAME)) {
+            readString(context, request->name, sizeof(request->name));
+        } else {
+            skipObject(context, 0);
+        }
+    }
+}
+
+static void readPayloadFormat(cmp_ctx_t* context,
+        openxc_PayloadFormatCommand* command) {
+    char format[16];
+    if(readString(context, format, sizeof(format))) {
+        if(!strcmp(format, json::PAYLOAD_FORMAT_JSON_NAME)) {
+            command->format = openxc_PayloadFormatCommand_PayloadFormat_JSON;
+        } else if(!strcmp(format, json::PAYLOAD_FORMAT_PROTOBUF_NAME)) {
+            command->format =
+                    openxc_PayloadFormatCommand_PayloadFormat_PROTOBUF;
+        } else if(!strcmp(format, json::PAYLOAD_FORMAT_MESSAGEPACK_NAME)) {
+            command->format =
+                    openxc_PayloadFormatCommand_PayloadFormat_MESSAGEPACK;
+        }
+    }
+}
+
+/* Private: Read the value for one key of a control command.
+ */
+static void readCommandField(cmp_ctx_t* context, const char* key,
+        openxc_ControlCommand* command) {
+    double number;
+    char action[8];
+    switch(command->type) {
+        case openxc_ControlCommand_Type_DIAGNOSTIC:
+            if(!strcmp(key, "action")) {
+                if(readString(context, action, sizeof(action))) {
+                    if(!strcmp(action, "add")) {
+                        command->diagnostic_request.action =
+                                openxc_DiagnosticControlCommand_Action_ADD;
+                    } else if(!strcmp(action, "cancel")) {
+                        command->diagnostic_request.action =
+                                openxc_DiagnosticControlCommand_Action_CANCEL;
+                    }
+                }
+                return;
+            } else if(!strcmp(key, "request")) {
+                readDiagnosticRequest(context,
+                        &command->diagnostic_request.request);
+                return;
+            }
+            break;
+        case openxc_ControlCommand_Type_PASSTHROUGH:
+            if(!strcmp(key, json::BUS_FIELD_NAME)) {
+                if(readNumber(context, &number)) {
+                    command->passthrough_mode_request.bus = number;
+                }
+                return;
+            } else if(!strcmp(key, "enabled")) {
+                readBool(context, &command->passthrough_mode_request.enabled);
+                return;
+            }
+            break;
+        case openxc_ControlCommand_Type_PREDEFINED_OBD2_REQUESTS:
+            if(!strcmp(key, "enabled")) {
+                readBool(context,
+                        &command->predefined_obd2_requests_command.enabled);
+                return;
+            }
+            break;
+        case openxc_ControlCommand_Type_ACCEPTANCE_FILTER_BYPASS:
+            if(!strcmp(key, json::BUS_FIELD_NAME)) {
+                if(readNumber(context, &number)) {
+                    command->acceptance_filter_bypass_command.bus = number;
+                }
+                return;
+            } else if(!strcmp(key, "bypass")) {
+                readBool(context,
+                        &command->acceptance_filter_bypass_command.bypass);
+                return;
+            }
+            break;
+        case openxc_ControlCommand_Type_PAYLOAD_FORMAT:
+            if(!strcmp(key, "format")) {
+                readPayloadFormat(context, &command->payload_format_command);
+                return;
+            }
+            break;
+        case openxc_ControlCommand_Type_MODEM_CONFIGURATION:
+            if(!strcmp(key, "host")) {
+                readString(context, command->modem_configuration_command.
+                            serverConnectSettings.host,
+                        sizeof(command->modem_configuration_command.
+                            serverConnectSettings.host));
+                return;
+            } else if(!strcmp(key, "port")) {
+                if(readNumber(context, &number)) {
+                    command->modem_configuration_command.
+                            serverConnectSettings.port = number;
+                }
+                return;
+            }
+            break;
+        case openxc_ControlCommand_Type_RTC_CONFIGURATION:
+            if(!strcmp(key, "unix_time")) {
+                if(readNumber(context, &number)) {
+                    command->rtc_configuration_command.unix_time = number;
+                }
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+    skipObject(context, 0);
+}
+
+static void readCanField(cmp_ctx_t* context, const char* key,
+        openxc_CanMessage* message) {
+    double number;
+    char frameFormat[16];
+    if(!strcmp(key, json::ID_FIELD_NAME)) {
+        if(readNumber(context, &number)) {
+            message->id = number;
+        }
+    } else if(!strcmp(key, json::BUS_FIELD_NAME)) {
+        if(readNumber(context, &number)) {
+            message->bus = number;
+        }
+    } else if(!strcmp(key, json::DATA_FIELD_NAME)) {
+        message->data.size = readBytes(context, message->data.bytes,
+                sizeof(message->data.bytes));
+    } else if(!strcmp(key, json::FRAME_FORMAT_FIELD_NAME)) {
+        if(readString(context, frameFormat, sizeof(frameFormat))) {
+            if(!strcmp(frameFormat, json::FRAME_FORMAT_STANDARD_NAME)) {
+                message->frame_format = openxc_CanMessage_FrameFormat_STANDARD;
+            } else if(!strcmp(frameFormat, json::FRAME_FORMAT_EXTENDED_NAME)) {
+                message->frame_format = openxc_CanMessage_FrameFormat_EXTENDED;
+            }
+        }
+    } else {
+        skipObject(context, 0);
+    }
+}
+
+static void readSimpleField(cmp_ctx_t* context, const char* key,
+        openxc_SimpleMessage* message) {
+    if(!strcmp(key, json::NAME_FIELD_NAME)) {
+        readString(context, message->name, sizeof(message->name));
+    } else if(!strcmp(key, json::VALUE_FIELD_NAME)) {
+        readDynamicField(context, &message->value);
+    } else if(!strcmp(key, json::EVENT_FIELD_NAME)) {
+        readDynamicField(context, &message->event);
+    } else {
+        skipObject(context, 0);
+    }
+}
+
+static openxc_ControlCommand_Type lookupCommandType(const char* name) {
+    for(size_t i = 0; i < sizeof(COMMAND_TYPES) / sizeof(COMMAND_TYPES[0]);
+            i++) {
+        if(!strcmp(name, json::commandName(COMMAND_TYPES[i]))) {
+            return COMMAND_TYPES[i];
+        }
+    }
+    return openxc_ControlCommand_Type_UNUSED;
+}
+
+size_t openxc::payload::messagepack::deserialize(uint8_t payload[],
+        size_t length, openxc_VehicleMessage* message) {
+    cmp_ctx_t context;
+    MessagePackBuffer buffer;
+    initializeContext(&context, &buffer, payload, length);
+
+    cmp_object_t root;
+    if(!cmp_read_object(&context, &root)) {
+        return 0;
+    } else if(!isMap(&root)) {
+        debug("MessagePack payload isn't a map -- skipping a byte");
+        return 1;
+    }
+
+    // The keys may come in any order, so find out what kind of message this
+    // is (and make sure all of it has arrived) before reading any values.
+    char commandName[MAX_KEY_LENGTH] = {0};
+    bool hasCommand = false;
+    bool hasName = false;
+    for(uint32_t i = 0; i < root.as.map_size; i++) {
+        char key[MAX_KEY_LENGTH];
+        bool valid;
+        if(!readString(&context, key, sizeof(key))) {
+            valid = !buffer.truncated && skipObject(&context, 0);
+        } else if(!strcmp(key, "command")) {
+            hasCommand = true;
+            valid = readString(&context, commandName, sizeof(commandName)) ||
+                    !buffer.truncated;
+        } else {
+            hasName = hasName || !strcmp(key, json::NAME_FIELD_NAME);
+            valid = skipObject(&context, 0);
+        }
+
+        if(buffer.truncated) {
+            return 0;
+        } else if(!valid) {
+            debug("Malformed MessagePack payload -- dropping it");
+            return buffer.position;
+        }
+    }
+    size_t messageLength = buffer.position;
+
+    if(hasCommand) {
+        message->type = openxc_VehicleMessage_Type_CONTROL_COMMAND;
+        message->control_command.type = lookupCommandType(commandName);
+        if(message->control_command.type == openxc_ControlCommand_Type_UNUSED) {
+            debug("Unrecognized command: %s", commandName);
+        }
+    } else if(hasName) {
+        message->type = openxc_VehicleMessage_Type_SIMPLE;
+    } else {
+        message->type = openxc_VehicleMessage_Type_CAN;
+    }
+
+    buffer.position = 0;
+    cmp_read_object(&context, &root);
+    for(uint32_t i = 0; i < root.as.map_size; i++) {
+        char key[MAX_KEY_LENGTH];
+        if(!readString(&context, key, sizeof(key)) || !strcmp(key, "command")) {
+            skipObject(&context, 0);
+        } else if(hasCommand) {
+            readCommandField(&context, key, &message->control_command);
+        } else if(hasName) {
+            readSimpleField(&context, key, &message->simple_message);
+        } else {
+            readCanField(&context, key, &message->can_message);
+        }
+    }
+    return messageLength;
+}
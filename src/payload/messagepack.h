@@ -0,0 +1,62 @@
+#ifndef __MESSAGEPACK_H__
+#define __MESSAGEPACK_H__
+
+#include "openxc.pb.h"
+
+namespace openxc {
+namespace payload {
+namespace messagepack {
+
+/* Public: Deserialize an OpenXC message from a payload containing MessagePack.
+ *
+ * The message must be a MessagePack map with the same keys and structure as
+ * the JSON format. Byte arrays (CAN message data and diagnostic payloads) may
+ * be either bin objects or hex strings like in JSON.
+ *
+ * payload - The bytestream payload to parse a message from.
+ * length -  The length of the payload.
+ * message - An output parameter, the object to store the deserialized message.
+ *
+ * Returns the number of bytes parsed as a MessagePack object from the payload.
+ * Returns 0 if the payload doesn't contain a complete object yet.
+ */
+size_t deserialize(uint8_t payload[], size_t length,
+        openxc_VehicleMessage* message);
+
+/* Public: Serialize an OpenXC message as MessagePack and store in the payload.
+ *
+ * The message is written as a map with the same keys and structure as the
+ * JSON format, except that byte arrays are written as bin objects instead of
+ * hex strings, and numbers use the smallest MessagePack type that holds them
+ * exactly.
+ *
+ * message - The message to serialize.
+ * payload - The buffer to store the payload - must be allocated by the caller.
+ * length -  The length of the payload buffer.
+ *
+ * Returns the number of bytes written to the payload. If the length is 0, an
+ * error occurred while serializing.
+ */
+int serialize(openxc_VehicleMessage* message, uint8_t payload[], size_t length);
+
+/* Public: Wrap a batch of MessagePack messages in a single container map with
+ * the same structure as the JSON container - a "batch" key with the version of
+ * the container, PAYLOAD_BATCH_VERSION, and a "messages" array.
+ *
+ * messages - The MessagePack messages, back to back, as written by
+ *      serialize().
+ * messagesLength - The total length of the messages.
+ * messageCount - The number of messages.
+ * payload - The buffer to store the frame - must be allocated by the caller.
+ * length -  The length of the payload buffer.
+ *
+ * Returns the number of bytes written to the payload, or 0 if it doesn't fit.
+ */
+int serializeBatch(const uint8_t messages[], size_t messagesLength,
+        int messageCount, uint8_t payload[], size_t length);
+
+} // namespace messagepack
+} // namespace payload
+} // namespace openxc
+
+#endif // __MESSAGEPACK_H__
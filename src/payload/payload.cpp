@@ -1,12 +1,15 @@
 #include "payload.h"
 #include "payload/json.h"
 #include "payload/protobuf.h"
+#include "payload/messagepack.h"
 #include "util/log.h"
+#include "util/profiler.h"
 #include <stdio.h>
 
 namespace payload = openxc::payload;
 
 using openxc::util::log::debug;
+using openxc::util::profiler::ProfileStage;
 
 openxc_DynamicField openxc::payload::wrapNumber(float value) {
     openxc_DynamicField sabot = openxc_DynamicField();	// Zero Fill
@@ -67,6 +70,8 @@ size_t openxc::payload::deserialize(uint8_t payload[], size_t length,
         debug("deserialize protobuf");
         dumpNum(bytesRead);
         dumpPayload(payload, bytesRead);
+    } else if(format == PayloadFormat::MESSAGEPACK) {
+        bytesRead = payload::messagepack::deserialize(payload, length, message);
     } else {
         debug("Invalid payload format: %d", format);
     }
@@ -75,11 +80,34 @@ size_t openxc::payload::deserialize(uint8_t payload[], size_t length,
 
 int openxc::payload::serialize(openxc_VehicleMessage* message,
         uint8_t payload[], size_t length, PayloadFormat format) {
+    PROFILE_SCOPE(ProfileStage::SERIALIZE);
     int serializedLength = 0;
     if(format == PayloadFormat::JSON) {
         serializedLength = payload::json::serialize(message, payload, length);
     } else if(format == PayloadFormat::PROTOBUF) {
         serializedLength = payload::protobuf::serialize(message, payload, length);
+    } else if(format == PayloadFormat::MESSAGEPACK) {
+        serializedLength = payload::messagepack::serialize(message, payload,
+                length);
+    } else {
+        debug("Invalid payload format: %d", format);
+    }
+    return serializedLength;
+}
+
+int openxc::payload::serializeBatch(const uint8_t messages[],
+        size_t messagesLength, int messageCount, uint8_t payload[],
+        size_t length, PayloadFormat format) {
+    int serializedLength = 0;
+    if(format == PayloadFormat::JSON) {
+        serializedLength = payload::json::serializeBatch(messages,
+                messagesLength, messageCount, payload, length);
+    } else if(format == PayloadFormat::PROTOBUF) {
+        serializedLength = payload::protobuf::serializeBatch(messages,
+                messagesLength, messageCount, payload, length);
+    } else if(format == PayloadFormat::MESSAGEPACK) {
+        serializedLength = payload::messagepack::serializeBatch(messages,
+                messagesLength, messageCount, payload, length);
     } else {
         debug("Invalid payload format: %d", format);
     }
@@ -4,6 +4,13 @@
 #include "openxc.pb.h"
 #include <stdint.h>
 
+// The version of the batch container frame, written in every frame so clients
+// can tell if they understand it.
+#define PAYLOAD_BATCH_VERSION 1
+// The most bytes a batch frame adds around the messages it carries, in any
+// payload format.
+#define PAYLOAD_BATCH_MAX_OVERHEAD 32
+
 namespace openxc {
 namespace payload {
 
@@ -12,6 +19,7 @@ namespace payload {
 typedef enum {
     JSON,
     PROTOBUF,
+    MESSAGEPACK,
 } PayloadFormat;
 
 /* Public: Deserialize an OpenXC message from the given payload, using the given
@@ -48,6 +56,27 @@ size_t deserialize(uint8_t payload[], size_t length, PayloadFormat format,
 int serialize(openxc_VehicleMessage* message, uint8_t payload[], size_t length,
         PayloadFormat format);
 
+/* Public: Wrap a batch of serialized messages into a single container frame.
+ *
+ * The messages are copied into the frame as they are, so each one must already
+ * be serialized in the same format. See serializeBatch in each format's module
+ * for what the frame looks like.
+ *
+ * messages - The serialized messages, back to back.
+ * messagesLength - The total length of the messages.
+ * messageCount - The number of messages.
+ * payload - The buffer to store the frame - must be allocated by the caller.
+ * length -  The length of the payload buffer. Frames are at most
+ *      PAYLOAD_BATCH_MAX_OVERHEAD bytes longer than the messages.
+ * format - The format the messages were serialized in.
+ *
+ * Returns the number of bytes written to the payload. If the length is 0, an
+ * error occurred while serializing.
+ */
+int serializeBatch(const uint8_t messages[], size_t messagesLength,
+        int messageCount, uint8_t payload[], size_t length,
+        PayloadFormat format);
+
 /* Public: Helper functions to wrap values in an openxc_DynamicField
  */
 openxc_DynamicField wrapNumber(float value);
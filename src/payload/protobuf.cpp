@@ -1,6 +1,7 @@
 #include "protobuf.h"
 
 #include <util/log.h>
+#include "payload/payload.h"
 #include "pb_encode.h"
 #include "pb_decode.h"
 
@@ -34,3 +35,18 @@ int openxc::payload::protobuf::serialize(openxc_VehicleMessage* message,
 
     return stream.bytes_written;
 }
+
+int openxc::payload::protobuf::serializeBatch(const uint8_t messages[],
+        size_t messagesLength, int messageCount, uint8_t payload[],
+        size_t length) {
+    const uint8_t header[] = {0, PAYLOAD_BATCH_VERSION};
+    pb_ostream_t stream = pb_ostream_from_buffer(payload, length);
+    if(messageCount == 0 ||
+            !pb_encode_varint(&stream, sizeof(header) + messagesLength) ||
+            !pb_write(&stream, header, sizeof(header)) ||
+            !pb_write(&stream, messages, messagesLength)) {
+        debug("Error encoding protobuf batch: %s", PB_GET_ERROR(&stream));
+        return 0;
+    }
+    return stream.bytes_written;
+}
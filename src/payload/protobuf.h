@@ -31,6 +31,25 @@ size_t deserialize(uint8_t payload[], size_t length, openxc_VehicleMessage* mess
  */
 int serialize(openxc_VehicleMessage* message, uint8_t payload[], size_t length);
 
+/* Public: Wrap a batch of delimited protobuf messages in a single frame.
+ *
+ * The frame is delimited like any other message, with its length as a varint,
+ * but the body starts with a 0 byte - a tag for field number 0, which can
+ * never begin a valid VehicleMessage - followed by the container version,
+ * PAYLOAD_BATCH_VERSION. The rest of the body is the messages exactly as they
+ * were, each with its own length prefix.
+ *
+ * messages - The delimited messages, back to back, as written by serialize().
+ * messagesLength - The total length of the messages.
+ * messageCount - The number of messages.
+ * payload - The buffer to store the frame - must be allocated by the caller.
+ * length -  The length of the payload buffer.
+ *
+ * Returns the number of bytes written to the payload, or 0 if it doesn't fit.
+ */
+int serializeBatch(const uint8_t messages[], size_t messagesLength,
+        int messageCount, uint8_t payload[], size_t length);
+
 } // namespace protobuf
 } // namespace payload
 } // namespace openxc
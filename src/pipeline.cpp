@@ -1,14 +1,15 @@
+#include <string.h>
 #include "emqueue.h"
 #include "pipeline.h"
 #include "util/log.h"
 #include "util/timer.h"
 #include "util/statistics.h"
 #include "util/bytebuffer.h"
+#include "util/slabpool.h"
+#include "util/profiler.h"
 #include "config.h"
 #include "lights.h"
-#define PIPELINE_ENDPOINT_COUNT 5
 #define PIPELINE_STATS_LOG_FREQUENCY_S 15
-#define QUEUE_FLUSH_MAX_TRIES 100
 #include "platform_profile.h"
 #ifdef RTC_SUPPORT
 	#include "platform/pic32/rtc.h"
@@ -22,53 +23,364 @@ namespace network = openxc::interface::network;
 namespace time = openxc::util::time;
 namespace statistics = openxc::util::statistics;
 namespace config = openxc::config;
+namespace slabpool = openxc::util::slabpool;
+namespace coalescing = openxc::util::coalescing;
+namespace payload = openxc::payload;
 
-using openxc::util::bytebuffer::conditionalEnqueue;
-using openxc::util::bytebuffer::messageFits;
 using openxc::util::statistics::DeltaStatistic;
 using openxc::util::log::debug;
 using openxc::pipeline::Pipeline;
 using openxc::pipeline::MessageClass;
+using openxc::pipeline::OutputBatch;
+using openxc::pipeline::BackpressurePolicy;
+using openxc::pipeline::BackpressureStall;
 using openxc::interface::InterfaceDescriptor;
 using openxc::interface::InterfaceType;
 using openxc::config::LoggingOutputInterface;
 using openxc::util::time::uptimeMs;
+using openxc::util::profiler::ProfileStage;
 
-unsigned int droppedMessages[PIPELINE_ENDPOINT_COUNT];
+unsigned int droppedMessages[PIPELINE_ENDPOINT_COUNT][SLAB_QUEUE_LANE_COUNT];
 unsigned int sentMessages[PIPELINE_ENDPOINT_COUNT];
 unsigned int dataSent[PIPELINE_ENDPOINT_COUNT];
 unsigned int sendQueueLength[PIPELINE_ENDPOINT_COUNT];
 unsigned int receiveQueueLength[PIPELINE_ENDPOINT_COUNT];
 
-void conditionalFlush(Pipeline* pipeline,
-        QUEUE_TYPE(uint8_t)* sendQueue, uint8_t* message, int messageSize) {
-    int timeout = QUEUE_FLUSH_MAX_TRIES;
-    while(timeout > 0 && !messageFits(sendQueue, message, messageSize)) {
-        process(pipeline);
-        --timeout;
+/* Private: A message on its way out to the interfaces. The payload is copied
+ * into a shared slab the first time an interface has room for it, and every
+ * interface after that queues a reference to the same slab.
+ *
+ * If the message may be coalesced, coalescingKey is the key of its signal
+ * (otherwise 0), and coalescingSlot is the slot it was stored in by the first
+ * interface to coalesce it.
+ *
+ * receivedAtUs is the time the CAN message it came from was received, or 0 if
+ * it didn't come from one.
+ */
+typedef struct {
+    uint8_t* payload;
+    int size;
+    PayloadSlab* slab;
+    slabpool::Lane lane;
+    uint32_t coalescingKey;
+    CoalescingSlot* coalescingSlot;
+    unsigned long receivedAtUs;
+} OutgoingMessage;
+
+/* Private: Return the lane of the interface send queues for a class of
+ * message. Command responses go ahead of everything else, so a client waiting
+ * on one isn't stuck behind (or has it dropped for) a flood of vehicle data.
+ */
+static slabpool::Lane laneForClass(MessageClass messageClass) {
+    switch(messageClass) {
+        case MessageClass::COMMAND_RESPONSE:
+            return slabpool::Lane::PRIORITY;
+        default:
+            return slabpool::Lane::BULK;
+    }
+}
+
+/* Private: Return the shared slab for the message, copying the payload into
+ * the pool if this is the first interface to need it.
+ *
+ * Returns NULL if the pool has no free slab for it.
+ */
+PayloadSlab* sharedSlab(OutgoingMessage* message) {
+    if(message->slab == NULL) {
+        message->slab = slabpool::acquire(message->payload, message->size,
+                message->lane);
+        if(message->slab != NULL) {
+            message->slab->receivedAtUs = message->receivedAtUs;
+        }
+    }
+    return message->slab;
+}
+
+/* Private: Return true if the message fits in the send queue and has a slab
+ * to be queued from.
+ */
+static bool ready(SlabQueue* sendQueue, OutgoingMessage* message) {
+    return slabpool::fits(sendQueue, message->size, message->lane) &&
+            sharedSlab(message) != NULL;
+}
+
+/* Private: Make room in the send queue for the message as the interface's
+ * backpressure policy allows.
+ *
+ * Returns true if the message can be queued.
+ */
+static bool makeRoom(Pipeline* pipeline, InterfaceType endpointType,
+        SlabQueue* sendQueue, OutgoingMessage* message) {
+    bool fits = slabpool::fits(sendQueue, message->size, message->lane);
+    if(fits && sharedSlab(message) != NULL) {
+        return true;
+    }
+
+    config::Configuration* configuration = config::getConfiguration();
+    switch(configuration->backpressurePolicies[endpointType]) {
+    case BackpressurePolicy::DROP_OLDEST: {
+        bool triedSlab = fits;
+        while(!fits && slabpool::dropOldest(sendQueue, message->lane)) {
+            ++droppedMessages[endpointType][message->lane];
+            fits = slabpool::fits(sendQueue, message->size, message->lane);
+        }
+        if(!fits) {
+            return false;
+        } else if(!triedSlab && sharedSlab(message) != NULL) {
+            return true;
+        }
+
+        // The pool is out of slabs. Dropping from the queue only returns one
+        // to the pool if no other interface is still sending it, so stop at
+        // the first drop that doesn't.
+        int freeSlabs = slabpool::available();
+        while(slabpool::dropOldest(sendQueue, message->lane)) {
+            ++droppedMessages[endpointType][message->lane];
+            if(slabpool::available() == freeSlabs) {
+                return false;
+            } else if(sharedSlab(message) != NULL) {
+                return true;
+            }
+            freeSlabs = slabpool::available();
+        }
+        return false;
+    }
+    case BackpressurePolicy::BLOCK: {
+        unsigned long startTimeUs = time::systemTimeUs();
+        unsigned long stalledUs;
+        bool queued;
+        do {
+            process(pipeline);
+            queued = ready(sendQueue, message);
+            stalledUs = time::systemTimeUs() - startTimeUs;
+        } while(!queued &&
+                stalledUs < configuration->backpressureBlockMs * 1000UL);
+
+        BackpressureStall* stall = &pipeline->stalls[endpointType];
+        ++stall->count;
+        stall->totalUs += stalledUs;
+        stall->longestUs = MAX(stall->longestUs, stalledUs);
+        return queued;
+    }
+    default:
+        return false;
+    }
+}
+
+/* Private: Store the message in the coalescing table instead of queueing it,
+ * if the interface has coalescing turned on and the message can be coalesced.
+ *
+ * Returns true if the message was stored, to be sent by flushCoalesced.
+ */
+static bool coalesce(Pipeline* pipeline, InterfaceType endpointType,
+        OutgoingMessage* message) {
+    if(message->coalescingKey == 0 || endpointType == InterfaceType::USB ||
+            !config::getConfiguration()->outputCoalescing[endpointType]) {
+        return false;
     }
+
+    if(message->coalescingSlot == NULL) {
+        message->coalescingSlot = coalescing::update(&pipeline->coalescing,
+                message->coalescingKey, message->payload, message->size);
+        if(message->coalescingSlot == NULL) {
+            // The table is full, so every interface sends it as usual
+            message->coalescingKey = 0;
+            return false;
+        }
+        message->coalescingSlot->receivedAtUs = message->receivedAtUs;
+    }
+    coalescing::markDirty(&pipeline->coalescing, message->coalescingSlot,
+            endpointType);
+    return true;
 }
 
-void sendToEndpoint(openxc::interface::InterfaceType endpointType,
-        QUEUE_TYPE(uint8_t)* sendQueue, QUEUE_TYPE(uint8_t)* receiveQueue,
-        uint8_t* message, int messageSize) {
-    if(!conditionalEnqueue(sendQueue, message, messageSize)) {
-        ++droppedMessages[endpointType];
+/* Private: Queue as many of the coalesced values waiting for the interface as
+ * its send queue has room for.
+ */
+static void flushCoalesced(Pipeline* pipeline, InterfaceType endpointType,
+        SlabQueue* sendQueue) {
+    CoalescingSlot* slot;
+    while((slot = coalescing::nextDirty(&pipeline->coalescing, endpointType))
+                != NULL &&
+            slabpool::fits(sendQueue, slot->length, slabpool::Lane::BULK)) {
+        // Every channel sending this value shares one copy of it
+        PayloadSlab* slab = coalescing::slab(slot);
+        if(slab == NULL) {
+            break;
+        }
+
+        slabpool::enqueue(sendQueue, slab, slabpool::Lane::BULK);
+        coalescing::markSent(&pipeline->coalescing, slot, endpointType);
+        ++sentMessages[endpointType];
+        dataSent[endpointType] += slot->length;
+    }
+}
+
+void sendToEndpoint(Pipeline* pipeline,
+        openxc::interface::InterfaceType endpointType,
+        SlabQueue* sendQueue, QUEUE_TYPE(uint8_t)* receiveQueue,
+        OutgoingMessage* message) {
+    if(coalesce(pipeline, endpointType, message)) {
+        return;
+    }
+
+    if(!makeRoom(pipeline, endpointType, sendQueue, message) ||
+            !slabpool::enqueue(sendQueue, message->slab, message->lane)) {
+        ++droppedMessages[endpointType][message->lane];
     } else {
         ++sentMessages[endpointType];
-        dataSent[endpointType] += messageSize;
+        dataSent[endpointType] += message->size;
+    }
+    sendQueueLength[endpointType] = slabpool::length(sendQueue);
+    if(receiveQueue != NULL) {
+        // TODO This may not belong here after USB refactoring
+        receiveQueueLength[endpointType] = QUEUE_LENGTH(uint8_t, receiveQueue);
+    }
+}
+
+/* Private: Wrap the messages waiting in a batch into one container frame and
+ * queue it on the interface, leaving the batch empty.
+ */
+void flushBatch(Pipeline* pipeline, OutputBatch* batch,
+        openxc::interface::InterfaceType endpointType,
+        SlabQueue* sendQueue, QUEUE_TYPE(uint8_t)* receiveQueue) {
+    if(batch->count == 0) {
+        return;
+    }
+
+    // The frame is serialized straight into a slab so the batch is only
+    // copied once on its way out. If the pool is out of slabs it's serialized
+    // on the stack instead, and sendToEndpoint gets a slab for it as the
+    // backpressure policy allows.
+    uint8_t frame[MAX_OUTGOING_PAYLOAD_SIZE];
+    int capacity = MIN(batch->length + PAYLOAD_BATCH_MAX_OVERHEAD,
+            (int) sizeof(frame));
+    PayloadSlab* slab = slabpool::reserve(capacity, slabpool::Lane::BULK);
+    uint8_t* buffer = slab != NULL ? slabpool::writableData(slab) : frame;
+    int size = payload::serializeBatch(batch->messages, batch->length,
+            batch->count, buffer, capacity, batch->format);
+    if(slab != NULL) {
+        slab->length = size;
+        slab->receivedAtUs = batch->receivedAtUs;
+    }
+    // Empty the batch before sending, in case the interfaces have to be
+    // flushed to make room and that sends this batch again.
+    batch->length = 0;
+    batch->count = 0;
+
+    if(size <= 0) {
+        slabpool::release(slab);
+    } else {
+        OutgoingMessage outgoing = {
+            payload: buffer,
+            size: size,
+            slab: slab,
+            lane: slabpool::Lane::BULK,
+            coalescingKey: 0,
+            coalescingSlot: NULL,
+            receivedAtUs: batch->receivedAtUs
+        };
+        sendToEndpoint(pipeline, endpointType, sendQueue, receiveQueue,
+                &outgoing);
+        slabpool::release(outgoing.slab);
     }
-    sendQueueLength[endpointType] = QUEUE_LENGTH(uint8_t, sendQueue);
-    // TODO This may not belong here after USB refactoring
-    receiveQueueLength[endpointType] = QUEUE_LENGTH(uint8_t, receiveQueue);
 }
 
-void sendToUsb(Pipeline* pipeline, uint8_t* message, int messageSize,
+/* Private: Send a message to an interface that supports output batching.
+ *
+ * If batching is enabled, vehicle data messages are added to the batch, which
+ * is sent as soon as it's full. Any other message for the bulk lane sends
+ * what's waiting in the batch first and then goes out on its own, so the
+ * order of messages in the lane doesn't change. Messages for the priority
+ * lane (e.g. a command response) go out right away and leave the batch be,
+ * and coalesced messages skip the batch as well.
+ */
+void sendToBatchedEndpoint(Pipeline* pipeline, OutputBatch* batch,
+        openxc::interface::InterfaceType endpointType,
+        SlabQueue* sendQueue, QUEUE_TYPE(uint8_t)* receiveQueue,
+        OutgoingMessage* message, MessageClass messageClass) {
+    if(coalesce(pipeline, endpointType, message)) {
+        return;
+    }
+
+    if(message->lane == slabpool::Lane::PRIORITY) {
+        sendToEndpoint(pipeline, endpointType, sendQueue, receiveQueue,
+                message);
+        return;
+    }
+
+    config::Configuration* configuration = config::getConfiguration();
+    int batchBytes = MIN(configuration->outputBatchBytes,
+            OUTPUT_BATCH_MAX_BYTES);
+    if(!configuration->outputBatching || message->size > batchBytes ||
+            (messageClass != MessageClass::SIMPLE &&
+                messageClass != MessageClass::CAN &&
+                messageClass != MessageClass::DIAGNOSTIC)) {
+        flushBatch(pipeline, batch, endpointType, sendQueue, receiveQueue);
+        sendToEndpoint(pipeline, endpointType, sendQueue, receiveQueue,
+                message);
+        return;
+    }
+
+    // A batch can only hold messages in one format, in case it was changed
+    // while some were waiting.
+    if(batch->length + message->size > batchBytes ||
+            batch->format != configuration->payloadFormat) {
+        flushBatch(pipeline, batch, endpointType, sendQueue, receiveQueue);
+    }
+
+    if(batch->count == 0) {
+        batch->format = configuration->payloadFormat;
+        batch->startedAt = time::systemTimeMs();
+        batch->receivedAtUs = 0;
+    }
+    // The batch goes out as late as its oldest message allows, so that's the
+    // one its latency is measured from.
+    if(batch->receivedAtUs == 0) {
+        batch->receivedAtUs = message->receivedAtUs;
+    }
+    memcpy(&batch->messages[batch->length], message->payload, message->size);
+    batch->length += message->size;
+    ++batch->count;
+
+    if(batch->length >= batchBytes) {
+        flushBatch(pipeline, batch, endpointType, sendQueue, receiveQueue);
+    }
+}
+
+/* Private: Send any batch that has waited longer than the configured age, or
+ * every batch if batching has been turned off.
+ */
+void flushExpiredBatches(Pipeline* pipeline) {
+    config::Configuration* configuration = config::getConfiguration();
+    unsigned long now = time::systemTimeMs();
+    if(pipeline->usb != NULL && pipeline->usbBatch.count > 0 &&
+            (!configuration->outputBatching ||
+                now - pipeline->usbBatch.startedAt >=
+                    configuration->outputBatchAgeMs)) {
+        flushBatch(pipeline, &pipeline->usbBatch,
+                pipeline->usb->descriptor.type,
+                &pipeline->usb->endpoints[IN_ENDPOINT_INDEX].sendQueue,
+                &pipeline->usb->endpoints[OUT_ENDPOINT_INDEX].queue);
+    }
+
+    if(pipeline->network != NULL && pipeline->networkBatch.count > 0 &&
+            (!configuration->outputBatching ||
+                now - pipeline->networkBatch.startedAt >=
+                    configuration->outputBatchAgeMs)) {
+        flushBatch(pipeline, &pipeline->networkBatch,
+                pipeline->network->descriptor.type,
+                &pipeline->network->sendQueue,
+                &pipeline->network->receiveQueue);
+    }
+}
+
+void sendToUsb(Pipeline* pipeline, OutgoingMessage* message,
         MessageClass messageClass) {
     if(pipeline->usb->configured) {
-        QUEUE_TYPE(uint8_t)* sendQueue;
+        SlabQueue* sendQueue;
         if(messageClass == MessageClass::LOG) {
-            sendQueue = &pipeline->usb->endpoints[LOG_ENDPOINT_INDEX].queue;
+            sendQueue = &pipeline->usb->endpoints[LOG_ENDPOINT_INDEX].sendQueue;
             if(config::getConfiguration()->loggingOutput !=
                         LoggingOutputInterface::BOTH &&
                     config::getConfiguration()->loggingOutput !=
@@ -76,84 +388,102 @@ void sendToUsb(Pipeline* pipeline, uint8_t* message, int messageSize,
                 return;
             }
         } else {
-            sendQueue = &pipeline->usb->endpoints[IN_ENDPOINT_INDEX].queue;
+            sendToBatchedEndpoint(pipeline, &pipeline->usbBatch,
+                    pipeline->usb->descriptor.type,
+                    &pipeline->usb->endpoints[IN_ENDPOINT_INDEX].sendQueue,
+                    &pipeline->usb->endpoints[OUT_ENDPOINT_INDEX].queue,
+                    message, messageClass);
+            return;
         }
 
-        conditionalFlush(pipeline, sendQueue, message, messageSize);
-        sendToEndpoint(pipeline->usb->descriptor.type, sendQueue,
-                &pipeline->usb->endpoints[OUT_ENDPOINT_INDEX].queue,
-                message, messageSize);
+        sendToEndpoint(pipeline, pipeline->usb->descriptor.type, sendQueue,
+                &pipeline->usb->endpoints[OUT_ENDPOINT_INDEX].queue, message);
     }
 }
 
-void sendToUart(Pipeline* pipeline, uint8_t* message, int messageSize,
+void sendToUart(Pipeline* pipeline, OutgoingMessage* message,
         MessageClass messageClass) {
     if(uart::connected(pipeline->uart) && messageClass != MessageClass::LOG) {
 		//if(uart::connected(pipeline->uart)) {
-        QUEUE_TYPE(uint8_t)* sendQueue = &pipeline->uart->sendQueue;
-        conditionalFlush(pipeline, sendQueue, message, messageSize);
-        sendToEndpoint(pipeline->uart->descriptor.type, sendQueue,
-                &pipeline->uart->receiveQueue, message, messageSize);
+        sendToEndpoint(pipeline, pipeline->uart->descriptor.type,
+                &pipeline->uart->sendQueue, &pipeline->uart->receiveQueue,
+                message);
     }
 }
 
 #ifdef TELIT_HE910_SUPPORT
-void sendToTelit(Pipeline* pipeline, uint8_t* message, int messageSize,
+void sendToTelit(Pipeline* pipeline, OutgoingMessage* message,
         MessageClass messageClass) {
     if(openxc::telitHE910::connected(pipeline->telit) && messageClass != MessageClass::LOG) {
-        QUEUE_TYPE(uint8_t)* sendQueue = &pipeline->telit->sendQueue;
-        conditionalFlush(pipeline, sendQueue, message, messageSize);
-        sendToEndpoint(pipeline->telit->descriptor.type, sendQueue, &pipeline->telit->receiveQueue, message,
-                messageSize);
+        sendToEndpoint(pipeline, pipeline->telit->descriptor.type,
+                &pipeline->telit->sendQueue, &pipeline->telit->receiveQueue,
+                message);
     }
     // removed UART logging from the telit
 }
 #endif
 
 #ifdef BLE_SUPPORT
-void sendToBle(Pipeline* pipeline, uint8_t* message, int messageSize,
+void sendToBle(Pipeline* pipeline, OutgoingMessage* message,
         MessageClass messageClass) {
         
     if(ble::connected(pipeline->ble) && messageClass != MessageClass::LOG) { //TODO add a characteristic for sending debug notification messages
-        QUEUE_TYPE(uint8_t)* sendQueue = (QUEUE_TYPE(uint8_t)* )&pipeline->ble->sendQueue;
-        conditionalFlush(pipeline,sendQueue, message, messageSize);
-        sendToEndpoint(pipeline->ble->descriptor.type, sendQueue,(QUEUE_TYPE(uint8_t)* )&pipeline->ble->receiveQueue, message,
-                messageSize);
+        sendToEndpoint(pipeline, pipeline->ble->descriptor.type,
+                &pipeline->ble->sendQueue, &pipeline->ble->receiveQueue,
+                message);
     }
 
 }
 #endif
 #ifdef FS_SUPPORT
-void sendToFS(Pipeline* pipeline, uint8_t* message, int messageSize,
+void sendToFS(Pipeline* pipeline, OutgoingMessage* message,
         MessageClass messageClass) {
     if(fs::connected(pipeline->fs) && messageClass != MessageClass::LOG
                     && messageClass != MessageClass::COMMAND_RESPONSE
     ) { 
-        QUEUE_TYPE(uint8_t)* sendQueue = (QUEUE_TYPE(uint8_t)* )&pipeline->fs->sendQueue;
-        conditionalFlush(pipeline,sendQueue, message, messageSize);
-        openxc::interface::InterfaceType endpointType = pipeline->fs->descriptor.type;
-        if(!conditionalEnqueue(sendQueue, message, messageSize)) {
-            ++droppedMessages[endpointType];
-        } else {
-        ++sentMessages[endpointType];
-        dataSent[endpointType] += messageSize;
-        }
-        sendQueueLength[endpointType] = QUEUE_LENGTH(uint8_t, sendQueue);
+        sendToEndpoint(pipeline, pipeline->fs->descriptor.type,
+                &pipeline->fs->sendQueue, NULL, message);
     }
 }
 #endif
 
 
-void sendToNetwork(Pipeline* pipeline, uint8_t* message, int messageSize,
+void sendToNetwork(Pipeline* pipeline, OutgoingMessage* message,
         MessageClass messageClass) {
     if(pipeline->network != NULL && messageClass != MessageClass::LOG) {
-        QUEUE_TYPE(uint8_t)* sendQueue = &pipeline->network->sendQueue;
-        conditionalFlush(pipeline, sendQueue, message, messageSize);
-        sendToEndpoint(pipeline->network->descriptor.type, sendQueue,
-                &pipeline->network->receiveQueue, message, messageSize);
+        sendToBatchedEndpoint(pipeline, &pipeline->networkBatch,
+                pipeline->network->descriptor.type,
+                &pipeline->network->sendQueue, &pipeline->network->receiveQueue,
+                message, messageClass);
     }
 }
 
+/* Private: Send the message to every interface that receives its class of
+ * message.
+ */
+static void sendToInterfaces(Pipeline* pipeline, OutgoingMessage* outgoing,
+        MessageClass messageClass) {
+    sendToUsb(pipeline, outgoing, messageClass);
+    #ifdef TELIT_HE910_SUPPORT
+    sendToTelit(pipeline, outgoing, messageClass);
+    #elif defined BLE_SUPPORT
+    sendToBle(pipeline, outgoing, messageClass);
+    #else
+    //#ifndef FS_SUPPORT //UART shared with RTC, disable
+    sendToUart(pipeline, outgoing, messageClass);
+    //#endif
+    #endif
+    #ifdef FS_SUPPORT
+    sendToFS(pipeline, outgoing, messageClass);
+    #endif
+    
+    sendToNetwork(pipeline, outgoing, messageClass);
+
+    // Drop our own reference - each queue holding the slab has its own, and
+    // the slab returns to the pool once the last of them has been sent.
+    slabpool::release(outgoing->slab);
+}
+
 void openxc::pipeline::publish(openxc_VehicleMessage* message,
         Pipeline* pipeline) {
     uint8_t payload[MAX_OUTGOING_PAYLOAD_SIZE] = {0};
@@ -189,8 +519,22 @@ void openxc::pipeline::publish(openxc_VehicleMessage* message,
             break;
     }
     if(matched) {
-        sendMessage(pipeline, payload, length, messageClass);
-
+        OutgoingMessage outgoing = {
+            payload: payload,
+            size: (int) length,
+            slab: NULL,
+            lane: laneForClass(messageClass),
+            coalescingKey: 0,
+            coalescingSlot: NULL,
+            receivedAtUs: pipeline->canReceivedAtUs
+        };
+        if(message->type == openxc_VehicleMessage_Type_SIMPLE &&
+                message->simple_message.event.type ==
+                    openxc_DynamicField_Type_UNUSED) {
+            outgoing.coalescingKey = coalescing::key(
+                    message->simple_message.name);
+        }
+        sendToInterfaces(pipeline, &outgoing, messageClass);
     } else {
         debug("Trying to serialize unrecognized type: %d", message->type);
     }
@@ -198,21 +542,16 @@ void openxc::pipeline::publish(openxc_VehicleMessage* message,
 
 void openxc::pipeline::sendMessage(Pipeline* pipeline, uint8_t* message,
         int messageSize, MessageClass messageClass) {
-    sendToUsb(pipeline, message, messageSize, messageClass);
-    #ifdef TELIT_HE910_SUPPORT
-    sendToTelit(pipeline, message, messageSize, messageClass);
-    #elif defined BLE_SUPPORT
-    sendToBle(pipeline, message, messageSize, messageClass);
-    #else
-    //#ifndef FS_SUPPORT //UART shared with RTC, disable
-    sendToUart(pipeline, message, messageSize, messageClass);
-    //#endif
-    #endif
-    #ifdef FS_SUPPORT
-    sendToFS(pipeline, message, messageSize, messageClass);
-    #endif
-    
-    sendToNetwork(pipeline, message, messageSize, messageClass);
+    OutgoingMessage outgoing = {
+        payload: message,
+        size: messageSize,
+        slab: NULL,
+        lane: laneForClass(messageClass),
+        coalescingKey: 0,
+        coalescingSlot: NULL,
+        receivedAtUs: pipeline->canReceivedAtUs
+    };
+    sendToInterfaces(pipeline, &outgoing, messageClass);
 
     if((config::getConfiguration()->loggingOutput == LoggingOutputInterface::BOTH ||
         config::getConfiguration()->loggingOutput == LoggingOutputInterface::UART)
@@ -223,28 +562,48 @@ void openxc::pipeline::sendMessage(Pipeline* pipeline, uint8_t* message,
 }
 
 void openxc::pipeline::process(Pipeline* pipeline) {
+    flushExpiredBatches(pipeline);
+
     // Must always process USB, because this function usually runs the MCU's USB
     // task that handles SETUP and enumeration.
-    usb::processSendQueue(pipeline->usb);
+    {
+        PROFILE_SCOPE(ProfileStage::SEND_USB);
+        usb::processSendQueue(pipeline->usb);
+    }
     #ifdef TELIT_HE910_SUPPORT
     if(telitHE910::connected(pipeline->telit)) {
+        flushCoalesced(pipeline, pipeline->telit->descriptor.type,
+                &pipeline->telit->sendQueue);
+        PROFILE_SCOPE(ProfileStage::SEND_TELIT);
         telitHE910::processSendQueue(pipeline->telit);
     }
     #endif
     #ifdef BLE_SUPPORT
     if(ble::connected(pipeline->ble)){
+        flushCoalesced(pipeline, pipeline->ble->descriptor.type,
+                &pipeline->ble->sendQueue);
+        PROFILE_SCOPE(ProfileStage::SEND_BLE);
         ble::processSendQueue(pipeline->ble);
     }
     #endif
     #ifdef FS_SUPPORT
     if(fs::connected(pipeline->fs)){
+        flushCoalesced(pipeline, pipeline->fs->descriptor.type,
+                &pipeline->fs->sendQueue);
+        PROFILE_SCOPE(ProfileStage::SEND_FS);
         fs::processSendQueue(pipeline->fs);
     }
     #endif
     if(uart::connected(pipeline->uart)) {
+        flushCoalesced(pipeline, pipeline->uart->descriptor.type,
+                &pipeline->uart->sendQueue);
+        PROFILE_SCOPE(ProfileStage::SEND_UART);
         uart::processSendQueue(pipeline->uart);
     }
     if(pipeline->network != NULL) {
+        flushCoalesced(pipeline, pipeline->network->descriptor.type,
+                &pipeline->network->sendQueue);
+        PROFILE_SCOPE(ProfileStage::SEND_NETWORK);
        network::processSendQueue(pipeline->network);
     }
 
@@ -257,6 +616,8 @@ void openxc::pipeline::logStatistics(Pipeline* pipeline) {
 
     static unsigned long lastTimeLogged;
     static DeltaStatistic droppedMessageStats[PIPELINE_ENDPOINT_COUNT];
+    static DeltaStatistic droppedLaneMessageStats[PIPELINE_ENDPOINT_COUNT][
+            SLAB_QUEUE_LANE_COUNT];
     static DeltaStatistic sentMessageStats[PIPELINE_ENDPOINT_COUNT];
     static DeltaStatistic totalMessageStats[PIPELINE_ENDPOINT_COUNT];
     static DeltaStatistic dataSentStats[PIPELINE_ENDPOINT_COUNT];
@@ -266,6 +627,9 @@ void openxc::pipeline::logStatistics(Pipeline* pipeline) {
     if(!initializedStats) {
         for(int i = 0; i < PIPELINE_ENDPOINT_COUNT; i++) {
             statistics::initialize(&droppedMessageStats[i]);
+            for(int lane = 0; lane < SLAB_QUEUE_LANE_COUNT; lane++) {
+                statistics::initialize(&droppedLaneMessageStats[i][lane]);
+            }
             statistics::initialize(&sentMessageStats[i]);
             statistics::initialize(&totalMessageStats[i]);
             statistics::initialize(&dataSentStats[i]);
@@ -278,10 +642,16 @@ void openxc::pipeline::logStatistics(Pipeline* pipeline) {
     if(time::systemTimeMs() - lastTimeLogged >
             PIPELINE_STATS_LOG_FREQUENCY_S * 1000) {
         for(int i = 0; i < PIPELINE_ENDPOINT_COUNT; i++) {
+            unsigned int dropped = 0;
+            for(int lane = 0; lane < SLAB_QUEUE_LANE_COUNT; lane++) {
+                statistics::update(&droppedLaneMessageStats[i][lane],
+                        droppedMessages[i][lane]);
+                dropped += droppedMessages[i][lane];
+            }
             statistics::update(&sentMessageStats[i], sentMessages[i]);
-            statistics::update(&droppedMessageStats[i], droppedMessages[i]);
+            statistics::update(&droppedMessageStats[i], dropped);
             statistics::update(&totalMessageStats[i],
-                    sentMessages[i] + droppedMessages[i]);
+                    sentMessages[i] + dropped);
             statistics::update(&dataSentStats[i], dataSent[i]);
             statistics::update(&dataSentStats[i], dataSent[i]);
 
@@ -296,13 +666,30 @@ void openxc::pipeline::logStatistics(Pipeline* pipeline) {
                         statistics::exponentialMovingAverage(&receiveQueueStats[i])
                             / QUEUE_MAX_LENGTH(uint8_t) * 100,
                         statistics::exponentialMovingAverage(&sendQueueStats[i])
-                            / QUEUE_MAX_LENGTH(uint8_t) * 100);
+                            / SLAB_QUEUE_MAX_BYTES * 100);
                 debug("%s msgs sent: %d, dropped: %d (avg %f percent)",
                         descriptorToString(&descriptor),
                         sentMessageStats[i].total,
                         droppedMessageStats[i].total,
                         statistics::exponentialMovingAverage(&droppedMessageStats[i]) /
                             statistics::exponentialMovingAverage(&totalMessageStats[i]) * 100);
+                debug("%s msgs dropped from priority lane: %d, bulk lane: %d",
+                        descriptorToString(&descriptor),
+                        droppedLaneMessageStats[i][slabpool::Lane::PRIORITY].total,
+                        droppedLaneMessageStats[i][slabpool::Lane::BULK].total);
+                if(pipeline->coalescing.replaced[i] > 0) {
+                    debug("%s coalesced away %u stale values",
+                            descriptorToString(&descriptor),
+                            pipeline->coalescing.replaced[i]);
+                }
+                BackpressureStall* stall = &pipeline->stalls[i];
+                if(stall->count > 0) {
+                    debug("%s stalled waiting for room %d times, "
+                            "avg %lu us, longest %lu us",
+                            descriptorToString(&descriptor), stall->count,
+                            stall->totalUs / stall->count, stall->longestUs);
+                }
+                logLatency(pipeline, (InterfaceType) i);
                 debug("%s avg throughput: %fKB / s, %d msgs / s",
                         descriptorToString(&descriptor),
                         statistics::exponentialMovingAverage(&dataSentStats[i])
@@ -312,5 +699,76 @@ void openxc::pipeline::logStatistics(Pipeline* pipeline) {
             }
             lastTimeLogged = time::systemTimeMs();
         }
+
+        if(pipeline->coalescing.overflows > 0) {
+            debug("%u values didn't fit in the coalescing table and were "
+                    "sent in order", pipeline->coalescing.overflows);
+        }
+    }
+}
+
+void openxc::pipeline::logLatency(Pipeline* pipeline,
+        InterfaceType interfaceType) {
+    const SendLatency* latency = &pipeline->latency[interfaceType];
+    InterfaceDescriptor descriptor;
+    descriptor.type = interfaceType;
+    if(latency->received.count > 0) {
+        debug("%s CAN receipt to send latency p50: %lu us, p90: %lu us, "
+                "p99: %lu us, max: %lu us (%u msgs)",
+                descriptorToString(&descriptor),
+                statistics::percentile(&latency->received, 50),
+                statistics::percentile(&latency->received, 90),
+                statistics::percentile(&latency->received, 99),
+                latency->received.maxUs, latency->received.count);
+    }
+    if(latency->queued.count > 0) {
+        debug("%s queue to send latency p50: %lu us, p90: %lu us, "
+                "p99: %lu us, max: %lu us (%u msgs)",
+                descriptorToString(&descriptor),
+                statistics::percentile(&latency->queued, 50),
+                statistics::percentile(&latency->queued, 90),
+                statistics::percentile(&latency->queued, 99),
+                latency->queued.maxUs, latency->queued.count);
+    }
+}
+
+void openxc::pipeline::initialize(Pipeline* pipeline) {
+    resetLatency(pipeline);
+    if(pipeline->usb != NULL) {
+        pipeline->usb->endpoints[IN_ENDPOINT_INDEX].sendQueue.latency =
+                &pipeline->latency[InterfaceType::USB];
+    }
+    if(pipeline->uart != NULL) {
+        pipeline->uart->sendQueue.latency =
+                &pipeline->latency[InterfaceType::UART];
+    }
+    #ifdef TELIT_HE910_SUPPORT
+    if(pipeline->telit != NULL) {
+        pipeline->telit->sendQueue.latency =
+                &pipeline->latency[InterfaceType::TELIT];
+    }
+    #endif
+    #ifdef BLE_SUPPORT
+    if(pipeline->ble != NULL) {
+        pipeline->ble->sendQueue.latency =
+                &pipeline->latency[InterfaceType::BLE];
+    }
+    #endif
+    #ifdef FS_SUPPORT
+    if(pipeline->fs != NULL) {
+        pipeline->fs->sendQueue.latency =
+                &pipeline->latency[InterfaceType::FS];
+    }
+    #endif
+    if(pipeline->network != NULL) {
+        pipeline->network->sendQueue.latency =
+                &pipeline->latency[InterfaceType::NETWORK];
+    }
+}
+
+void openxc::pipeline::resetLatency(Pipeline* pipeline) {
+    for(int i = 0; i < PIPELINE_ENDPOINT_COUNT; i++) {
+        statistics::initialize(&pipeline->latency[i].queued);
+        statistics::initialize(&pipeline->latency[i].received);
     }
 }
@@ -8,6 +8,8 @@
 #include "interface/fs.h"
 #include "platform_profile.h"
 #include "platform/pic32/telit_he910.h"
+#include "payload/payload.h"
+#include "util/coalescing.h"
 
 
 #ifdef FS_SUPPORT
@@ -22,6 +24,12 @@ using openxc::interface::ble::BleDevice;
 using openxc::telitHE910::TelitDevice;
 
 #define MAX_OUTGOING_PAYLOAD_SIZE 340
+// The most bytes of messages in one batch, leaving room for the container so
+// the whole frame still fits in MAX_OUTGOING_PAYLOAD_SIZE.
+#define OUTPUT_BATCH_MAX_BYTES (MAX_OUTGOING_PAYLOAD_SIZE - \
+        PAYLOAD_BATCH_MAX_OVERHEAD)
+// One for each InterfaceType
+#define PIPELINE_ENDPOINT_COUNT 6
 
 namespace openxc {
 namespace pipeline {
@@ -34,6 +42,54 @@ typedef enum {
     COMMAND_RESPONSE,
 } MessageClass;
 
+/* Public: What to do with a message for an interface whose send queue doesn't
+ * have room for it.
+ *
+ * DROP_NEWEST - Drop the new message. This is the default.
+ * DROP_OLDEST - Drop the oldest messages waiting in the same lane of the
+ *      queue until the new one fits.
+ * BLOCK - Flush the interfaces until the new message fits, for at most the
+ *      configured backpressureBlockMs, and then drop it.
+ */
+typedef enum {
+    DROP_NEWEST,
+    DROP_OLDEST,
+    BLOCK,
+} BackpressurePolicy;
+
+/* Public: How long sending has stalled waiting for room on one interface.
+ *
+ * count - The number of messages that had to wait.
+ * totalUs - The total time spent waiting, in microseconds.
+ * longestUs - The longest any one message waited, in microseconds.
+ */
+typedef struct {
+    unsigned int count;
+    unsigned long totalUs;
+    unsigned long longestUs;
+} BackpressureStall;
+
+/* Public: Serialized messages waiting to be sent to an interface together in
+ * one batch frame.
+ *
+ * messages - The serialized messages, back to back.
+ * length - The number of bytes used in messages.
+ * count - The number of messages in the batch.
+ * format - The payload format the messages were serialized in.
+ * startedAt - The time the first message was added to the batch, in
+ *      milliseconds.
+ * receivedAtUs - The time the CAN message the oldest message in the batch
+ *      came from was received, in microseconds, or 0 if none came from one.
+ */
+typedef struct {
+    uint8_t messages[OUTPUT_BATCH_MAX_BYTES];
+    uint16_t length;
+    uint8_t count;
+    openxc::payload::PayloadFormat format;
+    unsigned long startedAt;
+    unsigned long receivedAtUs;
+} OutputBatch;
+
 /* Public: A container for all output devices that want to be notified of new
  *      messages from the CAN bus.
  *
@@ -41,6 +97,23 @@ typedef enum {
  * updates from CAN. Right now, this means USB and UART, but it can be extended
  * to output over another UART, Network, WiFi, etc.
  *
+ * usbBatch and networkBatch hold the messages waiting to be sent to USB and
+ * the network when output batching is enabled.
+ *
+ * stalls holds the time spent waiting for room on each interface, indexed by
+ * InterfaceType.
+ *
+ * coalescing holds the newest value of each simple vehicle message for the
+ * interfaces with output coalescing turned on, shared between them with one
+ * channel for each InterfaceType.
+ *
+ * latency holds how long the messages sent on each interface took to go out,
+ * indexed by InterfaceType.
+ *
+ * canReceivedAtUs is the time the CAN message being handled right now was
+ * received, in microseconds, or 0 if there isn't one. Messages published
+ * while it's set are timestamped with it.
+ *
  * TODO This file could most likely be refactored and improved. Ideally these
  * output interfaces would all have the same type, so this could just be a list
  * of "receiver" functions. maybe instead of the devices, this is a list of the
@@ -57,6 +130,12 @@ typedef struct {
 #endif
     TelitDevice* telit;
     NetworkDevice* network;
+    OutputBatch usbBatch;
+    OutputBatch networkBatch;
+    BackpressureStall stalls[PIPELINE_ENDPOINT_COUNT];
+    CoalescingTable coalescing;
+    SendLatency latency[PIPELINE_ENDPOINT_COUNT];
+    unsigned long canReceivedAtUs;
 } Pipeline;
 
 /* Public: Serialize the message to a bytestream (conforming to the OpenXC
@@ -65,6 +144,12 @@ typedef struct {
  *
  * This will accept both raw and translated typed messages.
  *
+ * Interfaces with output coalescing turned on (e.g. BLE, which falls behind
+ * the CAN buses easily) get only the newest value of each simple vehicle
+ * message without an event, as soon as they have room for it, instead of
+ * every value in order. Evented messages are never coalesced, since each
+ * event is a separate state. USB always gets every message.
+ *
  * message - A message structure containing the type and data for the message.
  * pipeline - The pipeline to send on.
  */
@@ -73,15 +158,38 @@ void publish(openxc_VehicleMessage* message,
 
 /* Public: Queue the message to send on all of the interfaces registered with
  *      the pipeline. If the any of the queues does not have sufficient capacity
- *      to store the message, it will be dropped for that interface only (i.e.
- *      UART can be overloaded and dropping messages but USB will continue
- *      with a 100% translation rate).
+ *      to store the message, the interface's backpressure policy decides what
+ *      is dropped for that interface only (i.e. UART can be overloaded and
+ *      dropping messages but USB will continue with a 100% translation rate).
+ *
+ * Unless an interface's policy is BLOCK, this returns right away instead of
+ * waiting for a slow interface to catch up, so reading from CAN isn't held up
+ * by it.
+ *
+ * Messages sent with this function are never coalesced, since only publish()
+ * knows which signal a message is for.
+ *
+ * The message is copied once into a shared payload slab (see
+ * util/slabpool.h) and each interface queues a reference to it, so the cost
+ * of fanning out doesn't grow with the number of interfaces.
+ *
+ * Each interface's queue has a priority lane for command responses and a bulk
+ * lane for everything else, each with its own room, and the priority lane is
+ * always drained first. A flood of vehicle data can fill the bulk lane and
+ * have its messages dropped without delaying or dropping a response.
+ *
+ * If output batching is enabled in the configuration, simple, CAN and
+ * diagnostic messages for USB and the network are held back and sent
+ * together as a single batch frame (see payload::serializeBatch) once the
+ * batch is full or its oldest message has waited long enough. Batch frames
+ * are versioned containers that only appear when a client enables batching,
+ * so clients that don't know about them are unaffected.
  *
  * pipeline - Container of all pipelines to send the message on.
  * message - The message data as an array of uint8_t.
  * messageSize - The length of the message's byte array.
  * messageClass - the class of the message, used to decide which endpoints in
- *      the pipeline receive the message.
+ *      the pipeline receive the message and the lane it's queued in.
  */
 void sendMessage(Pipeline* pipeline, uint8_t* message, int messageSize,
         MessageClass messageClass);
@@ -89,6 +197,14 @@ void sendMessage(Pipeline* pipeline, uint8_t* message, int messageSize,
 /* Public: Perform interface-specific functions to flush all message queues out
  *      to their respective physical interfaces.
  *
+ * Batches whose oldest message has waited longer than the configured
+ * outputBatchAgeMs, or all batches if batching has been turned off, are sent
+ * first.
+ *
+ * The time each message takes to be sent, from being queued and from the CAN
+ * message it came from being received, is recorded in the pipeline's latency
+ * for the interface.
+ *
  * TODO This is the tricky part with making the pipeline more generic - this
  * needs to call an interface-specific method for each queue.
  *
@@ -98,6 +214,25 @@ void process(Pipeline* pipeline);
 
 void logStatistics(Pipeline* pipeline);
 
+/* Public: Log the 50th, 90th and 99th percentile latencies of the messages
+ * sent on an interface, if it has sent any.
+ */
+void logLatency(Pipeline* pipeline,
+        openxc::interface::InterfaceType interfaceType);
+
+/* Public: Prepare the pipeline's latency to record how long the messages
+ * drained from each configured interface's send queue take to go out.
+ *
+ * Call this once the pipeline's interfaces have been assigned.
+ *
+ * pipeline - Pipeline instance with the interfaces to track.
+ */
+void initialize(Pipeline* pipeline);
+
+/* Public: Forget the latencies recorded for every interface.
+ */
+void resetLatency(Pipeline* pipeline);
+
 } // namespace interface
 } // namespace openxc
 
@@ -2,12 +2,18 @@
 #include "canutil_lpc17xx.h"
 #include "signals.h"
 #include "util/log.h"
+#include "util/timer.h"
+#include "util/profiler.h"
+#include "can/canring.h"
 #include "diagnostics.h"
 
+namespace time = openxc::util::time;
+
 using openxc::util::log::debug;
 using openxc::signals::getCanBusCount;
 using openxc::signals::getCanBuses;
 using openxc::can::shouldAcceptMessage;
+using openxc::util::profiler::ProfileStage;
 
 CanMessage receiveCanMessage(CanBus* bus) {
     CAN_MSG_Type message;
@@ -18,7 +24,8 @@ CanMessage receiveCanMessage(CanBus* bus) {
         format: message.format == STD_ID_FORMAT ?
             CanMessageFormat::STANDARD : CanMessageFormat::EXTENDED,
         data: {0},
-        length: message.len
+        length: message.len,
+        receivedAtUs: time::systemTimeUs()
     };
 
     memcpy(result.data, message.dataA, 4);
@@ -33,13 +40,14 @@ void filterForVinLocal(CanMessage* message) {
 extern "C" {
 
 void CAN_IRQHandler() {
+    PROFILE_SCOPE(ProfileStage::CAN_INTERRUPT);
     for(int i = 0; i < getCanBusCount(); i++) {
         CanBus* bus = &getCanBuses()[i];
         CanMessage message = receiveCanMessage(bus);
         if(((CAN_IntGetStatus(CAN_CONTROLLER(bus)) & 0x01) == 1) || (message.format == CanMessageFormat::STANDARD)) {
             filterForVinLocal(&message);
             if(shouldAcceptMessage(bus, message.id) &&
-                    !QUEUE_PUSH(CanMessage, &bus->receiveQueue, message)) {
+                    !openxc::can::ring::push(&bus->receiveQueue, &message)) {
                 // An exception to the "don't leave commented out code" rule,
                 // this log statement is useful for debugging performance issues
                 // but if left enabled all of the time, it can can slown down
@@ -48,7 +56,8 @@ void CAN_IRQHandler() {
                 //
                 // debug("Dropped CAN message with ID 0x%02x -- queue is full",
                 // message.id);
-                ++bus->messagesDropped;
+                //
+                // The ring counts the dropped message in its overflows.
             }
         }
     }
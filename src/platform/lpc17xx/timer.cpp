@@ -5,7 +5,14 @@
 
 #define DELAY_TIMER LPC_TIM0
 
-unsigned int SYSTEM_TICK_COUNT;
+// The Cortex-M3 DWT cycle counter and the debug register that powers it up.
+#define DEMCR (*(volatile uint32_t*) 0xE000EDFC)
+#define DEMCR_TRCENA (1 << 24)
+#define DWT_CTRL (*(volatile uint32_t*) 0xE0001000)
+#define DWT_CTRL_CYCCNTENA 1
+#define DWT_CYCCNT (*(volatile uint32_t*) 0xE0001004)
+
+volatile unsigned int SYSTEM_TICK_COUNT;
 
 extern "C" {
 
@@ -35,7 +42,29 @@ unsigned long openxc::util::time::systemTimeMs() {
     return SYSTEM_TICK_COUNT;
 }
 
+unsigned long openxc::util::time::systemTimeUs() {
+    // SysTick counts down from LOAD once per millisecond - if it reloads while
+    // we're reading it, try again so the tick count and value agree.
+    unsigned int ticks;
+    unsigned int value;
+    do {
+        ticks = SYSTEM_TICK_COUNT;
+        value = SysTick->VAL;
+    } while(ticks != SYSTEM_TICK_COUNT);
+
+    return ticks * 1000 + (SysTick->LOAD - value) * 1000 /
+            (SysTick->LOAD + 1);
+}
+
+uint32_t openxc::util::time::cycleCount() {
+    return DWT_CYCCNT;
+}
+
 void openxc::util::time::initialize() {
     // Configure for 1ms tick
     SysTick_Config(SystemCoreClock / 1000);
+
+    DEMCR |= DEMCR_TRCENA;
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
 }
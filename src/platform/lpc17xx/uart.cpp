@@ -40,6 +40,7 @@
 #endif
 
 namespace gpio = openxc::gpio;
+namespace slabpool = openxc::util::slabpool;
 
 using openxc::config::getConfiguration;
 using openxc::util::log::debug;
@@ -51,6 +52,11 @@ using openxc::gpio::GpioDirection;
 __IO int32_t RTS_STATE;
 __IO FlagStatus TRANSMIT_INTERRUPT_STATUS;
 
+// Bytes waiting for the transmit interrupt. The interrupt handler only ever
+// touches this queue, never the payload slabs in the UartDevice's sendQueue, so
+// slab reference counts are only modified from the main loop.
+static QUEUE_TYPE(uint8_t) TRANSMIT_QUEUE;
+
 /* Disable request to send through RTS line. We cannot handle any more data
  * right now.
  */
@@ -100,8 +106,8 @@ void handleTransmitInterrupt() {
 
     while(UART_CheckBusy(UART1_DEVICE) == SET);
 
-    while(!QUEUE_EMPTY(uint8_t, &getConfiguration()->uart.sendQueue)) {
-        uint8_t byte = QUEUE_PEEK(uint8_t, &getConfiguration()->uart.sendQueue);
+    while(!QUEUE_EMPTY(uint8_t, &TRANSMIT_QUEUE)) {
+        uint8_t byte = QUEUE_PEEK(uint8_t, &TRANSMIT_QUEUE);
         // We used to use non-blocking here, but then we got into a race
         // condition - if the transmit interrupt occurred while adding more data
         // to the queue, you could lose data. We should be able to switch back
@@ -109,13 +115,13 @@ void handleTransmitInterrupt() {
         // (good practice anyway) but for now switching this to block sends
         // seems to work OK without any significant impacts.
         if(UART_Send(UART1_DEVICE, &byte, 1, BLOCKING)) {
-            QUEUE_POP(uint8_t, &getConfiguration()->uart.sendQueue);
+            QUEUE_POP(uint8_t, &TRANSMIT_QUEUE);
         } else {
             break;
         }
     }
 
-    if(QUEUE_EMPTY(uint8_t, &getConfiguration()->uart.sendQueue)) {
+    if(QUEUE_EMPTY(uint8_t, &TRANSMIT_QUEUE)) {
         disableTransmitInterrupt();
         TRANSMIT_INTERRUPT_STATUS = RESET;
     } else {
@@ -253,6 +259,7 @@ void openxc::interface::uart::initialize(UartDevice* device) {
         return;
     }
     initializeCommon(device);
+    QUEUE_INIT(uint8_t, &TRANSMIT_QUEUE);
 
     // Configure P0.18 as an input, pulldown
     LPC_PINCON->PINMODE1 |= (1 << 5);
@@ -269,7 +276,16 @@ void openxc::interface::uart::initialize(UartDevice* device) {
 }
 
 void openxc::interface::uart::processSendQueue(UartDevice* device) {
-    if(!QUEUE_EMPTY(uint8_t, &device->sendQueue)) {
+    int available = QUEUE_AVAILABLE(uint8_t, &TRANSMIT_QUEUE);
+    if(available > 0 && !slabpool::empty(&device->sendQueue)) {
+        uint8_t bytes[available];
+        int byteCount = slabpool::drain(&device->sendQueue, bytes, available);
+        for(int i = 0; i < byteCount; i++) {
+            QUEUE_PUSH(uint8_t, &TRANSMIT_QUEUE, bytes[i]);
+        }
+    }
+
+    if(!QUEUE_EMPTY(uint8_t, &TRANSMIT_QUEUE)) {
         if(TRANSMIT_INTERRUPT_STATUS == RESET) {
             handleTransmitInterrupt();
         } else {
@@ -34,6 +34,7 @@ extern "C" {
 namespace gpio = openxc::gpio;
 namespace commands = openxc::commands;
 namespace usb = openxc::interface::usb;
+namespace slabpool = openxc::util::slabpool;
 
 using openxc::config::getConfiguration;
 using openxc::util::log::debug;
@@ -112,20 +113,16 @@ void EVENT_USB_Device_ConfigurationChanged(void) {
 
 /* Private: Flush any queued data out to the USB host. */
 static void flushQueueToHost(UsbDevice* usbDevice, UsbEndpoint* endpoint) {
-    if(!usb::connected(usbDevice) || QUEUE_EMPTY(uint8_t, &endpoint->queue)) {
+    if(!usb::connected(usbDevice) || slabpool::empty(&endpoint->sendQueue)) {
         return;
     }
 
     uint8_t previousEndpoint = Endpoint_GetCurrentEndpoint();
     Endpoint_SelectEndpoint(endpoint->address);
     if(Endpoint_IsINReady()) {
-        // get bytes from transmit FIFO into intermediate buffer
-        int byteCount = 0;
-        while(!QUEUE_EMPTY(uint8_t, &endpoint->queue)
-                && byteCount < USB_SEND_BUFFER_SIZE) {
-            endpoint->sendBuffer[byteCount++] = QUEUE_POP(uint8_t,
-                    &endpoint->queue);
-        }
+        // get bytes from the queued payloads into intermediate buffer
+        int byteCount = slabpool::drain(&endpoint->sendQueue,
+                endpoint->sendBuffer, USB_SEND_BUFFER_SIZE);
 
         if(byteCount > 0) {
             Endpoint_Write_Stream_LE(endpoint->sendBuffer, byteCount, NULL);
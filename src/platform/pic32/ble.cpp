@@ -33,6 +33,8 @@
 #include "lights.h"
 
 
+namespace slabpool = openxc::util::slabpool;
+
 using openxc::util::bytebuffer::processQueue;
 using openxc::util::log::debug;
 using openxc::util::time::uptimeMs;
@@ -138,10 +140,7 @@ uint32_t notification_fail_retries =0;
 static void flush_ble_buffers(void) //flushing out old unsent data sitting in memory
 {
     debug("Flushing ble buffers");
-    while(QUEUE_EMPTY(uint8_t, &getConfiguration()->ble->sendQueue)==false)
-    {
-        QUEUE_POP(uint8_t, &getConfiguration()->ble->sendQueue);
-    }
+    slabpool::clear(&getConfiguration()->ble->sendQueue);
     RingBuffer_Clear(&notify_buffer_ring);
     
     while(QUEUE_EMPTY(uint8_t, &getConfiguration()->ble->receiveQueue)==false)
@@ -753,9 +752,9 @@ void openxc::interface::ble::processSendQueue(BleDevice* device)
     if(connected(device))
     {
 
-        while((RingBuffer_FreeSpace(&notify_buffer_ring) > 0) && QUEUE_EMPTY(uint8_t, &device->sendQueue)==false)
+        while((RingBuffer_FreeSpace(&notify_buffer_ring) > 0) && slabpool::empty(&device->sendQueue)==false)
         {
-            d = QUEUE_POP(uint8_t,&device->sendQueue);
+            slabpool::drain(&device->sendQueue, (uint8_t*) &d, 1);
             RingBuffer_Write(&notify_buffer_ring, &d, 1);
             
         }
@@ -2,13 +2,18 @@
 #include "canutil_pic32.h"
 #include "signals.h"
 #include "util/log.h"
+#include "util/timer.h"
+#include "util/profiler.h"
+#include "can/canring.h"
 #include "power.h"
 #include "diagnostics.h"
 
 namespace power = openxc::power;
+namespace time = openxc::util::time;
 
 using openxc::util::log::debug;
 using openxc::signals::getCanBuses;
+using openxc::util::profiler::ProfileStage;
 
 static CanMessage receiveCanMessage(CanBus* bus) {
     CAN::RxMessageBuffer* message = CAN_CONTROLLER(bus)->getRxMessage(
@@ -18,7 +23,8 @@ static CanMessage receiveCanMessage(CanBus* bus) {
         id: message->msgSID.SID,
         format: CanMessageFormat::STANDARD,
         data: {0},
-        length: (uint8_t) message->msgEID.DLC
+        length: (uint8_t) message->msgEID.DLC,
+        receivedAtUs: time::systemTimeUs()
     };
     memcpy(result.data, message->data, CAN_MESSAGE_SIZE);
 
@@ -31,6 +37,7 @@ static CanMessage receiveCanMessage(CanBus* bus) {
 }
 
 void openxc::can::pic32::handleCanInterrupt(CanBus* bus) {
+    PROFILE_SCOPE(ProfileStage::CAN_INTERRUPT);
     // handle the bus activity wake from sleep event
     if((CAN_CONTROLLER(bus)->getModuleEvent() &
                 CAN::BUS_ACTIVITY_WAKEUP_EVENT) != 0
@@ -49,7 +56,7 @@ void openxc::can::pic32::handleCanInterrupt(CanBus* bus) {
 
         CanMessage message = receiveCanMessage(bus);
         openxc::diagnostics::filterForVIN(&message);
-        if(!QUEUE_PUSH(CanMessage, &bus->receiveQueue, message)) {
+        if(!openxc::can::ring::push(&bus->receiveQueue, &message)) {
             // An exception to the "don't leave commented out code" rule,
             // this log statement is useful for debugging performance issues
             // but if left enabled all of the time, it can can slown down
@@ -57,8 +64,9 @@ void openxc::can::pic32::handleCanInterrupt(CanBus* bus) {
             // permanent interrupt handling land.
             //
             // debug("Dropped CAN message with ID 0x%02x -- queue is full with %d",
-                    // message.id, QUEUE_LENGTH(CanMessage, &bus->receiveQueue));
-            ++bus->messagesDropped;
+                    // message.id, openxc::can::ring::length(&bus->receiveQueue));
+            //
+            // The ring counts the dropped message in its overflows.
         }
 
         /* Call the CAN::updateChannel() function to let the CAN module know
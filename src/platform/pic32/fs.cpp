@@ -25,6 +25,7 @@ using openxc::config::getConfiguration;
 
 namespace lights = openxc::lights;
 namespace uart = openxc::interface::uart;
+namespace slabpool = openxc::util::slabpool;
 
 
 static FS_STATE fs_mode = FS_STATE::NONE_CONNECTED;
@@ -89,9 +90,9 @@ bool openxc::interface::fs::getSDStatus(void){
 void openxc::interface::fs::processSendQueue(FsDevice* device) 
 {    
     uint8_t d;
-    while(QUEUE_EMPTY(uint8_t, &device->sendQueue)==false && fsman_available()>0)
+    while(slabpool::empty(&device->sendQueue)==false && fsman_available()>0)
     {
-        d = QUEUE_POP(uint8_t,&device->sendQueue);
+        slabpool::drain(&device->sendQueue, &d, 1);
         write(device, &d, 1);
     }
     
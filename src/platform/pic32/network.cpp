@@ -13,6 +13,8 @@
 #define DEFAULT_MAC_ADDRESS {0, 0, 0, 0, 0, 0}
 #define DEFAULT_IP_ADDRESS {192, 168, 1, 100}
 
+namespace slabpool = openxc::util::slabpool;
+
 using openxc::util::log::debug;
 using openxc::util::bytebuffer::processQueue;
 
@@ -34,17 +36,14 @@ void openxc::interface::network::initialize(NetworkDevice* device) {
     }
 }
 
-// The message bytes are sequentially popped from the
-// send queue to the send buffer. After the buffer is full
-// or the queue is empty, the contents of the buffer are
-// sent over the network to listening clients.
+// The message bytes are drained from the send queue to the
+// send buffer. After the buffer is full or the queue is empty,
+// the contents of the buffer are sent over the network to
+// listening clients.
 void openxc::interface::network::processSendQueue(NetworkDevice* device) {
-    unsigned int byteCount = 0;
-    char sendBuffer[MAX_MESSAGE_SIZE];
-    while(!QUEUE_EMPTY(uint8_t, &device->sendQueue) &&
-            byteCount < MAX_MESSAGE_SIZE) {
-        sendBuffer[byteCount++] = QUEUE_POP(uint8_t, &device->sendQueue);
-    }
+    uint8_t sendBuffer[MAX_MESSAGE_SIZE];
+    unsigned int byteCount = slabpool::drain(&device->sendQueue, sendBuffer,
+            MAX_MESSAGE_SIZE);
 
     // must call at least one Network method to keep the TCP/IP stack alive,
     // because it's implemented all in software - a quirk of the chipKIT
@@ -33,6 +33,8 @@ API_RETURN openxc::server_api::serverPOSTdata(char* deviceId, char* host, char*
     static unsigned int state = 0;
     static const char* ctJSON = "application/json";
     static const char* ctPROTOBUF = "application/x-protobuf";
+    static const char* ctMESSAGEPACK = "application/x-msgpack";
+    const char* contentType = ctJSON;
     
     switch(state)
     {
@@ -40,12 +42,17 @@ API_RETURN openxc::server_api::serverPOSTdata(char* deviceId, char* host, char*
             state = 0;
         case 0:
             ret = Working;
+            if(getConfiguration()->payloadFormat == PayloadFormat::PROTOBUF) {
+                contentType = ctPROTOBUF;
+            } else if(getConfiguration()->payloadFormat == PayloadFormat::MESSAGEPACK) {
+                contentType = ctMESSAGEPACK;
+            }
             // compose the header for POST /data
             sprintf(header, "POST /api/%s/data HTTP/1.1\r\n"
                     "Content-Length: %u\r\n"
                     "Content-Type: %s\r\n"
                     "Host: %s\r\n"
-                    "Connection: Keep-Alive\r\n\r\n", deviceId, len, getConfiguration()->payloadFormat == PayloadFormat::PROTOBUF ? ctPROTOBUF : ctJSON, host);
+                    "Connection: Keep-Alive\r\n\r\n", deviceId, len, contentType, host);
             // configure the HTTP client
             client = http::httpClient();
             client.socketNumber = POST_DATA_SOCKET;
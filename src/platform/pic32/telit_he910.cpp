@@ -19,6 +19,7 @@ namespace can = openxc::can; // using this to get publishVehicleMessage() for GP
 namespace http = openxc::http;
 namespace telit = openxc::telitHE910;
 namespace commands = openxc::commands;
+namespace slabpool = openxc::util::slabpool;
 
 using openxc::interface::uart::UartDevice;
 using openxc::gpio::GpioValue;
@@ -1512,10 +1513,9 @@ void openxc::telitHE910::processSendQueue(TelitDevice* device) {
     // Thus the QUEUE is buffering data between successive iterations of firmwareLoop(), and 
     // our "sendBuffer" will buffer up multiple QUEUEs before flushing on a time and/or data watermark.
 
-    // pop bytes from the device send queue (stop short of sendBuffer overflow)
-    while(!QUEUE_EMPTY(uint8_t, &device->sendQueue) && (pSendBuffer - sendBuffer) < SEND_BUFFER_SIZE) {
-        *pSendBuffer++ = QUEUE_POP(uint8_t, &device->sendQueue);
-    }
+    // drain bytes from the device send queue (stop short of sendBuffer overflow)
+    pSendBuffer += slabpool::drain(&device->sendQueue, (uint8_t*)pSendBuffer,
+            SEND_BUFFER_SIZE - (pSendBuffer - sendBuffer));
 
     return;
 
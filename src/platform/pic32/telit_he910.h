@@ -108,7 +108,7 @@ typedef struct {
     openxc::interface::InterfaceDescriptor descriptor;
     ModemConfigurationDescriptor config;
     openxc::interface::uart::UartDevice* uart;
-    QUEUE_TYPE(uint8_t) sendQueue;
+    SlabQueue sendQueue;
     QUEUE_TYPE(uint8_t) receiveQueue;
     char deviceId[MAX_DEVICE_ID_LENGTH];
     char ICCID[MAX_ICCID_LENGTH];
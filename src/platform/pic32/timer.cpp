@@ -9,4 +9,13 @@ unsigned long openxc::util::time::systemTimeMs() {
     return millis();
 }
 
+unsigned long openxc::util::time::systemTimeUs() {
+    return micros();
+}
+
+uint32_t openxc::util::time::cycleCount() {
+    // The MIPS core timer counts at half the core clock
+    return _CP0_GET_COUNT();
+}
+
 void openxc::util::time::initialize() { }
@@ -59,6 +59,7 @@
 #define _UARTMODE_FLOWCONTROL 8
 
 namespace gpio = openxc::gpio;
+namespace slabpool = openxc::util::slabpool;
 
 using openxc::util::log::debug;
 using openxc::util::bytebuffer::processQueue;
@@ -141,12 +142,9 @@ void openxc::interface::uart::initialize(UartDevice* device) {
 // The chipKIT version of this function is blocking. It will entirely flush the
 // send queue before returning.
 void openxc::interface::uart::processSendQueue(UartDevice* device) {
-    int byteCount = 0;
-    char sendBuffer[MAX_MESSAGE_SIZE];
-    while(!QUEUE_EMPTY(uint8_t, &device->sendQueue) &&
-                    byteCount < MAX_MESSAGE_SIZE) {
-        sendBuffer[byteCount++] = QUEUE_POP(uint8_t, &device->sendQueue);
-    }
+    uint8_t sendBuffer[MAX_MESSAGE_SIZE];
+    int byteCount = slabpool::drain(&device->sendQueue, sendBuffer,
+            MAX_MESSAGE_SIZE);
 
     if(byteCount > 0) {
         ((HardwareSerial*)device->controller)->write((const uint8_t*)sendBuffer,
@@ -14,6 +14,7 @@ namespace gpio = openxc::gpio;
 namespace commands = openxc::commands;
 namespace usb = openxc::interface::usb;
 namespace fs = openxc::interface::fs;
+namespace slabpool = openxc::util::slabpool;
 
 using openxc::util::log::debug;
 using openxc::interface::usb::UsbDevice;
@@ -151,13 +152,9 @@ void openxc::interface::usb::processSendQueue(UsbDevice* usbDevice) {
         }
 
         while(usbDevice->configured &&
-                !QUEUE_EMPTY(uint8_t, &endpoint->queue)) {
-            int byteCount = 0;
-            while(!QUEUE_EMPTY(uint8_t, &endpoint->queue) &&
-                    byteCount < USB_SEND_BUFFER_SIZE) {
-                endpoint->sendBuffer[byteCount++] = QUEUE_POP(uint8_t,
-                        &endpoint->queue);
-            }
+                !slabpool::empty(&endpoint->sendQueue)) {
+            int byteCount = slabpool::drain(&endpoint->sendQueue,
+                    endpoint->sendBuffer, USB_SEND_BUFFER_SIZE);
 
             int nextByteIndex = 0;
             while(nextByteIndex < byteCount) {
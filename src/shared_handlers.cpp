@@ -18,10 +18,11 @@ using openxc::can::read::stateDecoder;
 using openxc::can::read::publishVehicleMessage;
 using openxc::can::read::publishNumericalMessage;
 using openxc::can::read::translateSignal;
+using openxc::can::read::loadPayload;
 using openxc::can::read::parseSignalBitfield;
 using openxc::can::read::shouldSend;
 using openxc::can::lookupSignal;
-using openxc::can::lookupSignalManagerDetails;
+using openxc::can::lookupSignalManager;
 using openxc::pipeline::Pipeline;
 
 const float openxc::signals::handlers::LITERS_PER_GALLON = 3.78541178;
@@ -102,8 +103,9 @@ openxc_DynamicField openxc::signals::handlers::tirePressureDecoder(
 
 float firstReceivedOdometerValue(SignalManager* signalManagers, int signalCount) {
     if(totalOdometerAtRestart == 0) {
-        SignalManager* odometerSignalManager = lookupSignalManagerDetails("total_odometer", signalManagers,
-                signalCount);
+        static SignalManagerBinding odometerBinding = {"total_odometer"};
+        SignalManager* odometerSignalManager = lookupSignalManager(
+                &odometerBinding, signalManagers, signalCount);
         if(odometerSignalManager != NULL && odometerSignalManager->received) {
             totalOdometerAtRestart = odometerSignalManager->lastValue;
         }
@@ -185,18 +187,27 @@ openxc_DynamicField openxc::signals::handlers::handleInverted(const CanSignal* s
 
 void openxc::signals::handlers::handleGpsMessage(const CanSignal* signal, const CanSignal* signals, SignalManager* signalManager,
         SignalManager* signalManagers, int signalCount, CanMessage* message, Pipeline* pipeline) {
+    static SignalBinding latitudeDegreesBinding = {"latitude_degrees"};
+    static SignalBinding latitudeMinutesBinding = {"latitude_minutes"};
+    static SignalBinding latitudeMinuteFractionBinding =
+            {"latitude_minute_fraction"};
+    static SignalBinding longitudeDegreesBinding = {"longitude_degrees"};
+    static SignalBinding longitudeMinutesBinding = {"longitude_minutes"};
+    static SignalBinding longitudeMinuteFractionBinding =
+            {"longitude_minute_fraction"};
+
     const CanSignal* latitudeDegreesSignal =
-        lookupSignal("latitude_degrees", signals, signalCount);
+        lookupSignal(&latitudeDegreesBinding, signals, signalCount);
     const CanSignal* latitudeMinutesSignal =
-        lookupSignal("latitude_minutes", signals, signalCount);
+        lookupSignal(&latitudeMinutesBinding, signals, signalCount);
     const CanSignal* latitudeMinuteFractionSignal =
-        lookupSignal("latitude_minute_fraction", signals, signalCount);
+        lookupSignal(&latitudeMinuteFractionBinding, signals, signalCount);
     const CanSignal* longitudeDegreesSignal =
-        lookupSignal("longitude_degrees", signals, signalCount);
+        lookupSignal(&longitudeDegreesBinding, signals, signalCount);
     const CanSignal* longitudeMinutesSignal =
-        lookupSignal("longitude_minutes", signals, signalCount);
+        lookupSignal(&longitudeMinutesBinding, signals, signalCount);
     const CanSignal* longitudeMinuteFractionSignal =
-        lookupSignal("longitude_minute_fraction", signals, signalCount);
+        lookupSignal(&longitudeMinuteFractionBinding, signals, signalCount);
 
     if(latitudeDegreesSignal == NULL ||
             latitudeMinutesSignal == NULL ||
@@ -208,14 +219,15 @@ void openxc::signals::handlers::handleGpsMessage(const CanSignal* signal, const
         return;
     }
 
-    float latitudeDegrees = parseSignalBitfield(latitudeDegreesSignal, message);
-    float latitudeMinutes = parseSignalBitfield(latitudeMinutesSignal, message);
+    uint64_t payload = loadPayload(message);
+    float latitudeDegrees = parseSignalBitfield(latitudeDegreesSignal, payload);
+    float latitudeMinutes = parseSignalBitfield(latitudeMinutesSignal, payload);
     float latitudeMinuteFraction = parseSignalBitfield(
-            latitudeMinuteFractionSignal, message);
-    float longitudeDegrees = parseSignalBitfield(longitudeDegreesSignal, message);
-    float longitudeMinutes = parseSignalBitfield(longitudeMinutesSignal, message);
+            latitudeMinuteFractionSignal, payload);
+    float longitudeDegrees = parseSignalBitfield(longitudeDegreesSignal, payload);
+    float longitudeMinutes = parseSignalBitfield(longitudeMinutesSignal, payload);
     float longitudeMinuteFraction = parseSignalBitfield(
-            longitudeMinuteFractionSignal, message);
+            longitudeMinuteFractionSignal, payload);
 
     float latitude = (latitudeMinutes + latitudeMinuteFraction) / 60.0;
     if(latitudeDegrees < 0) {
@@ -243,8 +255,10 @@ openxc_DynamicField openxc::signals::handlers::handleUnsignedSteeringWheelAngle(
         const CanSignal* signal, const CanSignal* signals, SignalManager* signalManager,
         SignalManager* signalManagers, int signalCount,
         Pipeline* pipeline, float value, bool* send) {
-    SignalManager* steeringAngleSign = lookupSignalManagerDetails("steering_wheel_angle_sign",
-            signalManagers, signalCount);
+    static SignalManagerBinding steeringAngleSignBinding =
+            {"steering_wheel_angle_sign"};
+    SignalManager* steeringAngleSign = lookupSignalManager(
+            &steeringAngleSignBinding, signalManagers, signalCount);
 
     if(steeringAngleSign == NULL) {
         debug("Unable to find stering wheel angle sign signal");
@@ -273,10 +287,12 @@ openxc_DynamicField openxc::signals::handlers::handleMultisizeWheelRotationCount
 
 void openxc::signals::handlers::handleButtonEventMessage(const CanSignal* signal, const CanSignal* signals, SignalManager* signalManager,
         SignalManager* signalManagers, int signalCount, CanMessage* message, Pipeline* pipeline) {
-    const CanSignal* buttonTypeSignal = lookupSignal("button_type", signals,
-            signalCount);
-    const CanSignal* buttonStateSignal = lookupSignal("button_state", signals,
-            signalCount);
+    static SignalBinding buttonTypeBinding = {"button_type"};
+    static SignalBinding buttonStateBinding = {"button_state"};
+    const CanSignal* buttonTypeSignal = lookupSignal(&buttonTypeBinding,
+            signals, signalCount);
+    const CanSignal* buttonStateSignal = lookupSignal(&buttonStateBinding,
+            signals, signalCount);
 
     if(buttonTypeSignal == NULL || buttonStateSignal == NULL) {
         debug("Unable to find button type and state signals");
@@ -284,8 +300,9 @@ void openxc::signals::handlers::handleButtonEventMessage(const CanSignal* signal
     }
 
     bool send = true;
-    float rawButtonType = parseSignalBitfield(buttonTypeSignal, message);
-    float rawButtonState = parseSignalBitfield(buttonStateSignal, message);
+    uint64_t payload = loadPayload(message);
+    float rawButtonType = parseSignalBitfield(buttonTypeSignal, payload);
+    float rawButtonState = parseSignalBitfield(buttonStateSignal, payload);
 
     openxc_DynamicField buttonType = stateDecoder(buttonTypeSignal,
             signals, signalManager, signalManagers, signalCount, pipeline, rawButtonType, &send);
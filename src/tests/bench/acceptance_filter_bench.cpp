@@ -0,0 +1,93 @@
+/* Time shouldAcceptMessage, which the LPC17xx CAN interrupt handler calls for
+ * every received frame, with all MAX_ACCEPTANCE_FILTERS filters in use. For
+ * comparison it also times a walk of the bus's filter list, which is how
+ * messages used to be filtered.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include "can/canutil.h"
+#include "signals.h"
+#include "bench.h"
+
+namespace can = openxc::can;
+
+using openxc::signals::getCanBuses;
+using openxc::signals::getCanBusCount;
+
+#define ITERATIONS 1000000
+
+static volatile bool SINK;
+
+static bool listAccepts(CanBus* bus, uint32_t messageId) {
+    AcceptanceFilterListEntry* entry;
+    LIST_FOREACH(entry, &bus->acceptanceFilters, entries) {
+        if(entry->filter == messageId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static double timeList(CanBus* bus, uint32_t messageId) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < ITERATIONS; i++) {
+        SINK = listAccepts(bus, messageId);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return elapsedNs(&start, &end) / ITERATIONS;
+}
+
+static double timeIndex(CanBus* bus, uint32_t messageId) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < ITERATIONS; i++) {
+        SINK = can::shouldAcceptMessage(bus, messageId);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return elapsedNs(&start, &end) / ITERATIONS;
+}
+
+int main(int argc, char* argv[]) {
+    CanBus* bus = &getCanBuses()[0];
+    can::initializeCommon(bus);
+    bus->bypassFilters = false;
+
+    // Half standard, half extended - the oldest filter is at the end of the
+    // list, so it's the worst case for the list walk.
+    for(int i = 0; i < MAX_ACCEPTANCE_FILTERS; i++) {
+        if(i % 2 == 0) {
+            can::addAcceptanceFilter(bus, 0x100 + i, CanMessageFormat::STANDARD,
+                    getCanBuses(), getCanBusCount());
+        } else {
+            can::addAcceptanceFilter(bus, 0x18daf100 + i,
+                    CanMessageFormat::EXTENDED, getCanBuses(),
+                    getCanBusCount());
+        }
+    }
+
+    struct {
+        const char* name;
+        uint32_t id;
+    } cases[] = {
+        {"standard, first filter", 0x100},
+        {"standard, no match", 0x7ff},
+        {"extended, first filter", 0x18daf101},
+        {"extended, no match", 0x18daffff},
+    };
+
+    printf("Acceptance filter lookup with %d filters, %d lookups each\n",
+            MAX_ACCEPTANCE_FILTERS, ITERATIONS);
+    printf("%-24s %-14s %-14s\n", "", "list ns/msg", "index ns/msg");
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if(listAccepts(bus, cases[i].id) !=
+                can::shouldAcceptMessage(bus, cases[i].id)) {
+            printf("Filters disagree on 0x%x\n", cases[i].id);
+            return 1;
+        }
+        printf("%-24s %-14.1f %-14.1f\n", cases[i].name,
+                timeList(bus, cases[i].id), timeIndex(bus, cases[i].id));
+    }
+    return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdlib.h>
+#include <time.h>
+
+/* Public: The number of allocations made through countingMalloc, for
+ * benchmarks that hand it to a library as its malloc.
+ */
+static unsigned long allocations;
+
+static inline void* countingMalloc(size_t size) {
+    ++allocations;
+    return malloc(size);
+}
+
+/* Public: Return the time between two clock_gettime readings, in
+ * nanoseconds.
+ */
+static inline double elapsedNs(struct timespec* start, struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) * 1e9 +
+            (end->tv_nsec - start->tv_nsec);
+}
+
+#endif // __BENCH_H__
@@ -0,0 +1,187 @@
+/* Compare deserializing JSON messages by copying them out of the payload and
+ * parsing them into a cJSON tree (how payload::json::deserialize used to do
+ * it) with tokenizing them in place with JsonReader, as it does now.
+ *
+ * The messages decoded both ways are compared first, and the benchmark fails
+ * if they differ at all.
+ */
+#include <cJSON.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "payload/json.h"
+#include "bench.h"
+
+namespace json = openxc::payload::json;
+
+#define ITERATIONS 100000
+
+static const char* MESSAGES[] = {
+    "{\"command\": \"version\"}",
+    "{\"command\": \"passthrough\", \"bus\": 1, \"enabled\": true}",
+    "{\"bus\": 1, \"id\": 42, \"data\": \"0x1234567812345678\"}",
+    "{\"name\": \"turn_signal_status\", \"value\": \"left\", \"event\": true}",
+    "{\"command\": \"diagnostic_request\", \"action\": \"add\", \"request\": "
+        "{\"bus\": 1, \"id\": 2015, \"mode\": 1, \"pid\": 12, "
+        "\"frequency\": 2.5}}",
+};
+
+static size_t dehexlify(const char source[], uint8_t* destination,
+        size_t destinationLength) {
+    size_t i = strstr(source, "0x") != NULL ? 2 : 0;
+    size_t byteIndex = 0;
+    for(; i < strlen(source) && byteIndex < destinationLength; i += 2) {
+        char bytestring[3] = {0};
+        strncpy(bytestring, &(source[i]), 2);
+        destination[byteIndex++] = strtoul(bytestring, NULL, 16);
+    }
+    return byteIndex;
+}
+
+static void cJsonDynamicField(cJSON* element, openxc_DynamicField* field) {
+    if(element->type == cJSON_String) {
+        field->type = openxc_DynamicField_Type_STRING;
+        strcpy(field->string_value, element->valuestring);
+    } else if(element->type == cJSON_False || element->type == cJSON_True) {
+        field->type = openxc_DynamicField_Type_BOOL;
+        field->boolean_value = bool(element->valueint);
+    } else if(element->type == cJSON_Number) {
+        field->type = openxc_DynamicField_Type_NUM;
+        field->numeric_value = element->valuedouble;
+    }
+}
+
+/* Private: The cJSON deserializer as it was before JsonReader, for the message
+ * types in the benchmark.
+ */
+static size_t cJsonDeserialize(uint8_t payload[], size_t length,
+        openxc_VehicleMessage* message) {
+    size_t messageLength = strnlen((const char*)payload, length) + 1;
+    uint8_t messageBuffer[messageLength];
+    memcpy(messageBuffer, payload, messageLength);
+    cJSON* root = cJSON_Parse(strchr((char*)messageBuffer, '{'));
+
+    cJSON* element = cJSON_GetObjectItem(root, "command");
+    if(element != NULL) {
+        message->type = openxc_VehicleMessage_Type_CONTROL_COMMAND;
+        openxc_ControlCommand* command = &message->control_command;
+        if(!strncmp(element->valuestring, "version", 7)) {
+            command->type = openxc_ControlCommand_Type_VERSION;
+        } else if(!strncmp(element->valuestring, "device_id", 9)) {
+            command->type = openxc_ControlCommand_Type_DEVICE_ID;
+        } else if(!strncmp(element->valuestring, "get_vin", 7)) {
+            command->type = openxc_ControlCommand_Type_GET_VIN;
+        } else if(!strncmp(element->valuestring, "platform", 8)) {
+            command->type = openxc_ControlCommand_Type_PLATFORM;
+        } else if(!strncmp(element->valuestring, "diagnostic_request", 18)) {
+            command->type = openxc_ControlCommand_Type_DIAGNOSTIC;
+            openxc_DiagnosticRequest* request =
+                    &command->diagnostic_request.request;
+            if(!strcmp(cJSON_GetObjectItem(root, "action")->valuestring,
+                        "add")) {
+                command->diagnostic_request.action =
+                        openxc_DiagnosticControlCommand_Action_ADD;
+            }
+            cJSON* requestObject = cJSON_GetObjectItem(root, "request");
+            request->bus = cJSON_GetObjectItem(requestObject, "bus")->valueint;
+            request->message_id = cJSON_GetObjectItem(requestObject,
+                    "id")->valueint;
+            request->mode = cJSON_GetObjectItem(requestObject,
+                    "mode")->valueint;
+            request->pid = cJSON_GetObjectItem(requestObject, "pid")->valueint;
+            request->frequency = cJSON_GetObjectItem(requestObject,
+                    "frequency")->valuedouble;
+        } else if(!strncmp(element->valuestring, "passthrough", 11)) {
+            command->type = openxc_ControlCommand_Type_PASSTHROUGH;
+            command->passthrough_mode_request.bus = cJSON_GetObjectItem(root,
+                    "bus")->valueint;
+            command->passthrough_mode_request.enabled = bool(
+                    cJSON_GetObjectItem(root, "enabled")->valueint);
+        }
+    } else if((element = cJSON_GetObjectItem(root, "name")) != NULL) {
+        message->type = openxc_VehicleMessage_Type_SIMPLE;
+        strcpy(message->simple_message.name, element->valuestring);
+        cJsonDynamicField(cJSON_GetObjectItem(root, "value"),
+                &message->simple_message.value);
+        cJsonDynamicField(cJSON_GetObjectItem(root, "event"),
+                &message->simple_message.event);
+    } else {
+        message->type = openxc_VehicleMessage_Type_CAN;
+        message->can_message.id = cJSON_GetObjectItem(root, "id")->valueint;
+        message->can_message.bus = cJSON_GetObjectItem(root, "bus")->valueint;
+        message->can_message.data.size = dehexlify(
+                cJSON_GetObjectItem(root, "data")->valuestring,
+                message->can_message.data.bytes,
+                sizeof(message->can_message.data.bytes));
+    }
+    cJSON_Delete(root);
+    return messageLength;
+}
+
+static bool sameMessage(const char* text) {
+    uint8_t payload[256] = {0};
+    strcpy((char*)payload, text);
+    size_t length = strlen(text) + 1;
+
+    openxc_VehicleMessage expected = openxc_VehicleMessage();
+    openxc_VehicleMessage actual = openxc_VehicleMessage();
+    size_t expectedLength = cJsonDeserialize(payload, length, &expected);
+    size_t actualLength = json::deserialize(payload, length, &actual);
+    if(expectedLength != actualLength ||
+            memcmp(&expected, &actual, sizeof(expected))) {
+        printf("Decoded message differs: %s\n", text);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    cJSON_Hooks hooks = {countingMalloc, free};
+    cJSON_InitHooks(&hooks);
+
+    const int messageCount = sizeof(MESSAGES) / sizeof(MESSAGES[0]);
+    for(int i = 0; i < messageCount; i++) {
+        if(!sameMessage(MESSAGES[i])) {
+            return 1;
+        }
+    }
+    printf("Decoded messages matched for %d messages\n", messageCount);
+
+    printf("JSON deserialization, %d messages each\n", ITERATIONS);
+    printf("%-6s %-26s %-26s\n", "", "cJSON", "JsonReader");
+    printf("%-6s %-12s %-13s %-12s %-13s\n", "size", "allocs/msg", "ns/msg",
+            "allocs/msg", "ns/msg");
+
+    for(int i = 0; i < messageCount; i++) {
+        uint8_t payload[256] = {0};
+        strcpy((char*)payload, MESSAGES[i]);
+        size_t length = strlen(MESSAGES[i]) + 1;
+        struct timespec start, end;
+
+        allocations = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for(int j = 0; j < ITERATIONS; j++) {
+            openxc_VehicleMessage message = openxc_VehicleMessage();
+            cJsonDeserialize(payload, length, &message);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        unsigned long cJsonAllocations = allocations;
+        double cJsonNs = elapsedNs(&start, &end) / ITERATIONS;
+
+        allocations = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for(int j = 0; j < ITERATIONS; j++) {
+            openxc_VehicleMessage message = openxc_VehicleMessage();
+            json::deserialize(payload, length, &message);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double readerNs = elapsedNs(&start, &end) / ITERATIONS;
+
+        printf("%-6zu %-12lu %-13.1f %-12lu %-13.1f\n", length,
+                cJsonAllocations / ITERATIONS, cJsonNs,
+                allocations / ITERATIONS, readerNs);
+    }
+    return 0;
+}
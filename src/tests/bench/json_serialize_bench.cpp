@@ -0,0 +1,230 @@
+/* Compare serializing messages to JSON by building a cJSON tree and printing
+ * it (how payload::json::serialize used to do it) with the streaming
+ * JsonWriter it uses now.
+ *
+ * The output of both is compared byte for byte first, for a few typical
+ * messages and then for a sweep of numeric values, and the benchmark fails if
+ * they differ at all.
+ */
+#include <cJSON.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "payload/json.h"
+#include "bench.h"
+
+namespace json = openxc::payload::json;
+
+#define ITERATIONS 100000
+#define NUMBER_SWEEP_COUNT 1000000
+
+static void addHex(cJSON* root, const char* name, const uint8_t* bytes,
+        int size, char* encoded, int encodedSize) {
+    const char* maxAddress = encoded + encodedSize;
+    char* index = encoded;
+    index += sprintf(index, "0x");
+    for(int i = 0; i < size && index < maxAddress; i++) {
+        index += snprintf(index, maxAddress - index, "%02x", bytes[i]);
+    }
+    cJSON_AddStringToObject(root, name, encoded);
+}
+
+static void addDynamicField(cJSON* root, const char* name,
+        openxc_DynamicField* field) {
+    if(field->type == openxc_DynamicField_Type_NUM) {
+        cJSON_AddNumberToObject(root, name, field->numeric_value);
+    } else if(field->type == openxc_DynamicField_Type_BOOL) {
+        cJSON_AddBoolToObject(root, name, field->boolean_value);
+    } else if(field->type == openxc_DynamicField_Type_STRING) {
+        cJSON_AddStringToObject(root, name, field->string_value);
+    }
+}
+
+/* Private: The cJSON serializer as it was before JsonWriter, for the message
+ * types in the benchmark.
+ */
+static int cJsonSerialize(openxc_VehicleMessage* message, uint8_t payload[],
+        size_t length) {
+    cJSON* root = cJSON_CreateObject();
+    if(message->timestamp != 0) {
+        cJSON_AddNumberToObject(root, "timestamp", message->timestamp);
+    }
+
+    if(message->type == openxc_VehicleMessage_Type_SIMPLE) {
+        cJSON_AddStringToObject(root, "name", message->simple_message.name);
+        addDynamicField(root, "value", &message->simple_message.value);
+        addDynamicField(root, "event", &message->simple_message.event);
+    } else if(message->type == openxc_VehicleMessage_Type_CAN) {
+        cJSON_AddNumberToObject(root, "bus", message->can_message.bus);
+        cJSON_AddNumberToObject(root, "id", message->can_message.id);
+        char encoded[67];
+        addHex(root, "data", message->can_message.data.bytes,
+                message->can_message.data.size, encoded, sizeof(encoded));
+    } else if(message->type == openxc_VehicleMessage_Type_DIAGNOSTIC) {
+        openxc_DiagnosticResponse* response = &message->diagnostic_response;
+        cJSON_AddNumberToObject(root, "bus", response->bus);
+        cJSON_AddNumberToObject(root, "id", response->message_id);
+        cJSON_AddNumberToObject(root, "mode", response->mode);
+        cJSON_AddBoolToObject(root, "success", response->success);
+        cJSON_AddNumberToObject(root, "pid", response->pid);
+        if(response->value.type == openxc_DynamicField_Type_NUM) {
+            cJSON_AddNumberToObject(root, "value", response->value.numeric_value);
+        } else if(response->payload.size > 0) {
+            char encoded[MAX_DIAGNOSTIC_PAYLOAD_SIZE];
+            addHex(root, "payload", response->payload.bytes,
+                    response->payload.size, encoded, sizeof(encoded));
+        }
+    } else if(message->type == openxc_VehicleMessage_Type_COMMAND_RESPONSE) {
+        cJSON_AddStringToObject(root, "command_response",
+                json::VERSION_COMMAND_NAME);
+        cJSON_AddStringToObject(root, "message",
+                message->command_response.message);
+        cJSON_AddBoolToObject(root, "status", message->command_response.status);
+    }
+
+    char* serialized = cJSON_PrintUnformatted(root);
+    size_t finalLength = strlen(serialized) + 1;
+    if(finalLength > length) {
+        finalLength = length;
+    }
+    memcpy(payload, serialized, finalLength);
+    free(serialized);
+    cJSON_Delete(root);
+    return finalLength;
+}
+
+static void buildMessages(openxc_VehicleMessage* messages) {
+    messages[0].type = openxc_VehicleMessage_Type_SIMPLE;
+    strcpy(messages[0].simple_message.name, "vehicle_speed");
+    messages[0].simple_message.value.type = openxc_DynamicField_Type_NUM;
+    messages[0].simple_message.value.numeric_value = 42.5;
+    messages[0].timestamp = 1332794184319;
+
+    messages[1].type = openxc_VehicleMessage_Type_SIMPLE;
+    strcpy(messages[1].simple_message.name, "door_status");
+    messages[1].simple_message.value.type = openxc_DynamicField_Type_STRING;
+    strcpy(messages[1].simple_message.value.string_value, "driver");
+    messages[1].simple_message.event.type = openxc_DynamicField_Type_BOOL;
+    messages[1].simple_message.event.boolean_value = true;
+
+    messages[2].type = openxc_VehicleMessage_Type_CAN;
+    messages[2].can_message.bus = 1;
+    messages[2].can_message.id = 0x4d2;
+    messages[2].can_message.data.size = 8;
+    for(int i = 0; i < 8; i++) {
+        messages[2].can_message.data.bytes[i] = 0x12 * i;
+    }
+
+    messages[3].type = openxc_VehicleMessage_Type_DIAGNOSTIC;
+    messages[3].diagnostic_response.bus = 1;
+    messages[3].diagnostic_response.message_id = 0x7e8;
+    messages[3].diagnostic_response.mode = 1;
+    messages[3].diagnostic_response.pid = 0xc;
+    messages[3].diagnostic_response.success = true;
+    messages[3].diagnostic_response.payload.size = 2;
+    messages[3].diagnostic_response.payload.bytes[0] = 0x1a;
+    messages[3].diagnostic_response.payload.bytes[1] = 0x2b;
+
+    messages[4].type = openxc_VehicleMessage_Type_COMMAND_RESPONSE;
+    messages[4].command_response.type = openxc_ControlCommand_Type_VERSION;
+    strcpy(messages[4].command_response.message, "7.2.1 (default)");
+    messages[4].command_response.status = true;
+}
+
+static bool sameOutput(openxc_VehicleMessage* message) {
+    uint8_t expected[512], actual[512];
+    int expectedLength = cJsonSerialize(message, expected, sizeof(expected));
+    int actualLength = json::serialize(message, actual, sizeof(actual));
+    if(expectedLength != actualLength ||
+            memcmp(expected, actual, expectedLength)) {
+        printf("Output differs:\n  cJSON:      %.*s\n  JsonWriter: %.*s\n",
+                expectedLength, expected, actualLength, actual);
+        return false;
+    }
+    return true;
+}
+
+/* Private: Compare the output for numbers across the whole range cJSON
+ * formats differently - integers, tiny and huge values and everything in
+ * between.
+ */
+static bool sweepNumbers() {
+    openxc_VehicleMessage message = openxc_VehicleMessage();
+    message.type = openxc_VehicleMessage_Type_SIMPLE;
+    strcpy(message.simple_message.name, "n");
+    message.simple_message.value.type = openxc_DynamicField_Type_NUM;
+
+    srand(1);
+    for(int i = 0; i < NUMBER_SWEEP_COUNT; i++) {
+        uint64_t bits = ((uint64_t) rand() << 33) ^ ((uint64_t) rand() << 11) ^
+                rand();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if(i % 2 == 0) {
+            value = (rand() % 20000001 - 10000000) / 1000.0 *
+                    pow(10, rand() % 30 - 15);
+        }
+        message.simple_message.value.numeric_value = value;
+        if(!sameOutput(&message)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    cJSON_Hooks hooks = {countingMalloc, free};
+    cJSON_InitHooks(&hooks);
+
+    const int messageCount = 5;
+    openxc_VehicleMessage messages[messageCount];
+    memset(messages, 0, sizeof(messages));
+    buildMessages(messages);
+
+    for(int i = 0; i < messageCount; i++) {
+        if(!sameOutput(&messages[i])) {
+            return 1;
+        }
+    }
+    if(!sweepNumbers()) {
+        return 1;
+    }
+    printf("Output matched for %d messages and %d numbers\n", messageCount,
+            NUMBER_SWEEP_COUNT);
+
+    printf("JSON serialization, %d messages each\n", ITERATIONS);
+    printf("%-6s %-26s %-26s\n", "", "cJSON", "JsonWriter");
+    printf("%-6s %-12s %-13s %-12s %-13s\n", "size", "allocs/msg", "ns/msg",
+            "allocs/msg", "ns/msg");
+
+    for(int i = 0; i < messageCount; i++) {
+        uint8_t payload[512];
+        struct timespec start, end;
+
+        allocations = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for(int j = 0; j < ITERATIONS; j++) {
+            cJsonSerialize(&messages[i], payload, sizeof(payload));
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        unsigned long cJsonAllocations = allocations;
+        double cJsonNs = elapsedNs(&start, &end) / ITERATIONS;
+
+        allocations = 0;
+        int size = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for(int j = 0; j < ITERATIONS; j++) {
+            size = json::serialize(&messages[i], payload, sizeof(payload));
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double writerNs = elapsedNs(&start, &end) / ITERATIONS;
+
+        printf("%-6d %-12lu %-13.1f %-12lu %-13.1f\n", size,
+                cJsonAllocations / ITERATIONS, cJsonNs,
+                allocations / ITERATIONS, writerNs);
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+/* Compare the number of payload bytes copied when a serialized message is
+ * published to USB, UART and network at the same time - once into a byte queue
+ * per interface (how the pipeline used to queue them) and once into a shared
+ * payload slab (how pipeline::sendMessage queues them now).
+ *
+ * Only the copies made when publishing are counted. Draining a queue out to
+ * the hardware costs one copy per interface either way.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "pipeline.h"
+#include "config.h"
+#include "util/bytebuffer.h"
+#include "util/slabpool.h"
+#include "bench.h"
+
+namespace usb = openxc::interface::usb;
+namespace uart = openxc::interface::uart;
+namespace network = openxc::interface::network;
+namespace slabpool = openxc::util::slabpool;
+
+using openxc::pipeline::MessageClass;
+using openxc::pipeline::Pipeline;
+using openxc::util::bytebuffer::conditionalEnqueue;
+using openxc::config::getConfiguration;
+
+#define ITERATIONS 100000
+#define FANOUT_INTERFACE_COUNT 3
+
+static const char* MESSAGES[] = {
+    "{\"name\":\"vehicle_speed\",\"value\":42.5}",
+    "{\"bus\":1,\"id\":1234,\"data\":\"0x1234567812345678\"}",
+    "{\"bus\":1,\"id\":2016,\"mode\":1,\"pid\":12,\"success\":true,"
+        "\"payload\":\"0x1a2b\",\"value\":1234.5}",
+};
+
+static void configurePipeline(Pipeline* pipeline) {
+    pipeline->usb = &getConfiguration()->usb;
+    pipeline->uart = &getConfiguration()->uart;
+    pipeline->network = &getConfiguration()->network;
+    usb::initialize(pipeline->usb);
+    uart::initialize(pipeline->uart);
+    network::initialize(pipeline->network);
+    pipeline->usb->configured = true;
+    slabpool::initialize();
+}
+
+/* Private: Queue the message on a byte queue for each interface, the way the
+ * pipeline did before payloads were shared.
+ */
+static void benchPerInterfaceCopy(uint8_t* message, int size,
+        unsigned long* bytesCopied, double* nsPerMessage) {
+    QUEUE_TYPE(uint8_t) queues[FANOUT_INTERFACE_COUNT];
+    *bytesCopied = 0;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < ITERATIONS; i++) {
+        for(int j = 0; j < FANOUT_INTERFACE_COUNT; j++) {
+            QUEUE_INIT(uint8_t, &queues[j]);
+            if(conditionalEnqueue(&queues[j], message, size)) {
+                *bytesCopied += size;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *nsPerMessage = elapsedNs(&start, &end) / ITERATIONS;
+}
+
+static void benchSharedSlab(Pipeline* pipeline, uint8_t* message, int size,
+        unsigned long* bytesCopied, double* nsPerMessage) {
+    unsigned int copiedBefore = slabpool::bytesCopied();
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < ITERATIONS; i++) {
+        openxc::pipeline::sendMessage(pipeline, message, size,
+                MessageClass::SIMPLE);
+        slabpool::clear(&pipeline->usb->endpoints[IN_ENDPOINT_INDEX].sendQueue);
+        slabpool::clear(&pipeline->uart->sendQueue);
+        slabpool::clear(&pipeline->network->sendQueue);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *bytesCopied = slabpool::bytesCopied() - copiedBefore;
+    *nsPerMessage = elapsedNs(&start, &end) / ITERATIONS;
+}
+
+int main(int argc, char* argv[]) {
+    Pipeline* pipeline = &getConfiguration()->pipeline;
+    configurePipeline(pipeline);
+
+    printf("Payload fan out to %d interfaces, %d messages each\n",
+            FANOUT_INTERFACE_COUNT, ITERATIONS);
+    printf("%-6s %-26s %-26s\n", "", "per interface copy",
+            "shared slab");
+    printf("%-6s %-12s %-13s %-12s %-13s\n", "size", "bytes/msg", "ns/msg",
+            "bytes/msg", "ns/msg");
+
+    for(size_t i = 0; i < sizeof(MESSAGES) / sizeof(MESSAGES[0]); i++) {
+        uint8_t* message = (uint8_t*) MESSAGES[i];
+        int size = strlen(MESSAGES[i]) + 1;
+
+        unsigned long beforeBytes, afterBytes;
+        double beforeNs, afterNs;
+        benchPerInterfaceCopy(message, size, &beforeBytes, &beforeNs);
+        benchSharedSlab(pipeline, message, size, &afterBytes, &afterNs);
+
+        printf("%-6d %-12lu %-13.1f %-12lu %-13.1f\n", size,
+                beforeBytes / ITERATIONS, beforeNs, afterBytes / ITERATIONS,
+                afterNs);
+    }
+
+    if(slabpool::available() != PAYLOAD_SLAB_COUNT) {
+        printf("Leaked %d payload slabs\n",
+                PAYLOAD_SLAB_COUNT - slabpool::available());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+/* Compare the size of typical messages and the time to encode them in each
+ * of the payload formats - JSON, protocol buffers and MessagePack.
+ *
+ * Each message is also decoded again where the format supports reading that
+ * type of message, and the benchmark fails if it doesn't come back the same.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "payload/payload.h"
+#include "bench.h"
+
+namespace payload = openxc::payload;
+
+using openxc::payload::PayloadFormat;
+
+#define ITERATIONS 100000
+#define MESSAGE_COUNT 5
+#define FORMAT_COUNT 3
+
+static const PayloadFormat FORMATS[FORMAT_COUNT] = {
+    PayloadFormat::JSON,
+    PayloadFormat::PROTOBUF,
+    PayloadFormat::MESSAGEPACK,
+};
+
+static const char* MESSAGE_NAMES[MESSAGE_COUNT] = {
+    "simple (number)",
+    "simple (event)",
+    "CAN",
+    "diagnostic",
+    "command response",
+};
+
+static void buildMessages(openxc_VehicleMessage* messages) {
+    messages[0].type = openxc_VehicleMessage_Type_SIMPLE;
+    strcpy(messages[0].simple_message.name, "vehicle_speed");
+    messages[0].simple_message.value.type = openxc_DynamicField_Type_NUM;
+    messages[0].simple_message.value.numeric_value = 42.5;
+    messages[0].timestamp = 1332794184319;
+
+    messages[1].type = openxc_VehicleMessage_Type_SIMPLE;
+    strcpy(messages[1].simple_message.name, "door_status");
+    messages[1].simple_message.value.type = openxc_DynamicField_Type_STRING;
+    strcpy(messages[1].simple_message.value.string_value, "driver");
+    messages[1].simple_message.event.type = openxc_DynamicField_Type_BOOL;
+    messages[1].simple_message.event.boolean_value = true;
+
+    messages[2].type = openxc_VehicleMessage_Type_CAN;
+    messages[2].can_message.bus = 1;
+    messages[2].can_message.id = 0x4d2;
+    messages[2].can_message.data.size = 8;
+    for(int i = 0; i < 8; i++) {
+        messages[2].can_message.data.bytes[i] = 0x12 * i;
+    }
+
+    messages[3].type = openxc_VehicleMessage_Type_DIAGNOSTIC;
+    messages[3].diagnostic_response.bus = 1;
+    messages[3].diagnostic_response.message_id = 0x7e8;
+    messages[3].diagnostic_response.mode = 1;
+    messages[3].diagnostic_response.pid = 0xc;
+    messages[3].diagnostic_response.success = true;
+    messages[3].diagnostic_response.payload.size = 2;
+    messages[3].diagnostic_response.payload.bytes[0] = 0x1a;
+    messages[3].diagnostic_response.payload.bytes[1] = 0x2b;
+
+    messages[4].type = openxc_VehicleMessage_Type_COMMAND_RESPONSE;
+    messages[4].command_response.type = openxc_ControlCommand_Type_VERSION;
+    strcpy(messages[4].command_response.message, "7.2.1 (default)");
+    messages[4].command_response.status = true;
+}
+
+/* Private: Decode a CAN message again and make sure it matches - it's the one
+ * message type every format can both write and read.
+ */
+static bool sameCanMessage(openxc_VehicleMessage* message, PayloadFormat format,
+        uint8_t encoded[], size_t length) {
+    openxc_VehicleMessage decoded = openxc_VehicleMessage();
+    if(payload::deserialize(encoded, length, format, &decoded) == 0 ||
+            decoded.type != openxc_VehicleMessage_Type_CAN ||
+            decoded.can_message.bus != message->can_message.bus ||
+            decoded.can_message.id != message->can_message.id ||
+            decoded.can_message.data.size != message->can_message.data.size ||
+            memcmp(decoded.can_message.data.bytes,
+                message->can_message.data.bytes,
+                message->can_message.data.size)) {
+        printf("CAN message didn't survive a round trip in format %d\n",
+                format);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    openxc_VehicleMessage messages[MESSAGE_COUNT];
+    memset(messages, 0, sizeof(messages));
+    buildMessages(messages);
+
+    printf("Payload size and encoding time, %d messages each\n", ITERATIONS);
+    printf("%-18s %-18s %-18s %-18s\n", "", "JSON", "protobuf",
+            "MessagePack");
+    printf("%-18s", "");
+    for(int i = 0; i < FORMAT_COUNT; i++) {
+        printf(" %-6s %-11s", "bytes", "ns/msg");
+    }
+    printf("\n");
+
+    size_t totals[FORMAT_COUNT] = {0};
+    for(int i = 0; i < MESSAGE_COUNT; i++) {
+        printf("%-18s", MESSAGE_NAMES[i]);
+        for(int j = 0; j < FORMAT_COUNT; j++) {
+            uint8_t encoded[512];
+            int size = 0;
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for(int k = 0; k < ITERATIONS; k++) {
+                size = payload::serialize(&messages[i], encoded,
+                        sizeof(encoded), FORMATS[j]);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+
+            if(size <= 0) {
+                printf("\nUnable to encode message in format %d\n",
+                        FORMATS[j]);
+                return 1;
+            }
+            if(messages[i].type == openxc_VehicleMessage_Type_CAN &&
+                    !sameCanMessage(&messages[i], FORMATS[j], encoded,
+                        size)) {
+                return 1;
+            }
+
+            totals[j] += size;
+            printf(" %-6d %-11.1f", size, elapsedNs(&start, &end) / ITERATIONS);
+        }
+        printf("\n");
+    }
+
+    printf("%-18s", "total");
+    for(int j = 0; j < FORMAT_COUNT; j++) {
+        printf(" %-6zu %-11s", totals[j], "");
+    }
+    printf("\n");
+    return 0;
+}
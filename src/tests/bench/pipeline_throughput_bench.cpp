@@ -0,0 +1,190 @@
+/* Measure how many CAN frames per second the VI can take from a bus's receive
+ * queue all the way out to an interface's send queue - decoding, translating,
+ * serializing and publishing each one - in each payload format, with and
+ * without output batching.
+ *
+ * Frames go through receiveCan() (which runs signals::decodeCanMessage and the
+ * diagnostics manager), then pipeline::process(). The network interface stands
+ * in for the hardware, and its send queue is drained after every frame.
+ *
+ * Results are printed one JSON object per line so they can be collected and
+ * compared between builds.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "can/canread.h"
+#include "can/canring.h"
+#include "config.h"
+#include "pipeline.h"
+#include "signals.h"
+#include "util/slabpool.h"
+#include "bench.h"
+
+namespace can = openxc::can;
+namespace slabpool = openxc::util::slabpool;
+
+using openxc::config::getConfiguration;
+using openxc::config::LoggingOutputInterface;
+using openxc::interface::InterfaceType;
+using openxc::payload::PayloadFormat;
+using openxc::pipeline::Pipeline;
+using openxc::signals::getCanBuses;
+using openxc::signals::getSignals;
+using openxc::signals::getSignalCount;
+using openxc::signals::getSignalManagers;
+
+extern unsigned long FAKE_TIME;
+extern unsigned int droppedMessages[][SLAB_QUEUE_LANE_COUNT];
+extern bool receiveCan(Pipeline* pipeline, CanBus* bus);
+extern void initializeVehicleInterface();
+
+#define FRAME_COUNT 20000
+#define WARMUP_FRAME_COUNT 1000
+// The messages defined on the first bus of the test message set
+#define MESSAGE_ID_COUNT 6
+#define FORMAT_COUNT 3
+
+static const PayloadFormat FORMATS[FORMAT_COUNT] = {
+    PayloadFormat::JSON,
+    PayloadFormat::PROTOBUF,
+    PayloadFormat::MESSAGEPACK,
+};
+
+static const char* FORMAT_NAMES[FORMAT_COUNT] = {
+    "json",
+    "protobuf",
+    "messagepack",
+};
+
+static unsigned long latencies[FRAME_COUNT];
+
+/* Private: Return the number of messages dropped from every lane of the
+ * network interface's send queue so far.
+ */
+static unsigned int networkDrops() {
+    unsigned int dropped = 0;
+    for(int lane = 0; lane < SLAB_QUEUE_LANE_COUNT; lane++) {
+        dropped += droppedMessages[InterfaceType::NETWORK][lane];
+    }
+    return dropped;
+}
+
+static int compareLatencies(const void* a, const void* b) {
+    unsigned long left = *(const unsigned long*) a;
+    unsigned long right = *(const unsigned long*) b;
+    return left < right ? -1 : left > right;
+}
+
+/* Private: Build the next synthetic frame, cycling through the message IDs in
+ * the message set with pseudo-random data so signal values keep changing.
+ */
+static CanMessage nextFrame(unsigned int index) {
+    static uint32_t seed = 1;
+    CanMessage frame = {
+        id: index % MESSAGE_ID_COUNT,
+        format: CanMessageFormat::STANDARD,
+    };
+    for(int i = 0; i < CAN_MESSAGE_SIZE; i++) {
+        seed = seed * 1103515245 + 12345;
+        frame.data[i] = seed >> 16;
+    }
+    frame.length = CAN_MESSAGE_SIZE;
+    return frame;
+}
+
+/* Private: Translate every signal in the frame.
+ *
+ * The test message set's decodeCanMessage only passes frames through raw, so
+ * this stands in for the code generated for a config like
+ * examples/signals.json, which translates each signal of a known message.
+ */
+static void translateFrame(Pipeline* pipeline, CanBus* bus, CanMessage* frame) {
+    for(int i = 0; i < getSignalCount(); i++) {
+        const CanSignal* signal = &getSignals()[i];
+        if(signal->message->bus == bus && signal->message->id == frame->id) {
+            can::read::translateSignal(signal, frame, getSignals(),
+                    getSignalManagers(), getSignalCount(), pipeline);
+        }
+    }
+}
+
+/* Private: Send one frame from the bus's receive queue out to the network.
+ *
+ * Returns the number of bytes sent.
+ */
+static int processFrame(Pipeline* pipeline, CanBus* bus, unsigned int index) {
+    CanMessage frame = nextFrame(index);
+    can::ring::push(&bus->receiveQueue, &frame);
+    receiveCan(pipeline, bus);
+    translateFrame(pipeline, bus, &frame);
+    openxc::pipeline::process(pipeline);
+
+    int sent = 0;
+    uint8_t buffer[MAX_OUTGOING_PAYLOAD_SIZE];
+    while(!slabpool::empty(&pipeline->network->sendQueue)) {
+        sent += slabpool::drain(&pipeline->network->sendQueue, buffer,
+                sizeof(buffer));
+    }
+    ++FAKE_TIME;
+    return sent;
+}
+
+static void runBenchmark(Pipeline* pipeline, CanBus* bus, int formatIndex,
+        bool batching) {
+    getConfiguration()->payloadFormat = FORMATS[formatIndex];
+    getConfiguration()->outputBatching = batching;
+    for(int i = 0; i < WARMUP_FRAME_COUNT; i++) {
+        processFrame(pipeline, bus, i);
+    }
+
+    unsigned long bytes = 0;
+    unsigned int dropped = networkDrops();
+    struct timespec runStart, runEnd;
+    clock_gettime(CLOCK_MONOTONIC, &runStart);
+    for(int i = 0; i < FRAME_COUNT; i++) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bytes += processFrame(pipeline, bus, i);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        latencies[i] = elapsedNs(&start, &end);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &runEnd);
+
+    qsort(latencies, FRAME_COUNT, sizeof(latencies[0]), compareLatencies);
+    printf("{\"bench\":\"pipeline_throughput\",\"format\":\"%s\","
+            "\"batching\":%s,\"frames\":%d,\"frames_per_s\":%.0f,"
+            "\"bytes_serialized\":%lu,\"dropped\":%u,\"p50_ns\":%lu,"
+            "\"p99_ns\":%lu}\n",
+            FORMAT_NAMES[formatIndex], batching ? "true" : "false",
+            FRAME_COUNT, FRAME_COUNT * 1e9 / elapsedNs(&runStart, &runEnd),
+            bytes, networkDrops() - dropped,
+            latencies[FRAME_COUNT / 2],
+            latencies[FRAME_COUNT * 99 / 100]);
+}
+
+int main(int argc, char* argv[]) {
+    getConfiguration()->loggingOutput = LoggingOutputInterface::OFF;
+    initializeVehicleInterface();
+
+    // USB isn't configured so its test platform doesn't print every payload
+    Pipeline* pipeline = &getConfiguration()->pipeline;
+    pipeline->usb->configured = false;
+    pipeline->uart = NULL;
+    pipeline->network = &getConfiguration()->network;
+
+    CanBus* bus = &getCanBuses()[0];
+    for(int i = 0; i < FORMAT_COUNT; i++) {
+        runBenchmark(pipeline, bus, i, false);
+        runBenchmark(pipeline, bus, i, true);
+    }
+
+    if(slabpool::available() != PAYLOAD_SLAB_COUNT) {
+        printf("Leaked %d payload slabs\n",
+                PAYLOAD_SLAB_COUNT - slabpool::available());
+        return 1;
+    }
+    return 0;
+}
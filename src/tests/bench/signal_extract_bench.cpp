@@ -0,0 +1,156 @@
+/* Compare parsing every signal of a CAN message with bitfield_parse_float,
+ * which walks the message data bit by bit for each signal (how
+ * parseSignalBitfield used to do it), with loading the data once with
+ * loadPayload and extracting each signal from the 64-bit word, as
+ * parseSignalBitfield does now, and with extractBitfield templates for a
+ * layout known at compile time.
+ *
+ * The values parsed each way are compared first for every bit position and
+ * size, and the benchmark fails if they differ at all.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <canutil/read.h>
+#include "can/canread.h"
+#include "bench.h"
+
+namespace read = openxc::can::read;
+
+#define ITERATIONS 1000000
+#define MESSAGE_SIGNAL_COUNT 6
+
+// A typical message - a few flags and enumerations packed around a couple of
+// wider measurements
+static const struct {
+    uint8_t bitPosition;
+    uint8_t bitSize;
+    float factor;
+    float offset;
+} LAYOUT[MESSAGE_SIGNAL_COUNT] = {
+    {0, 1, 1, 0},
+    {1, 3, 1, 0},
+    {4, 12, 0.1, -40},
+    {16, 16, 0.01, 0},
+    {32, 8, 0.5, 0},
+    {40, 19, 0.001, -100},
+};
+
+static CanSignal signals[MESSAGE_SIGNAL_COUNT];
+
+/* Private: Fill the data of a message with the next pseudo-random bytes, so
+ * the values change from one message to the next.
+ */
+static void nextMessage(CanMessage* message) {
+    static uint32_t seed = 1;
+    for(int i = 0; i < CAN_MESSAGE_SIZE; i++) {
+        seed = seed * 1103515245 + 12345;
+        message->data[i] = seed >> 16;
+    }
+}
+
+static float parseEachBitfield(const CanMessage* message) {
+    float sum = 0;
+    for(int i = 0; i < MESSAGE_SIGNAL_COUNT; i++) {
+        sum += bitfield_parse_float(message->data, CAN_MESSAGE_SIZE,
+                signals[i].bitPosition, signals[i].bitSize,
+                signals[i].factor, signals[i].offset);
+    }
+    return sum;
+}
+
+static float parsePayload(const CanMessage* message) {
+    uint64_t payload = read::loadPayload(message);
+    float sum = 0;
+    for(int i = 0; i < MESSAGE_SIGNAL_COUNT; i++) {
+        sum += read::parseSignalBitfield(&signals[i], payload);
+    }
+    return sum;
+}
+
+static float parseFixedLayout(const CanMessage* message) {
+    uint64_t payload = read::loadPayload(message);
+    return (read::extractBitfield<0, 1>(payload) * LAYOUT[0].factor +
+                LAYOUT[0].offset) +
+            (read::extractBitfield<1, 3>(payload) * LAYOUT[1].factor +
+                LAYOUT[1].offset) +
+            (read::extractBitfield<4, 12>(payload) * LAYOUT[2].factor +
+                LAYOUT[2].offset) +
+            (read::extractBitfield<16, 16>(payload) * LAYOUT[3].factor +
+                LAYOUT[3].offset) +
+            (read::extractBitfield<32, 8>(payload) * LAYOUT[4].factor +
+                LAYOUT[4].offset) +
+            (read::extractBitfield<40, 19>(payload) * LAYOUT[5].factor +
+                LAYOUT[5].offset);
+}
+
+/* Private: Check that every bitfield that fits in a message parses the same
+ * from the loaded payload as with bitfield_parse_float.
+ */
+static bool sameValues(const CanMessage* message) {
+    uint64_t payload = read::loadPayload(message);
+    CanSignal signal = CanSignal();
+    signal.factor = 0.1;
+    signal.offset = -40;
+    for(int position = 0; position < CAN_MESSAGE_SIZE * 8; position++) {
+        for(int size = 1; position + size <= CAN_MESSAGE_SIZE * 8; size++) {
+            signal.bitPosition = position;
+            signal.bitSize = size;
+            if(bitfield_parse_float(message->data, CAN_MESSAGE_SIZE,
+                        position, size, signal.factor, signal.offset) !=
+                    read::parseSignalBitfield(&signal, payload)) {
+                printf("Parsed value differs at bit %d, size %d\n", position,
+                        size);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void runBenchmark(const char* name,
+        float (*parse)(const CanMessage*)) {
+    CanMessage message = CanMessage();
+    volatile float sink = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < ITERATIONS; i++) {
+        nextMessage(&message);
+        sink += parse(&message);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = elapsedNs(&start, &end) / ITERATIONS;
+    printf("%-22s %-13.1f %-13.1f\n", name, ns, ns / MESSAGE_SIGNAL_COUNT);
+}
+
+int main(int argc, char* argv[]) {
+    for(int i = 0; i < MESSAGE_SIGNAL_COUNT; i++) {
+        signals[i].bitPosition = LAYOUT[i].bitPosition;
+        signals[i].bitSize = LAYOUT[i].bitSize;
+        signals[i].factor = LAYOUT[i].factor;
+        signals[i].offset = LAYOUT[i].offset;
+    }
+
+    CanMessage message = CanMessage();
+    for(int i = 0; i < 16; i++) {
+        nextMessage(&message);
+        if(!sameValues(&message)) {
+            return 1;
+        }
+        if(parseEachBitfield(&message) != parsePayload(&message) ||
+                parseEachBitfield(&message) != parseFixedLayout(&message)) {
+            printf("Parsed message differs\n");
+            return 1;
+        }
+    }
+    printf("Parsed values matched for every bitfield in 16 messages\n");
+
+    printf("Parsing %d signals per message, %d messages\n",
+            MESSAGE_SIGNAL_COUNT, ITERATIONS);
+    printf("%-22s %-13s %-13s\n", "", "ns/msg", "ns/signal");
+    runBenchmark("bitfield_parse_float", parseEachBitfield);
+    runBenchmark("loadPayload", parsePayload);
+    runBenchmark("extractBitfield<>", parseFixedLayout);
+    return 0;
+}
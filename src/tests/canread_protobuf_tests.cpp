@@ -10,6 +10,7 @@
 #include "can/canwrite.h"
 
 namespace usb = openxc::interface::usb;
+namespace slabpool = openxc::util::slabpool;
 namespace can = openxc::can;
 
 using openxc::util::log::debug;
@@ -30,10 +31,10 @@ using openxc::config::getConfiguration;
 
 extern void initializeVehicleInterface();
 
-QUEUE_TYPE(uint8_t)* OUTPUT_QUEUE = &getConfiguration()->usb.endpoints[IN_ENDPOINT_INDEX].queue;
+SlabQueue* OUTPUT_QUEUE = &getConfiguration()->usb.endpoints[IN_ENDPOINT_INDEX].sendQueue;
 
 bool queueEmpty() {
-    return QUEUE_EMPTY(uint8_t, OUTPUT_QUEUE);
+    return slabpool::empty(OUTPUT_QUEUE);
 }
 
 void setup() {
@@ -51,8 +52,8 @@ void setup() {
 }
 
 openxc_VehicleMessage decodeProtobufMessage(Pipeline* pipeline) {
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, &pipeline->usb->endpoints[IN_ENDPOINT_INDEX].queue) + 1];
-    QUEUE_SNAPSHOT(uint8_t, &pipeline->usb->endpoints[IN_ENDPOINT_INDEX].queue, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(&pipeline->usb->endpoints[IN_ENDPOINT_INDEX].sendQueue) + 1];
+    slabpool::snapshot(&pipeline->usb->endpoints[IN_ENDPOINT_INDEX].sendQueue, snapshot, sizeof(snapshot));
 
     openxc_VehicleMessage decodedMessage = openxc_VehicleMessage();	// Zero fill
     pb_istream_t stream = pb_istream_from_buffer(snapshot, sizeof(snapshot));
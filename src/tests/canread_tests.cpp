@@ -1,6 +1,7 @@
 #include <check.h>
 #include <stdint.h>
 #include <string>
+#include <canutil/read.h>
 #include "signals.h"
 #include "can/canutil.h"
 #include "can/canread.h"
@@ -9,7 +10,9 @@
 #include "config.h"
 
 namespace usb = openxc::interface::usb;
+namespace slabpool = openxc::util::slabpool;
 namespace can = openxc::can;
+namespace time = openxc::util::time;
 
 using openxc::can::read::booleanDecoder;
 using openxc::can::read::ignoreDecoder;
@@ -41,11 +44,10 @@ const CanMessage TEST_MESSAGE = {
 extern unsigned long FAKE_TIME;
 extern void initializeVehicleInterface();
 
-QUEUE_TYPE(uint8_t)* OUTPUT_QUEUE = &getConfiguration()->usb.endpoints[
-        IN_ENDPOINT_INDEX].queue;
+SlabQueue* OUTPUT_QUEUE = &getConfiguration()->usb.endpoints[IN_ENDPOINT_INDEX].sendQueue;
 
 bool queueEmpty() {
-    return QUEUE_EMPTY(uint8_t, OUTPUT_QUEUE);
+    return slabpool::empty(OUTPUT_QUEUE);
 }
 
 
@@ -61,10 +63,26 @@ void setup() {
         const CanSignal* testSignal = &getSignals()[0];
         SignalManager* signalManager = lookupSignalManagerDetails(testSignal->genericName, getSignalManagers(), getSignalCount());
         getSignalManagers()[i].received = false;
+        getSignalManagers()[i].sent = false;
+        getSignalManagers()[i].sendPending = false;
+        getSignalManagers()[i].sendFilterOverridden = false;
+        getSignalManagers()[i].publishedCount = 0;
+        getSignalManagers()[i].suppressedCount = 0;
+        ((CanSignal*)&getSignals()[i])->sendFilter = SignalSendFilter();
+        ((CanSignal*)&getSignals()[i])->decodeUnchanged = false;
         ((CanSignal*)testSignal)->sendSame = true;
         signalManager->frequencyClock = {0};
         ((CanSignal*)testSignal)->decoder = NULL;
     }
+    for(int i = 0; i < getMessageCount(); i++) {
+        CanMessageDefinition* definition =
+                (CanMessageDefinition*) &getMessages()[i];
+        definition->decodeUnchanged = false;
+        definition->decoded = false;
+        definition->decodedCount = 0;
+        definition->skippedCount = 0;
+    }
+    getCanBuses()[0].passthroughCanMessages = false;
 }
 
 START_TEST (test_passthrough_decoder)
@@ -135,8 +153,8 @@ START_TEST (test_send_numerical)
     publishNumericalMessage("test", 42, &getConfiguration()->pipeline);
     fail_if(queueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot, "{\"name\":\"test\",\"value\":42}\0");
 }
@@ -149,8 +167,8 @@ START_TEST (test_preserve_float_precision)
     publishNumericalMessage("test", value, &getConfiguration()->pipeline);
     fail_if(queueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot,
             "{\"name\":\"test\",\"value\":42.500000}\0");
@@ -163,8 +181,8 @@ START_TEST (test_send_boolean)
     publishBooleanMessage("test", false, &getConfiguration()->pipeline);
     fail_if(queueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot,
             "{\"name\":\"test\",\"value\":false}\0");
@@ -177,8 +195,8 @@ START_TEST (test_send_string)
     publishStringMessage("test", "string", &getConfiguration()->pipeline);
     fail_if(queueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot,
             "{\"name\":\"test\",\"value\":\"string\"}\0");
@@ -200,8 +218,8 @@ START_TEST (test_send_evented_boolean)
     publishVehicleMessage("test", &value, &event, &getConfiguration()->pipeline);
     fail_if(queueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot,
             "{\"name\":\"test\",\"value\":\"value\",\"event\":false}\0");
@@ -223,8 +241,8 @@ START_TEST (test_send_evented_string)
     publishVehicleMessage("test", &value, &event, &getConfiguration()->pipeline);
     fail_if(queueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot,
             "{\"name\":\"test\",\"value\":\"value\",\"event\":\"event\"}\0");
@@ -245,8 +263,8 @@ START_TEST (test_send_evented_float)
     publishVehicleMessage("test", &value, &event, &getConfiguration()->pipeline);
     fail_if(queueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot,
             "{\"name\":\"test\",\"value\":\"value\",\"event\":43}\0");
@@ -264,7 +282,7 @@ START_TEST (test_passthrough_force_send_changed)
     can::read::passthroughMessage(&getCanBuses()[0], &message, getMessages(),
             getMessageCount(), &getConfiguration()->pipeline);
     fail_if(queueEmpty());
-    QUEUE_INIT(uint8_t, OUTPUT_QUEUE);
+    slabpool::clear(OUTPUT_QUEUE);
     can::read::passthroughMessage(&getCanBuses()[0], &message, getMessages(),
             getMessageCount(), &getConfiguration()->pipeline);
     fail_unless(queueEmpty());
@@ -287,7 +305,7 @@ START_TEST (test_passthrough_limited_frequency)
     can::read::passthroughMessage(&getCanBuses()[0], &message, getMessages(),
             getMessageCount(), &getConfiguration()->pipeline);
     fail_if(queueEmpty());
-    QUEUE_INIT(uint8_t, OUTPUT_QUEUE);
+    slabpool::clear(OUTPUT_QUEUE);
     can::read::passthroughMessage(&getCanBuses()[0], &message, getMessages(),
             getMessageCount(), &getConfiguration()->pipeline);
     fail_unless(queueEmpty());
@@ -311,8 +329,8 @@ START_TEST (test_passthrough_message)
             &getConfiguration()->pipeline);
     fail_if(queueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot,
             "{\"bus\":1,\"id\":42,\"data\":\"0x123456789abcdef1\"}\0");
@@ -350,8 +368,8 @@ START_TEST (test_default_decoder)
     fail_if(queueEmpty());
     fail_unless(signalManager->received);
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot,
             "{\"name\":\"torque_at_transmission\",\"value\":-19990}\0");
@@ -386,8 +404,8 @@ START_TEST (test_translate_many_signals)
     ck_assert_int_eq(11 * 34 + 2, SENT_BYTES);
     // 1 in the output queue
     fail_if(queueEmpty());
-    //ck_assert_int_eq(1 * 34, QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE));	// Protobuff 2 result
-    ck_assert_int_eq(170, QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE));
+    //ck_assert_int_eq(1 * 34, slabpool::length(OUTPUT_QUEUE));	// Protobuff 2 result
+    ck_assert_int_eq(170, slabpool::length(OUTPUT_QUEUE));
 }
 END_TEST
 
@@ -401,8 +419,8 @@ START_TEST (test_translate_float)
     fail_if(queueEmpty());
     fail_unless(signalManager->received);
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot,
             "{\"name\":\"torque_at_transmission\",\"value\":42}\0");
@@ -460,8 +478,8 @@ START_TEST (test_translate_string)
             (CanMessage*)&TEST_MESSAGE, getSignals(), getSignalManagers(), getSignalCount(), &getConfiguration()->pipeline);
     fail_if(queueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot,
             "{\"name\":\"torque_at_transmission\",\"value\":\"foo\"}\0");
@@ -483,7 +501,7 @@ START_TEST (test_unlimited_frequency)
     can::read::translateSignal(testSignal,
             (CanMessage*)&TEST_MESSAGE, getSignals(), getSignalManagers(), getSignalCount(), &getConfiguration()->pipeline);
     fail_if(queueEmpty());
-    QUEUE_INIT(uint8_t, OUTPUT_QUEUE);
+    slabpool::clear(OUTPUT_QUEUE);
     can::read::translateSignal(testSignal,
             (CanMessage*)&TEST_MESSAGE, getSignals(), getSignalManagers(), getSignalCount(), &getConfiguration()->pipeline);
     fail_if(queueEmpty());
@@ -499,7 +517,7 @@ START_TEST (test_limited_frequency)
     can::read::translateSignal(testSignal,
             (CanMessage*)&TEST_MESSAGE, getSignals(), getSignalManagers(), getSignalCount(), &getConfiguration()->pipeline);
     fail_if(queueEmpty());
-    QUEUE_INIT(uint8_t, OUTPUT_QUEUE);
+    slabpool::clear(OUTPUT_QUEUE);
     can::read::translateSignal(testSignal,
             (CanMessage*)&TEST_MESSAGE, getSignals(), getSignalManagers(), getSignalCount(), &getConfiguration()->pipeline);
     fail_unless(queueEmpty());
@@ -532,7 +550,7 @@ START_TEST (test_preserve_last_value)
     can::read::translateSignal(testSignal, (CanMessage*)&TEST_MESSAGE, getSignals(), 
         getSignalManagers(), getSignalCount(), &getConfiguration()->pipeline);
     fail_if(queueEmpty());
-    QUEUE_INIT(uint8_t, OUTPUT_QUEUE);
+    slabpool::clear(OUTPUT_QUEUE);
 
     CanMessage message = {
         id: 0,
@@ -544,8 +562,8 @@ START_TEST (test_preserve_last_value)
             getSignalCount(), &getConfiguration()->pipeline);
     fail_if(queueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot,
             "{\"name\":\"torque_at_transmission\",\"value\":-19990}\0");
@@ -561,19 +579,289 @@ START_TEST (test_dont_send_same)
             getSignalManagers(), getSignalCount(), &getConfiguration()->pipeline);
     fail_if(queueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot,
             "{\"name\":\"brake_pedal_status\",\"value\":true}\0");
 
-    QUEUE_INIT(uint8_t, OUTPUT_QUEUE);
+    slabpool::clear(OUTPUT_QUEUE);
     can::read::translateSignal(testSignal,
             (CanMessage*)&TEST_MESSAGE, getSignals(), getSignalManagers(), getSignalCount(), &getConfiguration()->pipeline);
     fail_unless(queueEmpty());
 }
 END_TEST
 
+START_TEST (test_deadband)
+{
+    const CanSignal* testSignal = &getSignals()[0];
+    SignalManager* signalManager = lookupSignalManagerDetails(
+            testSignal->genericName, getSignalManagers(), getSignalCount());
+    ((CanSignal*)testSignal)->sendFilter.deadband = 5;
+
+    ck_assert(can::read::shouldSend(testSignal, signalManager, 100));
+    ck_assert(!can::read::shouldSend(testSignal, signalManager, 100));
+    ck_assert(!can::read::shouldSend(testSignal, signalManager, 95));
+    ck_assert(can::read::shouldSend(testSignal, signalManager, 106));
+    // Changes are measured from the last value published, not received
+    ck_assert(!can::read::shouldSend(testSignal, signalManager, 102));
+    ck_assert_int_eq(2, signalManager->publishedCount);
+    ck_assert_int_eq(3, signalManager->suppressedCount);
+}
+END_TEST
+
+START_TEST (test_deadband_percent)
+{
+    const CanSignal* testSignal = &getSignals()[0];
+    SignalManager* signalManager = lookupSignalManagerDetails(
+            testSignal->genericName, getSignalManagers(), getSignalCount());
+    ((CanSignal*)testSignal)->sendFilter.deadbandPercent = 10;
+
+    ck_assert(can::read::shouldSend(testSignal, signalManager, -200));
+    ck_assert(!can::read::shouldSend(testSignal, signalManager, -181));
+    ck_assert(can::read::shouldSend(testSignal, signalManager, -221));
+}
+END_TEST
+
+START_TEST (test_min_send_interval)
+{
+    const CanSignal* testSignal = &getSignals()[0];
+    SignalManager* signalManager = lookupSignalManagerDetails(
+            testSignal->genericName, getSignalManagers(), getSignalCount());
+    ((CanSignal*)testSignal)->sendFilter.minSendInterval = 100;
+
+    ck_assert(can::read::shouldSend(testSignal, signalManager, 1));
+    FAKE_TIME += 50;
+    ck_assert(!can::read::shouldSend(testSignal, signalManager, 2));
+    FAKE_TIME += 50;
+    ck_assert(can::read::shouldSend(testSignal, signalManager, 3));
+}
+END_TEST
+
+START_TEST (test_overridden_send_filter)
+{
+    const CanSignal* testSignal = &getSignals()[0];
+    SignalManager* signalManager = lookupSignalManagerDetails(
+            testSignal->genericName, getSignalManagers(), getSignalCount());
+    ((CanSignal*)testSignal)->sendFilter.deadband = 5;
+    signalManager->sendFilter = SignalSendFilter();
+    signalManager->sendFilterOverridden = true;
+
+    can::read::translateSignal(testSignal, (CanMessage*)&TEST_MESSAGE,
+            getSignals(), getSignalManagers(), getSignalCount(),
+            &getConfiguration()->pipeline);
+    fail_if(queueEmpty());
+    slabpool::clear(OUTPUT_QUEUE);
+    can::read::translateSignal(testSignal, (CanMessage*)&TEST_MESSAGE,
+            getSignals(), getSignalManagers(), getSignalCount(),
+            &getConfiguration()->pipeline);
+    fail_if(queueEmpty());
+
+    signalManager->sendFilterOverridden = false;
+    slabpool::clear(OUTPUT_QUEUE);
+    can::read::translateSignal(testSignal, (CanMessage*)&TEST_MESSAGE,
+            getSignals(), getSignalManagers(), getSignalCount(),
+            &getConfiguration()->pipeline);
+    fail_unless(queueEmpty());
+}
+END_TEST
+
+START_TEST (test_parse_matches_bitfield_parse_float)
+{
+    const uint8_t patterns[][CAN_MESSAGE_SIZE] = {
+        {0xeb},
+        {0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0},
+        {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
+        {0x80, 0, 0, 0, 0, 0, 0, 0x01},
+    };
+    CanSignal signal = getSignals()[0];
+    signal.factor = 0.25;
+    signal.offset = -40;
+    for(size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        CanMessage message = {0};
+        memcpy(message.data, patterns[i], CAN_MESSAGE_SIZE);
+        uint64_t payload = can::read::loadPayload(&message);
+        for(int position = 0; position < CAN_MESSAGE_SIZE * 8; position++) {
+            for(int size = 1; position + size <= CAN_MESSAGE_SIZE * 8;
+                    size++) {
+                signal.bitPosition = position;
+                signal.bitSize = size;
+                float expected = bitfield_parse_float(message.data,
+                        CAN_MESSAGE_SIZE, position, size, signal.factor,
+                        signal.offset);
+                ck_assert(expected == can::read::parseSignalBitfield(
+                            &signal, payload));
+                ck_assert(expected == can::read::parseSignalBitfield(
+                            &signal, &message));
+            }
+        }
+    }
+}
+END_TEST
+
+START_TEST (test_parse_out_of_range)
+{
+    CanMessage message = {0};
+    memset(message.data, 0xff, CAN_MESSAGE_SIZE);
+    uint64_t payload = can::read::loadPayload(&message);
+    ck_assert_int_eq(0, can::read::extractBitfield(payload, 60, 5));
+    ck_assert_int_eq(0, can::read::extractBitfield(payload, 0, 0));
+    ck_assert_int_eq(0, can::read::extractBitfield(payload, 0, 65));
+}
+END_TEST
+
+START_TEST (test_extract_fixed_layout)
+{
+    CanMessage message = {0};
+    const uint8_t data[] = {0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0};
+    memcpy(message.data, data, CAN_MESSAGE_SIZE);
+    uint64_t payload = can::read::loadPayload(&message);
+    ck_assert(0x123456789abcdef0ULL == payload);
+    ck_assert_int_eq(can::read::extractBitfield(payload, 0, 1),
+            (can::read::extractBitfield<0, 1>(payload)));
+    ck_assert_int_eq(can::read::extractBitfield(payload, 12, 4),
+            (can::read::extractBitfield<12, 4>(payload)));
+    ck_assert_int_eq(can::read::extractBitfield(payload, 5, 19),
+            (can::read::extractBitfield<5, 19>(payload)));
+    ck_assert_int_eq(can::read::extractBitfield(payload, 60, 4),
+            (can::read::extractBitfield<60, 4>(payload)));
+    ck_assert(payload == (can::read::extractBitfield<0, 64>(payload)));
+}
+END_TEST
+
+/* Private: Mark the signals of the first test message (torque_at_transmission
+ * twice) as received and without sendSame, so only a change to the message
+ * needs decoding.
+ */
+static CanMessageDefinition* quietFirstMessage() {
+    CanMessageDefinition* definition =
+            (CanMessageDefinition*) &getMessages()[0];
+    for(int i = 0; i < getSignalCount(); i++) {
+        if(getSignals()[i].message == definition) {
+            ((CanSignal*)&getSignals()[i])->sendSame = false;
+            getSignalManagers()[i].received = true;
+        }
+    }
+    return definition;
+}
+
+static bool shouldDecode(CanMessageDefinition* definition,
+        const CanMessage* message) {
+    return can::read::shouldDecodeMessage(definition, message, getSignals(),
+            getSignalManagers(), getSignalCount());
+}
+
+START_TEST (test_skip_unchanged_message)
+{
+    CanMessageDefinition* definition = quietFirstMessage();
+    CanMessage message = TEST_MESSAGE;
+    fail_unless(shouldDecode(definition, &message));
+    fail_if(shouldDecode(definition, &message));
+    fail_if(shouldDecode(definition, &message));
+
+    message.data[1] = 0x01;
+    fail_unless(shouldDecode(definition, &message));
+    fail_if(shouldDecode(definition, &message));
+    ck_assert_int_eq(2, definition->decodedCount);
+    ck_assert_int_eq(3, definition->skippedCount);
+
+    message.length = 4;
+    fail_unless(shouldDecode(definition, &message));
+}
+END_TEST
+
+START_TEST (test_decode_unchanged_until_received)
+{
+    CanMessageDefinition* definition = quietFirstMessage();
+    getSignalManagers()[0].received = false;
+    fail_unless(shouldDecode(definition, &TEST_MESSAGE));
+    fail_unless(shouldDecode(definition, &TEST_MESSAGE));
+}
+END_TEST
+
+START_TEST (test_decode_unchanged_when_due)
+{
+    CanMessageDefinition* definition = quietFirstMessage();
+    ((CanSignal*)&getSignals()[0])->sendSame = true;
+    getSignalManagers()[0].frequencyClock = {1};
+    time::tick(&getSignalManagers()[0].frequencyClock);
+    fail_unless(shouldDecode(definition, &TEST_MESSAGE));
+    fail_if(shouldDecode(definition, &TEST_MESSAGE));
+
+    FAKE_TIME += 1000;
+    fail_unless(shouldDecode(definition, &TEST_MESSAGE));
+}
+END_TEST
+
+/* Private: Check if a value should be sent and record it as received, as
+ * decoding a signal does.
+ */
+static bool receiveValue(const CanSignal* signal, SignalManager* signalManager,
+        float value) {
+    bool send = can::read::shouldSend(signal, signalManager, value);
+    signalManager->received = true;
+    signalManager->lastValue = value;
+    return send;
+}
+
+START_TEST (test_min_send_interval_publishes_held_value)
+{
+    CanMessageDefinition* definition = quietFirstMessage();
+    const CanSignal* testSignal = &getSignals()[0];
+    SignalManager* signalManager = lookupSignalManagerDetails(
+            testSignal->genericName, getSignalManagers(), getSignalCount());
+    ((CanSignal*)testSignal)->sendFilter.minSendInterval = 100;
+    signalManager->lastValue = 0;
+
+    ck_assert(receiveValue(testSignal, signalManager, 10));
+    fail_unless(shouldDecode(definition, &TEST_MESSAGE));
+    FAKE_TIME += 50;
+    ck_assert(!receiveValue(testSignal, signalManager, 20));
+
+    // the step is held back, but the steady value after it is still decoded
+    // and published once the interval is over
+    fail_unless(shouldDecode(definition, &TEST_MESSAGE));
+    ck_assert(!receiveValue(testSignal, signalManager, 20));
+    FAKE_TIME += 60;
+    fail_unless(shouldDecode(definition, &TEST_MESSAGE));
+    ck_assert(receiveValue(testSignal, signalManager, 20));
+    ck_assert(signalManager->lastSentValue == 20);
+
+    ck_assert(!receiveValue(testSignal, signalManager, 20));
+    fail_if(shouldDecode(definition, &TEST_MESSAGE));
+}
+END_TEST
+
+START_TEST (test_decode_unchanged_opt_out)
+{
+    CanMessageDefinition* definition = quietFirstMessage();
+    ((CanSignal*)&getSignals()[6])->decodeUnchanged = true;
+    fail_unless(shouldDecode(definition, &TEST_MESSAGE));
+    fail_unless(shouldDecode(definition, &TEST_MESSAGE));
+
+    ((CanSignal*)&getSignals()[6])->decodeUnchanged = false;
+    definition->decodeUnchanged = true;
+    fail_unless(shouldDecode(definition, &TEST_MESSAGE));
+    ck_assert_int_eq(0, definition->skippedCount);
+}
+END_TEST
+
+START_TEST (test_decode_unchanged_passthrough)
+{
+    CanMessageDefinition* definition = quietFirstMessage();
+    getCanBuses()[0].passthroughCanMessages = true;
+    fail_unless(shouldDecode(definition, &TEST_MESSAGE));
+    fail_unless(shouldDecode(definition, &TEST_MESSAGE));
+}
+END_TEST
+
+START_TEST (test_decode_without_definition)
+{
+    fail_unless(shouldDecode(NULL, &TEST_MESSAGE));
+    fail_unless(shouldDecode(NULL, &TEST_MESSAGE));
+}
+END_TEST
+
 Suite* canreadSuite(void) {
     Suite* s = suite_create("canread");
     TCase *tc_core = tcase_create("core");
@@ -584,6 +872,13 @@ Suite* canreadSuite(void) {
     tcase_add_test(tc_core, test_state_decoder);
     suite_add_tcase(s, tc_core);
 
+    TCase *tc_parse = tcase_create("parse");
+    tcase_add_checked_fixture(tc_parse, setup, NULL);
+    tcase_add_test(tc_parse, test_parse_matches_bitfield_parse_float);
+    tcase_add_test(tc_parse, test_parse_out_of_range);
+    tcase_add_test(tc_parse, test_extract_fixed_layout);
+    suite_add_tcase(s, tc_parse);
+
     TCase *tc_sending = tcase_create("sending");
     tcase_add_checked_fixture(tc_sending, setup, NULL);
     tcase_add_test(tc_sending, test_send_numerical);
@@ -609,6 +904,10 @@ Suite* canreadSuite(void) {
     tcase_add_test(tc_translate, test_translate_ignore_decoder_still_received);
     tcase_add_test(tc_translate, test_default_decoder);
     tcase_add_test(tc_translate, test_dont_send_same);
+    tcase_add_test(tc_translate, test_deadband);
+    tcase_add_test(tc_translate, test_deadband_percent);
+    tcase_add_test(tc_translate, test_min_send_interval);
+    tcase_add_test(tc_translate, test_overridden_send_filter);
     tcase_add_test(tc_translate, test_translate_respects_send_value);
     tcase_add_test(tc_translate,
             test_decoder_called_every_time_with_nonzero_frequency);
@@ -616,6 +915,13 @@ Suite* canreadSuite(void) {
             test_decoder_called_every_time_with_unlimited_frequency);
     tcase_add_test(tc_translate,
             test_translate_many_signals);
+    tcase_add_test(tc_translate, test_skip_unchanged_message);
+    tcase_add_test(tc_translate, test_decode_unchanged_until_received);
+    tcase_add_test(tc_translate, test_decode_unchanged_when_due);
+    tcase_add_test(tc_translate, test_min_send_interval_publishes_held_value);
+    tcase_add_test(tc_translate, test_decode_unchanged_opt_out);
+    tcase_add_test(tc_translate, test_decode_unchanged_passthrough);
+    tcase_add_test(tc_translate, test_decode_without_definition);
     suite_add_tcase(s, tc_translate);
 
     return s;
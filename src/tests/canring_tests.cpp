@@ -0,0 +1,204 @@
+#include <check.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include "can/canring.h"
+
+namespace ring = openxc::can::ring;
+
+#define STRESS_MESSAGE_COUNT 1000000
+
+CanRing RING;
+
+static CanMessage numberedMessage(uint32_t number) {
+    CanMessage message = {
+        id: number & 0x7ff,
+        format: CanMessageFormat::STANDARD,
+    };
+    for(int i = 0; i < CAN_MESSAGE_SIZE; i++) {
+        message.data[i] = number >> ((i % 4) * 8);
+    }
+    message.length = CAN_MESSAGE_SIZE;
+    return message;
+}
+
+static uint32_t messageNumber(const CanMessage* message) {
+    uint32_t number = 0;
+    for(int i = 0; i < 4; i++) {
+        number |= (uint32_t)message->data[i] << (i * 8);
+    }
+    return number;
+}
+
+void setup() {
+    ring::initialize(&RING, 0);
+}
+
+START_TEST (test_initialize_sizes)
+{
+    ck_assert_int_eq(CAN_RECEIVE_RING_MAX_SIZE, ring::initialize(&RING, 0));
+    ck_assert_int_eq(CAN_RECEIVE_RING_MAX_SIZE, ring::initialize(&RING, 3));
+    ck_assert_int_eq(CAN_RECEIVE_RING_MAX_SIZE,
+            ring::initialize(&RING, CAN_RECEIVE_RING_MAX_SIZE * 2));
+    ck_assert_int_eq(4, ring::initialize(&RING, 4));
+    ck_assert_int_eq(1, ring::initialize(&RING, 1));
+    ck_assert(ring::empty(&RING));
+}
+END_TEST
+
+START_TEST (test_pop_empty)
+{
+    CanMessage message;
+    fail_if(ring::pop(&RING, &message));
+}
+END_TEST
+
+START_TEST (test_fifo_across_wrap)
+{
+    ring::initialize(&RING, 4);
+    uint32_t next = 0;
+    for(uint32_t i = 0; i < 50; i++) {
+        CanMessage message = numberedMessage(i);
+        fail_unless(ring::push(&RING, &message));
+        // Let 3 build up before taking 2, so the indexes wrap unevenly
+        if(ring::length(&RING) == 3) {
+            for(int j = 0; j < 2; j++) {
+                CanMessage popped;
+                fail_unless(ring::pop(&RING, &popped));
+                ck_assert_int_eq(next++, messageNumber(&popped));
+            }
+        }
+    }
+
+    CanMessage popped;
+    while(ring::pop(&RING, &popped)) {
+        ck_assert_int_eq(next++, messageNumber(&popped));
+    }
+    ck_assert_int_eq(50, next);
+    ck_assert_int_eq(0, RING.overflows);
+}
+END_TEST
+
+START_TEST (test_full_counts_overflows)
+{
+    ring::initialize(&RING, 4);
+    for(uint32_t i = 0; i < 4; i++) {
+        CanMessage message = numberedMessage(i);
+        fail_unless(ring::push(&RING, &message));
+    }
+    fail_unless(ring::full(&RING));
+
+    CanMessage message = numberedMessage(4);
+    fail_if(ring::push(&RING, &message));
+    fail_if(ring::push(&RING, &message));
+    ck_assert_int_eq(2, RING.overflows);
+    ck_assert_int_eq(4, ring::length(&RING));
+
+    CanMessage popped;
+    fail_unless(ring::pop(&RING, &popped));
+    ck_assert_int_eq(0, messageNumber(&popped));
+    fail_unless(ring::push(&RING, &message));
+}
+END_TEST
+
+START_TEST (test_high_watermark)
+{
+    CanMessage message = numberedMessage(0);
+    CanMessage popped;
+    ring::push(&RING, &message);
+    ring::push(&RING, &message);
+    ring::push(&RING, &message);
+    ring::pop(&RING, &popped);
+    ring::pop(&RING, &popped);
+    ring::push(&RING, &message);
+    ck_assert_int_eq(2, ring::length(&RING));
+    ck_assert_int_eq(3, RING.highWatermark);
+}
+END_TEST
+
+static void* produce(void* arg) {
+    for(uint32_t i = 0; i < STRESS_MESSAGE_COUNT; i++) {
+        CanMessage message = numberedMessage(i);
+        // Like the CAN interrupt handler, drop the message if the ring is
+        // full, but then give the consumer a chance to catch up in case
+        // they're sharing a CPU.
+        if(!ring::push(&RING, &message)) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+/* A producer thread stands in for the CAN interrupt handler while the test
+ * thread consumes like the main loop. Every message that wasn't counted as an
+ * overflow must come out intact and in order.
+ */
+START_TEST (test_concurrent_producer)
+{
+    ring::initialize(&RING, 8);
+    pthread_t producer;
+    ck_assert_int_eq(0, pthread_create(&producer, NULL, produce, NULL));
+
+    unsigned int received = 0;
+    uint32_t last = 0;
+    bool producing = true;
+    while(producing || !ring::empty(&RING)) {
+        CanMessage popped;
+        if(!ring::pop(&RING, &popped)) {
+            // Check for completion only after finding the ring empty, so
+            // nothing pushed before the producer finished is missed
+            producing = received + RING.overflows < STRESS_MESSAGE_COUNT;
+            sched_yield();
+            continue;
+        }
+
+        uint32_t number = messageNumber(&popped);
+        CanMessage expected = numberedMessage(number);
+        ck_assert_int_eq(expected.id, popped.id);
+        ck_assert_int_eq(expected.length, popped.length);
+        ck_assert(!memcmp(expected.data, popped.data, CAN_MESSAGE_SIZE));
+        if(received > 0) {
+            ck_assert(number > last);
+        }
+        last = number;
+        ++received;
+    }
+    pthread_join(producer, NULL);
+
+    ck_assert_int_eq(STRESS_MESSAGE_COUNT, received + RING.overflows);
+    ck_assert(RING.highWatermark <= RING.size);
+    fail_unless(ring::empty(&RING));
+}
+END_TEST
+
+Suite* suite(void) {
+    Suite* s = suite_create("canring");
+    TCase *tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, NULL);
+    tcase_add_test(tc_core, test_initialize_sizes);
+    tcase_add_test(tc_core, test_pop_empty);
+    tcase_add_test(tc_core, test_fifo_across_wrap);
+    tcase_add_test(tc_core, test_full_counts_overflows);
+    tcase_add_test(tc_core, test_high_watermark);
+    suite_add_tcase(s, tc_core);
+
+    TCase *tc_stress = tcase_create("stress");
+    tcase_add_checked_fixture(tc_stress, setup, NULL);
+    tcase_add_test(tc_stress, test_concurrent_producer);
+    suite_add_tcase(s, tc_stress);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = suite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
@@ -15,6 +15,9 @@ using openxc::can::lookupMessageDefinition;
 using openxc::can::registerMessageDefinition;
 using openxc::can::unregisterMessageDefinition;
 using openxc::can::setAcceptanceFilterStatus;
+using openxc::can::addAcceptanceFilter;
+using openxc::can::removeAcceptanceFilter;
+using openxc::can::shouldAcceptMessage;
 using openxc::signals::getCanBusCount;
 using openxc::signals::getCanBuses;
 using openxc::signals::getMessages;
@@ -23,6 +26,8 @@ using openxc::signals::getSignals;
 using openxc::signals::getSignalCount;
 using openxc::signals::getSignalManagers;
 using openxc::can::lookupSignalManagerDetails;
+using openxc::can::lookupSignalManager;
+using openxc::can::bindSignalManagers;
 using openxc::signals::getCommands;
 using openxc::signals::getCommandCount;
 
@@ -79,6 +84,54 @@ START_TEST (test_lookup_signal)
 }
 END_TEST
 
+START_TEST (test_lookup_signal_binding)
+{
+    SignalBinding binding = {"transmission_gear_position"};
+    fail_unless(lookupSignal(&binding, getSignals(), getSignalCount())
+            == &getSignals()[1]);
+    fail_unless(binding.signals == getSignals());
+    fail_unless(lookupSignal(&binding, getSignals(), getSignalCount())
+            == &getSignals()[1]);
+
+    SignalBinding missing = {"does_not_exist"};
+    fail_unless(lookupSignal(&missing, getSignals(), getSignalCount()) == NULL);
+}
+END_TEST
+
+START_TEST (test_bind_signal_managers)
+{
+    bindSignalManagers(getSignals(), getSignalManagers(), getSignalCount());
+    fail_unless(lookupSignalManager(&getSignals()[1], getSignals(),
+            getSignalManagers(), getSignalCount()) == &getSignalManagers()[1]);
+    // signals with the same name share the first one's manager, the same as a
+    // lookup by name
+    fail_unless(lookupSignalManager(&getSignals()[6], getSignals(),
+            getSignalManagers(), getSignalCount()) == &getSignalManagers()[0]);
+}
+END_TEST
+
+START_TEST (test_lookup_signal_manager_unbound)
+{
+    getSignalManagers()[2].binding = NULL;
+    fail_unless(lookupSignalManager(&getSignals()[2], getSignals(),
+            getSignalManagers(), getSignalCount()) == &getSignalManagers()[2]);
+    fail_unless(getSignalManagers()[2].binding == &getSignalManagers()[2]);
+}
+END_TEST
+
+START_TEST (test_lookup_signal_manager_binding)
+{
+    SignalManagerBinding binding = {"measurement"};
+    fail_unless(lookupSignalManager(&binding, getSignalManagers(),
+            getSignalCount()) == &getSignalManagers()[3]);
+    fail_unless(binding.signalManagers == getSignalManagers());
+
+    SignalManagerBinding missing = {"does_not_exist"};
+    fail_unless(lookupSignalManager(&missing, getSignalManagers(),
+            getSignalCount()) == NULL);
+}
+END_TEST
+
 START_TEST (test_lookup_writable_signal)
 {
     fail_unless(lookupSignal("does_not_exist", getSignals(), getSignalCount(), true
@@ -211,6 +264,71 @@ START_TEST (test_unregister_predefined)
 }
 END_TEST
 
+START_TEST (test_lookup_message_definition_format)
+{
+    ck_assert(lookupMessageDefinition(&getCanBuses()[0], 1,
+            CanMessageFormat::EXTENDED, getMessages(), getMessageCount()) == NULL);
+
+    ck_assert(registerMessageDefinition(&getCanBuses()[0], 1,
+                CanMessageFormat::EXTENDED, getMessages(), getMessageCount()));
+    CanMessageDefinition* message = lookupMessageDefinition(&getCanBuses()[0],
+            1, CanMessageFormat::EXTENDED, getMessages(), getMessageCount());
+    ck_assert(message != NULL);
+    ck_assert(message != &getMessages()[1]);
+    ck_assert(message->format == CanMessageFormat::EXTENDED);
+
+    ck_assert(lookupMessageDefinition(&getCanBuses()[0], 1,
+            CanMessageFormat::STANDARD, getMessages(), getMessageCount()) ==
+            &getMessages()[1]);
+}
+END_TEST
+
+START_TEST (test_unregister_keeps_colliding_messages)
+{
+    for(uint32_t id = 100; id < 100 + MAX_DYNAMIC_MESSAGE_COUNT; id++) {
+        ck_assert(registerMessageDefinition(&getCanBuses()[0], id,
+                    CanMessageFormat::STANDARD, getMessages(), getMessageCount()));
+    }
+
+    ck_assert(unregisterMessageDefinition(&getCanBuses()[0], 105,
+                CanMessageFormat::STANDARD));
+    ck_assert(lookupMessageDefinition(&getCanBuses()[0], 105,
+            CanMessageFormat::STANDARD, getMessages(), getMessageCount()) == NULL);
+    for(uint32_t id = 100; id < 100 + MAX_DYNAMIC_MESSAGE_COUNT; id++) {
+        if(id != 105) {
+            CanMessageDefinition* message = lookupMessageDefinition(
+                    &getCanBuses()[0], id, CanMessageFormat::STANDARD,
+                    getMessages(), getMessageCount());
+            ck_assert(message != NULL);
+            ck_assert_int_eq(message->id, id);
+        }
+    }
+
+    ck_assert(registerMessageDefinition(&getCanBuses()[0], 105,
+                CanMessageFormat::STANDARD, getMessages(), getMessageCount()));
+    ck_assert(lookupMessageDefinition(&getCanBuses()[0], 105,
+            CanMessageFormat::STANDARD, getMessages(), getMessageCount()) != NULL);
+}
+END_TEST
+
+START_TEST (test_lookup_message_definition_new_message_set)
+{
+    ck_assert(registerMessageDefinition(&getCanBuses()[0], MESSAGE_ID,
+                CanMessageFormat::STANDARD, getMessages(), getMessageCount()));
+    ck_assert(lookupMessageDefinition(&getCanBuses()[0], 1,
+            CanMessageFormat::STANDARD, getMessages(), getMessageCount()) ==
+            &getMessages()[1]);
+
+    // only the first message is predefined now
+    ck_assert(lookupMessageDefinition(&getCanBuses()[0], 1,
+            CanMessageFormat::STANDARD, getMessages(), 1) == NULL);
+    CanMessageDefinition* message = lookupMessageDefinition(&getCanBuses()[0],
+            MESSAGE_ID, CanMessageFormat::STANDARD, getMessages(), 1);
+    ck_assert(message != NULL);
+    ck_assert_int_eq(message->id, MESSAGE_ID);
+}
+END_TEST
+
 START_TEST (test_set_acceptance_filter_status)
 {
     ck_assert(setAcceptanceFilterStatus(&getCanBuses()[0], true, getCanBuses(), getCanBusCount()));
@@ -223,6 +341,91 @@ START_TEST (test_set_acceptance_filter_status)
 }
 END_TEST
 
+START_TEST (test_accept_standard_filter)
+{
+    CanBus* bus = &getCanBuses()[0];
+    bus->bypassFilters = false;
+    ck_assert(!shouldAcceptMessage(bus, 0x7df));
+    ck_assert(addAcceptanceFilter(bus, 0x7df, CanMessageFormat::STANDARD,
+                getCanBuses(), getCanBusCount()));
+    ck_assert(shouldAcceptMessage(bus, 0x7df));
+    ck_assert(!shouldAcceptMessage(bus, 0x7de));
+    ck_assert(!shouldAcceptMessage(bus, 0x7e0));
+    ck_assert(!shouldAcceptMessage(&getCanBuses()[1], 0x7df));
+}
+END_TEST
+
+START_TEST (test_accept_extended_filters)
+{
+    CanBus* bus = &getCanBuses()[0];
+    bus->bypassFilters = false;
+    uint32_t ids[] = {0x18daf110, 0x800, 0x1fffffff, 0x18db33f1, 0x12345};
+    for(size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+        ck_assert(addAcceptanceFilter(bus, ids[i], CanMessageFormat::EXTENDED,
+                    getCanBuses(), getCanBusCount()));
+    }
+
+    for(size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+        ck_assert(shouldAcceptMessage(bus, ids[i]));
+    }
+    ck_assert(!shouldAcceptMessage(bus, 0x18daf111));
+    ck_assert(!shouldAcceptMessage(bus, 0x801));
+    ck_assert(!shouldAcceptMessage(bus, 0x1ffffffe));
+}
+END_TEST
+
+START_TEST (test_accept_all_filter_slots)
+{
+    CanBus* bus = &getCanBuses()[0];
+    bus->bypassFilters = false;
+    for(int i = 0; i < MAX_ACCEPTANCE_FILTERS; i++) {
+        ck_assert(addAcceptanceFilter(bus, 0x10000000 - i * 0x100,
+                    CanMessageFormat::EXTENDED, getCanBuses(),
+                    getCanBusCount()));
+    }
+    ck_assert(!addAcceptanceFilter(bus, 0x42, CanMessageFormat::STANDARD,
+                getCanBuses(), getCanBusCount()));
+    ck_assert(!shouldAcceptMessage(bus, 0x42));
+
+    for(int i = 0; i < MAX_ACCEPTANCE_FILTERS; i++) {
+        ck_assert(shouldAcceptMessage(bus, 0x10000000 - i * 0x100));
+    }
+}
+END_TEST
+
+START_TEST (test_remove_filter_stops_accepting)
+{
+    CanBus* bus = &getCanBuses()[0];
+    bus->bypassFilters = false;
+    ck_assert(addAcceptanceFilter(bus, 0x42, CanMessageFormat::STANDARD,
+                getCanBuses(), getCanBusCount()));
+    ck_assert(addAcceptanceFilter(bus, 0x42, CanMessageFormat::STANDARD,
+                getCanBuses(), getCanBusCount()));
+    ck_assert(addAcceptanceFilter(bus, 0x18daf110, CanMessageFormat::EXTENDED,
+                getCanBuses(), getCanBusCount()));
+
+    removeAcceptanceFilter(bus, 0x42, CanMessageFormat::STANDARD,
+            getCanBuses(), getCanBusCount());
+    ck_assert(shouldAcceptMessage(bus, 0x42));
+    removeAcceptanceFilter(bus, 0x42, CanMessageFormat::STANDARD,
+            getCanBuses(), getCanBusCount());
+    ck_assert(!shouldAcceptMessage(bus, 0x42));
+
+    removeAcceptanceFilter(bus, 0x18daf110, CanMessageFormat::EXTENDED,
+            getCanBuses(), getCanBusCount());
+    ck_assert(!shouldAcceptMessage(bus, 0x18daf110));
+}
+END_TEST
+
+START_TEST (test_accept_bypass)
+{
+    CanBus* bus = &getCanBuses()[0];
+    bus->bypassFilters = true;
+    ck_assert(shouldAcceptMessage(bus, 0x42));
+    ck_assert(shouldAcceptMessage(bus, 0x18daf110));
+}
+END_TEST
+
 Suite* canutilSuite(void) {
     Suite* s = suite_create("canutil");
     TCase *tc_core = tcase_create("core");
@@ -231,6 +434,10 @@ Suite* canutilSuite(void) {
     tcase_add_test(tc_core, test_can_signal_struct);
     tcase_add_test(tc_core, test_can_signal_states);
     tcase_add_test(tc_core, test_lookup_signal);
+    tcase_add_test(tc_core, test_lookup_signal_binding);
+    tcase_add_test(tc_core, test_bind_signal_managers);
+    tcase_add_test(tc_core, test_lookup_signal_manager_unbound);
+    tcase_add_test(tc_core, test_lookup_signal_manager_binding);
     tcase_add_test(tc_core, test_lookup_writable_signal);
     tcase_add_test(tc_core, test_lookup_signal_state_by_name);
     tcase_add_test(tc_core, test_lookup_signal_state_by_value);
@@ -248,8 +455,20 @@ Suite* canutilSuite(void) {
     tcase_add_test(tc_message_def, test_unregister_can_message);
     tcase_add_test(tc_message_def, test_unregister_can_message_not_registered);
     tcase_add_test(tc_message_def, test_unregister_predefined);
+    tcase_add_test(tc_message_def, test_lookup_message_definition_format);
+    tcase_add_test(tc_message_def, test_unregister_keeps_colliding_messages);
+    tcase_add_test(tc_message_def, test_lookup_message_definition_new_message_set);
     suite_add_tcase(s, tc_message_def);
 
+    TCase *tc_filters = tcase_create("acceptance_filters");
+    tcase_add_checked_fixture(tc_filters, setup, teardown);
+    tcase_add_test(tc_filters, test_accept_standard_filter);
+    tcase_add_test(tc_filters, test_accept_extended_filters);
+    tcase_add_test(tc_filters, test_accept_all_filter_slots);
+    tcase_add_test(tc_filters, test_remove_filter_stops_accepting);
+    tcase_add_test(tc_filters, test_accept_bypass);
+    suite_add_tcase(s, tc_filters);
+
     return s;
 }
 
@@ -0,0 +1,135 @@
+#include <check.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include "util/coalescing.h"
+
+namespace coalescing = openxc::util::coalescing;
+
+#define CHANNEL 1
+#define OTHER_CHANNEL 4
+
+CoalescingTable TABLE;
+
+static CoalescingSlot* update(const char* name, const char* value) {
+    return coalescing::update(&TABLE, coalescing::key(name),
+            (const uint8_t*)value, strlen(value) + 1);
+}
+
+void setup() {
+    coalescing::initialize(&TABLE);
+}
+
+START_TEST (test_key_never_zero)
+{
+    fail_if(coalescing::key("") == 0);
+    fail_if(coalescing::key("engine_speed") == 0);
+    fail_if(coalescing::key("engine_speed") ==
+            coalescing::key("vehicle_speed"));
+}
+END_TEST
+
+START_TEST (test_update_overwrites_in_place)
+{
+    CoalescingSlot* slot = update("engine_speed", "1");
+    fail_if(slot == NULL);
+    ck_assert(update("engine_speed", "22") == slot);
+    ck_assert_int_eq(1, TABLE.slotCount);
+    ck_assert_str_eq("22", (char*)slot->payload);
+    ck_assert_int_eq(3, slot->length);
+}
+END_TEST
+
+START_TEST (test_dirty_slot_sent_once)
+{
+    CoalescingSlot* slot = update("engine_speed", "1");
+    coalescing::markDirty(&TABLE, slot, CHANNEL);
+    update("engine_speed", "2");
+    coalescing::markDirty(&TABLE, slot, CHANNEL);
+    ck_assert_int_eq(1, TABLE.replaced[CHANNEL]);
+
+    ck_assert(coalescing::nextDirty(&TABLE, CHANNEL) == slot);
+    ck_assert_str_eq("2", (char*)slot->payload);
+    coalescing::markSent(&TABLE, slot, CHANNEL);
+    ck_assert(coalescing::nextDirty(&TABLE, CHANNEL) == NULL);
+}
+END_TEST
+
+START_TEST (test_channels_independent)
+{
+    CoalescingSlot* slot = update("engine_speed", "1");
+    coalescing::markDirty(&TABLE, slot, CHANNEL);
+    coalescing::markDirty(&TABLE, slot, OTHER_CHANNEL);
+    coalescing::markSent(&TABLE, slot, CHANNEL);
+    ck_assert(coalescing::nextDirty(&TABLE, CHANNEL) == NULL);
+    ck_assert(coalescing::nextDirty(&TABLE, OTHER_CHANNEL) == slot);
+}
+END_TEST
+
+START_TEST (test_slots_take_turns)
+{
+    CoalescingSlot* first = update("a", "1");
+    CoalescingSlot* second = update("b", "2");
+    coalescing::markDirty(&TABLE, first, CHANNEL);
+    coalescing::markDirty(&TABLE, second, CHANNEL);
+    ck_assert(coalescing::nextDirty(&TABLE, CHANNEL) == first);
+    coalescing::markSent(&TABLE, first, CHANNEL);
+
+    // The first signal changing again doesn't starve the second
+    coalescing::markDirty(&TABLE, first, CHANNEL);
+    ck_assert(coalescing::nextDirty(&TABLE, CHANNEL) == second);
+    coalescing::markSent(&TABLE, second, CHANNEL);
+    ck_assert(coalescing::nextDirty(&TABLE, CHANNEL) == first);
+}
+END_TEST
+
+START_TEST (test_full_table_overflows)
+{
+    char name[8];
+    for(int i = 0; i < COALESCING_TABLE_SIZE; i++) {
+        snprintf(name, sizeof(name), "s%d", i);
+        fail_if(update(name, "1") == NULL);
+    }
+    ck_assert(update("another", "1") == NULL);
+    fail_if(update("s0", "2") == NULL);
+    ck_assert_int_eq(1, TABLE.overflows);
+}
+END_TEST
+
+START_TEST (test_large_value_overflows)
+{
+    uint8_t value[COALESCING_SLOT_SIZE + 1] = {0};
+    ck_assert(coalescing::update(&TABLE, coalescing::key("a"), value,
+                sizeof(value)) == NULL);
+    ck_assert_int_eq(1, TABLE.overflows);
+    ck_assert_int_eq(0, TABLE.slotCount);
+}
+END_TEST
+
+Suite* suite(void) {
+    Suite* s = suite_create("coalescing");
+    TCase *tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, NULL);
+    tcase_add_test(tc_core, test_key_never_zero);
+    tcase_add_test(tc_core, test_update_overwrites_in_place);
+    tcase_add_test(tc_core, test_dirty_slot_sent_once);
+    tcase_add_test(tc_core, test_channels_independent);
+    tcase_add_test(tc_core, test_slots_take_turns);
+    tcase_add_test(tc_core, test_full_table_overflows);
+    tcase_add_test(tc_core, test_large_value_overflows);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = suite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
@@ -1,5 +1,6 @@
 #include <check.h>
 #include <stdint.h>
+#include <stdio.h>
 #include "signals.h"
 #include "config.h"
 #include "diagnostics.h"
@@ -10,10 +11,15 @@
 
 namespace diagnostics = openxc::diagnostics;
 namespace usb = openxc::interface::usb;
+namespace slabpool = openxc::util::slabpool;
 
 using openxc::pipeline::Pipeline;
 using openxc::signals::getCanBuses;
 using openxc::signals::getActiveMessageSet;
+using openxc::signals::getSignals;
+using openxc::signals::getSignalCount;
+using openxc::signals::getSignalManagers;
+using openxc::can::lookupSignalManager;
 using openxc::commands::handleIncomingMessage;
 using openxc::commands::validate;
 using openxc::config::getConfiguration;
@@ -23,6 +29,7 @@ using openxc::signals::getCanBusCount;
 using openxc::payload::PayloadFormat;
 using openxc::interface::InterfaceDescriptor;
 using openxc::interface::InterfaceType;
+using openxc::pipeline::BackpressurePolicy;
 
 extern void initializeVehicleInterface();
 
@@ -30,8 +37,7 @@ extern char LAST_COMMAND_NAME[];
 extern openxc_DynamicField LAST_COMMAND_VALUE;
 extern openxc_DynamicField LAST_COMMAND_EVENT;
 
-QUEUE_TYPE(uint8_t)* OUTPUT_QUEUE = &getConfiguration()->usb.endpoints[
-        IN_ENDPOINT_INDEX].queue;
+SlabQueue* OUTPUT_QUEUE = &getConfiguration()->usb.endpoints[IN_ENDPOINT_INDEX].sendQueue;
 
 openxc_VehicleMessage CAN_MESSAGE = openxc_VehicleMessage();	// Zero Fill
 openxc_VehicleMessage SIMPLE_MESSAGE = openxc_VehicleMessage();	// Zero Fill
@@ -43,7 +49,7 @@ InterfaceDescriptor DESCRIPTOR = {
 };
 
 bool outputQueueEmpty() {
-    return QUEUE_EMPTY(uint8_t, OUTPUT_QUEUE);
+    return slabpool::empty(OUTPUT_QUEUE);
 }
 
 static bool canQueueEmpty(int bus) {
@@ -64,7 +70,16 @@ void setup() {
     getConfiguration()->desiredRunLevel = openxc::config::RunLevel::ALL_IO;
     getConfiguration()->obd2BusAddress = 0;
     getConfiguration()->payloadFormat = PayloadFormat::JSON;
+    getConfiguration()->outputBatching = false;
+    for(int i = 0; i < PIPELINE_ENDPOINT_COUNT; i++) {
+        getConfiguration()->backpressurePolicies[i] =
+                BackpressurePolicy::DROP_NEWEST;
+        getConfiguration()->outputCoalescing[i] = false;
+    }
     initializeVehicleInterface();
+    for(int i = 0; i < getSignalCount(); i++) {
+        getSignalManagers()[i].sendFilterOverridden = false;
+    }
     getConfiguration()->usb.configured = true;
     fail_unless(canQueueEmpty(0));
     ((CanMessageSet*)getActiveMessageSet())->busCount = 2;
@@ -529,6 +544,198 @@ START_TEST (test_simple_write_allowed_by_signal_override)
 }
 END_TEST
 
+START_TEST (test_output_batching_command)
+{
+    uint8_t request[] = "{\"name\": \"output_batching\", \"value\": 128, "
+            "\"event\": 50}\0";
+    ck_assert(handleIncomingMessage(request, sizeof(request), &DESCRIPTOR));
+    ck_assert(getConfiguration()->outputBatching);
+    ck_assert_int_eq(128, getConfiguration()->outputBatchBytes);
+    ck_assert_int_eq(50, getConfiguration()->outputBatchAgeMs);
+
+    uint8_t disable[] = "{\"name\": \"output_batching\", \"value\": false}\0";
+    ck_assert(handleIncomingMessage(disable, sizeof(disable), &DESCRIPTOR));
+    ck_assert(!getConfiguration()->outputBatching);
+    ck_assert_int_eq(128, getConfiguration()->outputBatchBytes);
+}
+END_TEST
+
+START_TEST (test_output_batching_command_limits_size)
+{
+    uint8_t request[] = "{\"name\": \"output_batching\", \"value\": 5000}\0";
+    ck_assert(handleIncomingMessage(request, sizeof(request), &DESCRIPTOR));
+    ck_assert(getConfiguration()->outputBatching);
+    ck_assert_int_eq(OUTPUT_BATCH_MAX_BYTES,
+            getConfiguration()->outputBatchBytes);
+}
+END_TEST
+
+START_TEST (test_output_backpressure_command)
+{
+    uint8_t request[] = "{\"name\": \"output_backpressure\", "
+            "\"value\": \"drop_oldest\", \"event\": \"uart\"}\0";
+    ck_assert(handleIncomingMessage(request, sizeof(request), &DESCRIPTOR));
+    ck_assert_int_eq(BackpressurePolicy::DROP_OLDEST,
+            getConfiguration()->backpressurePolicies[InterfaceType::UART]);
+    ck_assert_int_eq(BackpressurePolicy::DROP_NEWEST,
+            getConfiguration()->backpressurePolicies[InterfaceType::USB]);
+
+    uint8_t block[] = "{\"name\": \"output_backpressure\", \"value\": 10}\0";
+    ck_assert(handleIncomingMessage(block, sizeof(block), &DESCRIPTOR));
+    ck_assert_int_eq(10, getConfiguration()->backpressureBlockMs);
+    for(int i = 0; i < PIPELINE_ENDPOINT_COUNT; i++) {
+        ck_assert_int_eq(BackpressurePolicy::BLOCK,
+                getConfiguration()->backpressurePolicies[i]);
+    }
+    getConfiguration()->backpressureBlockMs = DEFAULT_BACKPRESSURE_BLOCK_MS;
+}
+END_TEST
+
+START_TEST (test_output_backpressure_command_unknown_interface)
+{
+    uint8_t request[] = "{\"name\": \"output_backpressure\", "
+            "\"value\": \"block\", \"event\": \"serial\"}\0";
+    ck_assert(handleIncomingMessage(request, sizeof(request), &DESCRIPTOR));
+    for(int i = 0; i < PIPELINE_ENDPOINT_COUNT; i++) {
+        ck_assert_int_eq(BackpressurePolicy::DROP_NEWEST,
+                getConfiguration()->backpressurePolicies[i]);
+    }
+}
+END_TEST
+
+START_TEST (test_output_coalescing_command)
+{
+    uint8_t request[] = "{\"name\": \"output_coalescing\", "
+            "\"value\": true, \"event\": \"network\"}\0";
+    ck_assert(handleIncomingMessage(request, sizeof(request), &DESCRIPTOR));
+    ck_assert(getConfiguration()->outputCoalescing[InterfaceType::NETWORK]);
+    ck_assert(!getConfiguration()->outputCoalescing[InterfaceType::UART]);
+
+    uint8_t all[] = "{\"name\": \"output_coalescing\", \"value\": true}\0";
+    ck_assert(handleIncomingMessage(all, sizeof(all), &DESCRIPTOR));
+    ck_assert(getConfiguration()->outputCoalescing[InterfaceType::UART]);
+    ck_assert(!getConfiguration()->outputCoalescing[InterfaceType::USB]);
+}
+END_TEST
+
+START_TEST (test_output_coalescing_command_rejects_usb)
+{
+    uint8_t request[] = "{\"name\": \"output_coalescing\", "
+            "\"value\": true, \"event\": \"usb\"}\0";
+    ck_assert(handleIncomingMessage(request, sizeof(request), &DESCRIPTOR));
+    ck_assert(!getConfiguration()->outputCoalescing[InterfaceType::USB]);
+}
+END_TEST
+
+START_TEST (test_pipeline_stats_command_resets)
+{
+    Pipeline* pipeline = &getConfiguration()->pipeline;
+    openxc::pipeline::resetLatency(pipeline);
+    openxc::util::statistics::record(
+            &pipeline->latency[InterfaceType::USB].received, 1500);
+
+    uint8_t request[] = "{\"name\": \"pipeline_stats\", "
+            "\"value\": true, \"event\": \"usb\"}\0";
+    ck_assert(handleIncomingMessage(request, sizeof(request), &DESCRIPTOR));
+    ck_assert_int_eq(1, pipeline->latency[InterfaceType::USB].received.count);
+
+    uint8_t reset[] = "{\"name\": \"pipeline_stats\", "
+            "\"value\": \"reset\"}\0";
+    ck_assert(handleIncomingMessage(reset, sizeof(reset), &DESCRIPTOR));
+    ck_assert_int_eq(0, pipeline->latency[InterfaceType::USB].received.count);
+}
+END_TEST
+
+START_TEST (test_diagnostic_rate_command)
+{
+    uint8_t request[] = "{\"command\": \"diagnostic_request\","
+           " \"action\": \"add\", \"request\": {\"name\": \"foobar\", "
+           "\"bus\": 1, \"id\": 2, \"mode\": 1, \"frequency\": 4}}\0";
+    ck_assert(handleIncomingMessage(request, sizeof(request), &DESCRIPTOR));
+    diagnostics::ActiveDiagnosticRequest* entry = TAILQ_FIRST(
+            &getConfiguration()->diagnosticsManager.recurringRequests);
+    ck_assert(entry != NULL);
+    ck_assert(!entry->adaptive);
+
+    uint8_t adaptive[] = "{\"name\": \"diagnostic_rate\", "
+            "\"value\": 0.5, \"event\": \"foobar\"}\0";
+    ck_assert(handleIncomingMessage(adaptive, sizeof(adaptive), &DESCRIPTOR));
+    ck_assert(entry->adaptive);
+    ck_assert(entry->minFrequency == 0.5);
+
+    uint8_t fixed[] = "{\"name\": \"diagnostic_rate\", "
+            "\"value\": false}\0";
+    ck_assert(handleIncomingMessage(fixed, sizeof(fixed), &DESCRIPTOR));
+    ck_assert(!entry->adaptive);
+    ck_assert(entry->frequencyClock.frequency == 4);
+}
+END_TEST
+
+START_TEST (test_diagnostic_flow_control_commands)
+{
+    uint8_t request[] = "{\"command\": \"diagnostic_request\","
+           " \"action\": \"add\", \"request\": {\"name\": \"foobar\", "
+           "\"bus\": 1, \"id\": 2, \"mode\": 1, \"frequency\": 4}}\0";
+    ck_assert(handleIncomingMessage(request, sizeof(request), &DESCRIPTOR));
+    diagnostics::ActiveDiagnosticRequest* entry = TAILQ_FIRST(
+            &getConfiguration()->diagnosticsManager.recurringRequests);
+    ck_assert(entry != NULL);
+    ck_assert_int_eq(entry->flowControl.blockSize,
+            DEFAULT_FLOW_CONTROL_BLOCK_SIZE);
+
+    uint8_t blockSize[] = "{\"name\": \"diagnostic_block_size\", "
+            "\"value\": 8, \"event\": \"foobar\"}\0";
+    ck_assert(handleIncomingMessage(blockSize, sizeof(blockSize), &DESCRIPTOR));
+    ck_assert_int_eq(entry->flowControl.blockSize, 8);
+    // only the named request changed
+    ck_assert_int_eq(getConfiguration()->diagnosticsManager.flowControl[0].blockSize,
+            DEFAULT_FLOW_CONTROL_BLOCK_SIZE);
+
+    uint8_t separationTime[] = "{\"name\": \"diagnostic_separation_time\", "
+            "\"value\": 0.5}\0";
+    ck_assert(handleIncomingMessage(separationTime, sizeof(separationTime),
+            &DESCRIPTOR));
+    ck_assert_int_eq(entry->flowControl.separationTime, 0xf5);
+    ck_assert_int_eq(entry->flowControl.blockSize, 8);
+    ck_assert_int_eq(
+            getConfiguration()->diagnosticsManager.flowControl[0].separationTime,
+            0xf5);
+}
+END_TEST
+
+START_TEST (test_signal_send_filter_commands)
+{
+    const CanSignal* signal = &getSignals()[0];
+    SignalManager* signalManager = lookupSignalManager(signal, getSignals(),
+            getSignalManagers(), getSignalCount());
+    const char* names[] = {"signal_deadband", "signal_deadband_percent",
+            "signal_min_send_interval"};
+    for(int i = 0; i < 3; i++) {
+        char request[128];
+        int length = snprintf(request, sizeof(request),
+                "{\"name\": \"%s\", \"value\": \"%s\", \"event\": %d}",
+                names[i], signal->genericName, i + 2);
+        ck_assert(handleIncomingMessage((uint8_t*)request, length + 1,
+                &DESCRIPTOR));
+    }
+
+    ck_assert(signalManager->sendFilterOverridden);
+    ck_assert(signalManager->sendFilter.deadband == 2);
+    ck_assert(signalManager->sendFilter.deadbandPercent == 3);
+    ck_assert_int_eq(4, signalManager->sendFilter.minSendInterval);
+    fail_unless(canQueueEmpty(0));
+}
+END_TEST
+
+START_TEST (test_signal_send_filter_unknown_signal)
+{
+    uint8_t request[] = "{\"name\": \"signal_deadband\", \"value\": "
+            "\"foo\", \"event\": 1}\0";
+    ck_assert(handleIncomingMessage(request, sizeof(request), &DESCRIPTOR));
+    fail_unless(canQueueEmpty(0));
+}
+END_TEST
+
 START_TEST (test_unrecognized_command_name)
 {
     uint8_t request[] = "{\"command\": \"foo\"}\0";
@@ -555,8 +762,8 @@ START_TEST (test_version_message_in_stream)
     char firmwareDescriptor[256] = {0};
     getFirmwareDescriptor(firmwareDescriptor, sizeof(firmwareDescriptor));
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert(strstr((char*)snapshot, firmwareDescriptor) != NULL);
 }
@@ -570,8 +777,8 @@ START_TEST (test_device_id_message_in_stream)
     ck_assert(handleIncomingMessage(request, sizeof(request), &DESCRIPTOR));
     ck_assert(!outputQueueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert(strstr((char*)snapshot,
                 getConfiguration()->uart.deviceId) != NULL);
@@ -812,6 +1019,21 @@ Suite* suite(void) {
     tcase_add_test(tc_complex_commands, test_simple_write_not_allowed);
     tcase_add_test(tc_complex_commands, test_simple_write_missing_value);
     tcase_add_test(tc_complex_commands, test_simple_write_no_match);
+    tcase_add_test(tc_complex_commands, test_output_batching_command);
+    tcase_add_test(tc_complex_commands,
+            test_output_batching_command_limits_size);
+    tcase_add_test(tc_complex_commands, test_output_backpressure_command);
+    tcase_add_test(tc_complex_commands,
+            test_output_backpressure_command_unknown_interface);
+    tcase_add_test(tc_complex_commands, test_output_coalescing_command);
+    tcase_add_test(tc_complex_commands,
+            test_output_coalescing_command_rejects_usb);
+    tcase_add_test(tc_complex_commands, test_pipeline_stats_command_resets);
+    tcase_add_test(tc_complex_commands, test_diagnostic_rate_command);
+    tcase_add_test(tc_complex_commands, test_diagnostic_flow_control_commands);
+    tcase_add_test(tc_complex_commands, test_signal_send_filter_commands);
+    tcase_add_test(tc_complex_commands,
+            test_signal_send_filter_unknown_signal);
     tcase_add_test(tc_complex_commands, test_custom_command);
     tcase_add_test(tc_complex_commands, test_custom_evented_command);
     tcase_add_test(tc_complex_commands,
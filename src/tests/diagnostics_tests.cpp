@@ -3,6 +3,7 @@
 #include "signals.h"
 #include "config.h"
 #include "diagnostics.h"
+#include "obd2.h"
 #include "platform/platform.h"
 
 #include "canutil_spy.h"
@@ -10,6 +11,7 @@
 
 namespace diagnostics = openxc::diagnostics;
 namespace usb = openxc::interface::usb;
+namespace slabpool = openxc::util::slabpool;
 
 using openxc::diagnostics::ActiveDiagnosticRequest;
 using openxc::diagnostics::DiagnosticsManager;
@@ -22,7 +24,7 @@ using openxc::config::getConfiguration;
 extern void initializeVehicleInterface();
 extern long FAKE_TIME;
 
-QUEUE_TYPE(uint8_t)* OUTPUT_QUEUE = &getConfiguration()->usb.endpoints[IN_ENDPOINT_INDEX].queue;
+SlabQueue* OUTPUT_QUEUE = &getConfiguration()->usb.endpoints[IN_ENDPOINT_INDEX].sendQueue;
 
 DiagnosticRequest request = {
     arbitration_id: 0x7e0,
@@ -44,7 +46,7 @@ static bool canQueueEmpty(int bus) {
 }
 
 bool outputQueueEmpty() {
-    return QUEUE_EMPTY(uint8_t, OUTPUT_QUEUE);
+    return slabpool::empty(OUTPUT_QUEUE);
 }
 
 static void resetQueues() {
@@ -130,8 +132,8 @@ START_TEST (test_simultaneous_recurring_nonrecurring)
             &message, &getConfiguration()->pipeline);
     fail_if(outputQueueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert(strstr((char*)snapshot, "foo") == NULL);
     ck_assert(strstr((char*)snapshot, "bar") != NULL);
@@ -149,7 +151,7 @@ START_TEST (test_simultaneous_recurring_nonrecurring)
 
     diagnostics::receiveCanMessage(&getConfiguration()->diagnosticsManager, &getCanBuses()[0],
             &message, &getConfiguration()->pipeline);
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert(strstr((char*)snapshot, "foo") == NULL);
     ck_assert(strstr((char*)snapshot, "bar") != NULL);
@@ -162,13 +164,49 @@ START_TEST (test_simultaneous_recurring_nonrecurring)
 
     diagnostics::receiveCanMessage(&getConfiguration()->diagnosticsManager, &getCanBuses()[0],
             &message, &getConfiguration()->pipeline);
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert(strstr((char*)snapshot, "foo") != NULL);
     ck_assert(strstr((char*)snapshot, "bar") == NULL);
 }
 END_TEST
 
+START_TEST (test_adaptive_rate_backs_off_and_recovers)
+{
+    DiagnosticsManager* manager = &getConfiguration()->diagnosticsManager;
+    ck_assert(diagnostics::addRecurringRequest(manager, &getCanBuses()[0],
+            &request, 4));
+    ck_assert(diagnostics::setAdaptiveRate(manager, NULL, 1));
+    ActiveDiagnosticRequest* entry = TAILQ_FIRST(&manager->recurringRequests);
+
+    // get around the staggered start
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+    FAKE_TIME += 2000;
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+    fail_if(canQueueEmpty(0));
+    resetQueues();
+
+    // no response, so the rate is halved
+    FAKE_TIME += 100;
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+    fail_unless(canQueueEmpty(0));
+    ck_assert(entry->frequencyClock.frequency == 2);
+    ck_assert_int_eq(entry->stats.timeoutCount, 1);
+
+    // answered right away, so the rate steps back up
+    FAKE_TIME += 400;
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+    fail_if(canQueueEmpty(0));
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0], &message,
+            &getConfiguration()->pipeline);
+    ck_assert(entry->frequencyClock.frequency == 2.5);
+    ck_assert_int_eq(entry->stats.responseCount, 1);
+
+    ck_assert(diagnostics::setAdaptiveRate(manager, NULL, 0));
+    ck_assert(entry->frequencyClock.frequency == 4);
+}
+END_TEST
+
 START_TEST (test_cancel_invalid)
 {
     ck_assert(!diagnostics::cancelRecurringRequest(
@@ -279,8 +317,8 @@ START_TEST (test_add_basic_request)
           &getCanBuses()[0], &message, &getConfiguration()->pipeline);
     fail_if(outputQueueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot, "{\"bus\":1,\"id\":2016,\"mode\":1,\"success\":true,\"pid\":2,\"payload\":\"0x45\"}\0");
 }
@@ -298,8 +336,8 @@ START_TEST (test_recognized_obd2_request_overridden)
             &message, &getConfiguration()->pipeline);
     fail_if(outputQueueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert(strstr((char*)snapshot, "value") != NULL);
     ck_assert(strstr((char*)snapshot, "payload") == NULL);
@@ -316,8 +354,8 @@ START_TEST (test_recognized_obd2_request)
             &message, &getConfiguration()->pipeline);
     fail_if(outputQueueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     // only doing OBD-II autodetection for commands, still need to be able to
     // pass NULL to addRequest to say no decoder, and don't put 'value' in.
@@ -371,8 +409,8 @@ START_TEST (test_add_request_other_bus)
             &message, &getConfiguration()->pipeline);
     fail_if(outputQueueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot, "{\"name\":\"mypid\",\"value\":69}\0");
 }
@@ -388,8 +426,8 @@ START_TEST (test_add_request_with_name)
             &message, &getConfiguration()->pipeline);
     fail_if(outputQueueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot, "{\"name\":\"mypid\",\"value\":69}\0");
 }
@@ -429,6 +467,122 @@ START_TEST (test_recurring_obd2_build)
 }
 END_TEST
 
+START_TEST (test_recurring_obd2_pids_packed)
+{
+    DiagnosticsManager* manager = &getConfiguration()->diagnosticsManager;
+    request.pid = 0xc;
+    ck_assert(diagnostics::addRecurringRequest(manager, &getCanBuses()[0],
+            &request, "engine_speed", false,
+            openxc::diagnostics::obd2::handleObd2Pid, NULL, 1));
+    request.pid = 0xd;
+    ck_assert(diagnostics::addRecurringRequest(manager, &getCanBuses()[0],
+            &request, "vehicle_speed", false,
+            openxc::diagnostics::obd2::handleObd2Pid, NULL, 1));
+    // get around the staggered start
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+    FAKE_TIME += 2000;
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+
+    // both PIDs go out in a single request
+    fail_if(canQueueEmpty(0));
+    CanMessage sent = QUEUE_POP(CanMessage, &getCanBuses()[0].sendQueue);
+    fail_unless(canQueueEmpty(0));
+    ck_assert_int_eq(sent.data[0], 0x3);
+    ck_assert_int_eq(sent.data[1], 0x1);
+    ck_assert((sent.data[2] == 0xc && sent.data[3] == 0xd) ||
+            (sent.data[2] == 0xd && sent.data[3] == 0xc));
+
+    CanMessage response = {
+       id: request.arbitration_id + 0x8,
+       format: CanMessageFormat::STANDARD,
+       data: {0x06, 0x41, 0xc, 0x1a, 0xf8, 0xd, 0x3c},
+       length: 8
+    };
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0], &response,
+            &getConfiguration()->pipeline);
+    fail_if(outputQueueEmpty());
+
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    snapshot[sizeof(snapshot) - 1] = NULL;
+    ck_assert(strstr((char*)snapshot, "engine_speed") != NULL);
+    ck_assert(strstr((char*)snapshot, "vehicle_speed") != NULL);
+
+    // and each can still be cancelled on its own
+    ck_assert(diagnostics::cancelRecurringRequest(manager, &getCanBuses()[0],
+            &request));
+    request.pid = 0xc;
+    ck_assert(diagnostics::cancelRecurringRequest(manager, &getCanBuses()[0],
+            &request));
+}
+END_TEST
+
+START_TEST (test_recurring_broadcast_pids_packed)
+{
+    DiagnosticsManager* manager = &getConfiguration()->diagnosticsManager;
+    request.arbitration_id = OBD2_FUNCTIONAL_BROADCAST_ID;
+    request.pid = 0xc;
+    ck_assert(diagnostics::addRecurringRequest(manager, &getCanBuses()[0],
+            &request, "engine_speed", false,
+            openxc::diagnostics::obd2::handleObd2Pid, NULL, 1));
+    request.pid = 0xd;
+    ck_assert(diagnostics::addRecurringRequest(manager, &getCanBuses()[0],
+            &request, "vehicle_speed", false,
+            openxc::diagnostics::obd2::handleObd2Pid, NULL, 1));
+    // get around the staggered start
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+    FAKE_TIME += 2000;
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+
+    // both PIDs go out in a single broadcast request
+    fail_if(canQueueEmpty(0));
+    CanMessage sent = QUEUE_POP(CanMessage, &getCanBuses()[0].sendQueue);
+    fail_unless(canQueueEmpty(0));
+    ck_assert_int_eq(sent.id, OBD2_FUNCTIONAL_BROADCAST_ID);
+    ck_assert_int_eq(sent.data[0], 0x3);
+
+    // each module answers with only the PID it supports, and both are relayed
+    CanMessage response = {
+       id: 0x7e8,
+       format: CanMessageFormat::STANDARD,
+       data: {0x04, 0x41, 0xc, 0x1a, 0xf8},
+       length: 8
+    };
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0], &response,
+            &getConfiguration()->pipeline);
+    fail_if(outputQueueEmpty());
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    snapshot[sizeof(snapshot) - 1] = NULL;
+    ck_assert(strstr((char*)snapshot, "engine_speed") != NULL);
+    resetQueues();
+
+    CanMessage otherResponse = {
+       id: 0x7e9,
+       format: CanMessageFormat::STANDARD,
+       data: {0x03, 0x41, 0xd, 0x3c},
+       length: 8
+    };
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0], &otherResponse,
+            &getConfiguration()->pipeline);
+    fail_if(outputQueueEmpty());
+    uint8_t otherSnapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, otherSnapshot, sizeof(otherSnapshot));
+    otherSnapshot[sizeof(otherSnapshot) - 1] = NULL;
+    ck_assert(strstr((char*)otherSnapshot, "vehicle_speed") != NULL);
+
+    // the request is done once it times out, and each PID can still be
+    // cancelled on its own
+    FAKE_TIME += 200;
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+    ck_assert(diagnostics::cancelRecurringRequest(manager, &getCanBuses()[0],
+            &request));
+    request.pid = 0xc;
+    ck_assert(diagnostics::cancelRecurringRequest(manager, &getCanBuses()[0],
+            &request));
+}
+END_TEST
+
 START_TEST (test_ignition_check_power_management_uses_watchdog)
 {
     getConfiguration()->powerManagement = openxc::config::PowerManagement::OBD2_IGNITION_CHECK;
@@ -463,8 +617,8 @@ START_TEST (test_add_request_with_name_and_decoder)
             &message, &getConfiguration()->pipeline);
     fail_if(outputQueueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert_str_eq((char*)snapshot, "{\"name\":\"mypid\",\"value\":138}\0");
 }
@@ -551,6 +705,201 @@ START_TEST (test_receive_nonrecurring_twice)
 }
 END_TEST
 
+START_TEST (test_receive_ignores_other_response_ids)
+{
+    ck_assert(diagnostics::addRequest(&getConfiguration()->diagnosticsManager,
+            &getCanBuses()[0], &request));
+    diagnostics::sendRequests(&getConfiguration()->diagnosticsManager, &getCanBuses()[0]);
+    fail_if(canQueueEmpty(0));
+
+    CanMessage otherModule = message;
+    otherModule.id = request.arbitration_id + 0x9;
+    diagnostics::receiveCanMessage(&getConfiguration()->diagnosticsManager, &getCanBuses()[0],
+            &otherModule, &getConfiguration()->pipeline);
+    otherModule.id = 0x100;
+    diagnostics::receiveCanMessage(&getConfiguration()->diagnosticsManager, &getCanBuses()[0],
+            &otherModule, &getConfiguration()->pipeline);
+    fail_unless(outputQueueEmpty());
+
+    // the request is still waiting for its own response
+    diagnostics::receiveCanMessage(&getConfiguration()->diagnosticsManager, &getCanBuses()[0],
+            &message, &getConfiguration()->pipeline);
+    fail_if(outputQueueEmpty());
+}
+END_TEST
+
+START_TEST (test_multi_frame_responses_relayed_per_session)
+{
+    DiagnosticsManager* manager = &getConfiguration()->diagnosticsManager;
+    DiagnosticRequest didRequest = {
+        arbitration_id: 0x7e0,
+        mode: 0x22,
+        has_pid: true,
+        pid: 0xde00,
+        pid_length: 2
+    };
+    ck_assert(diagnostics::addRequest(manager, &getCanBuses()[0], &didRequest));
+    didRequest.arbitration_id = 0x7e1;
+    ck_assert(diagnostics::addRequest(manager, &getCanBuses()[0], &didRequest));
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+
+    CanMessage firstFrame = {
+       id: 0x7e8,
+       format: CanMessageFormat::STANDARD,
+       data: {0x10, 0x0a, 0x62, 0xde, 0x00, 0x1, 0x2, 0x3},
+       length: 8
+    };
+    CanMessage consecutiveFrame = {
+       id: 0x7e8,
+       format: CanMessageFormat::STANDARD,
+       data: {0x21, 0x4, 0x5, 0x6, 0x7, 0x0, 0x0, 0x0},
+       length: 8
+    };
+
+    // the two responses arrive interleaved, each is numbered on its own
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0], &firstFrame,
+            &getConfiguration()->pipeline);
+    firstFrame.id = 0x7e9;
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0], &firstFrame,
+            &getConfiguration()->pipeline);
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0], &consecutiveFrame,
+            &getConfiguration()->pipeline);
+    consecutiveFrame.id = 0x7e9;
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0], &consecutiveFrame,
+            &getConfiguration()->pipeline);
+    fail_if(outputQueueEmpty());
+
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    snapshot[sizeof(snapshot) - 1] = NULL;
+    char* first = strstr((char*)snapshot, "\"frame\":0");
+    ck_assert(first != NULL);
+    ck_assert(strstr(first + 1, "\"frame\":0") != NULL);
+    ck_assert(strstr((char*)snapshot, "\"frame\":1") == NULL);
+    char* last = strstr((char*)snapshot, "\"frame\":-1");
+    ck_assert(last != NULL);
+    ck_assert(strstr(last + 1, "\"frame\":-1") != NULL);
+}
+END_TEST
+
+START_TEST (test_flow_control_block_size)
+{
+    DiagnosticsManager* manager = &getConfiguration()->diagnosticsManager;
+    ck_assert(diagnostics::addRequest(manager, &getCanBuses()[0], &request,
+            "big", false, NULL, NULL));
+    ck_assert(diagnostics::setFlowControl(manager, "big", 1, 2));
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+    QUEUE_POP(CanMessage, &getCanBuses()[0].sendQueue);
+    fail_unless(canQueueEmpty(0));
+
+    CanMessage firstFrame = {
+       id: request.arbitration_id + 0x8,
+       format: CanMessageFormat::STANDARD,
+       data: {0x10, 0x14, 0x41, 0x2, 0x1, 0x2, 0x3, 0x4},
+       length: 8
+    };
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0], &firstFrame,
+            &getConfiguration()->pipeline);
+    fail_if(canQueueEmpty(0));
+    CanMessage flowControl = QUEUE_POP(CanMessage, &getCanBuses()[0].sendQueue);
+    ck_assert_int_eq(flowControl.id, request.arbitration_id);
+    ck_assert_int_eq(flowControl.data[0], 0x30);
+    ck_assert_int_eq(flowControl.data[1], 1);
+    ck_assert_int_eq(flowControl.data[2], 2);
+
+    // after every block of 1 frame, the next block is asked for
+    CanMessage consecutiveFrame = firstFrame;
+    consecutiveFrame.data[0] = 0x21;
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0],
+            &consecutiveFrame, &getConfiguration()->pipeline);
+    fail_if(canQueueEmpty(0));
+    flowControl = QUEUE_POP(CanMessage, &getCanBuses()[0].sendQueue);
+    ck_assert_int_eq(flowControl.data[0], 0x30);
+    ck_assert_int_eq(flowControl.data[1], 1);
+
+    ActiveDiagnosticRequest* entry = LIST_FIRST(&manager->nonrecurringRequests);
+    ck_assert(entry != NULL);
+    ck_assert_int_eq(entry->stats.framesReceived, 2);
+}
+END_TEST
+
+START_TEST (test_flow_control_block_size_extended_id)
+{
+    DiagnosticsManager* manager = &getConfiguration()->diagnosticsManager;
+    DiagnosticRequest extendedRequest = {
+        arbitration_id: 0x18da10f1,
+        mode: 0x22,
+        has_pid: true,
+        pid: 0xf190,
+        pid_length: 2
+    };
+    ck_assert(diagnostics::addRequest(manager, &getCanBuses()[0],
+            &extendedRequest, "vin", false, NULL, NULL));
+    ck_assert(diagnostics::setFlowControl(manager, "vin", 1, -1));
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+    QUEUE_POP(CanMessage, &getCanBuses()[0].sendQueue);
+    fail_unless(canQueueEmpty(0));
+
+    CanMessage firstFrame = {
+       id: extendedRequest.arbitration_id + 0x8,
+       format: CanMessageFormat::EXTENDED,
+       data: {0x10, 0x14, 0x62, 0xf1, 0x90, 0x1, 0x2, 0x3},
+       length: 8
+    };
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0], &firstFrame,
+            &getConfiguration()->pipeline);
+    fail_if(canQueueEmpty(0));
+    QUEUE_POP(CanMessage, &getCanBuses()[0].sendQueue);
+
+    // the next block is asked for on the 29-bit ID the request went out on
+    CanMessage consecutiveFrame = firstFrame;
+    consecutiveFrame.data[0] = 0x21;
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0],
+            &consecutiveFrame, &getConfiguration()->pipeline);
+    fail_if(canQueueEmpty(0));
+    CanMessage flowControl = QUEUE_POP(CanMessage,
+            &getCanBuses()[0].sendQueue);
+    ck_assert_int_eq(flowControl.id, extendedRequest.arbitration_id);
+    ck_assert(flowControl.format == CanMessageFormat::EXTENDED);
+    ck_assert_int_eq(flowControl.data[0], 0x30);
+    ck_assert_int_eq(flowControl.data[1], 1);
+}
+END_TEST
+
+START_TEST (test_flow_control_block_size_broadcast)
+{
+    DiagnosticsManager* manager = &getConfiguration()->diagnosticsManager;
+    request.arbitration_id = OBD2_FUNCTIONAL_BROADCAST_ID;
+    ck_assert(diagnostics::addRequest(manager, &getCanBuses()[0], &request,
+            "big", false, NULL, NULL));
+    ck_assert(diagnostics::setFlowControl(manager, "big", 1, -1));
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+    QUEUE_POP(CanMessage, &getCanBuses()[0].sendQueue);
+    fail_unless(canQueueEmpty(0));
+
+    CanMessage firstFrame = {
+       id: 0x7e9,
+       format: CanMessageFormat::STANDARD,
+       data: {0x10, 0x14, 0x41, 0x2, 0x1, 0x2, 0x3, 0x4},
+       length: 8
+    };
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0], &firstFrame,
+            &getConfiguration()->pipeline);
+    resetQueues();
+
+    // the next block is asked for from the module that answered, not 0x7df
+    CanMessage consecutiveFrame = firstFrame;
+    consecutiveFrame.data[0] = 0x21;
+    diagnostics::receiveCanMessage(manager, &getCanBuses()[0],
+            &consecutiveFrame, &getConfiguration()->pipeline);
+    fail_if(canQueueEmpty(0));
+    CanMessage flowControl = QUEUE_POP(CanMessage,
+            &getCanBuses()[0].sendQueue);
+    ck_assert_int_eq(flowControl.id, 0x7e1);
+    ck_assert_int_eq(flowControl.data[0], 0x30);
+}
+END_TEST
+
 START_TEST (test_nonrecurring_timeout)
 {
     ck_assert(diagnostics::addRequest(&getConfiguration()->diagnosticsManager,
@@ -598,6 +947,58 @@ START_TEST(test_clear_to_send_blocked)
 }
 END_TEST
 
+START_TEST(test_clear_to_send_after_cancel_in_flight)
+{
+    ck_assert(diagnostics::addRecurringRequest(&getConfiguration()->diagnosticsManager,
+            &getCanBuses()[0], &request, 1));
+    // get around the staggered start
+    diagnostics::sendRequests(&getConfiguration()->diagnosticsManager, &getCanBuses()[0]);
+    FAKE_TIME += 2000;
+    diagnostics::sendRequests(&getConfiguration()->diagnosticsManager, &getCanBuses()[0]);
+    fail_if(canQueueEmpty(0));
+    resetQueues();
+
+    // cancelling the in-flight recurring request must free up its arb ID
+    ck_assert(diagnostics::cancelRecurringRequest(
+             &getConfiguration()->diagnosticsManager, &getCanBuses()[0],
+             &request));
+    ck_assert(diagnostics::addRequest(&getConfiguration()->diagnosticsManager,
+            &getCanBuses()[0], &request));
+    diagnostics::sendRequests(&getConfiguration()->diagnosticsManager, &getCanBuses()[0]);
+    fail_if(canQueueEmpty(0));
+}
+END_TEST
+
+START_TEST(test_recurring_sorted_by_deadline)
+{
+    DiagnosticsManager* manager = &getConfiguration()->diagnosticsManager;
+    ck_assert(diagnostics::addRecurringRequest(manager, &getCanBuses()[0],
+            &request, 1));
+    request.arbitration_id = 0x7e1;
+    ck_assert(diagnostics::addRecurringRequest(manager, &getCanBuses()[0],
+            &request, 10));
+    // get around the staggered start
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+    FAKE_TIME += 2000;
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+    fail_if(canQueueEmpty(0));
+
+    // both went out at the same time, so the faster one is due first
+    ActiveDiagnosticRequest* first = TAILQ_FIRST(&manager->recurringRequests);
+    ck_assert_int_eq(first->arbitration_id, 0x7e1);
+    ck_assert_int_eq(TAILQ_NEXT(first, queueEntries)->arbitration_id, 0x7e0);
+
+    resetQueues();
+    FAKE_TIME += 100;
+    // only the 10Hz request is due again
+    diagnostics::sendRequests(manager, &getCanBuses()[0]);
+    fail_if(canQueueEmpty(0));
+    CanMessage sent = QUEUE_POP(CanMessage, &getCanBuses()[0].sendQueue);
+    ck_assert_int_eq(sent.id, 0x7e1);
+    fail_unless(canQueueEmpty(0));
+}
+END_TEST
+
 START_TEST(test_clear_to_send)
 {
     // add 2 requests for 2 pids from same arb id. send one request, then the
@@ -802,8 +1203,8 @@ START_TEST(test_broadcast_response_arb_id)
             &message, &getConfiguration()->pipeline);
     fail_if(outputQueueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert(strstr((char*)snapshot, "2024") != NULL);
     ck_assert(strstr((char*)snapshot, "2015") == NULL);
@@ -821,8 +1222,8 @@ START_TEST(test_passthrough_decoder)
             &message, &getConfiguration()->pipeline);
     fail_if(outputQueueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     ck_assert(strstr((char*)snapshot, "69") != NULL);
 }
@@ -1048,10 +1449,16 @@ Suite* suite(void) {
     tcase_add_test(tc_core, test_cancel_recurring);
     tcase_add_test(tc_core, test_cancel_recurring_from_command);
     tcase_add_test(tc_core, test_cancel_invalid);
+    tcase_add_test(tc_core, test_adaptive_rate_backs_off_and_recovers);
     tcase_add_test(tc_core, test_unable_to_cancel_nonrecurring);
     tcase_add_test(tc_core, test_add_nonrecurring_doesnt_clobber_recurring);
     tcase_add_test(tc_core, test_receive_nonrecurring_twice);
     tcase_add_test(tc_core, test_nonrecurring_timeout);
+    tcase_add_test(tc_core, test_receive_ignores_other_response_ids);
+    tcase_add_test(tc_core, test_multi_frame_responses_relayed_per_session);
+    tcase_add_test(tc_core, test_flow_control_block_size);
+    tcase_add_test(tc_core, test_flow_control_block_size_extended_id);
+    tcase_add_test(tc_core, test_flow_control_block_size_broadcast);
     tcase_add_test(tc_core, test_recognized_obd2_request);
     tcase_add_test(tc_core, test_recognized_obd2_request_overridden);
 
@@ -1060,6 +1467,8 @@ Suite* suite(void) {
 
     tcase_add_test(tc_core, test_clear_to_send_blocked);
     tcase_add_test(tc_core, test_clear_to_send);
+    tcase_add_test(tc_core, test_clear_to_send_after_cancel_in_flight);
+    tcase_add_test(tc_core, test_recurring_sorted_by_deadline);
     tcase_add_test(tc_core, test_broadcast_response_arb_id);
     tcase_add_test(tc_core, test_broadcast_accept_multiple_responses);
     tcase_add_test(tc_core, test_passthrough_decoder);
@@ -1082,6 +1491,8 @@ Suite* suite(void) {
     tcase_add_test(tc_core, test_request_callback);
 
     tcase_add_test(tc_core, test_recurring_obd2_build);
+    tcase_add_test(tc_core, test_recurring_obd2_pids_packed);
+    tcase_add_test(tc_core, test_recurring_broadcast_pids_packed);
 
     tcase_add_test(tc_core, test_ignition_check_power_management_uses_watchdog);
 
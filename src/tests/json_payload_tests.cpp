@@ -4,8 +4,11 @@
 
 #include "commands/commands.h"
 #include "payload/json.h"
+#include "payload/jsonreader.h"
+#include "payload/jsonwriter.h"
 
 namespace json = openxc::payload::json;
+namespace jsonwriter = openxc::payload::jsonwriter;
 
 using openxc::commands::validate;
 
@@ -133,6 +136,263 @@ START_TEST (test_deserialize_message_after_junk)
 }
 END_TEST
 
+START_TEST (test_deserialize_incomplete)
+{
+    uint8_t rawRequest[] = "{\"bus\": 1, \"id\": 42, \"da";
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    ck_assert_int_eq(0, json::deserialize(rawRequest, sizeof(rawRequest) - 1,
+            &deserialized));
+}
+END_TEST
+
+START_TEST (test_deserialize_malformed)
+{
+    uint8_t rawRequest[] = "{\"bus\": 1, \"id\" 42}\0";
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    ck_assert_int_eq(0, json::deserialize(rawRequest, sizeof(rawRequest),
+            &deserialized));
+}
+END_TEST
+
+START_TEST (test_deserialize_too_many_values)
+{
+    std::string request = "{\"bus\": 1, \"id\": 42, \"data\": \"0x1234\"";
+    for(int i = 0; i < JSON_MAX_TOKENS; i++) {
+        request += ", \"extra\": 1";
+    }
+    request += "}";
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    ck_assert_int_eq(request.length() + 1, json::deserialize(
+            (uint8_t*)request.c_str(), request.length() + 1, &deserialized));
+    ck_assert(!validate(&deserialized));
+}
+END_TEST
+
+START_TEST (test_deserialize_keys_ignore_case)
+{
+    uint8_t rawRequest[] = "{\"BUS\": 2, \"Id\": 42, \"data\": \"0x1234\"}\0";
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    json::deserialize(rawRequest, sizeof(rawRequest), &deserialized);
+    ck_assert_int_eq(2, deserialized.can_message.bus);
+    ck_assert_int_eq(42, deserialized.can_message.id);
+    ck_assert_int_eq(2, deserialized.can_message.data.size);
+}
+END_TEST
+
+START_TEST (test_deserialize_simple_escaped_string)
+{
+    uint8_t rawRequest[] = "{\"value\": \"a\\\"b\\u00e9\\n\", "
+            "\"name\": \"door\", \"event\": -1.5e1}\0";
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    ck_assert_int_eq(sizeof(rawRequest) - 1, json::deserialize(rawRequest,
+            sizeof(rawRequest), &deserialized));
+    ck_assert_int_eq(openxc_VehicleMessage_Type_SIMPLE, deserialized.type);
+    ck_assert_str_eq("door", deserialized.simple_message.name);
+    ck_assert_int_eq(openxc_DynamicField_Type_STRING,
+            deserialized.simple_message.value.type);
+    ck_assert_str_eq("a\"b\xc3\xa9\n",
+            deserialized.simple_message.value.string_value);
+    ck_assert_int_eq(openxc_DynamicField_Type_NUM,
+            deserialized.simple_message.event.type);
+    ck_assert(deserialized.simple_message.event.numeric_value == -15);
+}
+END_TEST
+
+START_TEST (test_deserialize_diagnostic_request)
+{
+    uint8_t rawRequest[] = "{\"command\": \"diagnostic_request\", "
+            "\"action\": \"add\", \"request\": {\"bus\": 1, \"id\": 2015, "
+            "\"mode\": 34, \"pid\": 61744, \"payload\": \"0x1234\", "
+            "\"multiple_responses\": true, \"frequency\": 0.5, "
+            "\"decoded_type\": \"none\", \"name\": \"my_pid\"}}\0";
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    json::deserialize(rawRequest, sizeof(rawRequest), &deserialized);
+    ck_assert_int_eq(openxc_ControlCommand_Type_DIAGNOSTIC,
+            deserialized.control_command.type);
+
+    openxc_DiagnosticControlCommand* command =
+            &deserialized.control_command.diagnostic_request;
+    ck_assert_int_eq(openxc_DiagnosticControlCommand_Action_ADD,
+            command->action);
+    ck_assert_int_eq(1, command->request.bus);
+    ck_assert_int_eq(2015, command->request.message_id);
+    ck_assert_int_eq(34, command->request.mode);
+    ck_assert_int_eq(61744, command->request.pid);
+    ck_assert_int_eq(2, command->request.payload.size);
+    ck_assert_int_eq(0x12, command->request.payload.bytes[0]);
+    ck_assert_int_eq(0x34, command->request.payload.bytes[1]);
+    ck_assert(command->request.multiple_responses);
+    ck_assert(command->request.frequency == 0.5);
+    ck_assert_int_eq(openxc_DiagnosticRequest_DecodedType_NONE,
+            command->request.decoded_type);
+    ck_assert_str_eq("my_pid", command->request.name);
+}
+END_TEST
+
+START_TEST (test_deserialize_commands)
+{
+    const char* names[] = {"version", "device_id", "get_vin", "platform",
+            "sd_mount_status", "passthrough", "foo", "versions"};
+    openxc_ControlCommand_Type types[] = {openxc_ControlCommand_Type_VERSION,
+            openxc_ControlCommand_Type_DEVICE_ID,
+            openxc_ControlCommand_Type_GET_VIN,
+            openxc_ControlCommand_Type_PLATFORM,
+            openxc_ControlCommand_Type_SD_MOUNT_STATUS,
+            openxc_ControlCommand_Type_PASSTHROUGH,
+            openxc_ControlCommand_Type_UNUSED,
+            openxc_ControlCommand_Type_UNUSED};
+    for(size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        std::string request = std::string("{\"command\": \"") + names[i] +
+                "\"}";
+        openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+        json::deserialize((uint8_t*)request.c_str(), request.length() + 1,
+                &deserialized);
+        ck_assert_int_eq(openxc_VehicleMessage_Type_CONTROL_COMMAND,
+                deserialized.type);
+        ck_assert_int_eq(types[i], deserialized.control_command.type);
+    }
+}
+END_TEST
+
+START_TEST (test_deserialize_payload_format)
+{
+    uint8_t rawRequest[] = "{\"command\": \"payload_format\", "
+            "\"format\": \"messagepack\"}\0";
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    json::deserialize(rawRequest, sizeof(rawRequest), &deserialized);
+    ck_assert_int_eq(openxc_ControlCommand_Type_PAYLOAD_FORMAT,
+            deserialized.control_command.type);
+    ck_assert_int_eq(openxc_PayloadFormatCommand_PayloadFormat_MESSAGEPACK,
+            deserialized.control_command.payload_format_command.format);
+}
+END_TEST
+
+START_TEST (test_serialize_simple)
+{
+    openxc_VehicleMessage message = openxc_VehicleMessage();	// Zero fill
+    message.type = openxc_VehicleMessage_Type_SIMPLE;
+    strcpy(message.simple_message.name, "vehicle_speed");
+    message.simple_message.value.type = openxc_DynamicField_Type_NUM;
+    message.simple_message.value.numeric_value = 42.5;
+    message.simple_message.event.type = openxc_DynamicField_Type_BOOL;
+    message.simple_message.event.boolean_value = true;
+    message.timestamp = 1332794184319;
+    uint8_t payload[256] = {0};
+    const char expected[] = "{\"timestamp\":1332794184319,"
+            "\"name\":\"vehicle_speed\",\"value\":42.500000,\"event\":true}";
+    ck_assert_int_eq(sizeof(expected),
+            json::serialize(&message, payload, sizeof(payload)));
+    ck_assert_str_eq(expected, (char*)payload);
+}
+END_TEST
+
+START_TEST (test_serialize_escaped_string)
+{
+    openxc_VehicleMessage message = openxc_VehicleMessage();	// Zero fill
+    message.type = openxc_VehicleMessage_Type_SIMPLE;
+    strcpy(message.simple_message.name, "door");
+    message.simple_message.value.type = openxc_DynamicField_Type_STRING;
+    strcpy(message.simple_message.value.string_value, "a\"b\\c\n\x01");
+    uint8_t payload[256] = {0};
+    json::serialize(&message, payload, sizeof(payload));
+    ck_assert_str_eq("{\"name\":\"door\",\"value\":\"a\\\"b\\\\c\\n\\u0001\"}",
+            (char*)payload);
+}
+END_TEST
+
+START_TEST (test_serialize_can)
+{
+    openxc_VehicleMessage message = openxc_VehicleMessage();	// Zero fill
+    message.type = openxc_VehicleMessage_Type_CAN;
+    message.can_message.bus = 1;
+    message.can_message.id = 0x7e8;
+    message.can_message.data.size = 3;
+    message.can_message.data.bytes[0] = 0x12;
+    message.can_message.data.bytes[1] = 0xab;
+    message.can_message.data.bytes[2] = 0x0;
+    message.can_message.frame_format = openxc_CanMessage_FrameFormat_EXTENDED;
+    uint8_t payload[256] = {0};
+    json::serialize(&message, payload, sizeof(payload));
+    ck_assert_str_eq("{\"bus\":1,\"id\":2024,\"data\":\"0x12ab00\","
+            "\"frame_format\":\"extended\"}", (char*)payload);
+}
+END_TEST
+
+START_TEST (test_serialize_diagnostic)
+{
+    openxc_VehicleMessage message = openxc_VehicleMessage();	// Zero fill
+    message.type = openxc_VehicleMessage_Type_DIAGNOSTIC;
+    message.diagnostic_response.bus = 1;
+    message.diagnostic_response.message_id = 0x7e8;
+    message.diagnostic_response.mode = 1;
+    message.diagnostic_response.pid = 0xc;
+    message.diagnostic_response.success = true;
+    message.diagnostic_response.payload.size = 2;
+    message.diagnostic_response.payload.bytes[0] = 0x1a;
+    message.diagnostic_response.payload.bytes[1] = 0x2b;
+    uint8_t payload[256] = {0};
+    json::serialize(&message, payload, sizeof(payload));
+    ck_assert_str_eq("{\"bus\":1,\"id\":2024,\"mode\":1,\"success\":true,"
+            "\"pid\":12,\"payload\":\"0x1a2b\"}", (char*)payload);
+
+    message.diagnostic_response.value.type = openxc_DynamicField_Type_NUM;
+    message.diagnostic_response.value.numeric_value = 0.0000001;
+    json::serialize(&message, payload, sizeof(payload));
+    ck_assert_str_eq("{\"bus\":1,\"id\":2024,\"mode\":1,\"success\":true,"
+            "\"pid\":12,\"value\":1.000000e-07}", (char*)payload);
+}
+END_TEST
+
+START_TEST (test_serialize_command_response)
+{
+    openxc_VehicleMessage message = openxc_VehicleMessage();	// Zero fill
+    message.type = openxc_VehicleMessage_Type_COMMAND_RESPONSE;
+    message.command_response.type = openxc_ControlCommand_Type_VERSION;
+    strcpy(message.command_response.message, "7.2.1");
+    message.command_response.status = true;
+    uint8_t payload[256] = {0};
+    json::serialize(&message, payload, sizeof(payload));
+    ck_assert_str_eq("{\"command_response\":\"version\",\"message\":\"7.2.1\","
+            "\"status\":true}", (char*)payload);
+
+    message.command_response.type = openxc_ControlCommand_Type_UNUSED;
+    ck_assert_int_eq(0, json::serialize(&message, payload, sizeof(payload)));
+}
+END_TEST
+
+START_TEST (test_serialize_truncated)
+{
+    openxc_VehicleMessage message = openxc_VehicleMessage();	// Zero fill
+    message.type = openxc_VehicleMessage_Type_COMMAND_RESPONSE;
+    message.command_response.type = openxc_ControlCommand_Type_VERSION;
+    uint8_t payload[8] = {0};
+    ck_assert_int_eq(sizeof(payload),
+            json::serialize(&message, payload, sizeof(payload)));
+    ck_assert(!memcmp("{\"comman", payload, sizeof(payload)));
+}
+END_TEST
+
+START_TEST (test_format_number)
+{
+    char buffer[JSON_NUMBER_MAX_LENGTH + 1];
+    jsonwriter::formatNumber(-42, buffer);
+    ck_assert_str_eq("-42", buffer);
+    jsonwriter::formatNumber(4294967295.0, buffer);
+    ck_assert_str_eq("4294967295", buffer);
+    jsonwriter::formatNumber(0.1, buffer);
+    ck_assert_str_eq("0.100000", buffer);
+    jsonwriter::formatNumber(2.0000005, buffer);
+    ck_assert_str_eq("2.000001", buffer);
+    jsonwriter::formatNumber(-1234567890.5, buffer);
+    ck_assert_str_eq("-1.234568e+09", buffer);
+    jsonwriter::formatNumber(1e300, buffer);
+    ck_assert_str_eq("1.000000e+300", buffer);
+    jsonwriter::formatNumber(1e59, buffer);
+    ck_assert_str_eq("99999999999999997168788049560464200849936328366177157906432",
+            buffer);
+}
+END_TEST
+
 Suite* suite(void) {
     Suite* s = suite_create("json_payload");
     TCase *tc_json_payload = tcase_create("json_payload");
@@ -148,6 +408,21 @@ Suite* suite(void) {
     tcase_add_test(tc_json_payload, test_deserialize_can_message_write);
     tcase_add_test(tc_json_payload, test_deserialize_can_message_write_with_format);
     tcase_add_test(tc_json_payload, test_deserialize_message_after_junk);
+    tcase_add_test(tc_json_payload, test_deserialize_incomplete);
+    tcase_add_test(tc_json_payload, test_deserialize_malformed);
+    tcase_add_test(tc_json_payload, test_deserialize_too_many_values);
+    tcase_add_test(tc_json_payload, test_deserialize_keys_ignore_case);
+    tcase_add_test(tc_json_payload, test_deserialize_simple_escaped_string);
+    tcase_add_test(tc_json_payload, test_deserialize_diagnostic_request);
+    tcase_add_test(tc_json_payload, test_deserialize_commands);
+    tcase_add_test(tc_json_payload, test_deserialize_payload_format);
+    tcase_add_test(tc_json_payload, test_serialize_simple);
+    tcase_add_test(tc_json_payload, test_serialize_escaped_string);
+    tcase_add_test(tc_json_payload, test_serialize_can);
+    tcase_add_test(tc_json_payload, test_serialize_diagnostic);
+    tcase_add_test(tc_json_payload, test_serialize_command_response);
+    tcase_add_test(tc_json_payload, test_serialize_truncated);
+    tcase_add_test(tc_json_payload, test_format_number);
     suite_add_tcase(s, tc_json_payload);
 
     return s;
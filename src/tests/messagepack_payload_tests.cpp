@@ -0,0 +1,347 @@
+#include <check.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "commands/commands.h"
+#include "payload/messagepack.h"
+#include "payload/payload.h"
+
+namespace messagepack = openxc::payload::messagepack;
+
+using openxc::commands::validate;
+
+static uint8_t payload[256];
+static size_t payloadLength;
+
+void setup() {
+    memset(payload, 0, sizeof(payload));
+    payloadLength = 0;
+}
+
+static void appendByte(uint8_t value) {
+    payload[payloadLength++] = value;
+}
+
+static void appendMap(uint8_t size) {
+    appendByte(0x80 | size);
+}
+
+static void appendString(const char* value) {
+    appendByte(0xa0 | strlen(value));
+    memcpy(&payload[payloadLength], value, strlen(value));
+    payloadLength += strlen(value);
+}
+
+static void appendField(const char* key, const char* value) {
+    appendString(key);
+    appendString(value);
+}
+
+START_TEST (test_serialize_simple)
+{
+    openxc_VehicleMessage message = openxc_VehicleMessage();	// Zero fill
+    message.type = openxc_VehicleMessage_Type_SIMPLE;
+    strcpy(message.simple_message.name, "speed");
+    message.simple_message.value.type = openxc_DynamicField_Type_NUM;
+    message.simple_message.value.numeric_value = 42;
+
+    uint8_t expected[] = {0x82, 0xa4, 'n', 'a', 'm', 'e',
+            0xa5, 's', 'p', 'e', 'e', 'd',
+            0xa5, 'v', 'a', 'l', 'u', 'e', 0x2a};
+    ck_assert_int_eq(sizeof(expected),
+            messagepack::serialize(&message, payload, sizeof(payload)));
+    ck_assert(!memcmp(expected, payload, sizeof(expected)));
+}
+END_TEST
+
+START_TEST (test_serialize_number_types)
+{
+    openxc_VehicleMessage message = openxc_VehicleMessage();	// Zero fill
+    message.type = openxc_VehicleMessage_Type_SIMPLE;
+    strcpy(message.simple_message.name, "n");
+    message.simple_message.value.type = openxc_DynamicField_Type_NUM;
+
+    // The value starts after the map header and the two short strings
+    const size_t valueOffset = 1 + 5 + 2 + 6;
+
+    message.simple_message.value.numeric_value = -1000;
+    ck_assert_int_eq(valueOffset + 3,
+            messagepack::serialize(&message, payload, sizeof(payload)));
+    ck_assert_int_eq(0xd1, payload[valueOffset]);
+
+    message.simple_message.value.numeric_value = 0.5;
+    ck_assert_int_eq(valueOffset + 5,
+            messagepack::serialize(&message, payload, sizeof(payload)));
+    ck_assert_int_eq(0xca, payload[valueOffset]);
+
+    message.simple_message.value.numeric_value = 0.1;
+    ck_assert_int_eq(valueOffset + 9,
+            messagepack::serialize(&message, payload, sizeof(payload)));
+    ck_assert_int_eq(0xcb, payload[valueOffset]);
+}
+END_TEST
+
+START_TEST (test_round_trip_simple)
+{
+    openxc_VehicleMessage message = openxc_VehicleMessage();	// Zero fill
+    message.type = openxc_VehicleMessage_Type_SIMPLE;
+    strcpy(message.simple_message.name, "door_status");
+    message.simple_message.value.type = openxc_DynamicField_Type_STRING;
+    strcpy(message.simple_message.value.string_value, "driver");
+    message.simple_message.event.type = openxc_DynamicField_Type_BOOL;
+    message.simple_message.event.boolean_value = true;
+    message.timestamp = 1332794184319;
+
+    int length = messagepack::serialize(&message, payload, sizeof(payload));
+    ck_assert(length > 0);
+
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    ck_assert_int_eq(length, messagepack::deserialize(payload, length,
+            &deserialized));
+    ck_assert_int_eq(openxc_VehicleMessage_Type_SIMPLE, deserialized.type);
+    ck_assert_str_eq("door_status", deserialized.simple_message.name);
+    ck_assert_int_eq(openxc_DynamicField_Type_STRING,
+            deserialized.simple_message.value.type);
+    ck_assert_str_eq("driver", deserialized.simple_message.value.string_value);
+    ck_assert_int_eq(openxc_DynamicField_Type_BOOL,
+            deserialized.simple_message.event.type);
+    ck_assert(deserialized.simple_message.event.boolean_value);
+}
+END_TEST
+
+START_TEST (test_round_trip_can)
+{
+    openxc_VehicleMessage message = openxc_VehicleMessage();	// Zero fill
+    message.type = openxc_VehicleMessage_Type_CAN;
+    message.can_message.bus = 1;
+    message.can_message.id = 0x12345;
+    message.can_message.frame_format = openxc_CanMessage_FrameFormat_EXTENDED;
+    message.can_message.data.size = 3;
+    message.can_message.data.bytes[0] = 0xab;
+    message.can_message.data.bytes[1] = 0x00;
+    message.can_message.data.bytes[2] = 0xff;
+
+    int length = messagepack::serialize(&message, payload, sizeof(payload));
+    ck_assert(length > 0);
+
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    ck_assert_int_eq(length, messagepack::deserialize(payload, length,
+            &deserialized));
+    ck_assert_int_eq(openxc_VehicleMessage_Type_CAN, deserialized.type);
+    ck_assert_int_eq(1, deserialized.can_message.bus);
+    ck_assert_int_eq(0x12345, deserialized.can_message.id);
+    ck_assert_int_eq(openxc_CanMessage_FrameFormat_EXTENDED,
+            deserialized.can_message.frame_format);
+    ck_assert_int_eq(3, deserialized.can_message.data.size);
+    ck_assert(!memcmp(message.can_message.data.bytes,
+            deserialized.can_message.data.bytes, 3));
+    ck_assert(validate(&deserialized));
+}
+END_TEST
+
+START_TEST (test_deserialize_can_hex_data)
+{
+    appendMap(3);
+    appendString("bus");
+    appendByte(1);
+    appendString("id");
+    appendByte(42);
+    appendField("data", "0x1234");
+
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    ck_assert_int_eq(payloadLength, messagepack::deserialize(payload,
+            payloadLength, &deserialized));
+    ck_assert_int_eq(2, deserialized.can_message.data.size);
+    ck_assert_int_eq(0x12, deserialized.can_message.data.bytes[0]);
+    ck_assert_int_eq(0x34, deserialized.can_message.data.bytes[1]);
+    ck_assert(validate(&deserialized));
+}
+END_TEST
+
+START_TEST (test_deserialize_payload_format_command)
+{
+    appendMap(2);
+    appendField("format", "messagepack");
+    appendField("command", "payload_format");
+
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    ck_assert_int_eq(payloadLength, messagepack::deserialize(payload,
+            payloadLength, &deserialized));
+    ck_assert_int_eq(openxc_VehicleMessage_Type_CONTROL_COMMAND,
+            deserialized.type);
+    ck_assert_int_eq(openxc_ControlCommand_Type_PAYLOAD_FORMAT,
+            deserialized.control_command.type);
+    ck_assert_int_eq(openxc_PayloadFormatCommand_PayloadFormat_MESSAGEPACK,
+            deserialized.control_command.payload_format_command.format);
+    ck_assert(validate(&deserialized));
+}
+END_TEST
+
+START_TEST (test_deserialize_diagnostic_command)
+{
+    appendMap(3);
+    appendField("command", "diagnostic_request");
+    appendField("action", "add");
+    appendString("request");
+    appendMap(5);
+    appendString("bus");
+    appendByte(1);
+    appendString("id");
+    appendByte(0xcd);
+    appendByte(0x07);
+    appendByte(0xdf);
+    appendString("mode");
+    appendByte(1);
+    appendString("pid");
+    appendByte(0xc);
+    appendString("frequency");
+    appendByte(0xca);
+    appendByte(0x3f);
+    appendByte(0x00);
+    appendByte(0x00);
+    appendByte(0x00);
+
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    ck_assert_int_eq(payloadLength, messagepack::deserialize(payload,
+            payloadLength, &deserialized));
+    ck_assert_int_eq(openxc_ControlCommand_Type_DIAGNOSTIC,
+            deserialized.control_command.type);
+    openxc_DiagnosticControlCommand* command =
+            &deserialized.control_command.diagnostic_request;
+    ck_assert_int_eq(openxc_DiagnosticControlCommand_Action_ADD,
+            command->action);
+    ck_assert_int_eq(1, command->request.bus);
+    ck_assert_int_eq(0x7df, command->request.message_id);
+    ck_assert_int_eq(1, command->request.mode);
+    ck_assert_int_eq(0xc, command->request.pid);
+    ck_assert(command->request.frequency == 0.5);
+}
+END_TEST
+
+START_TEST (test_deserialize_incomplete)
+{
+    appendMap(2);
+    appendField("command", "version");
+    appendString("unused");
+
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    ck_assert_int_eq(0, messagepack::deserialize(payload, payloadLength,
+            &deserialized));
+}
+END_TEST
+
+START_TEST (test_deserialize_message_after_junk)
+{
+    appendByte(0);
+    appendMap(1);
+    appendField("command", "version");
+
+    openxc_VehicleMessage deserialized = openxc_VehicleMessage();	// Zero fill
+    ck_assert_int_eq(1, messagepack::deserialize(payload, payloadLength,
+            &deserialized));
+    ck_assert_int_eq(payloadLength - 1, messagepack::deserialize(
+            &payload[1], payloadLength - 1, &deserialized));
+    ck_assert_int_eq(openxc_ControlCommand_Type_VERSION,
+            deserialized.control_command.type);
+}
+END_TEST
+
+START_TEST (test_serialize_command_response)
+{
+    openxc_VehicleMessage message = openxc_VehicleMessage();	// Zero fill
+    message.type = openxc_VehicleMessage_Type_COMMAND_RESPONSE;
+    message.command_response.type = openxc_ControlCommand_Type_PAYLOAD_FORMAT;
+    message.command_response.status = true;
+    ck_assert(messagepack::serialize(&message, payload, sizeof(payload)) > 0);
+    ck_assert_int_eq(0x83, payload[0]);
+
+    message.command_response.type = openxc_ControlCommand_Type_UNUSED;
+    ck_assert_int_eq(0, messagepack::serialize(&message, payload,
+            sizeof(payload)));
+}
+END_TEST
+
+START_TEST (test_serialize_diagnostic)
+{
+    openxc_VehicleMessage message = openxc_VehicleMessage();	// Zero fill
+    message.type = openxc_VehicleMessage_Type_DIAGNOSTIC;
+    message.diagnostic_response.bus = 1;
+    message.diagnostic_response.message_id = 0x7e8;
+    message.diagnostic_response.mode = 1;
+    message.diagnostic_response.pid = 0xc;
+    message.diagnostic_response.success = true;
+    message.diagnostic_response.payload.size = 2;
+    ck_assert(messagepack::serialize(&message, payload, sizeof(payload)) > 0);
+    ck_assert_int_eq(0x86, payload[0]);
+}
+END_TEST
+
+START_TEST (test_serialize_truncated)
+{
+    openxc_VehicleMessage message = openxc_VehicleMessage();	// Zero fill
+    message.type = openxc_VehicleMessage_Type_SIMPLE;
+    strcpy(message.simple_message.name, "vehicle_speed");
+    message.simple_message.value.type = openxc_DynamicField_Type_NUM;
+    message.simple_message.value.numeric_value = 42;
+    ck_assert_int_eq(0, messagepack::serialize(&message, payload, 10));
+}
+END_TEST
+
+START_TEST (test_serialize_batch)
+{
+    uint8_t messages[] = {0x81, 0xa1, 'a', 0x01, 0x81, 0xa1, 'b', 0x02};
+
+    appendMap(2);
+    appendString("batch");
+    appendByte(PAYLOAD_BATCH_VERSION);
+    appendString("messages");
+    appendByte(0x92);
+    uint8_t expected[sizeof(payload)];
+    memcpy(expected, payload, payloadLength);
+    memcpy(&expected[payloadLength], messages, sizeof(messages));
+
+    uint8_t frame[64];
+    ck_assert_int_eq(payloadLength + sizeof(messages),
+            messagepack::serializeBatch(messages, sizeof(messages), 2, frame,
+                sizeof(frame)));
+    ck_assert(!memcmp(expected, frame, payloadLength + sizeof(messages)));
+    ck_assert_int_eq(0, messagepack::serializeBatch(messages, sizeof(messages),
+                2, frame, payloadLength + sizeof(messages) - 1));
+}
+END_TEST
+
+Suite* suite(void) {
+    Suite* s = suite_create("messagepack_payload");
+    TCase *tc_messagepack_payload = tcase_create("messagepack_payload");
+    tcase_add_checked_fixture(tc_messagepack_payload, setup, NULL);
+    tcase_add_test(tc_messagepack_payload, test_serialize_simple);
+    tcase_add_test(tc_messagepack_payload, test_serialize_number_types);
+    tcase_add_test(tc_messagepack_payload, test_round_trip_simple);
+    tcase_add_test(tc_messagepack_payload, test_round_trip_can);
+    tcase_add_test(tc_messagepack_payload, test_deserialize_can_hex_data);
+    tcase_add_test(tc_messagepack_payload,
+            test_deserialize_payload_format_command);
+    tcase_add_test(tc_messagepack_payload, test_deserialize_diagnostic_command);
+    tcase_add_test(tc_messagepack_payload, test_deserialize_incomplete);
+    tcase_add_test(tc_messagepack_payload,
+            test_deserialize_message_after_junk);
+    tcase_add_test(tc_messagepack_payload, test_serialize_command_response);
+    tcase_add_test(tc_messagepack_payload, test_serialize_diagnostic);
+    tcase_add_test(tc_messagepack_payload, test_serialize_truncated);
+    tcase_add_test(tc_messagepack_payload, test_serialize_batch);
+    suite_add_tcase(s, tc_messagepack_payload);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = suite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
@@ -1,5 +1,6 @@
 #include <check.h>
 #include <stdint.h>
+#include <string.h>
 #include "pipeline.h"
 #include "emqueue.h"
 #include "config.h"
@@ -7,26 +8,66 @@
 namespace uart = openxc::interface::uart;
 namespace network = openxc::interface::network;
 namespace usb = openxc::interface::usb;
+namespace slabpool = openxc::util::slabpool;
+namespace coalescing = openxc::util::coalescing;
 
 using openxc::pipeline::Pipeline;
 using openxc::pipeline::MessageClass;
+using openxc::pipeline::BackpressurePolicy;
+using openxc::interface::InterfaceType;
 using openxc::config::getConfiguration;
 
-QUEUE_TYPE(uint8_t)* OUTPUT_QUEUE = &getConfiguration()->usb.endpoints[IN_ENDPOINT_INDEX].queue;
-QUEUE_TYPE(uint8_t)* LOG_QUEUE = &getConfiguration()->usb.endpoints[LOG_ENDPOINT_INDEX].queue;
+SlabQueue* OUTPUT_QUEUE = &getConfiguration()->usb.endpoints[IN_ENDPOINT_INDEX].sendQueue;
+SlabQueue* LOG_QUEUE = &getConfiguration()->usb.endpoints[LOG_ENDPOINT_INDEX].sendQueue;
 
 extern bool USB_PROCESSED;
 extern bool UART_PROCESSED;
 extern bool NETWORK_PROCESSED;
+extern unsigned long FAKE_TIME;
+extern unsigned long FAKE_TIME_US_STEP;
+
+void fillQueue(SlabQueue* queue) {
+    uint8_t filler[64];
+    memset(filler, 128, sizeof(filler));
+    PayloadSlab* slab = slabpool::acquire(filler, sizeof(filler),
+            slabpool::Lane::BULK);
+    while(slabpool::enqueue(queue, slab, slabpool::Lane::BULK));
+    slabpool::release(slab);
+}
 
 void setup() {
     getConfiguration()->pipeline.usb = &getConfiguration()->usb;
-    getConfiguration()->pipeline.uart = NULL;
-    getConfiguration()->pipeline.network = NULL;
+    getConfiguration()->pipeline.uart = &getConfiguration()->uart;
+    getConfiguration()->pipeline.network = &getConfiguration()->network;
     usb::initialize(&getConfiguration()->usb);
     uart::initialize(&getConfiguration()->uart);
     network::initialize(&getConfiguration()->network);
+    openxc::pipeline::initialize(&getConfiguration()->pipeline);
+    getConfiguration()->pipeline.uart = NULL;
+    getConfiguration()->pipeline.network = NULL;
+    slabpool::initialize();
     getConfiguration()->usb.configured = true;
+    getConfiguration()->payloadFormat = openxc::payload::PayloadFormat::JSON;
+    getConfiguration()->outputBatching = false;
+    getConfiguration()->outputBatchBytes = 16;
+    getConfiguration()->outputBatchAgeMs = 20;
+    getConfiguration()->pipeline.usbBatch.count = 0;
+    getConfiguration()->pipeline.usbBatch.length = 0;
+    getConfiguration()->pipeline.networkBatch.count = 0;
+    getConfiguration()->pipeline.networkBatch.length = 0;
+    for(int i = 0; i < PIPELINE_ENDPOINT_COUNT; i++) {
+        getConfiguration()->backpressurePolicies[i] =
+                BackpressurePolicy::DROP_NEWEST;
+        memset(&getConfiguration()->pipeline.stalls[i], 0,
+                sizeof(getConfiguration()->pipeline.stalls[i]));
+    }
+    getConfiguration()->backpressureBlockMs = 5;
+    memset(getConfiguration()->outputCoalescing, 0,
+            sizeof(getConfiguration()->outputCoalescing));
+    coalescing::initialize(&getConfiguration()->pipeline.coalescing);
+    getConfiguration()->pipeline.canReceivedAtUs = 0;
+    FAKE_TIME = 1000;
+    FAKE_TIME_US_STEP = 0;
     USB_PROCESSED = false;
     UART_PROCESSED = false;
     NETWORK_PROCESSED = false;
@@ -37,10 +78,10 @@ START_TEST (test_log_to_usb)
     const char* message = "message";
     sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::LOG);
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, LOG_QUEUE)];
-    ck_assert(QUEUE_EMPTY(uint8_t, OUTPUT_QUEUE));
-    ck_assert(!QUEUE_EMPTY(uint8_t, &getConfiguration()->usb.endpoints[LOG_ENDPOINT_INDEX].queue));
-    QUEUE_SNAPSHOT(uint8_t, &getConfiguration()->usb.endpoints[LOG_ENDPOINT_INDEX].queue, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(LOG_QUEUE)];
+    ck_assert(slabpool::empty(OUTPUT_QUEUE));
+    ck_assert(!slabpool::empty(&getConfiguration()->usb.endpoints[LOG_ENDPOINT_INDEX].sendQueue));
+    slabpool::snapshot(&getConfiguration()->usb.endpoints[LOG_ENDPOINT_INDEX].sendQueue, snapshot, sizeof(snapshot));
     ck_assert_str_eq((char*)snapshot, "message");
 }
 END_TEST
@@ -50,8 +91,8 @@ START_TEST (test_only_usb)
     const char* message = "message";
     sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::SIMPLE);
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE)];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE)];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     ck_assert_str_eq((char*)snapshot, "message");
 }
 END_TEST
@@ -59,10 +100,9 @@ END_TEST
 START_TEST (test_full_network)
 {
     getConfiguration()->pipeline.network = &getConfiguration()->network;
-    for(int i = 0; i < QUEUE_MAX_LENGTH(uint8_t) + 1; i++) {
-        QUEUE_PUSH(uint8_t, &getConfiguration()->pipeline.network->sendQueue, (uint8_t) 128);
-    }
-    fail_unless(QUEUE_FULL(uint8_t, &getConfiguration()->pipeline.network->sendQueue));
+    fillQueue(&getConfiguration()->pipeline.network->sendQueue);
+    fail_if(slabpool::fits(&getConfiguration()->pipeline.network->sendQueue, 8,
+                slabpool::Lane::BULK));
 
     const char* message = "message";
     sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::SIMPLE);
@@ -72,10 +112,9 @@ END_TEST
 START_TEST (test_full_uart)
 {
     getConfiguration()->pipeline.uart = &getConfiguration()->uart;
-    for(int i = 0; i < QUEUE_MAX_LENGTH(uint8_t) + 1; i++) {
-        QUEUE_PUSH(uint8_t, &getConfiguration()->pipeline.uart->sendQueue, (uint8_t) 128);
-    }
-    fail_unless(QUEUE_FULL(uint8_t, &getConfiguration()->pipeline.uart->sendQueue));
+    fillQueue(&getConfiguration()->pipeline.uart->sendQueue);
+    fail_if(slabpool::fits(&getConfiguration()->pipeline.uart->sendQueue, 8,
+                slabpool::Lane::BULK));
 
     const char* message = "message";
     sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::SIMPLE);
@@ -84,13 +123,138 @@ END_TEST
 
 START_TEST (test_full_usb)
 {
-    for(int i = 0; i < QUEUE_MAX_LENGTH(uint8_t) + 1; i++) {
-        QUEUE_PUSH(uint8_t, OUTPUT_QUEUE, (uint8_t) 128);
+    fillQueue(OUTPUT_QUEUE);
+    fail_if(slabpool::fits(OUTPUT_QUEUE, 8, slabpool::Lane::BULK));
+
+    const char* message = "message";
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::SIMPLE);
+}
+END_TEST
+
+START_TEST (test_full_queue_drops_newest_without_flushing)
+{
+    fillQueue(OUTPUT_QUEUE);
+    int filled = slabpool::length(OUTPUT_QUEUE);
+
+    const char* message = "message";
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::SIMPLE);
+    fail_if(USB_PROCESSED);
+    ck_assert_int_eq(filled, slabpool::length(OUTPUT_QUEUE));
+}
+END_TEST
+
+START_TEST (test_full_queue_drops_oldest)
+{
+    getConfiguration()->backpressurePolicies[InterfaceType::USB] =
+            BackpressurePolicy::DROP_OLDEST;
+    fillQueue(OUTPUT_QUEUE);
+    int filled = slabpool::length(OUTPUT_QUEUE);
+
+    const char* message = "message";
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::SIMPLE);
+    fail_if(USB_PROCESSED);
+    ck_assert_int_eq(filled - 64 + 8, slabpool::length(OUTPUT_QUEUE));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE)];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    ck_assert_str_eq((char*)&snapshot[sizeof(snapshot) - 8], "message");
+}
+END_TEST
+
+START_TEST (test_drop_oldest_skips_payload_in_progress)
+{
+    PayloadSlab* slabs[3] = {
+        slabpool::acquire((uint8_t*)"one", 4, slabpool::Lane::BULK),
+        slabpool::acquire((uint8_t*)"two", 4, slabpool::Lane::BULK),
+        slabpool::acquire((uint8_t*)"six", 4, slabpool::Lane::BULK),
+    };
+    for(int i = 0; i < 3; i++) {
+        slabpool::enqueue(OUTPUT_QUEUE, slabs[i], slabpool::Lane::BULK);
+        slabpool::release(slabs[i]);
+    }
+
+    uint8_t buffer[6];
+    ck_assert_int_eq(2, slabpool::drain(OUTPUT_QUEUE, buffer, 2));
+    fail_unless(slabpool::dropOldest(OUTPUT_QUEUE, slabpool::Lane::BULK));
+    ck_assert_int_eq(PAYLOAD_SLAB_COUNT - 2, slabpool::available());
+    ck_assert_int_eq(6, slabpool::drain(OUTPUT_QUEUE, buffer, sizeof(buffer)));
+    ck_assert(!memcmp("e\0six\0", buffer, sizeof(buffer)));
+    fail_if(slabpool::dropOldest(OUTPUT_QUEUE, slabpool::Lane::BULK));
+}
+END_TEST
+
+START_TEST (test_drop_oldest_stops_when_pool_exhausted)
+{
+    getConfiguration()->backpressurePolicies[InterfaceType::USB] =
+            BackpressurePolicy::DROP_OLDEST;
+    // Still held by another interface, so dropping them frees nothing
+    PayloadSlab* shared[2] = {
+        slabpool::acquire((uint8_t*)"one", 4, slabpool::Lane::BULK),
+        slabpool::acquire((uint8_t*)"two", 4, slabpool::Lane::BULK),
+    };
+    for(int i = 0; i < 2; i++) {
+        slabpool::enqueue(OUTPUT_QUEUE, shared[i], slabpool::Lane::BULK);
+    }
+
+    uint8_t filler[PAYLOAD_SLAB_SMALL_SIZE];
+    memset(filler, 128, sizeof(filler));
+    PayloadSlab* slabs[PAYLOAD_SLAB_COUNT];
+    int held = 0;
+    while((slabs[held] = slabpool::acquire(filler, sizeof(filler),
+                    slabpool::Lane::PRIORITY)) != NULL) {
+        ++held;
     }
-    fail_unless(QUEUE_FULL(uint8_t, OUTPUT_QUEUE));
+    unsigned int exhausted = slabpool::exhaustedCount();
+
+    const char* message = "message";
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8,
+            MessageClass::SIMPLE);
+    ck_assert_int_eq(4, slabpool::length(OUTPUT_QUEUE));
+    ck_assert_int_eq(exhausted + 1, slabpool::exhaustedCount());
+
+    for(int i = 0; i < held; i++) {
+        slabpool::release(slabs[i]);
+    }
+    for(int i = 0; i < 2; i++) {
+        slabpool::release(shared[i]);
+    }
+}
+END_TEST
+
+START_TEST (test_full_queue_blocks_until_flushed)
+{
+    getConfiguration()->backpressurePolicies[InterfaceType::USB] =
+            BackpressurePolicy::BLOCK;
+    fillQueue(OUTPUT_QUEUE);
 
     const char* message = "message";
     sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::SIMPLE);
+    fail_unless(USB_PROCESSED);
+    ck_assert_int_eq(8, slabpool::length(OUTPUT_QUEUE));
+    ck_assert_int_eq(1,
+            getConfiguration()->pipeline.stalls[InterfaceType::USB].count);
+}
+END_TEST
+
+START_TEST (test_full_queue_blocks_for_limited_time)
+{
+    getConfiguration()->pipeline.network = &getConfiguration()->network;
+    SlabQueue* networkQueue = &getConfiguration()->network.sendQueue;
+    getConfiguration()->backpressurePolicies[InterfaceType::NETWORK] =
+            BackpressurePolicy::BLOCK;
+    FAKE_TIME_US_STEP = 100;
+    fillQueue(networkQueue);
+    int filled = slabpool::length(networkQueue);
+
+    const char* message = "message";
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::SIMPLE);
+    fail_unless(NETWORK_PROCESSED);
+    ck_assert_int_eq(filled, slabpool::length(networkQueue));
+
+    openxc::pipeline::BackpressureStall* stall =
+            &getConfiguration()->pipeline.stalls[InterfaceType::NETWORK];
+    ck_assert_int_eq(1, stall->count);
+    ck_assert(stall->longestUs >= 5000);
+    ck_assert(stall->longestUs < 6000);
 }
 END_TEST
 
@@ -100,11 +264,11 @@ START_TEST (test_with_uart)
     const char* message = "message";
     sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::SIMPLE);
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE)];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE)];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     ck_assert_str_eq((char*)snapshot, "message");
 
-    QUEUE_SNAPSHOT(uint8_t, &getConfiguration()->pipeline.uart->sendQueue, snapshot, sizeof(snapshot));
+    slabpool::snapshot(&getConfiguration()->pipeline.uart->sendQueue, snapshot, sizeof(snapshot));
     ck_assert_str_eq((char*)snapshot, "message");
 }
 END_TEST
@@ -116,18 +280,182 @@ START_TEST (test_with_uart_and_network)
     const char* message = "message";
     sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::SIMPLE);
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE)];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE)];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     ck_assert_str_eq((char*)snapshot, "message");
 
-    QUEUE_SNAPSHOT(uint8_t, &getConfiguration()->pipeline.uart->sendQueue, snapshot, sizeof(snapshot));
+    slabpool::snapshot(&getConfiguration()->pipeline.uart->sendQueue, snapshot, sizeof(snapshot));
     ck_assert_str_eq((char*)snapshot, "message");
 
-    QUEUE_SNAPSHOT(uint8_t, &getConfiguration()->pipeline.network->sendQueue, snapshot, sizeof(snapshot));
+    slabpool::snapshot(&getConfiguration()->pipeline.network->sendQueue, snapshot, sizeof(snapshot));
     ck_assert_str_eq((char*)snapshot, "message");
 }
 END_TEST
 
+START_TEST (test_fan_out_copies_payload_once)
+{
+    getConfiguration()->pipeline.uart = &getConfiguration()->uart;
+    getConfiguration()->pipeline.network = &getConfiguration()->network;
+    const char* message = "message";
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::SIMPLE);
+
+    ck_assert_int_eq(8, slabpool::bytesCopied());
+    ck_assert_int_eq(PAYLOAD_SLAB_COUNT - 1, slabpool::available());
+    ck_assert_int_eq(8, slabpool::length(OUTPUT_QUEUE));
+    ck_assert_int_eq(8, slabpool::length(&getConfiguration()->uart.sendQueue));
+    ck_assert_int_eq(8, slabpool::length(&getConfiguration()->network.sendQueue));
+}
+END_TEST
+
+START_TEST (test_slab_released_after_last_send)
+{
+    getConfiguration()->pipeline.uart = &getConfiguration()->uart;
+    const char* message = "message";
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::SIMPLE);
+
+    uint8_t buffer[8];
+    ck_assert_int_eq(8, slabpool::drain(OUTPUT_QUEUE, buffer, sizeof(buffer)));
+    ck_assert_str_eq((char*)buffer, "message");
+    ck_assert_int_eq(PAYLOAD_SLAB_COUNT - 1, slabpool::available());
+
+    ck_assert_int_eq(4, slabpool::drain(&getConfiguration()->uart.sendQueue,
+                buffer, 4));
+    ck_assert_int_eq(PAYLOAD_SLAB_COUNT - 1, slabpool::available());
+    ck_assert_int_eq(4, slabpool::drain(&getConfiguration()->uart.sendQueue,
+                buffer, sizeof(buffer)));
+    ck_assert_int_eq(PAYLOAD_SLAB_COUNT, slabpool::available());
+}
+END_TEST
+
+START_TEST (test_large_payload_uses_large_slab)
+{
+    uint8_t message[PAYLOAD_SLAB_SMALL_SIZE + 1];
+    memset(message, 'a', sizeof(message));
+    sendMessage(&getConfiguration()->pipeline, message, sizeof(message),
+            MessageClass::SIMPLE);
+    ck_assert_int_eq(sizeof(message), slabpool::length(OUTPUT_QUEUE));
+}
+END_TEST
+
+START_TEST (test_pool_exhausted)
+{
+    uint8_t filler[PAYLOAD_SLAB_SMALL_SIZE];
+    memset(filler, 128, sizeof(filler));
+    PayloadSlab* slabs[PAYLOAD_SLAB_COUNT];
+    for(int i = 0; i < PAYLOAD_SLAB_COUNT; i++) {
+        slabs[i] = slabpool::acquire(filler, sizeof(filler),
+                slabpool::Lane::PRIORITY);
+        fail_if(slabs[i] == NULL);
+    }
+    fail_unless(slabpool::acquire(filler, sizeof(filler),
+                slabpool::Lane::PRIORITY) == NULL);
+
+    const char* message = "message";
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)message, 8, MessageClass::SIMPLE);
+    ck_assert(slabpool::empty(OUTPUT_QUEUE));
+    ck_assert(slabpool::exhaustedCount() > 0);
+
+    for(int i = 0; i < PAYLOAD_SLAB_COUNT; i++) {
+        slabpool::release(slabs[i]);
+    }
+    ck_assert_int_eq(PAYLOAD_SLAB_COUNT, slabpool::available());
+}
+END_TEST
+
+/* Private: Publish a simple vehicle message with a numeric value.
+ */
+static void publishValue(const char* name, int value, const char* event) {
+    openxc_VehicleMessage message = openxc_VehicleMessage();
+    message.type = openxc_VehicleMessage_Type_SIMPLE;
+    strcpy(message.simple_message.name, name);
+    message.simple_message.value.type = openxc_DynamicField_Type_NUM;
+    message.simple_message.value.numeric_value = value;
+    if(event != NULL) {
+        message.simple_message.event.type = openxc_DynamicField_Type_STRING;
+        strcpy(message.simple_message.event.string_value, event);
+    }
+    openxc::pipeline::publish(&message, &getConfiguration()->pipeline);
+}
+
+START_TEST (test_coalesced_interface_gets_newest_value)
+{
+    getConfiguration()->pipeline.uart = &getConfiguration()->uart;
+    SlabQueue* uartQueue = &getConfiguration()->uart.sendQueue;
+    getConfiguration()->outputCoalescing[InterfaceType::UART] = true;
+    publishValue("engine_speed", 1, NULL);
+    publishValue("engine_speed", 2, NULL);
+    publishValue("engine_speed", 3, NULL);
+    ck_assert(slabpool::empty(uartQueue));
+    int messageSize = slabpool::length(OUTPUT_QUEUE) / 3;
+
+    process(&getConfiguration()->pipeline);
+    ck_assert_int_eq(messageSize, slabpool::length(uartQueue));
+    uint8_t snapshot[messageSize];
+    slabpool::snapshot(uartQueue, snapshot, sizeof(snapshot));
+    ck_assert(strstr((char*)snapshot, "\"value\":3") != NULL);
+    ck_assert_int_eq(2, getConfiguration()->pipeline.coalescing.replaced[
+            InterfaceType::UART]);
+
+    process(&getConfiguration()->pipeline);
+    ck_assert_int_eq(messageSize, slabpool::length(uartQueue));
+}
+END_TEST
+
+START_TEST (test_coalesced_interface_sends_when_room)
+{
+    getConfiguration()->pipeline.uart = &getConfiguration()->uart;
+    SlabQueue* uartQueue = &getConfiguration()->uart.sendQueue;
+    getConfiguration()->outputCoalescing[InterfaceType::UART] = true;
+    fillQueue(uartQueue);
+    int filled = slabpool::length(uartQueue);
+    publishValue("engine_speed", 1, NULL);
+
+    process(&getConfiguration()->pipeline);
+    ck_assert_int_eq(filled, slabpool::length(uartQueue));
+    fail_if(coalescing::nextDirty(&getConfiguration()->pipeline.coalescing,
+                InterfaceType::UART) == NULL);
+
+    slabpool::clear(uartQueue);
+    process(&getConfiguration()->pipeline);
+    fail_if(slabpool::empty(uartQueue));
+}
+END_TEST
+
+START_TEST (test_coalesced_value_shared_between_interfaces)
+{
+    getConfiguration()->pipeline.uart = &getConfiguration()->uart;
+    getConfiguration()->pipeline.network = &getConfiguration()->network;
+    getConfiguration()->outputCoalescing[InterfaceType::UART] = true;
+    getConfiguration()->outputCoalescing[InterfaceType::NETWORK] = true;
+    publishValue("engine_speed", 1, NULL);
+    int available = slabpool::available();
+
+    process(&getConfiguration()->pipeline);
+    fail_if(slabpool::empty(&getConfiguration()->uart.sendQueue));
+    fail_if(slabpool::empty(&getConfiguration()->network.sendQueue));
+    ck_assert_int_eq(available - 1, slabpool::available());
+}
+END_TEST
+
+START_TEST (test_evented_message_not_coalesced)
+{
+    getConfiguration()->pipeline.uart = &getConfiguration()->uart;
+    getConfiguration()->outputCoalescing[InterfaceType::UART] = true;
+    publishValue("door_status", 1, "driver");
+    fail_if(slabpool::empty(&getConfiguration()->uart.sendQueue));
+}
+END_TEST
+
+START_TEST (test_usb_never_coalesced)
+{
+    getConfiguration()->outputCoalescing[InterfaceType::USB] = true;
+    publishValue("engine_speed", 1, NULL);
+    publishValue("engine_speed", 2, NULL);
+    ck_assert_int_eq(0, getConfiguration()->pipeline.coalescing.slotCount);
+    fail_if(slabpool::empty(OUTPUT_QUEUE));
+}
+END_TEST
+
 START_TEST (test_process_usb)
 {
     process(&getConfiguration()->pipeline);
@@ -158,6 +486,257 @@ START_TEST (test_process_all)
 }
 END_TEST
 
+START_TEST (test_batch_sent_when_full)
+{
+    getConfiguration()->outputBatching = true;
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)"{\"a\":1}", 8,
+            MessageClass::SIMPLE);
+    ck_assert(slabpool::empty(OUTPUT_QUEUE));
+
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)"{\"b\":2}", 8,
+            MessageClass::CAN);
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE)];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    ck_assert_str_eq((char*)snapshot,
+            "{\"batch\":1,\"messages\":[{\"a\":1},{\"b\":2}]}");
+    ck_assert_int_eq(strlen((char*)snapshot) + 1, sizeof(snapshot));
+}
+END_TEST
+
+START_TEST (test_batch_serialized_into_slab)
+{
+    getConfiguration()->outputBatching = true;
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)"{\"a\":1}", 8,
+            MessageClass::SIMPLE);
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)"{\"b\":2}", 8,
+            MessageClass::CAN);
+
+    ck_assert(!slabpool::empty(OUTPUT_QUEUE));
+    ck_assert_int_eq(0, slabpool::bytesCopied());
+    ck_assert_int_eq(PAYLOAD_SLAB_COUNT - 1, slabpool::available());
+}
+END_TEST
+
+START_TEST (test_batch_sent_after_age)
+{
+    getConfiguration()->pipeline.network = &getConfiguration()->network;
+    SlabQueue* networkQueue = &getConfiguration()->network.sendQueue;
+    getConfiguration()->outputBatching = true;
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)"{\"a\":1}", 8,
+            MessageClass::SIMPLE);
+
+    process(&getConfiguration()->pipeline);
+    ck_assert(slabpool::empty(networkQueue));
+
+    FAKE_TIME += getConfiguration()->outputBatchAgeMs;
+    process(&getConfiguration()->pipeline);
+    uint8_t snapshot[slabpool::length(networkQueue)];
+    slabpool::snapshot(networkQueue, snapshot, sizeof(snapshot));
+    ck_assert_str_eq((char*)snapshot,
+            "{\"batch\":1,\"messages\":[{\"a\":1}]}");
+}
+END_TEST
+
+START_TEST (test_batch_sent_before_unbatched_message)
+{
+    getConfiguration()->outputBatching = true;
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)"{\"a\":1}", 8,
+            MessageClass::SIMPLE);
+    // Too big for a batch of outputBatchBytes
+    const char large[] = "{\"c\":\"0123456789\"}";
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)large, sizeof(large),
+            MessageClass::SIMPLE);
+
+    const char expected[] = "{\"batch\":1,\"messages\":[{\"a\":1}]}\0"
+            "{\"c\":\"0123456789\"}";
+    ck_assert_int_eq(sizeof(expected), slabpool::length(OUTPUT_QUEUE));
+    uint8_t snapshot[sizeof(expected)];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    ck_assert(!memcmp(expected, snapshot, sizeof(expected)));
+}
+END_TEST
+
+START_TEST (test_command_response_skips_batch)
+{
+    getConfiguration()->outputBatching = true;
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)"{\"a\":1}", 8,
+            MessageClass::SIMPLE);
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)"{\"c\":3}", 8,
+            MessageClass::COMMAND_RESPONSE);
+
+    ck_assert_int_eq(8, slabpool::length(OUTPUT_QUEUE,
+                slabpool::Lane::PRIORITY));
+    ck_assert_int_eq(8, slabpool::length(OUTPUT_QUEUE));
+    ck_assert_int_eq(1, getConfiguration()->pipeline.usbBatch.count);
+}
+END_TEST
+
+START_TEST (test_command_response_ahead_of_full_queue)
+{
+    fillQueue(OUTPUT_QUEUE);
+    int filled = slabpool::length(OUTPUT_QUEUE);
+    fail_if(slabpool::fits(OUTPUT_QUEUE, 8, slabpool::Lane::BULK));
+
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)"{\"c\":3}", 8,
+            MessageClass::COMMAND_RESPONSE);
+    ck_assert_int_eq(filled + 8, slabpool::length(OUTPUT_QUEUE));
+
+    uint8_t buffer[8];
+    ck_assert_int_eq(8, slabpool::drain(OUTPUT_QUEUE, buffer, sizeof(buffer)));
+    ck_assert_str_eq((char*)buffer, "{\"c\":3}");
+}
+END_TEST
+
+START_TEST (test_lane_in_progress_finishes_first)
+{
+    SlabQueue* queue = OUTPUT_QUEUE;
+    PayloadSlab* bulk = slabpool::acquire((uint8_t*)"bulk", 5,
+            slabpool::Lane::BULK);
+    PayloadSlab* priority = slabpool::acquire((uint8_t*)"prio", 5,
+            slabpool::Lane::PRIORITY);
+    slabpool::enqueue(queue, bulk, slabpool::Lane::BULK);
+
+    uint8_t buffer[10];
+    ck_assert_int_eq(2, slabpool::drain(queue, buffer, 2));
+    slabpool::enqueue(queue, priority, slabpool::Lane::PRIORITY);
+    slabpool::enqueue(queue, bulk, slabpool::Lane::BULK);
+
+    uint8_t snapshot[13];
+    ck_assert_int_eq(13, slabpool::snapshot(queue, snapshot,
+                sizeof(snapshot)));
+    ck_assert(!memcmp("lk\0prio\0bulk\0", snapshot, sizeof(snapshot)));
+    ck_assert_int_eq(13, slabpool::drain(queue, buffer, 3) +
+            slabpool::drain(queue, buffer, sizeof(buffer)));
+    ck_assert_str_eq((char*)buffer, "prio");
+    slabpool::release(bulk);
+    slabpool::release(priority);
+}
+END_TEST
+
+START_TEST (test_bulk_leaves_priority_reserve)
+{
+    uint8_t filler[PAYLOAD_SLAB_SMALL_SIZE];
+    memset(filler, 128, sizeof(filler));
+    PayloadSlab* slabs[PAYLOAD_SLAB_COUNT];
+    int acquired = 0;
+    while((slabs[acquired] = slabpool::acquire(filler, sizeof(filler),
+                    slabpool::Lane::BULK)) != NULL) {
+        ++acquired;
+    }
+    ck_assert_int_eq(PAYLOAD_SLAB_COUNT - PAYLOAD_SLAB_PRIORITY_RESERVE * 2,
+            acquired);
+
+    PayloadSlab* response = slabpool::acquire(filler, sizeof(filler),
+            slabpool::Lane::PRIORITY);
+    fail_if(response == NULL);
+    slabpool::release(response);
+    for(int i = 0; i < acquired; i++) {
+        slabpool::release(slabs[i]);
+    }
+}
+END_TEST
+
+START_TEST (test_batch_sent_when_format_changes)
+{
+    getConfiguration()->outputBatching = true;
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)"{\"a\":1}", 8,
+            MessageClass::SIMPLE);
+    ck_assert(slabpool::empty(OUTPUT_QUEUE));
+
+    getConfiguration()->payloadFormat =
+            openxc::payload::PayloadFormat::MESSAGEPACK;
+    uint8_t emptyMap = 0x80;
+    sendMessage(&getConfiguration()->pipeline, &emptyMap, 1,
+            MessageClass::SIMPLE);
+    const char expected[] = "{\"batch\":1,\"messages\":[{\"a\":1}]}";
+    ck_assert_int_eq(sizeof(expected), slabpool::length(OUTPUT_QUEUE));
+    uint8_t snapshot[sizeof(expected)];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    ck_assert_str_eq(expected, (char*)snapshot);
+    ck_assert_int_eq(1, getConfiguration()->pipeline.usbBatch.count);
+}
+END_TEST
+
+START_TEST (test_batch_sent_when_batching_turned_off)
+{
+    getConfiguration()->pipeline.network = &getConfiguration()->network;
+    SlabQueue* networkQueue = &getConfiguration()->network.sendQueue;
+    getConfiguration()->outputBatching = true;
+    sendMessage(&getConfiguration()->pipeline, (uint8_t*)"{\"a\":1}", 8,
+            MessageClass::SIMPLE);
+    ck_assert(slabpool::empty(networkQueue));
+
+    getConfiguration()->outputBatching = false;
+    process(&getConfiguration()->pipeline);
+    ck_assert(!slabpool::empty(networkQueue));
+    ck_assert_int_eq(0, getConfiguration()->pipeline.usbBatch.count);
+    ck_assert_int_eq(0, getConfiguration()->pipeline.networkBatch.count);
+}
+END_TEST
+
+START_TEST (test_latency_recorded_when_sent)
+{
+    Pipeline* pipeline = &getConfiguration()->pipeline;
+    pipeline->canReceivedAtUs = FAKE_TIME * 1000 - 1000;
+    sendMessage(pipeline, (uint8_t*)"{\"a\":1}", 8, MessageClass::SIMPLE);
+    pipeline->canReceivedAtUs = 0;
+    ck_assert_int_eq(0, pipeline->latency[InterfaceType::USB].queued.count);
+
+    FAKE_TIME += 3;
+    process(pipeline);
+    SendLatency* latency = &pipeline->latency[InterfaceType::USB];
+    ck_assert_int_eq(1, latency->queued.count);
+    ck_assert_int_eq(3000, latency->queued.maxUs);
+    ck_assert_int_eq(1, latency->received.count);
+    ck_assert_int_eq(4000,
+            openxc::util::statistics::percentile(&latency->received, 50));
+}
+END_TEST
+
+START_TEST (test_latency_not_received_without_can_message)
+{
+    Pipeline* pipeline = &getConfiguration()->pipeline;
+    sendMessage(pipeline, (uint8_t*)"{\"a\":1}", 8, MessageClass::SIMPLE);
+    process(pipeline);
+    ck_assert_int_eq(1, pipeline->latency[InterfaceType::USB].queued.count);
+    ck_assert_int_eq(0, pipeline->latency[InterfaceType::USB].received.count);
+}
+END_TEST
+
+START_TEST (test_latency_attached_at_initialization)
+{
+    Pipeline* pipeline = &getConfiguration()->pipeline;
+    ck_assert(OUTPUT_QUEUE->latency == &pipeline->latency[InterfaceType::USB]);
+    ck_assert(getConfiguration()->network.sendQueue.latency ==
+            &pipeline->latency[InterfaceType::NETWORK]);
+
+    OUTPUT_QUEUE->latency = NULL;
+    sendMessage(pipeline, (uint8_t*)"{\"a\":1}", 8, MessageClass::SIMPLE);
+    process(pipeline);
+    ck_assert(OUTPUT_QUEUE->latency == NULL);
+    ck_assert_int_eq(0, pipeline->latency[InterfaceType::USB].queued.count);
+    OUTPUT_QUEUE->latency = &pipeline->latency[InterfaceType::USB];
+}
+END_TEST
+
+START_TEST (test_batch_latency_from_oldest_message)
+{
+    Pipeline* pipeline = &getConfiguration()->pipeline;
+    getConfiguration()->outputBatching = true;
+    pipeline->canReceivedAtUs = FAKE_TIME * 1000;
+    sendMessage(pipeline, (uint8_t*)"{\"a\":1}", 8, MessageClass::SIMPLE);
+    FAKE_TIME += 10;
+    pipeline->canReceivedAtUs = FAKE_TIME * 1000;
+    sendMessage(pipeline, (uint8_t*)"{\"b\":2}", 8, MessageClass::SIMPLE);
+    pipeline->canReceivedAtUs = 0;
+
+    process(pipeline);
+    ck_assert_int_eq(1, pipeline->latency[InterfaceType::USB].received.count);
+    ck_assert_int_eq(10000,
+            pipeline->latency[InterfaceType::USB].received.maxUs);
+}
+END_TEST
+
 Suite* pipelineSuite(void) {
     Suite* s = suite_create("pipeline");
     TCase *tc_core = tcase_create("core");
@@ -168,10 +747,39 @@ Suite* pipelineSuite(void) {
     tcase_add_test(tc_core, test_full_usb);
     tcase_add_test(tc_core, test_full_uart);
     tcase_add_test(tc_core, test_full_network);
+    tcase_add_test(tc_core, test_full_queue_drops_newest_without_flushing);
+    tcase_add_test(tc_core, test_full_queue_drops_oldest);
+    tcase_add_test(tc_core, test_drop_oldest_skips_payload_in_progress);
+    tcase_add_test(tc_core, test_drop_oldest_stops_when_pool_exhausted);
+    tcase_add_test(tc_core, test_full_queue_blocks_until_flushed);
+    tcase_add_test(tc_core, test_full_queue_blocks_for_limited_time);
     tcase_add_test(tc_core, test_process_all);
+    tcase_add_test(tc_core, test_coalesced_interface_gets_newest_value);
+    tcase_add_test(tc_core, test_coalesced_interface_sends_when_room);
+    tcase_add_test(tc_core, test_coalesced_value_shared_between_interfaces);
+    tcase_add_test(tc_core, test_evented_message_not_coalesced);
+    tcase_add_test(tc_core, test_usb_never_coalesced);
     tcase_add_test(tc_core, test_process_usb_and_uart);
     tcase_add_test(tc_core, test_process_usb);
     tcase_add_test(tc_core, test_log_to_usb);
+    tcase_add_test(tc_core, test_fan_out_copies_payload_once);
+    tcase_add_test(tc_core, test_slab_released_after_last_send);
+    tcase_add_test(tc_core, test_large_payload_uses_large_slab);
+    tcase_add_test(tc_core, test_pool_exhausted);
+    tcase_add_test(tc_core, test_batch_sent_when_full);
+    tcase_add_test(tc_core, test_batch_serialized_into_slab);
+    tcase_add_test(tc_core, test_batch_sent_after_age);
+    tcase_add_test(tc_core, test_batch_sent_before_unbatched_message);
+    tcase_add_test(tc_core, test_command_response_skips_batch);
+    tcase_add_test(tc_core, test_command_response_ahead_of_full_queue);
+    tcase_add_test(tc_core, test_lane_in_progress_finishes_first);
+    tcase_add_test(tc_core, test_bulk_leaves_priority_reserve);
+    tcase_add_test(tc_core, test_batch_sent_when_format_changes);
+    tcase_add_test(tc_core, test_batch_sent_when_batching_turned_off);
+    tcase_add_test(tc_core, test_latency_recorded_when_sent);
+    tcase_add_test(tc_core, test_latency_not_received_without_can_message);
+    tcase_add_test(tc_core, test_batch_latency_from_oldest_message);
+    tcase_add_test(tc_core, test_latency_attached_at_initialization);
     suite_add_tcase(s, tc_core);
 
     return s;
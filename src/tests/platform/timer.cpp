@@ -1,5 +1,7 @@
 #include "util/timer.h"
 
+#include <time.h>
+
 void openxc::util::time::delayMs(unsigned long delayInMs) { }
 
 unsigned long FAKE_TIME = 1000;
@@ -8,4 +10,20 @@ unsigned long openxc::util::time::systemTimeMs() {
     return FAKE_TIME;
 }
 
+// The fake microsecond clock advances by this much each time it's read, so
+// tests can make time-budgeted loops run out.
+unsigned long FAKE_TIME_US_STEP = 0;
+
+unsigned long openxc::util::time::systemTimeUs() {
+    static unsigned long elapsedUs = 0;
+    elapsedUs += FAKE_TIME_US_STEP;
+    return FAKE_TIME * 1000 + elapsedUs;
+}
+
+uint32_t openxc::util::time::cycleCount() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000UL + now.tv_nsec;
+}
+
 void openxc::util::time::initialize() { }
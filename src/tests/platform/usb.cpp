@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <stdarg.h>
 
+namespace slabpool = openxc::util::slabpool;
+
 using openxc::util::bytebuffer::IncomingMessageCallback;
 
 bool USB_PROCESSED = false;
@@ -16,11 +18,12 @@ void openxc::interface::usb::processSendQueue(UsbDevice* usbDevice) {
     for(int i = 0; i < ENDPOINT_COUNT; i++) {
         UsbEndpoint* endpoint = &usbDevice->endpoints[i];
         if(endpoint->direction == UsbEndpointDirection::USB_ENDPOINT_DIRECTION_IN) {
-            printf("USB endpoint %d buffer:\n", i);
-            uint8_t snapshot[QUEUE_LENGTH(uint8_t, &endpoint->queue) + 1];
-            QUEUE_SNAPSHOT(uint8_t, &endpoint->queue, snapshot, sizeof(snapshot));
+            if(!slabpool::empty(&endpoint->sendQueue)) {
+                printf("USB endpoint %d buffer:\n", i);
+            }
+            uint8_t snapshot[slabpool::length(&endpoint->sendQueue) + 1];
+            slabpool::drain(&endpoint->sendQueue, snapshot, sizeof(snapshot));
             SENT_BYTES += sizeof(snapshot);
-            QUEUE_INIT(uint8_t, &endpoint->queue);
             for(size_t i = 0; i < sizeof(snapshot) - 1; i++) {
                 if(snapshot[i] == 0) {
                     printf("\n");
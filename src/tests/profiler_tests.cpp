@@ -0,0 +1,86 @@
+#include <check.h>
+#include <stdint.h>
+
+#include "util/profiler.h"
+
+using openxc::util::profiler::ProfileStage;
+using openxc::util::profiler::ProfileCounter;
+using openxc::util::profiler::ScopedProbe;
+
+namespace profiler = openxc::util::profiler;
+
+void setup() {
+    profiler::reset();
+}
+
+void teardown() {
+}
+
+START_TEST (test_record_counts_runs)
+{
+    profiler::record(ProfileStage::DECODE, 30);
+    profiler::record(ProfileStage::DECODE, 10);
+    profiler::record(ProfileStage::DECODE, 20);
+    const ProfileCounter* counter = profiler::counter(ProfileStage::DECODE);
+    ck_assert_int_eq(3, counter->count);
+    ck_assert_int_eq(60, counter->totalCycles);
+    ck_assert_int_eq(10, counter->minCycles);
+    ck_assert_int_eq(30, counter->maxCycles);
+    ck_assert_int_eq(0, profiler::counter(ProfileStage::SERIALIZE)->count);
+}
+END_TEST
+
+START_TEST (test_reset)
+{
+    profiler::record(ProfileStage::SEND_USB, 30);
+    profiler::reset();
+    profiler::record(ProfileStage::SEND_USB, 40);
+    const ProfileCounter* counter = profiler::counter(ProfileStage::SEND_USB);
+    ck_assert_int_eq(1, counter->count);
+    ck_assert_int_eq(40, counter->minCycles);
+}
+END_TEST
+
+START_TEST (test_scoped_probe_records_on_exit)
+{
+    {
+        ScopedProbe probe(ProfileStage::RECEIVE_CAN);
+        ck_assert_int_eq(0,
+                profiler::counter(ProfileStage::RECEIVE_CAN)->count);
+    }
+    ck_assert_int_eq(1, profiler::counter(ProfileStage::RECEIVE_CAN)->count);
+}
+END_TEST
+
+START_TEST (test_stage_names)
+{
+    ck_assert_str_eq("can_interrupt",
+            profiler::stageName(ProfileStage::CAN_INTERRUPT));
+    ck_assert_str_eq("send_fs", profiler::stageName(ProfileStage::SEND_FS));
+}
+END_TEST
+
+Suite* suite(void) {
+    Suite* s = suite_create("profiler");
+    TCase *tc_core = tcase_create("core");
+    tcase_add_checked_fixture (tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_record_counts_runs);
+    tcase_add_test(tc_core, test_reset);
+    tcase_add_test(tc_core, test_scoped_probe_records_on_exit);
+    tcase_add_test(tc_core, test_stage_names);
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
+int main(void) {
+    int numberFailed;
+    Suite* s = suite();
+    SRunner *sr = srunner_create(s);
+    // Don't fork so we can actually use gdb
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    numberFailed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (numberFailed == 0) ? 0 : 1;
+}
@@ -6,6 +6,7 @@
 #include "signals.h"
 
 namespace usb = openxc::interface::usb;
+namespace slabpool = openxc::util::slabpool;
 
 using openxc::can::write::encodeState;
 using openxc::can::write::encodeNumber;
@@ -24,10 +25,10 @@ using openxc::can::lookupSignalManagerDetails;
 using openxc::signals::getCanBuses;
 using openxc::config::getConfiguration;
 
-QUEUE_TYPE(uint8_t)* OUTPUT_QUEUE = &getConfiguration()->usb.endpoints[IN_ENDPOINT_INDEX].queue;
+SlabQueue* OUTPUT_QUEUE = &getConfiguration()->usb.endpoints[IN_ENDPOINT_INDEX].sendQueue;
 
 bool queueEmpty() {
-    return QUEUE_EMPTY(uint8_t, OUTPUT_QUEUE);
+    return slabpool::empty(OUTPUT_QUEUE);
 }
 
 void setup() {
@@ -96,8 +97,8 @@ START_TEST (test_button_event_handler_correct_types)
             &getConfiguration()->pipeline);
     fail_if(queueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     fail_if(strstr((char*)snapshot, "event") == NULL);
     fail_if(strstr((char*)snapshot, "value") == NULL);
@@ -137,8 +138,8 @@ START_TEST (test_tire_pressure_as_decoder)
         getSignalManagers(), getSignalCount(), &message, &send);
     fail_if(queueEmpty());
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     fail_if(strstr((char*)snapshot, "front_left") == NULL);
 }
@@ -156,8 +157,8 @@ START_TEST (test_tire_pressure_handler)
     fail_if(queueEmpty());
     ck_assert_str_eq(decodedTireId.string_value, "front_left");
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     fail_if(strstr((char*)snapshot, "front_left") == NULL);
 }
@@ -199,8 +200,8 @@ START_TEST (test_door_handler)
     fail_if(queueEmpty());
     ck_assert_str_eq(decodedDoorId.string_value, "driver");
 
-    uint8_t snapshot[QUEUE_LENGTH(uint8_t, OUTPUT_QUEUE) + 1];
-    QUEUE_SNAPSHOT(uint8_t, OUTPUT_QUEUE, snapshot, sizeof(snapshot));
+    uint8_t snapshot[slabpool::length(OUTPUT_QUEUE) + 1];
+    slabpool::snapshot(OUTPUT_QUEUE, snapshot, sizeof(snapshot));
     snapshot[sizeof(snapshot) - 1] = NULL;
     fail_if(strstr((char*)snapshot, "driver") == NULL);
 }
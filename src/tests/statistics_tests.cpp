@@ -5,6 +5,7 @@
 
 using openxc::util::statistics::Statistic;
 using openxc::util::statistics::DeltaStatistic;
+using openxc::util::statistics::LatencyHistogram;
 
 namespace statistics = openxc::util::statistics;
 
@@ -93,6 +94,53 @@ START_TEST (test_delta_stat_exponential_average)
 }
 END_TEST
 
+START_TEST (test_latency_percentile_empty)
+{
+    LatencyHistogram histogram;
+    statistics::initialize(&histogram);
+    ck_assert_int_eq(0, statistics::percentile(&histogram, 50));
+}
+END_TEST
+
+START_TEST (test_latency_percentiles)
+{
+    LatencyHistogram histogram;
+    statistics::initialize(&histogram);
+    for(int i = 0; i < 90; i++) {
+        statistics::record(&histogram, 150);
+    }
+    for(int i = 0; i < 9; i++) {
+        statistics::record(&histogram, 1500);
+    }
+    statistics::record(&histogram, 30000);
+    ck_assert_int_eq(100, histogram.count);
+    ck_assert_int_eq(200, statistics::percentile(&histogram, 50));
+    ck_assert_int_eq(200, statistics::percentile(&histogram, 90));
+    ck_assert_int_eq(2000, statistics::percentile(&histogram, 99));
+    ck_assert_int_eq(30000, statistics::percentile(&histogram, 100));
+}
+END_TEST
+
+START_TEST (test_latency_percentile_capped_at_max)
+{
+    LatencyHistogram histogram;
+    statistics::initialize(&histogram);
+    statistics::record(&histogram, 3000);
+    ck_assert_int_eq(3000, statistics::percentile(&histogram, 50));
+}
+END_TEST
+
+START_TEST (test_latency_beyond_last_bucket)
+{
+    LatencyHistogram histogram;
+    statistics::initialize(&histogram);
+    statistics::record(&histogram, 60000000);
+    ck_assert_int_eq(1,
+            histogram.buckets[LATENCY_HISTOGRAM_BUCKET_COUNT - 1]);
+    ck_assert_int_eq(60000000, statistics::percentile(&histogram, 50));
+}
+END_TEST
+
 Suite* suite(void) {
     Suite* s = suite_create("statistics");
     TCase *tc_core = tcase_create("core");
@@ -103,6 +151,10 @@ Suite* suite(void) {
     tcase_add_test(tc_core, test_delta_stat_min_max);
     tcase_add_test(tc_core, test_delta_stat_exponential_average);
     tcase_add_test(tc_core, test_average_starts_at_first_value);
+    tcase_add_test(tc_core, test_latency_percentile_empty);
+    tcase_add_test(tc_core, test_latency_percentiles);
+    tcase_add_test(tc_core, test_latency_percentile_capped_at_max);
+    tcase_add_test(tc_core, test_latency_beyond_last_bucket);
     suite_add_tcase(s, tc_core);
 
     return s;
@@ -10,6 +10,11 @@ TEST_SRC=$(wildcard $(TEST_DIR)/*_tests.cpp)
 TESTS=$(patsubst %.cpp,$(TEST_OBJDIR)/%.bin,$(TEST_SRC))
 TEST_LIBS = -lcheck -lrt -lpthread -lsubunit
 
+BENCH_DIR = $(TEST_DIR)/bench
+BENCH_OBJDIR = build/bench
+BENCH_SRC=$(wildcard $(BENCH_DIR)/*_bench.cpp)
+BENCHES=$(patsubst %.cpp,$(BENCH_OBJDIR)/%.bin,$(BENCH_SRC))
+
 NON_TESTABLE_SRCS = signals.cpp main.cpp hardware_tests_main.cpp
 
 TEST_C_SRCS = $(CROSSPLATFORM_C_SRCS) $(wildcard tests/platform/*.c) \
@@ -19,10 +24,11 @@ TEST_CPP_SRCS := $(filter-out $(NON_TESTABLE_SRCS),$(TEST_CPP_SRCS))
 
 TEST_OBJ_FILES = $(TEST_C_SRCS:.c=.o) $(TEST_CPP_SRCS:.cpp=.o)
 TEST_OBJS = $(patsubst %,$(TEST_OBJDIR)/%,$(TEST_OBJ_FILES))
+BENCH_OBJS = $(patsubst %,$(BENCH_OBJDIR)/%,$(TEST_OBJ_FILES))
 
 GENERATOR = openxc-generate-firmware-code -s ../examples
 EXAMPLE_CONFIG_DIR = ../examples
-.PRECIOUS: $(TEST_OBJS) $(TESTS:.bin=.o)
+.PRECIOUS: $(TEST_OBJS) $(TESTS:.bin=.o) $(BENCH_OBJS) $(BENCHES:.bin=.o)
 
 define COMPILE_TEST_TEMPLATE
 $1: $3
@@ -65,11 +71,13 @@ test_long: test_short
 	@make usb_raw_write_compile_test
 	@make bluetooth_raw_write_compile_test
 	@make binary_output_compile_test
+	@make messagepack_output_compile_test
 	@make emulator_compile_test
 	@make msd_emulator_compile_test
 	@make stats_compile_test
 	@make msd_stats_compile_test
 	@make debug_stats_compile_test
+	@make profiling_compile_test
 	@make msd_mapped_compile_test
 	@make msd_passthrough_compile_test
 	@make msd_diag_compile_test
@@ -105,7 +113,10 @@ CXX_SUPRESSED_ERRORS = $(CC_SUPRESSED_ERRORS) -Wno-conversion-null
 unit_tests: LD = $(TEST_LD)
 unit_tests: CC = $(TEST_CC)
 unit_tests: CXX = $(TEST_CXX)
-unit_tests: CPPFLAGS = -I/usr/local -c -Wall -Werror -g -ggdb -coverage
+# The profiler only exists in PROFILING=1 builds, so the unit tests are built
+# with its probes compiled in.
+unit_tests: CPPFLAGS = -I/usr/local -c -Wall -Werror -g -ggdb -coverage \
+		-D__PROFILING__
 unit_tests: CFLAGS = $(CC_SUPRESSED_ERRORS) $(CFLAGS_STD)
 unit_tests: CXXFLAGS =  $(CXX_SUPRESSED_ERRORS) $(CXXFLAGS_STD)
 unit_tests: LDFLAGS = -lm -coverage
@@ -115,6 +126,21 @@ unit_tests: $(TESTS)
 	@set -o $(TEST_SET_OPTS) >/dev/null 2>&1
 	@export SHELLOPTS
 	@sh tests/runtests.sh $(TEST_OBJDIR)/$(TEST_DIR)
+
+# Benchmarks run on the development computer against the same test platform as
+# the unit tests, but are built with optimizations and without coverage so the
+# timings mean something.
+bench: LD = $(TEST_LD)
+bench: CC = $(TEST_CC)
+bench: CXX = $(TEST_CXX)
+bench: CPPFLAGS = -I/usr/local -c -Wall -Werror -O2
+bench: CFLAGS = $(CC_SUPRESSED_ERRORS) $(CFLAGS_STD)
+bench: CXXFLAGS =  $(CXX_SUPRESSED_ERRORS) $(CXXFLAGS_STD)
+bench: LDFLAGS = -lm
+bench: LDLIBS = -lrt
+bench: INCLUDE_PATHS += -I./tests/platform/
+bench: $(BENCHES)
+	@for i in $(BENCHES); do echo "Running $$i:"; ./$$i || exit 1; done
 	
 $(eval $(call ALL_PLATFORMS_TEST_TEMPLATE, default_compile_test, DEBUG=0, code_generation_test))
 $(eval $(call MSD_PLATFORMS_TEST_TEMPLATE, msd_default_compile_test, DEBUG=0 MSD_ENABLE=1, code_generation_test))
@@ -131,6 +157,7 @@ $(eval $(call MSD_PLATFORMS_TEST_TEMPLATE, msd_emulator_compile_test, DEBUG=0 DE
 $(eval $(call ALL_PLATFORMS_TEST_TEMPLATE, stats_compile_test, DEFAULT_METRICS_STATUS=1 DEBUG=0, code_generation_test))
 $(eval $(call MSD_PLATFORMS_TEST_TEMPLATE, msd_stats_compile_test, DEFAULT_METRICS_STATUS=1 DEBUG=0 MSD_ENABLE=1, code_generation_test))
 $(eval $(call ALL_PLATFORMS_TEST_TEMPLATE, debug_stats_compile_test, DEBUG=1 DEFAULT_METRICS_STATUS=1, code_generation_test))
+$(eval $(call ALL_PLATFORMS_TEST_TEMPLATE, profiling_compile_test, DEBUG=1 PROFILING=1, code_generation_test))
 #no more MSD below here - can add later
 # TODO see https://github.com/openxc/vi-firmware/issues/189
 #$(eval $(call ALL_PLATFORMS_TEST_TEMPLATE, network_compile_test, NETWORK=1, code_generation_test))
@@ -138,6 +165,7 @@ $(eval $(call ALL_PLATFORMS_TEST_TEMPLATE, debug_stats_compile_test, DEBUG=1 DEF
 $(eval $(call ALL_PLATFORMS_TEST_TEMPLATE, usb_raw_write_compile_test, DEBUG=0 DEFAULT_ALLOW_RAW_WRITE_USB=0, code_generation_test))
 $(eval $(call ALL_PLATFORMS_TEST_TEMPLATE, bluetooth_raw_write_compile_test, DEBUG=0 DEFAULT_ALLOW_RAW_WRITE_UART=1, code_generation_test))
 $(eval $(call ALL_PLATFORMS_TEST_TEMPLATE, binary_output_compile_test, DEBUG=0 DEFAULT_OUTPUT_FORMAT=PROTOBUF, code_generation_test))
+$(eval $(call ALL_PLATFORMS_TEST_TEMPLATE, messagepack_output_compile_test, DEBUG=0 DEFAULT_OUTPUT_FORMAT=MESSAGEPACK, code_generation_test))
 
 copy_passthrough_signals:
 	@echo "Testing example passthrough config in repo for FORDBOARD..."
@@ -198,5 +226,17 @@ $(TEST_OBJDIR)/%.bin: $(TEST_OBJDIR)/%.o $(TEST_OBJS)
 	@mkdir -p $(dir $@)
 	$(LD) $(LDFLAGS) $(CC_SYMBOLS) $(CXXFLAGS) $(INCLUDE_PATHS) -o $@ $^ $(LDLIBS)
 
+$(BENCH_OBJDIR)/%.o: %.cpp .firmware_options
+	@mkdir -p $(dir $@)
+	$(CXX) $(CPPFLAGS) $(CC_SYMBOLS) $(CXXFLAGS) $(INCLUDE_PATHS) -o $@ $<
+
+$(BENCH_OBJDIR)/%.o: %.c .firmware_options
+	@mkdir -p $(dir $@)
+	$(CC) $(CPPFLAGS) $(CC_SYMBOLS) $(CFLAGS) $(INCLUDE_PATHS) -o $@ $<
+
+$(BENCH_OBJDIR)/%.bin: $(BENCH_OBJDIR)/%.o $(BENCH_OBJS)
+	@mkdir -p $(dir $@)
+	$(LD) $(LDFLAGS) $(CC_SYMBOLS) $(CXXFLAGS) $(INCLUDE_PATHS) -o $@ $^ $(LDLIBS)
+
 cppclean:
 	cppclean $(INCLUDE_PATHS) --exclude libs --exclude tests .  | grep -v "declared but not defined" | grep -v static
@@ -1,6 +1,7 @@
 #include <check.h>
 #include <stdint.h>
 #include "signals.h"
+#include "can/canring.h"
 #include "diagnostics.h"
 #include "lights.h"
 #include "config.h"
@@ -9,6 +10,7 @@
 
 namespace diagnostics = openxc::diagnostics;
 namespace usb = openxc::interface::usb;
+namespace ring = openxc::can::ring;
 
 using openxc::pipeline::Pipeline;
 using openxc::signals::getCanBuses;
@@ -17,10 +19,12 @@ using openxc::config::getConfiguration;
 
 extern openxc::lights::RGB LIGHT_A_LAST_COLOR;
 extern unsigned long FAKE_TIME;
+extern unsigned long FAKE_TIME_US_STEP;
 
 // TODO this should be refactored out of vi_firmware.cpp, and include a header
 // file so we don't have to use extern.
-extern void receiveCan(Pipeline* pipeline, CanBus* bus);
+extern bool receiveCan(Pipeline* pipeline, CanBus* bus);
+extern void receiveAllCan(Pipeline* pipeline, CanBus* buses, int busCount);
 extern void checkBusActivity();
 extern void initializeVehicleInterface();
 extern void firmwareLoop();
@@ -33,6 +37,9 @@ static bool canQueueEmpty(int bus) {
 void setup() {
     initializeVehicleInterface();
     fail_unless(canQueueEmpty(0));
+    getConfiguration()->canReceiveBatchSize = 8;
+    getConfiguration()->canReceiveBudgetUs = 0;
+    FAKE_TIME_US_STEP = 0;
 }
 
 CanMessage message = {
@@ -44,7 +51,7 @@ CanMessage message = {
 START_TEST (test_update_data_lights_can_active)
 {
     CanBus* bus = &getCanBuses()[0];
-    QUEUE_PUSH(CanMessage, &bus->receiveQueue, message);
+    ring::push(&bus->receiveQueue, &message);
     receiveCan(&getConfiguration()->pipeline, bus);
 
     checkBusActivity();
@@ -61,7 +68,7 @@ START_TEST (test_update_data_lights_can_inactive)
                 openxc::lights::COLORS.red));
 
     CanBus* bus = &getCanBuses()[0];
-    QUEUE_PUSH(CanMessage, &bus->receiveQueue, message);
+    ring::push(&bus->receiveQueue, &message);
     receiveCan(&getConfiguration()->pipeline, bus);
 
     FAKE_TIME += (openxc::can::CAN_ACTIVE_TIMEOUT_S * 1000) * 2;
@@ -72,7 +79,7 @@ END_TEST
 START_TEST (test_update_data_lights_suspend)
 {
     CanBus* bus = &getCanBuses()[0];
-    QUEUE_PUSH(CanMessage, &bus->receiveQueue, message);
+    ring::push(&bus->receiveQueue, &message);
     receiveCan(&getConfiguration()->pipeline, bus);
 
     FAKE_TIME += (openxc::can::CAN_ACTIVE_TIMEOUT_S * 1000) * 2;
@@ -89,6 +96,73 @@ START_TEST (test_update_data_lights_suspend)
 }
 END_TEST
 
+static void pushReceivedMessages(CanBus* bus, int count) {
+    for(int i = 0; i < count; i++) {
+        ring::push(&bus->receiveQueue, &message);
+    }
+}
+
+START_TEST (test_receive_all_drains_queue)
+{
+    CanBus* bus = &getCanBuses()[0];
+    unsigned int received = bus->messagesReceived;
+    unsigned int exhausted = bus->receiveBudgetExhausted;
+    pushReceivedMessages(bus, 5);
+
+    receiveAllCan(&getConfiguration()->pipeline, getCanBuses(),
+            getCanBusCount());
+    ck_assert(ring::empty(&bus->receiveQueue));
+    ck_assert_int_eq(received + 5, bus->messagesReceived);
+    ck_assert_int_eq(exhausted, bus->receiveBudgetExhausted);
+}
+END_TEST
+
+START_TEST (test_receive_all_batch_limit)
+{
+    getConfiguration()->canReceiveBatchSize = 2;
+    CanBus* bus = &getCanBuses()[0];
+    unsigned int exhausted = bus->receiveBudgetExhausted;
+    unsigned int limited = bus->receiveBatchLimited;
+    pushReceivedMessages(bus, 5);
+
+    receiveAllCan(&getConfiguration()->pipeline, getCanBuses(),
+            getCanBusCount());
+    ck_assert_int_eq(3, ring::length(&bus->receiveQueue));
+    ck_assert_int_eq(limited + 1, bus->receiveBatchLimited);
+    ck_assert_int_eq(exhausted, bus->receiveBudgetExhausted);
+}
+END_TEST
+
+START_TEST (test_receive_all_round_robin)
+{
+    getConfiguration()->canReceiveBatchSize = 1;
+    pushReceivedMessages(&getCanBuses()[0], 3);
+    pushReceivedMessages(&getCanBuses()[1], 3);
+
+    receiveAllCan(&getConfiguration()->pipeline, getCanBuses(),
+            getCanBusCount());
+    ck_assert_int_eq(2, ring::length(&getCanBuses()[0].receiveQueue));
+    ck_assert_int_eq(2, ring::length(&getCanBuses()[1].receiveQueue));
+}
+END_TEST
+
+START_TEST (test_receive_all_time_budget)
+{
+    getConfiguration()->canReceiveBudgetUs = 1500;
+    FAKE_TIME_US_STEP = 1000;
+    CanBus* bus = &getCanBuses()[0];
+    unsigned int exhausted = bus->receiveBudgetExhausted;
+    unsigned int limited = bus->receiveBatchLimited;
+    pushReceivedMessages(bus, 5);
+
+    receiveAllCan(&getConfiguration()->pipeline, getCanBuses(),
+            getCanBusCount());
+    ck_assert_int_eq(3, ring::length(&bus->receiveQueue));
+    ck_assert_int_eq(exhausted + 1, bus->receiveBudgetExhausted);
+    ck_assert_int_eq(limited, bus->receiveBatchLimited);
+}
+END_TEST
+
 START_TEST (test_loop)
 {
     firmwareLoop();
@@ -102,6 +176,10 @@ Suite* suite(void) {
     tcase_add_test(tc_core, test_update_data_lights_can_active);
     tcase_add_test(tc_core, test_update_data_lights_can_inactive);
     tcase_add_test(tc_core, test_update_data_lights_suspend);
+    tcase_add_test(tc_core, test_receive_all_drains_queue);
+    tcase_add_test(tc_core, test_receive_all_batch_limit);
+    tcase_add_test(tc_core, test_receive_all_round_robin);
+    tcase_add_test(tc_core, test_receive_all_time_budget);
 
     tcase_add_test(tc_core, test_loop);
 
@@ -0,0 +1,92 @@
+#include "util/coalescing.h"
+
+#include <string.h>
+
+namespace slabpool = openxc::util::slabpool;
+
+void openxc::util::coalescing::initialize(CoalescingTable* table) {
+    memset(table, 0, sizeof(*table));
+}
+
+uint32_t openxc::util::coalescing::key(const char* name) {
+    // 32-bit FNV-1a
+    uint32_t hash = 2166136261u;
+    for(; *name != '\0'; name++) {
+        hash = (hash ^ (uint8_t)*name) * 16777619u;
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+CoalescingSlot* openxc::util::coalescing::update(CoalescingTable* table,
+        uint32_t key, const uint8_t* payload, int length) {
+    if(length <= 0 || length > COALESCING_SLOT_SIZE) {
+        ++table->overflows;
+        return NULL;
+    }
+
+    CoalescingSlot* slot = NULL;
+    for(int i = 0; i < table->slotCount; i++) {
+        if(table->slots[i].key == key) {
+            slot = &table->slots[i];
+            break;
+        }
+    }
+
+    if(slot == NULL) {
+        if(table->slotCount >= COALESCING_TABLE_SIZE) {
+            ++table->overflows;
+            return NULL;
+        }
+        slot = &table->slots[table->slotCount++];
+        slot->key = key;
+        slot->dirty = 0;
+        slot->slab = NULL;
+    } else if(slot->slab != NULL) {
+        slabpool::release(slot->slab);
+        slot->slab = NULL;
+    }
+
+    memcpy(slot->payload, payload, length);
+    slot->length = length;
+    return slot;
+}
+
+void openxc::util::coalescing::markDirty(CoalescingTable* table,
+        CoalescingSlot* slot, uint8_t channel) {
+    if(slot->dirty & (1 << channel)) {
+        ++table->replaced[channel];
+    }
+    slot->dirty |= 1 << channel;
+}
+
+CoalescingSlot* openxc::util::coalescing::nextDirty(CoalescingTable* table,
+        uint8_t channel) {
+    for(int i = 0; i < table->slotCount; i++) {
+        int index = (table->nextSlot[channel] + i) % table->slotCount;
+        if(table->slots[index].dirty & (1 << channel)) {
+            return &table->slots[index];
+        }
+    }
+    return NULL;
+}
+
+PayloadSlab* openxc::util::coalescing::slab(CoalescingSlot* slot) {
+    if(slot->slab == NULL) {
+        slot->slab = slabpool::acquire(slot->payload, slot->length,
+                slabpool::Lane::BULK);
+        if(slot->slab != NULL) {
+            slot->slab->receivedAtUs = slot->receivedAtUs;
+        }
+    }
+    return slot->slab;
+}
+
+void openxc::util::coalescing::markSent(CoalescingTable* table,
+        CoalescingSlot* slot, uint8_t channel) {
+    slot->dirty &= ~(1 << channel);
+    if(slot->dirty == 0 && slot->slab != NULL) {
+        slabpool::release(slot->slab);
+        slot->slab = NULL;
+    }
+    table->nextSlot[channel] = (slot - table->slots + 1) % table->slotCount;
+}
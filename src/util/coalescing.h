@@ -0,0 +1,118 @@
+#ifndef __COALESCING_H__
+#define __COALESCING_H__
+
+#include <stdint.h>
+#include "util/slabpool.h"
+
+// The number of values a CoalescingTable can hold, one for each signal that's
+// being coalesced.
+#ifndef COALESCING_TABLE_SIZE
+#define COALESCING_TABLE_SIZE 32
+#endif
+
+// The largest serialized value a slot can hold. Larger messages aren't
+// coalesced, which costs nothing for simple vehicle messages.
+#define COALESCING_SLOT_SIZE PAYLOAD_SLAB_SMALL_SIZE
+
+// The most channels (interfaces) sharing one table, one per bit of
+// CoalescingSlot.dirty.
+#define COALESCING_CHANNEL_COUNT 8
+
+/* Public: The newest serialized value of one signal.
+ *
+ * key - The key of the signal, from coalescing::key. 0 if the slot is unused.
+ * payload - The serialized message.
+ * length - The number of bytes in payload.
+ * dirty - One bit for each channel that hasn't sent this value yet.
+ * slab - The pool slab the value was copied into when the first channel sent
+ *      it, shared by every channel that sends it after, or NULL if it hasn't
+ *      been copied yet. The slot holds one reference until the value is
+ *      replaced or every channel has sent it.
+ * receivedAtUs - The time the CAN message this value came from was received,
+ *      in microseconds, or 0 if it didn't come from one.
+ */
+typedef struct {
+    uint32_t key;
+    uint8_t payload[COALESCING_SLOT_SIZE];
+    uint8_t length;
+    uint8_t dirty;
+    PayloadSlab* slab;
+    unsigned long receivedAtUs;
+} CoalescingSlot;
+
+/* Public: A table holding only the newest value of each signal, for interfaces
+ * that would rather skip stale values than send every one in order.
+ *
+ * A value replaced before it was sent is never sent at all, and each slot is
+ * sent at most once per update however many times it changed.
+ *
+ * slots - The slots, in the order their signals were first seen.
+ * slotCount - The number of slots in use.
+ * nextSlot - For each channel, the slot to look at first for the next value to
+ *      send, so every signal gets its turn.
+ * replaced - For each channel, the number of values replaced before they were
+ *      sent.
+ * overflows - The number of values that didn't fit in the table and had to be
+ *      sent as usual.
+ */
+typedef struct {
+    CoalescingSlot slots[COALESCING_TABLE_SIZE];
+    uint8_t slotCount;
+    uint8_t nextSlot[COALESCING_CHANNEL_COUNT];
+    unsigned int replaced[COALESCING_CHANNEL_COUNT];
+    unsigned int overflows;
+} CoalescingTable;
+
+namespace openxc {
+namespace util {
+namespace coalescing {
+
+/* Public: Empty the table and reset its counters.
+ *
+ * Any slabs held by the slots are forgotten rather than released, so the slab
+ * pool must be initialized again as well.
+ */
+void initialize(CoalescingTable* table);
+
+/* Public: Return the key for a signal's name, which is never 0.
+ */
+uint32_t key(const char* name);
+
+/* Public: Store the newest value of a signal in the table, overwriting the
+ * last one in place and releasing the slab of the last one.
+ *
+ * The channels that have to send the value must be marked with markDirty.
+ *
+ * Returns the signal's slot, or NULL if the table is full or the value is too
+ * large for a slot (and counted as an overflow).
+ */
+CoalescingSlot* update(CoalescingTable* table, uint32_t key,
+        const uint8_t* payload, int length);
+
+/* Public: Mark the value in a slot as waiting to be sent on a channel.
+ */
+void markDirty(CoalescingTable* table, CoalescingSlot* slot, uint8_t channel);
+
+/* Public: Return the next slot with a value waiting to be sent on a channel,
+ * taking the slots in turn, or NULL if there are none.
+ */
+CoalescingSlot* nextDirty(CoalescingTable* table, uint8_t channel);
+
+/* Public: Return the slab holding the value in a slot, copying it into one
+ * from the pool if no channel has sent it yet.
+ *
+ * Returns the slab, owned by the slot, or NULL if the pool has no free slab
+ * for the BULK lane.
+ */
+PayloadSlab* slab(CoalescingSlot* slot);
+
+/* Public: Mark the value in a slot as sent on a channel, releasing its slab
+ * once every channel has sent it.
+ */
+void markSent(CoalescingTable* table, CoalescingSlot* slot, uint8_t channel);
+
+} // namespace coalescing
+} // namespace util
+} // namespace openxc
+
+#endif // __COALESCING_H__
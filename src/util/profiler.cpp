@@ -0,0 +1,71 @@
+#include "util/profiler.h"
+
+#ifdef __PROFILING__
+
+#include <string.h>
+#include "util/log.h"
+
+using openxc::util::log::debug;
+using openxc::util::profiler::ProfileStage;
+using openxc::util::profiler::ProfileCounter;
+
+namespace time = openxc::util::time;
+
+// Indexed by ProfileStage
+static const char* STAGE_NAMES[PROFILE_STAGE_COUNT] = {
+    "can_interrupt",
+    "receive_can",
+    "decode",
+    "serialize",
+    "send_usb",
+    "send_uart",
+    "send_network",
+    "send_telit",
+    "send_ble",
+    "send_fs",
+};
+
+static ProfileCounter COUNTERS[PROFILE_STAGE_COUNT];
+
+openxc::util::profiler::ScopedProbe::~ScopedProbe() {
+    record(stage, time::cycleCount() - startCycles);
+}
+
+void openxc::util::profiler::record(ProfileStage stage, uint32_t cycles) {
+    ProfileCounter* counter = &COUNTERS[stage];
+    if(counter->count == 0 || cycles < counter->minCycles) {
+        counter->minCycles = cycles;
+    }
+    if(cycles > counter->maxCycles) {
+        counter->maxCycles = cycles;
+    }
+    counter->totalCycles += cycles;
+    ++counter->count;
+}
+
+const ProfileCounter* openxc::util::profiler::counter(ProfileStage stage) {
+    return &COUNTERS[stage];
+}
+
+const char* openxc::util::profiler::stageName(ProfileStage stage) {
+    return STAGE_NAMES[stage];
+}
+
+void openxc::util::profiler::reset() {
+    memset(COUNTERS, 0, sizeof(COUNTERS));
+}
+
+void openxc::util::profiler::logCounters() {
+    for(int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        const ProfileCounter* counter = &COUNTERS[i];
+        if(counter->count > 0) {
+            debug("Profile %s: %lu runs, avg %lu cycles, min %lu, max %lu",
+                    STAGE_NAMES[i], (unsigned long) counter->count,
+                    (unsigned long) (counter->totalCycles / counter->count),
+                    (unsigned long) counter->minCycles,
+                    (unsigned long) counter->maxCycles);
+        }
+    }
+}
+
+#endif // __PROFILING__
@@ -0,0 +1,115 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <stdint.h>
+#include "util/timer.h"
+
+/* Public: Time the rest of the enclosing scope as one run of a hot path stage,
+ * when the firmware is built with PROFILING=1. Otherwise this compiles to
+ * nothing at all.
+ *
+ * stage - The ProfileStage to record the run in.
+ */
+#ifdef __PROFILING__
+#define PROFILE_SCOPE(stage) \
+        openxc::util::profiler::ScopedProbe profileProbe(stage)
+#else
+#define PROFILE_SCOPE(stage)
+#endif
+
+namespace openxc {
+namespace util {
+namespace profiler {
+
+/* Public: The stages of the path from a CAN message arriving to its signals
+ * going out to the interfaces. The SEND_ stages are in the same order as
+ * InterfaceType.
+ */
+typedef enum {
+    CAN_INTERRUPT,
+    RECEIVE_CAN,
+    DECODE,
+    SERIALIZE,
+    SEND_USB,
+    SEND_UART,
+    SEND_NETWORK,
+    SEND_TELIT,
+    SEND_BLE,
+    SEND_FS,
+} ProfileStage;
+
+#define PROFILE_STAGE_COUNT 10
+
+/* Public: The cycles spent in one stage, as counted by time::cycleCount.
+ *
+ * count - The number of runs recorded.
+ * totalCycles - The cycles spent in all of them.
+ * minCycles - The fewest cycles any one run took.
+ * maxCycles - The most cycles any one run took.
+ */
+typedef struct {
+    uint32_t count;
+    uint64_t totalCycles;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+} ProfileCounter;
+
+/* Public: Return true if the probes were compiled in.
+ */
+inline bool enabled() {
+#ifdef __PROFILING__
+    return true;
+#else
+    return false;
+#endif
+}
+
+// The counters and the functions below only exist when the firmware is built
+// with PROFILING=1, so a regular build has no profiler RAM or code at all.
+#ifdef __PROFILING__
+
+/* Public: Records the cycles from its construction to the end of its scope
+ * in a stage's counter. Use PROFILE_SCOPE instead, so it can be compiled out.
+ */
+class ScopedProbe {
+public:
+    ScopedProbe(ProfileStage stage) :
+            stage(stage), startCycles(time::cycleCount()) { }
+    ~ScopedProbe();
+
+private:
+    ProfileStage stage;
+    uint32_t startCycles;
+};
+
+/* Public: Record one run of a stage.
+ *
+ * Each stage must only be recorded from one context, e.g. only from the CAN
+ * interrupt handler or only from the main loop, since the counters aren't
+ * locked.
+ */
+void record(ProfileStage stage, uint32_t cycles);
+
+/* Public: Return the counter for a stage.
+ */
+const ProfileCounter* counter(ProfileStage stage);
+
+/* Public: Return a short name for a stage, e.g. "decode".
+ */
+const char* stageName(ProfileStage stage);
+
+/* Public: Reset the counters of every stage.
+ */
+void reset();
+
+/* Public: Log the counters of every stage that has run.
+ */
+void logCounters();
+
+#endif // __PROFILING__
+
+} // namespace profiler
+} // namespace util
+} // namespace openxc
+
+#endif // __PROFILER_H__
@@ -0,0 +1,323 @@
+#include "util/slabpool.h"
+
+#include <string.h>
+#include "util/timer.h"
+
+namespace time = openxc::util::time;
+namespace statistics = openxc::util::statistics;
+
+QUEUE_DEFINE(PayloadSlabRef);
+
+static PayloadSlab SLABS[PAYLOAD_SLAB_COUNT];
+static uint8_t SMALL_SLAB_DATA[PAYLOAD_SLAB_SMALL_COUNT][PAYLOAD_SLAB_SMALL_SIZE];
+static uint8_t LARGE_SLAB_DATA[PAYLOAD_SLAB_LARGE_COUNT][PAYLOAD_SLAB_SIZE];
+
+static unsigned int copiedBytes;
+static unsigned int exhaustions;
+
+/* Private: Return the storage for the slab - the first PAYLOAD_SLAB_SMALL_COUNT
+ * slabs are the small size class, the rest are large.
+ */
+static uint8_t* slabStorage(const PayloadSlab* slab) {
+    int index = slab - SLABS;
+    if(index < PAYLOAD_SLAB_SMALL_COUNT) {
+        return SMALL_SLAB_DATA[index];
+    }
+    return LARGE_SLAB_DATA[index - PAYLOAD_SLAB_SMALL_COUNT];
+}
+
+/* Private: Return a free slab between start and end, as long as more than
+ * reserve of them are free.
+ */
+static PayloadSlab* findFreeSlab(int start, int end, int reserve) {
+    PayloadSlab* slab = NULL;
+    int free = 0;
+    for(int i = start; i < end && free <= reserve; i++) {
+        if(SLABS[i].references == 0) {
+            if(slab == NULL) {
+                slab = &SLABS[i];
+            }
+            ++free;
+        }
+    }
+    return free > reserve ? slab : NULL;
+}
+
+void openxc::util::slabpool::initialize() {
+    for(int i = 0; i < PAYLOAD_SLAB_COUNT; i++) {
+        SLABS[i].length = 0;
+        SLABS[i].references = 0;
+        SLABS[i].queuedAtUs = 0;
+        SLABS[i].receivedAtUs = 0;
+    }
+    copiedBytes = 0;
+    exhaustions = 0;
+}
+
+PayloadSlab* openxc::util::slabpool::reserve(int capacity, Lane lane) {
+    if(capacity <= 0 || capacity > PAYLOAD_SLAB_SIZE) {
+        return NULL;
+    }
+
+    int reserved = lane == Lane::PRIORITY ? 0 : PAYLOAD_SLAB_PRIORITY_RESERVE;
+    PayloadSlab* slab = NULL;
+    if(capacity <= PAYLOAD_SLAB_SMALL_SIZE) {
+        slab = findFreeSlab(0, PAYLOAD_SLAB_SMALL_COUNT, reserved);
+    }
+
+    if(slab == NULL) {
+        slab = findFreeSlab(PAYLOAD_SLAB_SMALL_COUNT, PAYLOAD_SLAB_COUNT,
+                reserved);
+    }
+
+    if(slab == NULL) {
+        ++exhaustions;
+        return NULL;
+    }
+
+    slab->length = capacity;
+    slab->references = 1;
+    slab->queuedAtUs = time::systemTimeUs();
+    slab->receivedAtUs = 0;
+    return slab;
+}
+
+PayloadSlab* openxc::util::slabpool::acquire(const uint8_t* payload,
+        int length, Lane lane) {
+    if(payload == NULL) {
+        return NULL;
+    }
+
+    PayloadSlab* slab = reserve(length, lane);
+    if(slab != NULL) {
+        memcpy(slabStorage(slab), payload, length);
+        copiedBytes += length;
+    }
+    return slab;
+}
+
+void openxc::util::slabpool::release(PayloadSlab* slab) {
+    if(slab != NULL && slab->references > 0) {
+        --slab->references;
+    }
+}
+
+const uint8_t* openxc::util::slabpool::data(const PayloadSlab* slab) {
+    return slabStorage(slab);
+}
+
+uint8_t* openxc::util::slabpool::writableData(PayloadSlab* slab) {
+    return slabStorage(slab);
+}
+
+int openxc::util::slabpool::available() {
+    int count = 0;
+    for(int i = 0; i < PAYLOAD_SLAB_COUNT; i++) {
+        if(SLABS[i].references == 0) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+unsigned int openxc::util::slabpool::bytesCopied() {
+    return copiedBytes;
+}
+
+unsigned int openxc::util::slabpool::exhaustedCount() {
+    return exhaustions;
+}
+
+void openxc::util::slabpool::initializeQueue(SlabQueue* queue) {
+    for(int i = 0; i < SLAB_QUEUE_LANE_COUNT; i++) {
+        QUEUE_INIT(PayloadSlabRef, &queue->lanes[i].slabs);
+        queue->lanes[i].length = 0;
+    }
+    queue->drainingLane = 0;
+    queue->offset = 0;
+    queue->length = 0;
+    queue->latency = NULL;
+}
+
+bool openxc::util::slabpool::fits(SlabQueue* queue, int length, Lane lane) {
+    return queue != NULL &&
+            !QUEUE_FULL(PayloadSlabRef, &queue->lanes[lane].slabs) &&
+            queue->lanes[lane].length + length <= SLAB_QUEUE_MAX_BYTES;
+}
+
+bool openxc::util::slabpool::enqueue(SlabQueue* queue, PayloadSlab* slab,
+        Lane lane) {
+    if(slab == NULL || !fits(queue, slab->length, lane)) {
+        return false;
+    }
+
+    QUEUE_PUSH(PayloadSlabRef, &queue->lanes[lane].slabs, slab);
+    ++slab->references;
+    queue->lanes[lane].length += slab->length;
+    queue->length += slab->length;
+    return true;
+}
+
+/* Private: Record how long a payload that has just finished draining took
+ * to go out.
+ */
+static void recordLatency(SlabQueue* queue, const PayloadSlab* slab) {
+    if(queue->latency == NULL) {
+        return;
+    }
+
+    unsigned long now = time::systemTimeUs();
+    statistics::record(&queue->latency->queued, now - slab->queuedAtUs);
+    if(slab->receivedAtUs != 0) {
+        statistics::record(&queue->latency->received,
+                now - slab->receivedAtUs);
+    }
+}
+
+/* Private: Return the lane the next byte should be drained from - the one
+ * with a payload in progress, or else the highest priority lane with anything
+ * waiting.
+ *
+ * Returns NULL if the queue is empty.
+ */
+static SlabLane* nextLane(SlabQueue* queue) {
+    if(queue->offset > 0) {
+        return &queue->lanes[queue->drainingLane];
+    }
+
+    for(int i = 0; i < SLAB_QUEUE_LANE_COUNT; i++) {
+        if(!QUEUE_EMPTY(PayloadSlabRef, &queue->lanes[i].slabs)) {
+            queue->drainingLane = i;
+            return &queue->lanes[i];
+        }
+    }
+    return NULL;
+}
+
+int openxc::util::slabpool::drain(SlabQueue* queue, uint8_t* buffer,
+        int length) {
+    int drained = 0;
+    SlabLane* lane;
+    while(drained < length && (lane = nextLane(queue)) != NULL) {
+        PayloadSlab* slab = QUEUE_PEEK(PayloadSlabRef, &lane->slabs);
+        int count = slab->length - queue->offset;
+        if(count > length - drained) {
+            count = length - drained;
+        }
+
+        memcpy(&buffer[drained], &slabStorage(slab)[queue->offset], count);
+        drained += count;
+        queue->offset += count;
+        queue->length -= count;
+        lane->length -= count;
+
+        if(queue->offset >= slab->length) {
+            QUEUE_POP(PayloadSlabRef, &lane->slabs);
+            queue->offset = 0;
+            recordLatency(queue, slab);
+            release(slab);
+        }
+    }
+    return drained;
+}
+
+/* Private: Copy the payloads waiting in one lane into buffer, starting offset
+ * bytes into the first.
+ *
+ * Returns the number of bytes copied.
+ */
+static int snapshotLane(SlabLane* lane, int offset, uint8_t* buffer,
+        int length) {
+    int slabCount = QUEUE_LENGTH(PayloadSlabRef, &lane->slabs);
+    if(slabCount == 0) {
+        return 0;
+    }
+
+    PayloadSlabRef slabs[slabCount];
+    QUEUE_SNAPSHOT(PayloadSlabRef, &lane->slabs, slabs, slabCount);
+
+    int copied = 0;
+    for(int i = 0; i < slabCount && copied < length; i++) {
+        int count = slabs[i]->length - offset;
+        if(count > length - copied) {
+            count = length - copied;
+        }
+        memcpy(&buffer[copied], &slabStorage(slabs[i])[offset], count);
+        copied += count;
+        offset = 0;
+    }
+    return copied;
+}
+
+int openxc::util::slabpool::snapshot(SlabQueue* queue, uint8_t* buffer,
+        int length) {
+    int copied = 0;
+    int skipped = 0;
+    if(queue->offset > 0) {
+        // The rest of the payload in progress goes first, then the lanes in
+        // order as usual
+        SlabLane* lane = &queue->lanes[queue->drainingLane];
+        PayloadSlab* slab = QUEUE_PEEK(PayloadSlabRef, &lane->slabs);
+        copied = slab->length - queue->offset;
+        if(copied > length) {
+            copied = length;
+        }
+        memcpy(buffer, &slabStorage(slab)[queue->offset], copied);
+        skipped = slab->length;
+    }
+
+    for(int i = 0; i < SLAB_QUEUE_LANE_COUNT && copied < length; i++) {
+        copied += snapshotLane(&queue->lanes[i],
+                i == queue->drainingLane ? skipped : 0, &buffer[copied],
+                length - copied);
+    }
+    return copied;
+}
+
+bool openxc::util::slabpool::dropOldest(SlabQueue* queue, Lane lane) {
+    SlabLane* slabLane = &queue->lanes[lane];
+    int slabCount = QUEUE_LENGTH(PayloadSlabRef, &slabLane->slabs);
+    int dropped = queue->offset > 0 && queue->drainingLane == lane ? 1 : 0;
+    if(dropped >= slabCount) {
+        return false;
+    }
+
+    // The queue can only be popped from the front, so cycle every reference
+    // around to the back once to take out the one in the middle
+    for(int i = 0; i < slabCount; i++) {
+        PayloadSlab* slab = QUEUE_POP(PayloadSlabRef, &slabLane->slabs);
+        if(i == dropped) {
+            slabLane->length -= slab->length;
+            queue->length -= slab->length;
+            release(slab);
+        } else {
+            QUEUE_PUSH(PayloadSlabRef, &slabLane->slabs, slab);
+        }
+    }
+    return true;
+}
+
+void openxc::util::slabpool::clear(SlabQueue* queue) {
+    for(int i = 0; i < SLAB_QUEUE_LANE_COUNT; i++) {
+        SlabLane* lane = &queue->lanes[i];
+        while(!QUEUE_EMPTY(PayloadSlabRef, &lane->slabs)) {
+            release(QUEUE_POP(PayloadSlabRef, &lane->slabs));
+        }
+        lane->length = 0;
+    }
+    queue->drainingLane = 0;
+    queue->offset = 0;
+    queue->length = 0;
+}
+
+int openxc::util::slabpool::length(SlabQueue* queue) {
+    return queue->length;
+}
+
+int openxc::util::slabpool::length(SlabQueue* queue, Lane lane) {
+    return queue->lanes[lane].length;
+}
+
+bool openxc::util::slabpool::empty(SlabQueue* queue) {
+    return queue->length == 0;
+}
@@ -0,0 +1,256 @@
+#ifndef __SLABPOOL_H__
+#define __SLABPOOL_H__
+
+#include <stdint.h>
+#include "emqueue.h"
+#include "util/statistics.h"
+
+// The largest payload a single slab can hold - this must be at least as large
+// as MAX_OUTGOING_PAYLOAD_SIZE in pipeline.h.
+#define PAYLOAD_SLAB_SIZE 340
+// Most serialized messages are well under 100 bytes, so the pool is split into
+// two size classes to avoid spending 340 bytes on every simple message.
+#define PAYLOAD_SLAB_SMALL_SIZE 96
+
+#ifndef PAYLOAD_SLAB_SMALL_COUNT
+#define PAYLOAD_SLAB_SMALL_COUNT 24
+#endif
+
+#ifndef PAYLOAD_SLAB_LARGE_COUNT
+#define PAYLOAD_SLAB_LARGE_COUNT 4
+#endif
+
+#define PAYLOAD_SLAB_COUNT (PAYLOAD_SLAB_SMALL_COUNT + PAYLOAD_SLAB_LARGE_COUNT)
+
+// The most bytes that may be waiting in each lane of one interface's
+// SlabQueue, the same as the byte queues they replaced so backpressure behaves
+// as it did before.
+#define SLAB_QUEUE_MAX_BYTES 384
+
+// The number of priority lanes in each SlabQueue - see slabpool::Lane.
+#define SLAB_QUEUE_LANE_COUNT 2
+
+// The number of slabs of each size class that only payloads for the priority
+// lane may take, so a flood of data can't leave a command response nowhere to
+// go.
+#ifndef PAYLOAD_SLAB_PRIORITY_RESERVE
+#define PAYLOAD_SLAB_PRIORITY_RESERVE 1
+#endif
+
+/* Public: A reference counted, serialized payload shared by every interface
+ * that is sending it.
+ *
+ * length - The number of bytes of payload data stored in the slab.
+ * references - The number of queues (and owners) still holding the slab. The
+ *      slab returns to the pool when this drops to 0.
+ * queuedAtUs - The system time the payload was copied into the slab, in
+ *      microseconds.
+ * receivedAtUs - The system time the CAN message the payload came from was
+ *      received, in microseconds, or 0 if it didn't come from one.
+ */
+typedef struct {
+    uint16_t length;
+    uint8_t references;
+    unsigned long queuedAtUs;
+    unsigned long receivedAtUs;
+} PayloadSlab;
+
+typedef PayloadSlab* PayloadSlabRef;
+
+QUEUE_DECLARE(PayloadSlabRef, 8);
+
+/* Public: How long the payloads drained from a SlabQueue took to go out.
+ *
+ * queued - The time from each payload being queued to it being drained.
+ * received - The time from the CAN message each payload came from being
+ *      received to the payload being drained, for payloads that came from one.
+ */
+typedef struct {
+    openxc::util::statistics::LatencyHistogram queued;
+    openxc::util::statistics::LatencyHistogram received;
+} SendLatency;
+
+/* Public: One priority lane of a SlabQueue.
+ *
+ * slabs - References to the slabs waiting to be sent, oldest first.
+ * length - The number of bytes waiting in this lane.
+ */
+typedef struct {
+    QUEUE_TYPE(PayloadSlabRef) slabs;
+    uint16_t length;
+} SlabLane;
+
+/* Public: An outgoing queue of payloads for one interface, split into lanes
+ * that are drained strictly in priority order.
+ *
+ * A payload is never interrupted once draining it has started, so a payload
+ * arriving in a higher priority lane waits for the one in progress to finish
+ * and then goes next.
+ *
+ * lanes - The lanes, highest priority first.
+ * drainingLane - The lane of the payload that's partially drained, if offset
+ *      isn't 0.
+ * offset - The number of bytes of that payload that have already been drained.
+ * length - The total number of bytes still waiting to be sent in all lanes.
+ * latency - Where to record how long each payload took to be drained, or NULL
+ *      to not record it.
+ */
+typedef struct {
+    SlabLane lanes[SLAB_QUEUE_LANE_COUNT];
+    uint8_t drainingLane;
+    uint16_t offset;
+    uint16_t length;
+    SendLatency* latency;
+} SlabQueue;
+
+namespace openxc {
+namespace util {
+namespace slabpool {
+
+/* Public: The lanes of a SlabQueue.
+ *
+ * PRIORITY - Payloads that must not wait behind vehicle data, e.g. command
+ *      responses.
+ * BULK - Everything else.
+ */
+typedef enum {
+    PRIORITY,
+    BULK,
+} Lane;
+
+/* Public: Return every slab to the pool and reset the copy counters.
+ *
+ * Any SlabQueue still holding a slab must be re-initialized as well.
+ */
+void initialize();
+
+/* Public: Copy a payload into a free slab from the pool.
+ *
+ * This is the only place the payload bytes are copied before they are drained
+ * out to the hardware, no matter how many interfaces it's queued on.
+ *
+ * payload - The serialized payload to copy.
+ * length - The length of the payload in bytes.
+ * lane - The lane the payload will be queued in. Payloads for the BULK lane
+ *      can't take the last PAYLOAD_SLAB_PRIORITY_RESERVE slabs of either size
+ *      class.
+ *
+ * The slab's queuedAtUs is set to the current time and its receivedAtUs to 0.
+ *
+ * Returns a slab with a single reference owned by the caller, or NULL if the
+ * payload is too large or no slab is free. The caller must release() it once
+ * it's been enqueued on all interfaces.
+ */
+PayloadSlab* acquire(const uint8_t* payload, int length, Lane lane);
+
+/* Public: Take a free slab from the pool for a payload of up to capacity
+ * bytes, to be serialized straight into writableData() instead of being copied
+ * in by acquire().
+ *
+ * The slab's length is set to capacity - the caller must set it to the number
+ * of bytes it actually wrote before enqueueing it. Those bytes don't count
+ * towards bytesCopied().
+ *
+ * Returns a slab with a single reference owned by the caller, or NULL if the
+ * capacity is too large or no slab is free for the lane, as for acquire().
+ */
+PayloadSlab* reserve(int capacity, Lane lane);
+
+/* Public: Drop one reference to the slab, returning it to the pool if it was
+ * the last.
+ */
+void release(PayloadSlab* slab);
+
+/* Public: Return the payload bytes stored in the slab.
+ */
+const uint8_t* data(const PayloadSlab* slab);
+
+/* Public: Return the payload storage of a slab taken with reserve(), for the
+ * caller to write into.
+ */
+uint8_t* writableData(PayloadSlab* slab);
+
+/* Public: Return the number of slabs free in the pool.
+ */
+int available();
+
+/* Public: Return the total number of payload bytes copied into slabs since the
+ * pool was initialized.
+ */
+unsigned int bytesCopied();
+
+/* Public: Return the number of times a slab was requested but the pool was
+ * empty.
+ */
+unsigned int exhaustedCount();
+
+/* Public: Initialize an empty queue that doesn't record latency, without
+ * releasing any slabs it held.
+ */
+void initializeQueue(SlabQueue* queue);
+
+/* Public: Check if a payload of the given length will fit in a lane of the
+ * queue.
+ *
+ * Returns true if there is room in the lane. Returns false otherwise, or if
+ * queue is NULL.
+ */
+bool fits(SlabQueue* queue, int length, Lane lane);
+
+/* Public: Add a reference to the slab to the back of a lane of the queue.
+ *
+ * Returns true if the slab fit in the lane and was added.
+ */
+bool enqueue(SlabQueue* queue, PayloadSlab* slab, Lane lane);
+
+/* Public: Copy up to length bytes from the front of the queue into buffer,
+ * releasing any slabs that have been completely drained.
+ *
+ * The payload in progress is finished first, then each following payload is
+ * taken from the highest priority lane that isn't empty.
+ *
+ * This is intended for copying straight into the hardware send buffer in an
+ * interface's processSendQueue, so the time each payload finishes draining is
+ * recorded in the queue's latency (if it has one) as the time it was sent.
+ *
+ * Returns the number of bytes copied.
+ */
+int drain(SlabQueue* queue, uint8_t* buffer, int length);
+
+/* Public: Copy up to length bytes from the front of the queue into buffer
+ * without removing them, in the order drain() would send them if nothing else
+ * were queued.
+ *
+ * Returns the number of bytes copied.
+ */
+int snapshot(SlabQueue* queue, uint8_t* buffer, int length);
+
+/* Public: Return the number of bytes waiting in one lane of the queue.
+ */
+int length(SlabQueue* queue, Lane lane);
+
+/* Public: Remove the oldest payload waiting in a lane of the queue, to make
+ * room for a newer one. A payload that has started draining is left alone,
+ * and the one after it is removed instead.
+ *
+ * Returns true if a payload was removed.
+ */
+bool dropOldest(SlabQueue* queue, Lane lane);
+
+/* Public: Release all slabs held by the queue and leave it empty.
+ */
+void clear(SlabQueue* queue);
+
+/* Public: Return the number of bytes waiting in the queue.
+ */
+int length(SlabQueue* queue);
+
+/* Public: Return true if there are no bytes waiting in the queue.
+ */
+bool empty(SlabQueue* queue);
+
+} // namespace slabpool
+} // namespace util
+} // namespace openxc
+
+#endif // __SLABPOOL_H__
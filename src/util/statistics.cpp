@@ -2,9 +2,21 @@
 
 #include <limits.h>
 #include <stddef.h>
+#include <string.h>
 
 #include "config.h"
 
+// The upper bound of each LatencyHistogram bucket but the last, in
+// microseconds.
+static const unsigned long LATENCY_BUCKET_LIMITS_US[
+        LATENCY_HISTOGRAM_BUCKET_COUNT - 1] = {
+    100, 200, 500,
+    1000, 2000, 5000,
+    10000, 20000, 50000,
+    100000, 200000, 500000,
+    1000000, 2000000, 5000000,
+};
+
 void openxc::util::statistics::initialize(DeltaStatistic* stat) {
     stat->total = 0;
     initialize(&stat->statistic);
@@ -58,3 +70,37 @@ int openxc::util::statistics::maximum(const Statistic* stat) {
 int openxc::util::statistics::maximum(const DeltaStatistic* stat) {
     return stat->statistic.max;
 }
+
+void openxc::util::statistics::initialize(LatencyHistogram* histogram) {
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+void openxc::util::statistics::record(LatencyHistogram* histogram,
+        unsigned long latencyUs) {
+    int bucket = 0;
+    while(bucket < LATENCY_HISTOGRAM_BUCKET_COUNT - 1 &&
+            latencyUs > LATENCY_BUCKET_LIMITS_US[bucket]) {
+        ++bucket;
+    }
+    ++histogram->buckets[bucket];
+    ++histogram->count;
+    histogram->maxUs = MAX(histogram->maxUs, latencyUs);
+}
+
+unsigned long openxc::util::statistics::percentile(
+        const LatencyHistogram* histogram, int percent) {
+    if(histogram->count == 0) {
+        return 0;
+    }
+
+    // The rank of the sample at the percentile, counting from 1
+    unsigned int rank = MAX(1, (histogram->count * percent + 99) / 100);
+    unsigned int seen = 0;
+    for(int i = 0; i < LATENCY_HISTOGRAM_BUCKET_COUNT - 1; i++) {
+        seen += histogram->buckets[i];
+        if(seen >= rank) {
+            return MIN(LATENCY_BUCKET_LIMITS_US[i], histogram->maxUs);
+        }
+    }
+    return histogram->maxUs;
+}
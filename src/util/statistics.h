@@ -26,6 +26,24 @@ typedef struct {
     Statistic statistic;
 } DeltaStatistic;
 
+// The number of buckets in a LatencyHistogram, the last of which holds
+// everything longer than the others.
+#define LATENCY_HISTOGRAM_BUCKET_COUNT 16
+
+/* Public: A histogram of latencies with fixed buckets, from 100us up to 5s in
+ * roughly 1-2-5 steps, for estimating percentiles without keeping every
+ * sample.
+ *
+ * buckets - The number of latencies recorded in each bucket.
+ * count - The total number of latencies recorded.
+ * maxUs - The longest latency recorded, in microseconds.
+ */
+typedef struct {
+    unsigned int buckets[LATENCY_HISTOGRAM_BUCKET_COUNT];
+    unsigned int count;
+    unsigned long maxUs;
+} LatencyHistogram;
+
 /* Public: Initialize a new Statistic.
  *
  * stat - the Statistic to initialize.
@@ -55,6 +73,24 @@ int maximum(const Statistic* stat);
 
 int maximum(const DeltaStatistic* stat);
 
+/* Public: Empty a LatencyHistogram.
+ */
+void initialize(LatencyHistogram* histogram);
+
+/* Public: Record one latency, in microseconds.
+ */
+void record(LatencyHistogram* histogram, unsigned long latencyUs);
+
+/* Public: Estimate a percentile of the latencies recorded.
+ *
+ * percent - The percentile, from 0 to 100.
+ *
+ * Returns the upper bound of the bucket the percentile falls in (or the
+ * longest latency recorded, if that's shorter), in microseconds. Returns 0 if
+ * nothing has been recorded.
+ */
+unsigned long percentile(const LatencyHistogram* histogram, int percent);
+
 
 } // namespace statistics
 } // namespace util
@@ -1,6 +1,8 @@
 #ifndef __TIMER_H__
 #define __TIMER_H__
 
+#include <stdint.h>
+
 namespace openxc {
 namespace util {
 namespace time {
@@ -68,6 +70,23 @@ void delayMs(unsigned long delayInMs);
  */
 unsigned long systemTimeMs();
 
+/* Public: Return the current system time in microseconds.
+ *
+ * This wraps around much sooner than systemTimeMs(), so it's only useful for
+ * measuring short intervals.
+ */
+unsigned long systemTimeUs();
+
+/* Public: Return a free running count of CPU cycles, for profiling short
+ * stretches of code.
+ *
+ * This wraps around every few seconds and its rate depends on the platform
+ * (the core clock on the LPC17xx, half of it on the PIC32 and nanoseconds on
+ * the host), so only the difference between two counts close together means
+ * anything.
+ */
+uint32_t cycleCount();
+
 /* Public: Perform any one-time initialization required to use system times,
  * including those for system time and the delayMs function.
  */
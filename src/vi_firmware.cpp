@@ -1,5 +1,6 @@
 #include "interface/usb.h"
 #include "can/canread.h"
+#include "can/canring.h"
 #include "interface/uart.h"
 #include "interface/network.h"
 #include "signals.h"
@@ -7,6 +8,7 @@
 #include "cJSON.h"
 #include "pipeline.h"
 #include "util/timer.h"
+#include "util/profiler.h"
 #include "lights.h"
 #include "power.h"
 #include "bluetooth.h"
@@ -56,6 +58,7 @@ using openxc::pipeline::Pipeline;
 using openxc::config::getConfiguration;
 using openxc::config::PowerManagement;
 using openxc::config::RunLevel;
+using openxc::util::profiler::ProfileStage;
 
 static bool BUS_WAS_ACTIVE;
 static bool SUSPENDED;
@@ -171,11 +174,23 @@ void initializeAllCan() {
 /*
  * Check to see if a packet has been received. If so, read the packet and print
  * the packet payload to the uart monitor.
+ *
+ * Returns true if a message was waiting in the bus's receive queue.
  */
-void receiveCan(Pipeline* pipeline, CanBus* bus) {
-    if(!QUEUE_EMPTY(CanMessage, &bus->receiveQueue)) {
-        CanMessage message = QUEUE_POP(CanMessage, &bus->receiveQueue);
-        signals::decodeCanMessage(pipeline, bus, &message);
+bool receiveCan(Pipeline* pipeline, CanBus* bus) {
+    CanMessage message;
+    if(can::ring::pop(&bus->receiveQueue, &message)) {
+        PROFILE_SCOPE(ProfileStage::RECEIVE_CAN);
+        // Everything published while handling the message is timestamped
+        // with when it was received, to measure how long it takes to go out
+        pipeline->canReceivedAtUs = message.receivedAtUs;
+        CanMessageDefinition* definition = can::lookupMessageDefinition(bus,
+                message.id, message.format, getMessages(), getMessageCount());
+        if(can::read::shouldDecodeMessage(definition, &message, getSignals(),
+                    signals::getSignalManagers(), getSignalCount())) {
+            PROFILE_SCOPE(ProfileStage::DECODE);
+            signals::decodeCanMessage(pipeline, bus, &message);
+        }
         if(bus->passthroughCanMessages) {
             openxc::can::read::passthroughMessage(bus, &message, getMessages(),
                     getMessageCount(), pipeline);
@@ -185,7 +200,56 @@ void receiveCan(Pipeline* pipeline, CanBus* bus) {
 
         diagnostics::receiveCanMessage(&getConfiguration()->diagnosticsManager,
                 bus, &message, pipeline);
+        pipeline->canReceivedAtUs = 0;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Drain up to canReceiveBatchSize messages from each bus's receive queue,
+ * taking one message from each bus in turn so a busy bus can't starve the
+ * others. The bus that goes first rotates each time this is called. Stops
+ * early if the canReceiveBudgetUs time budget runs out.
+ *
+ * If messages are still waiting when the time budget runs out, the bus's
+ * receiveBudgetExhausted count is incremented; if they are waiting because the
+ * batch size was reached, its receiveBatchLimited count is incremented instead.
+ */
+void receiveAllCan(Pipeline* pipeline, CanBus* buses, int busCount) {
+    static int firstBus = 0;
+    if(busCount <= 0) {
+        return;
+    }
+
+    int batchSize = MAX(getConfiguration()->canReceiveBatchSize, 1);
+    unsigned int budgetUs = getConfiguration()->canReceiveBudgetUs;
+    unsigned long startTimeUs = time::systemTimeUs();
+
+    bool budgetRemaining = true;
+    bool received = true;
+    for(int round = 0; round < batchSize && received && budgetRemaining;
+            round++) {
+        received = false;
+        for(int i = 0; i < busCount && budgetRemaining; i++) {
+            if(receiveCan(pipeline, &buses[(firstBus + i) % busCount])) {
+                received = true;
+                budgetRemaining = budgetUs == 0 ||
+                        time::systemTimeUs() - startTimeUs < budgetUs;
+            }
+        }
+    }
+
+    for(int i = 0; i < busCount; i++) {
+        if(!can::ring::empty(&buses[i].receiveQueue)) {
+            if(budgetRemaining) {
+                ++buses[i].receiveBatchLimited;
+            } else {
+                ++buses[i].receiveBudgetExhausted;
+            }
+        }
     }
+    firstBus = (firstBus + 1) % busCount;
 }
 
 void initializeIO() {
@@ -235,6 +299,9 @@ void initializeVehicleInterface() {
             getCanBuses(), getCanBusCount(),
             getConfiguration()->obd2BusAddress);
     signals::initialize(&getConfiguration()->diagnosticsManager);
+    can::bindSignalManagers(getSignals(), signals::getSignalManagers(),
+            getSignalCount());
+    can::bindMessageSignals(getSignals(), getSignalCount());
     getConfiguration()->runLevel = RunLevel::CAN_ONLY;
 
     if(getConfiguration()->powerManagement ==
@@ -258,19 +325,19 @@ void firmwareLoop() {
         initializeIO();
         
     }
+    // In normal operation, if no output interface is enabled/attached (e.g.
+    // no USB or Bluetooth, the loop will stall here. Deep down in
+    // receiveCan when it tries to append messages to the queue it will
+    // reach a point where it tries to flush the (full) queue. Since nothing
+    // is attached, that will just keep timing out. Just be aware that if
+    // you need to modify the firmware to not use any interfaces, you'll
+    // have to change that or enable the flush functionality to write to
+    // your desired output interface.
+    receiveAllCan(&getConfiguration()->pipeline, getCanBuses(),
+            getCanBusCount());
     for(int i = 0; i < getCanBusCount(); i++) {
-        // In normal operation, if no output interface is enabled/attached (e.g.
-        // no USB or Bluetooth, the loop will stall here. Deep down in
-        // receiveCan when it tries to append messages to the queue it will
-        // reach a point where it tries to flush the (full) queue. Since nothing
-        // is attached, that will just keep timing out. Just be aware that if
-        // you need to modify the firmware to not use any interfaces, you'll
-        // have to change that or enable the flush functionality to write to
-        // your desired output interface.
-        CanBus* bus = &(getCanBuses()[i]);
-        receiveCan(&getConfiguration()->pipeline, bus);
-        diagnostics::sendRequests(&getConfiguration()->diagnosticsManager, bus);
-        
+        diagnostics::sendRequests(&getConfiguration()->diagnosticsManager,
+                &(getCanBuses()[i]));
     }
 
     diagnostics::obd2::loop(&getConfiguration()->diagnosticsManager);